@@ -13,3 +13,4 @@ in the PhotoshopAPI repository.
 #include "LayeredFile/LayerTypes/GroupLayer.h"
 #include "LayeredFile/LayerTypes/SmartObjectLayer.h"
 #include "Util/Enum.h"
+#include "Util/Parallel.h"
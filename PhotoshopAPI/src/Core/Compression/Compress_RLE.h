@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 #include "Core/FileIO/Read.h"
 #include "Core/FileIO/Util.h"
 #include "Util/Logger.h"
@@ -10,9 +11,13 @@
 #include "Core/Struct/ByteStream.h"
 #include "PhotoshopFile/FileHeader.h"
 #include "Util/Profiling/Perf/Instrumentor.h"
+#include "Util/CPUFeatures.h"
 
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <numeric>
+#include <bit>
 
 #include <cstring>
 #include <inttypes.h>
@@ -31,225 +36,233 @@ PSAPI_NAMESPACE_BEGIN
 
 namespace RLE_Impl
 {
-    // This is the packbits algorithm described here: https://en.wikipedia.org/wiki/PackBits we iterate byte by byte and 
-    // compress. The logic is heavily adapted from MolecularMatters and credit goes to them:
-    // https://github.com/MolecularMatters/psd_sdk/blob/master/src/Psd/PsdDecompressRle.cpp
-    // We assume a compression of a single scanline as they are all independant of each other
+    // The scanners split a scanline into the PackBits tokens, the encoding itself lives in EncodePackBits. We encode
+    // every sequence of at least 2 equal bytes as a run while everything in between becomes a literal, both of these
+    // being limited to 128 bytes.
     // ---------------------------------------------------------------------------------------------------------------------
     // ---------------------------------------------------------------------------------------------------------------------
-    inline std::vector<uint8_t> CompressPackBits(const std::span<const uint8_t> uncompressedScanline, uint32_t& scanlineSize)
+    struct ScalarScanner
     {
-        // We assume a ~4x compression ratio for RLE to avoid continuously reserving more size
-        std::vector<uint8_t> compressedData;
-        compressedData.reserve(uncompressedScanline.size() / 4);
-
-        // Keep track of how long our run / no run is
-        uint8_t runLen = 0u;
-        uint8_t nonRunLen = 0u;
+        // Length of the run of bytes equal to data[0], at most maxLen
+        static size_t RunLength(const uint8_t* data, const size_t maxLen)
+        {
+            size_t len = 1;
+            while (len < maxLen && data[len] == data[0])
+            {
+                ++len;
+            }
+            return len;
+        }
 
-        for (int i = 1; i < uncompressedScanline.size(); ++i)
+        // Length of the literal starting at data[0], i.e. the number of bytes until the next run of at least 2 bytes
+        // starts. available is the number of bytes left in the scanline
+        static size_t LiteralLength(const uint8_t* data, const size_t available)
         {
-            const uint8_t prev = uncompressedScanline[i - 1];
-            const uint8_t curr = uncompressedScanline[i];
+            const size_t maxLen = std::min<size_t>(128u, available);
+            size_t len = 1;
+            while (len < maxLen && !(len + 1 < available && data[len] == data[len + 1]))
+            {
+                ++len;
+            }
+            return len;
+        }
+    };
+
 
-            // We have a run of at least 2 bytes
-            if (prev == curr)
+#ifdef PSAPI_SIMD_AVX2
+    // Same as ScalarScanner but comparing 32 bytes at a time, the remainder is handled scalar
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    struct AVX2Scanner
+    {
+        PSAPI_TARGET_AVX2 static size_t RunLength(const uint8_t* data, const size_t maxLen)
+        {
+            const __m256i value = _mm256_set1_epi8(static_cast<char>(data[0]));
+            size_t len = 1;
+            for (; len + 32 <= maxLen; len += 32)
             {
-                if (nonRunLen != 0)
+                const __m256i curr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + len));
+                const uint32_t mismatch = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(curr, value)));
+                if (mismatch != 0)
                 {
-                    // End the non run len and store how long our non run length is in the header byte
-                    compressedData.push_back(nonRunLen - 1u);
-                    for (int j = 0; j < nonRunLen; ++j)
-                    {
-                        compressedData.push_back(uncompressedScanline[i - nonRunLen - 1u + j]);
-                    }
-                    nonRunLen = 0;
+                    return len + std::countr_zero(mismatch);
                 }
+            }
+            while (len < maxLen && data[len] == data[0])
+            {
+                ++len;
+            }
+            return len;
+        }
 
-                ++runLen;
-
-                // runs cant be any longer than this due to the way that they are encoded so we are forced to terminate here
-                if (runLen == 128u)
+        PSAPI_TARGET_AVX2 static size_t LiteralLength(const uint8_t* data, const size_t available)
+        {
+            const size_t maxLen = std::min<size_t>(128u, available);
+            size_t len = 1;
+            // Compare each byte with its successor, each iteration reads one byte past the 32 bytes it checks
+            for (; len < maxLen && len + 33 <= available; len += 32)
+            {
+                const __m256i curr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + len));
+                const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + len + 1));
+                const uint32_t equal = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(curr, next)));
+                if (equal != 0)
                 {
-                    compressedData.push_back(static_cast<uint8_t>(257u - runLen));
-                    compressedData.push_back(curr);
-                    runLen = 0u;
+                    return std::min(len + std::countr_zero(equal), maxLen);
                 }
             }
-            else
+            while (len < maxLen && !(len + 1 < available && data[len] == data[len + 1]))
             {
-                // End the run if there is one going on
-                if (runLen != 0)
-                {
-                    ++runLen;
+                ++len;
+            }
+            return std::min(len, maxLen);
+        }
+    };
+#endif
 
-                    compressedData.push_back(static_cast<uint8_t>(257u - runLen));
-                    compressedData.push_back(prev);
-                    runLen = 0u;
-                }
-                else
+
+    // This is the packbits algorithm described here: https://en.wikipedia.org/wiki/PackBits. Encodes a single scanline
+    // (as they are all independant of each other) into compressedData and returns the number of bytes written including
+    // the padding to 2 bytes. If Write is false we only compute the size which allows laying out all the scanlines 
+    // before compressing them. The logic was originally adapted from MolecularMatters and credit goes to them:
+    // https://github.com/MolecularMatters/psd_sdk/blob/master/src/Psd/PsdDecompressRle.cpp
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    template <typename Scanner, bool Write>
+    inline size_t EncodePackBits(const std::span<const uint8_t> uncompressedScanline, [[maybe_unused]] uint8_t* compressedData)
+    {
+        const uint8_t* data = uncompressedScanline.data();
+        const size_t size = uncompressedScanline.size();
+        size_t bytesWritten = 0u;
+        size_t i = 0u;
+        while (i < size)
+        {
+            if (i + 1 < size && data[i] == data[i + 1])
+            {
+                const size_t runLen = Scanner::RunLength(data + i, std::min<size_t>(128u, size - i));
+                if constexpr (Write)
                 {
-                    ++nonRunLen;
+                    compressedData[bytesWritten] = static_cast<uint8_t>(257u - runLen);
+                    compressedData[bytesWritten + 1] = data[i];
                 }
-
-                // Same as the termination condition on run lengths
-                if (nonRunLen == 128u)
+                bytesWritten += 2u;
+                i += runLen;
+            }
+            else
+            {
+                const size_t nonRunLen = Scanner::LiteralLength(data + i, size - i);
+                if constexpr (Write)
                 {
-                    compressedData.push_back(nonRunLen - 1u);
-                    for (int j = 0; j < nonRunLen; ++j)
-                    {
-                        compressedData.push_back(uncompressedScanline[i - nonRunLen + j]);
-                    }
-                    nonRunLen = 0;
+                    compressedData[bytesWritten] = static_cast<uint8_t>(nonRunLen - 1u);
+                    std::memcpy(compressedData + bytesWritten + 1, data + i, nonRunLen);
                 }
+                bytesWritten += nonRunLen + 1u;
+                i += nonRunLen;
             }
         }
 
-        // After having iterated all the items we must now encode the last item
-        if (runLen != 0)
-        {
-            ++runLen;
-            // Push back the last element as the run
-            compressedData.push_back(static_cast<uint8_t>(257u - runLen));
-            compressedData.push_back(uncompressedScanline[uncompressedScanline.size() - 1u]);
-        }
-        else
+        // The section is padded to 2 bytes, if we need to insert a padding byte we use the no-op
+        // value of 128
+        if (bytesWritten % 2 != 0)
         {
-            ++nonRunLen;
-            compressedData.push_back(nonRunLen - 1u);
-            for (int j = 0; j < nonRunLen; ++j)
+            if constexpr (Write)
             {
-                compressedData.push_back(uncompressedScanline[uncompressedScanline.size() - nonRunLen + j]);
+                compressedData[bytesWritten] = 128u;
             }
-            nonRunLen = 0;
+            ++bytesWritten;
         }
+        return bytesWritten;
+    }
 
-        // The section is padded to 2 bytes, if we need to insert a padding byte we use the no-op
-        // value of 128
-        if (compressedData.size() % 2 != 0)
+
+#ifdef PSAPI_SIMD_AVX2
+    template <bool Write>
+    PSAPI_TARGET_AVX2 size_t EncodePackBitsAVX2(const std::span<const uint8_t> uncompressedScanline, uint8_t* compressedData)
+    {
+        return EncodePackBits<AVX2Scanner, Write>(uncompressedScanline, compressedData);
+    }
+#endif
+
+
+    // Compute the size the scanline will have once PackBits compressed including the padding
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline size_t CompressedPackBitsSize(const std::span<const uint8_t> uncompressedScanline)
+    {
+#ifdef PSAPI_SIMD_AVX2
+        if (CPU::hasAVX2())
         {
-            compressedData.push_back(128u);
+            return EncodePackBitsAVX2<false>(uncompressedScanline, nullptr);
         }
-
-        // Store and return
-        scanlineSize = static_cast<uint32_t>(compressedData.size());
-        return compressedData;
+#endif
+        return EncodePackBits<ScalarScanner, false>(uncompressedScanline, nullptr);
     }
 
 
-    // This is the packbits algorithm described here: https://en.wikipedia.org/wiki/PackBits we iterate byte by byte and 
-    // compress. We use the buffer to store our compressed data and return a span at the same memory address but with the 
-    // actual compressed size
+    // PackBits compress the scanline into the buffer which must be at least CompressedPackBitsSize() large and return a
+    // span at the same memory address but with the actual compressed size
     // ---------------------------------------------------------------------------------------------------------------------
     // ---------------------------------------------------------------------------------------------------------------------
     inline std::span<uint8_t> CompressPackBits(const std::span<const uint8_t> uncompressedScanline, std::span<uint8_t> buffer)
     {
-        // Total bytes written, used to generate a new span in the end with the correct sizing
-        uint32_t bytesWritten = 0u;
-        // Keep track of how long our run / no run is
-        uint8_t runLen = 0u;
-        uint8_t nonRunLen = 0u;
-
-        for (int i = 1; i < uncompressedScanline.size(); ++i)
+#ifdef PSAPI_SIMD_AVX2
+        if (CPU::hasAVX2())
         {
-            const uint8_t prev = uncompressedScanline[i - 1];
-            const uint8_t curr = uncompressedScanline[i];
+            return std::span<uint8_t>(buffer.data(), EncodePackBitsAVX2<true>(uncompressedScanline, buffer.data()));
+        }
+#endif
+        return std::span<uint8_t>(buffer.data(), EncodePackBits<ScalarScanner, true>(uncompressedScanline, buffer.data()));
+    }
 
-            // We have a run of at least 2 bytes
-            if (prev == curr)
-            {
-                if (nonRunLen != 0)
-                {
-                    // End the non run len and store how long our non run length is in the header byte
-                    buffer[bytesWritten] = (nonRunLen - 1u);
-                    ++bytesWritten;
-                    for (int j = 0; j < nonRunLen; ++j)
-                    {
-                        buffer[bytesWritten] = uncompressedScanline[i - nonRunLen - 1u + j];
-                        ++bytesWritten;
-                    }
-                    nonRunLen = 0;
-                }
-                ++runLen;
 
-                // runs cant be any longer than this due to the way that they are encoded so we are forced to terminate here
-                if (runLen == 128u)
-                {
-                    buffer[bytesWritten] = static_cast<uint8_t>(257u - runLen);
-                    ++bytesWritten;
-                    buffer[bytesWritten] = curr;
-                    ++bytesWritten;
-                    runLen = 0u;
-                }
-            }
-            else
-            {
-                // End the run if there is one going on
-                if (runLen != 0)
-                {
-                    ++runLen;
+    // PackBits compress the scanline into a newly allocated vector, storing its size in scanlineSize
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline std::vector<uint8_t> CompressPackBits(const std::span<const uint8_t> uncompressedScanline, uint32_t& scanlineSize)
+    {
+        std::vector<uint8_t> compressedData(CompressedPackBitsSize(uncompressedScanline));
+        CompressPackBits(uncompressedScanline, compressedData);
+        scanlineSize = static_cast<uint32_t>(compressedData.size());
+        return compressedData;
+    }
 
-                    buffer[bytesWritten] = static_cast<uint8_t>(257u - runLen);
-                    ++bytesWritten;
-                    buffer[bytesWritten] = prev;
-                    ++bytesWritten;
 
-                    runLen = 0u;
-                }
-                else
-                {
-                    ++nonRunLen;
-                }
-
-                // Same as the termination condition on run lengths
-                if (nonRunLen == 128u)
-                {
-                    buffer[bytesWritten] = (nonRunLen - 1u);
-                    ++bytesWritten;
-                    for (int j = 0; j < nonRunLen; ++j)
-                    {
-                        buffer[bytesWritten] = uncompressedScanline[i - nonRunLen + j];
-                        ++bytesWritten;
-                    }
-                    nonRunLen = 0;
-                }
-            }
-        }
+    // PackBits compress all the scanlines of the (already big endian encoded) channel and append them to compressedData 
+    // at offset, returning the compressed size of each of the scanlines. We first compute all the scanline sizes such 
+    // that every scanline can be compressed in parallel directly into its final position
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    template <typename T>
+    std::vector<uint32_t> CompressScanlines(std::span<const T> uncompressedData, const uint32_t width, const uint32_t height, std::vector<uint8_t>& compressedData, const size_t offset)
+    {
+        PSAPI_PROFILE_FUNCTION();
+        const size_t scanlineSize = static_cast<size_t>(width) * sizeof(T);
+        const auto scanline = [&](uint32_t y)
+            {
+                return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(uncompressedData.data()) + y * scanlineSize, scanlineSize);
+            };
 
-        // After having iterated all the items we must now encode the last item
-        if (runLen != 0)
-        {
-            ++runLen;
-            // Push back the last element as the run
-            buffer[bytesWritten] = static_cast<uint8_t>(257u - runLen);
-            ++bytesWritten;
-            buffer[bytesWritten] = uncompressedScanline[uncompressedScanline.size() - 1u];
-            ++bytesWritten;
-        }
-        else
-        {
-            ++nonRunLen;
-            buffer[bytesWritten] = nonRunLen - 1u;
-            ++bytesWritten;
-            for (int j = 0; j < nonRunLen; ++j)
+        std::vector<uint32_t> verticalIter(height);
+        std::iota(verticalIter.begin(), verticalIter.end(), 0u);
+        std::vector<uint32_t> scanlineSizes(height);
+        Parallel::forEach(verticalIter.begin(), verticalIter.end(), [&](uint32_t y)
             {
-                
-                buffer[bytesWritten] = uncompressedScanline[uncompressedScanline.size() - nonRunLen + j];
-                ++bytesWritten;
-            }
-            nonRunLen = 0;
-        }
+                scanlineSizes[y] = static_cast<uint32_t>(CompressedPackBitsSize(scanline(y)));
+            });
 
-        // The section is padded to 2 bytes, if we need to insert a padding byte we use the no-op
-        // value of 128
-        if (bytesWritten % 2 != 0)
+        std::vector<size_t> scanlineOffsets(height);
+        size_t totalSize = offset;
+        for (uint32_t y = 0; y < height; ++y)
         {
-            buffer[bytesWritten] = 128u;
-            ++bytesWritten;
+            scanlineOffsets[y] = totalSize;
+            totalSize += scanlineSizes[y];
         }
+        compressedData.resize(totalSize);
 
-        // Generate a "resized" span and return it
-        return std::span<uint8_t>(buffer.data(), bytesWritten);
+        Parallel::forEach(verticalIter.begin(), verticalIter.end(), [&](uint32_t y)
+            {
+                CompressPackBits(scanline(y), std::span<uint8_t>(compressedData.data() + scanlineOffsets[y], scanlineSizes[y]));
+            });
+        return scanlineSizes;
     }
 
 
@@ -292,86 +305,39 @@ namespace RLE_Impl
 
 
 // Compresses a single channel using the packbits algorithm into a binary array as well as big endian encoding it. Returns a binary vector of data
-// with the size of each scanline as either a 2- or 4-byte unsigned int preceding it
+// with the size of each scanline as either a 2- or 4-byte unsigned int preceding it. Unlike the other codecs no intermediate buffer 
+// is required as every scanline is compressed directly into its final position
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template<typename T>
-std::vector<uint8_t> CompressRLE(std::span<T> uncompressedData, std::span<uint8_t> buffer, const FileHeader& header, const uint32_t width, const uint32_t height)
+std::vector<uint8_t> CompressRLE(std::span<T> uncompressedData, const FileHeader& header, const uint32_t width, const uint32_t height)
 {
     PSAPI_PROFILE_FUNCTION();
     endianEncodeBEArray(uncompressedData);
 
-    // Generate spans for uncompressed as well as compressed data such that each thread
-    // can decode in parallel and we can memcpy at the end 
-    size_t maxScanlineSize = RLE_Impl::MaxCompressedSize<T>(header, 1, width, false);
-    if (maxScanlineSize * height > buffer.size())
-        PSAPI_LOG_ERROR("RLE", "Was passed incorrectly sized buffer, expected at least %zu bytes but instead got %zu bytes", maxScanlineSize * height, buffer.size());
-    std::vector<std::span<const uint8_t>> uncompressedDataViews;
-    std::vector<std::span<uint8_t>> compressedDataViews;
-    std::vector<uint32_t> verticalIter;
-    for (uint32_t i = 0; i < height; ++i)
-    {
-        std::span<const uint8_t> uncompressedView(reinterpret_cast<const uint8_t*>(uncompressedData.data() + width * i), width * sizeof(T));
-        uncompressedDataViews.push_back(uncompressedView);
-        std::span<uint8_t> compressedView(buffer.data() + i * maxScanlineSize, maxScanlineSize);
-        compressedDataViews.push_back(compressedView);
-        verticalIter.push_back(i);
-    }
-
-    // Compress each scanline while additionally overwriting the compressedDataViews with a properly sized span
-    // rather than aligned to maxScanlineSize
-    std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(), [&](const auto index)
-        {
-            compressedDataViews[index] = RLE_Impl::CompressPackBits(uncompressedDataViews[index], compressedDataViews[index]);
-        });
-
-    // We now take the data out of the buffer and copy them over in parallel
+    // Leave space for the scanline sizes at the start of the data which we fill in at the end
+    const size_t scanlineSizesSize = static_cast<size_t>(SwapPsdPsb<uint16_t, uint32_t>(header.m_Version)) * height;
     std::vector<uint8_t> compressedData;
+    std::vector<uint32_t> scanlineSizes = RLE_Impl::CompressScanlines(std::span<const T>(uncompressedData), width, height, compressedData, scanlineSizesSize);
+
     if (header.m_Version == Enum::Version::Psd)
     {
-        std::vector<size_t> scanlineOffsets;
-        std::vector<uint16_t> scanlineSizes;
-        size_t totalSize = height * sizeof(uint16_t);
+        std::vector<uint16_t> scanlineSizesu16(height);
         for (uint32_t y = 0; y < height; ++y)
         {
-            scanlineOffsets.push_back(totalSize);
-            scanlineSizes.push_back(static_cast<uint16_t>(compressedDataViews[y].size()));
-            totalSize += compressedDataViews[y].size();
-        }
-        compressedData = std::vector<uint8_t>(totalSize);
-
-        std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(), [&](const auto index)
+            if (scanlineSizes[y] > (std::numeric_limits<uint16_t>::max)()) [[unlikely]]
             {
-                const uint8_t* srcAddress = compressedDataViews[index].data();
-                uint8_t* dstAddress = compressedData.data() + scanlineOffsets[index];
-                std::memcpy(dstAddress, srcAddress, compressedDataViews[index].size());
-            });
-        // We deliberately only copy over the scanline sizes at the end since they need to be endian swapped first
-        endianEncodeBEArray(std::span<uint16_t>(scanlineSizes));
-        std::memcpy(compressedData.data(), reinterpret_cast<uint8_t*>(scanlineSizes.data()), height * sizeof(uint16_t));
+                PSAPI_LOG_ERROR("CompressRLE", "Scanline sizes cannot exceed the numeric limits of 16-bit values when writing a PSD file");
+            }
+            scanlineSizesu16[y] = static_cast<uint16_t>(scanlineSizes[y]);
+        }
+        endianEncodeBEArray(std::span<uint16_t>(scanlineSizesu16));
+        std::memcpy(compressedData.data(), reinterpret_cast<uint8_t*>(scanlineSizesu16.data()), scanlineSizesSize);
     }
     else
     {
-        std::vector<size_t> scanlineOffsets;
-        std::vector<uint32_t> scanlineSizes;
-        size_t totalSize = height * sizeof(uint32_t);
-        for (uint32_t y = 0; y < height; ++y)
-        {
-            scanlineOffsets.push_back(totalSize);
-            scanlineSizes.push_back(static_cast<uint32_t>(compressedDataViews[y].size()));
-            totalSize += compressedDataViews[y].size();
-        }
-        compressedData = std::vector<uint8_t>(totalSize);
-
-        std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(), [&](auto& index)
-            {
-                const uint8_t* srcAddress = compressedDataViews[index].data();
-                uint8_t* dstAddress = compressedData.data() + scanlineOffsets[index];
-                std::memcpy(dstAddress, srcAddress, compressedDataViews[index].size());
-            });
-        // We deliberately only copy over the scanline sizes at the end since they need to be endian swapped first
         endianEncodeBEArray(std::span<uint32_t>(scanlineSizes));
-        std::memcpy(compressedData.data(), reinterpret_cast<uint8_t*>(scanlineSizes.data()), height * sizeof(uint32_t));
+        std::memcpy(compressedData.data(), reinterpret_cast<uint8_t*>(scanlineSizes.data()), scanlineSizesSize);
     }
 
     return compressedData;
@@ -386,52 +352,7 @@ std::vector<uint8_t> CompressRLE(std::span<T> uncompressedData, std::span<uint8_
 template<typename T>
 std::vector<uint8_t> CompressRLE(std::vector<T>& uncompressedData, const FileHeader& header, const uint32_t width, const uint32_t height)
 {
-    PSAPI_PROFILE_FUNCTION();
-    endianEncodeBEArray(std::span<T>(uncompressedData));
-
-    std::vector<std::span<uint8_t>> uncompressedDataViews;
-    for (int i = 0; i < height; ++i)
-    {
-        // Generate a span for each scanline
-        std::span<uint8_t> data(reinterpret_cast<uint8_t*>(uncompressedData.data() + width * i), width * sizeof(T));
-        uncompressedDataViews.push_back(data);
-    }
-
-    // Allocate the size required for all the scanline sizes ahead of time
-    std::vector<uint8_t> compressedData(SwapPsdPsb<uint16_t, uint32_t>(header.m_Version) * height, 0u);
-    // Compress each scanline of the uncompressed data individually and push it into the compressed data
-    // While also filling out the scanlineSizes vector
-    for (int i = 0; i < uncompressedDataViews.size(); ++i)
-    {
-        uint32_t scanlineSize = 0u;
-        std::vector<uint8_t> data = RLE_Impl::CompressPackBits(uncompressedDataViews[i], scanlineSize);
-
-        // Insert the scanline size at the start of the data in our pre-allocated buffer.
-        // For PSD we must shrink the value to uint16_t
-        const size_t scanlineIndex = i * SwapPsdPsb<uint16_t, uint32_t>(header.m_Version);
-        if (header.m_Version == Enum::Version::Psd)
-        {
-            if (scanlineSize > (std::numeric_limits<uint16_t>::max)()) [[unlikely]]
-                {
-                    PSAPI_LOG_ERROR("CompressRLE", "Scanline sizes cannot exceed the numeric limits of 16-bit values when writing a PSD file");
-                }
-                uint16_t scanlineSizeu16 = static_cast<uint16_t>(scanlineSize);
-                scanlineSizeu16 = endian_encode_be(scanlineSizeu16);
-                // Set the data at the correct index
-                std::memcpy(reinterpret_cast<void*>(compressedData.data() + scanlineIndex), &scanlineSizeu16, sizeof(uint16_t));
-        }
-        else
-        {
-            scanlineSize = endian_encode_be(scanlineSize);
-            std::memcpy(reinterpret_cast<void*>(compressedData.data() + scanlineIndex), &scanlineSize, sizeof(uint32_t));
-        }
-
-        // Since our compressed data has the scanline sizes preallocated we can just insert at the end and that will be correct
-        compressedData.insert(std::end(compressedData), std::begin(data), std::end(data));
-    }
-
-
-    return compressedData;
+    return CompressRLE(std::span<T>(uncompressedData), header, width, height);
 }
 
 
@@ -445,32 +366,15 @@ std::vector<uint8_t> CompressRLEImageDataPsd(std::vector<T>& uncompressedData, c
     PSAPI_PROFILE_FUNCTION();
     endianEncodeBEArray(std::span<T>(uncompressedData));
 
-    std::vector<std::span<uint8_t>> uncompressedDataViews;
-    for (uint32_t i = 0; i < height; ++i)
-    {
-        // Generate a span for each scanline
-        std::span<uint8_t> data(reinterpret_cast<uint8_t*>(uncompressedData.data() + width * i), width * sizeof(T));
-        uncompressedDataViews.push_back(data);
-    }
-
-    std::vector<uint8_t> compressedData = {};
-    // Compress each scanline of the uncompressed data individually and push it into the compressed data
-    // While also filling out the scanlineSizes vector
-    for (int i = 0; i < uncompressedDataViews.size(); ++i)
+    std::vector<uint8_t> compressedData;
+    for (const auto scanlineSize : RLE_Impl::CompressScanlines(std::span<const T>(uncompressedData), width, height, compressedData, 0u))
     {
-        uint32_t scanlineSize = 0u;
-        std::vector<uint8_t> data = RLE_Impl::CompressPackBits(uncompressedDataViews[i], scanlineSize);
-
         if (scanlineSize > (std::numeric_limits<uint16_t>::max)()) [[unlikely]]
-            {
-                PSAPI_LOG_ERROR("CompressRLE", "Scanline size would exceed the size of a uint16_t, this is not valid");
-            }
-            scanlineSizes.push_back(static_cast<uint16_t>(scanlineSize));
-
-            // Since our compressed data has the scanline sizes preallocated we can just insert at the end and that will be correct
-            compressedData.insert(std::end(compressedData), std::begin(data), std::end(data));
+        {
+            PSAPI_LOG_ERROR("CompressRLE", "Scanline size would exceed the size of a uint16_t, this is not valid");
+        }
+        scanlineSizes.push_back(static_cast<uint16_t>(scanlineSize));
     }
-
     return compressedData;
 }
 
@@ -485,28 +389,9 @@ std::vector<uint8_t> CompressRLEImageDataPsb(std::vector<T>& uncompressedData, c
     PSAPI_PROFILE_FUNCTION();
     endianEncodeBEArray(std::span<T>(uncompressedData));
 
-    std::vector<std::span<uint8_t>> uncompressedDataViews;
-    for (uint32_t i = 0; i < height; ++i)
-    {
-        // Generate a span for each scanline
-        std::span<uint8_t> data(reinterpret_cast<uint8_t*>(uncompressedData.data() + width * i), width * sizeof(T));
-        uncompressedDataViews.push_back(data);
-    }
-
-    std::vector<uint8_t> compressedData = {};
-    // Compress each scanline of the uncompressed data individually and push it into the compressed data
-    // While also filling out the scanlineSizes vector
-    for (int i = 0; i < uncompressedDataViews.size(); ++i)
-    {
-        uint32_t scanlineSize = 0u;
-        std::vector<uint8_t> data = RLE_Impl::CompressPackBits(uncompressedDataViews[i], scanlineSize);
-
-        scanlineSizes.push_back(scanlineSize);
-
-        // Since our compressed data has the scanline sizes preallocated we can just insert at the end and that will be correct
-        compressedData.insert(std::end(compressedData), std::begin(data), std::end(data));
-    }
-
+    std::vector<uint8_t> compressedData;
+    std::vector<uint32_t> sizes = RLE_Impl::CompressScanlines(std::span<const T>(uncompressedData), width, height, compressedData, 0u);
+    scanlineSizes.insert(scanlineSizes.end(), sizes.begin(), sizes.end());
     return compressedData;
 }
 
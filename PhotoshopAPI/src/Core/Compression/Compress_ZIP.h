@@ -1,9 +1,12 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 #include "Util/Logger.h"
 #include "CompressionUtil.h"
+#include "DeflateStream.h"
 #include "InterleavedToPlanar.h"
+#include "Prediction.h"
 #include "Core/Endian/EndianByteSwap.h"
 #include "Core/Endian/EndianByteSwapArr.h"
 #include "Core/Struct/ByteStream.h"
@@ -12,10 +15,12 @@
 #include "libdeflate.h"
 
 #include <algorithm>
-#include <execution>
+#include <array>
 #include <vector>
 #include <cstring>
 #include <bit>
+#include <stdexcept>
+#include <string>
 
 
 // If we compile with C++<20 we replace the stdlib implementation with the compatibility
@@ -32,6 +37,202 @@ PSAPI_NAMESPACE_BEGIN
 
 namespace ZIP_Impl
 {
+	// Per-thread cache of libdeflate compressors, one for each compression level. Allocating a compressor is fairly
+	// expensive (it allocates several hundred KB) so we keep them around for the lifetime of the thread rather than
+	// creating one per layer.
+	struct CompressorCache
+	{
+		std::array<libdeflate_compressor*, ZIP_MAX_COMPRESSION_LVL + 1> compressors{};
+
+		CompressorCache() = default;
+		CompressorCache(const CompressorCache&) = delete;
+		CompressorCache& operator=(const CompressorCache&) = delete;
+
+		~CompressorCache()
+		{
+			for (auto* compressor : compressors)
+			{
+				if (compressor)
+				{
+					libdeflate_free_compressor(compressor);
+				}
+			}
+		}
+	};
+
+
+	// Check that the given compression level is within the range supported by libdeflate, throwing a 
+	// std::invalid_argument if it is not.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline void ValidateCompressionLevel(const int compressionLevel)
+	{
+		if (compressionLevel < ZIP_MIN_COMPRESSION_LVL || compressionLevel > ZIP_MAX_COMPRESSION_LVL)
+		{
+			throw std::invalid_argument("Invalid zip compression level " + std::to_string(compressionLevel) + " encountered, expected a value between "
+				+ std::to_string(ZIP_MIN_COMPRESSION_LVL) + " and " + std::to_string(ZIP_MAX_COMPRESSION_LVL));
+		}
+	}
+
+
+	// Get the compressor for the given compression level owned by the calling thread, it must therefore not be shared
+	// across threads. The compressor is only valid for as long as the thread is alive.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline libdeflate_compressor* GetCompressor(const int compressionLevel)
+	{
+		ValidateCompressionLevel(compressionLevel);
+		thread_local CompressorCache cache;
+		auto& compressor = cache.compressors[compressionLevel];
+		if (!compressor)
+		{
+			PSAPI_PROFILE_SCOPE("Allocate compressor");
+			compressor = libdeflate_alloc_compressor(compressionLevel);
+			if (!compressor)
+			{
+				PSAPI_LOG_ERROR("Zip", "Unable to allocate a compressor with compression level %i", compressionLevel);
+			}
+		}
+		return compressor;
+	}
+
+
+	// Get the second byte of the zlib header (FLG) for the given compression level, these are the same values libdeflate
+	// writes. zlib differs in marking level 7 as its slowest compression (0xDA), the level is purely informational though
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline uint8_t ZlibHeaderByte(const int compressionLevel)
+	{
+		if (compressionLevel < 2)
+		{
+			return 0x01;
+		}
+		else if (compressionLevel < 6)
+		{
+			return 0x5E;
+		}
+		else if (compressionLevel < 8)
+		{
+			return 0x9C;
+		}
+		return 0xDA;
+	}
+
+
+	// Get the number of chunks the given number of input bytes are split into for parallel compression, a value of 1
+	// means the data is compressed in a single call
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline size_t ChunkCount(const size_t inputBytes)
+	{
+		if (inputBytes < ZIP_PARALLEL_MIN_SIZE)
+		{
+			return 1;
+		}
+		return (inputBytes + ZIP_PARALLEL_CHUNK_SIZE - 1) / ZIP_PARALLEL_CHUNK_SIZE;
+	}
+
+
+	// Get the scratch buffer size required to compress a single chunk of the given size, this includes the room for 
+	// the empty stored block terminating each chunk (see Deflate_Impl::MakeNonFinal())
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline size_t ChunkBound(const size_t chunkBytes, const int compressionLevel)
+	{
+		return libdeflate_deflate_compress_bound(GetCompressor(compressionLevel), chunkBytes) + 5;
+	}
+
+
+	// Get the maximum size the zlib stream of the given number of input bytes may take up when compressed with the 
+	// given level, this is the size the scratch buffer passed to Compress() must have
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline size_t CompressBound(const size_t inputBytes, const int compressionLevel = ZIP_COMPRESSION_LVL)
+	{
+		const size_t numChunks = ChunkCount(inputBytes);
+		if (numChunks == 1)
+		{
+			return libdeflate_zlib_compress_bound(GetCompressor(compressionLevel), inputBytes);
+		}
+		const size_t lastChunkBytes = inputBytes - (numChunks - 1) * ZIP_PARALLEL_CHUNK_SIZE;
+		return (numChunks - 1) * ChunkBound(ZIP_PARALLEL_CHUNK_SIZE, compressionLevel) + ChunkBound(lastChunkBytes, compressionLevel);
+	}
+
+
+	// Deflate the input in chunks of ZIP_PARALLEL_CHUNK_SIZE in parallel and append them to the compressed data as one
+	// continuous deflate stream. Each chunk is compressed into its own region of the buffer using the compressor of
+	// the thread it runs on, all but the last chunk are then made non-final. Returns the adler32 checksum of the input.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline uint32_t CompressChunked(std::span<const uint8_t> input, std::span<uint8_t> buffer, const int compressionLevel, std::vector<uint8_t>& compressedData)
+	{
+		PSAPI_PROFILE_FUNCTION();
+		struct Chunk
+		{
+			std::span<const uint8_t> input;
+			std::span<uint8_t> output;
+			size_t compressedSize = 0;
+			uint32_t adler32 = 1;
+		};
+
+		const size_t numChunks = ChunkCount(input.size());
+		std::vector<Chunk> chunks(numChunks);
+		size_t bufferOffset = 0;
+		for (size_t i = 0; i < numChunks; ++i)
+		{
+			const size_t inputOffset = i * ZIP_PARALLEL_CHUNK_SIZE;
+			const size_t chunkBytes = std::min(ZIP_PARALLEL_CHUNK_SIZE, input.size() - inputOffset);
+			const size_t chunkBound = ChunkBound(chunkBytes, compressionLevel);
+			if (bufferOffset + chunkBound > buffer.size())
+			{
+				PSAPI_LOG_ERROR("Zip", "Buffer is too small for chunked compression, expected at least %zu bytes but got %zu instead",
+					CompressBound(input.size(), compressionLevel), buffer.size());
+			}
+			chunks[i].input = input.subspan(inputOffset, chunkBytes);
+			chunks[i].output = buffer.subspan(bufferOffset, chunkBound);
+			bufferOffset += chunkBound;
+		}
+
+		Parallel::forEach(chunks.begin(), chunks.end(), [&](Chunk& chunk)
+			{
+				libdeflate_compressor* compressor = GetCompressor(compressionLevel);
+				// Leave room for the stored block appended by MakeNonFinal()
+				chunk.compressedSize = libdeflate_deflate_compress(compressor, chunk.input.data(), chunk.input.size(), 
+					chunk.output.data(), chunk.output.size() - 5);
+				if (chunk.compressedSize == 0)
+				{
+					PSAPI_LOG_ERROR("Zip", "Compression failed");
+				}
+				if (&chunk != &chunks.back())
+				{
+					chunk.compressedSize = Deflate_Impl::MakeNonFinal(chunk.output, chunk.compressedSize);
+				}
+				chunk.adler32 = libdeflate_adler32(1, chunk.input.data(), chunk.input.size());
+			});
+
+		uint32_t adler32Checksum = chunks.front().adler32;
+		size_t totalSize = 0;
+		for (size_t i = 0; i < numChunks; ++i)
+		{
+			totalSize += chunks[i].compressedSize;
+			if (i > 0)
+			{
+				adler32Checksum = Deflate_Impl::Adler32Combine(adler32Checksum, chunks[i].adler32, chunks[i].input.size());
+			}
+		}
+
+		{
+			PSAPI_PROFILE_SCOPE("Zip Insert buffer");
+			compressedData.reserve(compressedData.size() + totalSize + sizeof(uint32_t));
+			for (const auto& chunk : chunks)
+			{
+				compressedData.insert(compressedData.end(), chunk.output.begin(), chunk.output.begin() + chunk.compressedSize);
+			}
+		}
+		return adler32Checksum;
+	}
+
+
 	// Prediction encode the data per scanline while also big endian converting it
 	// The buffer parameter must match the bytesize of the data vector
 	// ---------------------------------------------------------------------------------------------------------------------
@@ -42,21 +243,28 @@ namespace ZIP_Impl
 		if (data.size() > buffer.size() * sizeof(T))
 			PSAPI_LOG_ERROR("PredictionEncode", "Buffer size does not match data size, expected at least %zu bytes but got %zu instead", data.size() * sizeof(T), buffer.size());
 		PSAPI_PROFILE_FUNCTION();
-		for (uint32_t y = 0; y < height; ++y)
-		{
-			// Initialize the prediction encoding for the current scanline
-			T prev = data[static_cast<uint64_t>(width) * y];
-			for (uint32_t x = 1; x < width; ++x)
+		std::vector<uint32_t> verticalIter = createVerticalImageIterator(height);
+		Parallel::forEach(verticalIter.begin(), verticalIter.end(), [&](uint32_t y)
 			{
-				// Perform prediction encoding in-place
-				T current = data[static_cast<uint64_t>(width) * y + x];
-				data[static_cast<uint64_t>(width) * y + x] = current - prev;
-				prev = current;
-			}
-		}
-
-		// After performing prediction encoding, apply big-endian conversion
-		endianEncodeBEArray<T>(data);
+				std::span<T> scanline(data.data() + static_cast<uint64_t>(width) * y, width);
+				if constexpr (std::is_same_v<T, uint8_t>)
+				{
+					predictionEncodeRow(std::span<const uint8_t>(scanline), scanline);
+				}
+				else if constexpr (std::is_same_v<T, uint16_t>)
+				{
+					predictionEncodeRow(scanline);
+				}
+				else
+				{
+					for (uint32_t x = width; x > 1; --x)
+					{
+						// Perform prediction encoding in-place, back to front so the previous value is still intact
+						scanline[x - 1] = scanline[x - 1] - scanline[x - 2];
+					}
+					endianEncodeBEArray<T>(scanline);
+				}
+			});
 	}
 
 
@@ -74,95 +282,62 @@ namespace ZIP_Impl
 
 		std::span<uint8_t> byteDataView(reinterpret_cast<uint8_t*>(data.data()), data.size() * sizeof(float32_t));
 		std::vector<uint32_t> verticalIter = createVerticalImageIterator(height);
-		{
-			PSAPI_PROFILE_SCOPE("32-bit binary de-interleave");
-			// First de-interleave the data to planar byte order, i.e. going from 1234 1234 1234 1234 to 1111 2222 3333 4444
-			// We essentially split each scanline into 4 equal parts each holding the first, second, third and fourth of the original bytes
-			// We also convert to big endian order which is what is stored on disk
-			std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(), [&](uint32_t y)
-				{
-					// Binary view into the whole scanline
-					std::span<uint8_t> scanlineView(byteDataView.data() + y * width * sizeof(float32_t), width * sizeof(float32_t));
-					std::span<uint8_t> scanlineBuffer(buffer.data() + y * width * sizeof(float32_t), width * sizeof(float32_t));
-					interleavedToPlanarFloat(scanlineView, scanlineBuffer, width);
-					// Copy over the memory from the buffer into the data
-					std::memcpy(scanlineView.data(), scanlineBuffer.data(), scanlineView.size());
-				});
-		}
-
-		{
-			PSAPI_PROFILE_SCOPE("32-bit binary prediction encode");
-			// Perform the prediction encoding of the data, keep in mind that this is done byte by byte
-			std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(),
-				[&](uint32_t y)
-				{
-					// Generate a non-overlapping view of each row of the data
-					uint8_t* dataRowOffset = reinterpret_cast<uint8_t*>(data.data() + static_cast<uint64_t>(y) * width);
-					std::span<uint8_t> dataView(dataRowOffset, width * sizeof(float32_t));
 
-					uint8_t prev = dataView[0];
-					for (uint32_t x = 1; x < width * sizeof(float32_t); ++x)
-					{
-						uint8_t curr = dataView[x];
-						// Generate the difference between the current value and the next one and store it
-						dataView[x] = curr - prev;
-						prev = curr;
-					}
-				});
-		}
+		// First de-interleave the data to planar byte order, i.e. going from 1234 1234 1234 1234 to 1111 2222 3333 4444
+		// We essentially split each scanline into 4 equal parts each holding the first, second, third and fourth of the original bytes
+		// We also convert to big endian order which is what is stored on disk. The bytewise prediction encoding then
+		// writes the planar scanline back into the data
+		Parallel::forEach(verticalIter.begin(), verticalIter.end(), [&](uint32_t y)
+			{
+				const size_t scanlineSize = static_cast<size_t>(width) * sizeof(float32_t);
+				std::span<uint8_t> scanlineView(byteDataView.data() + y * scanlineSize, scanlineSize);
+				std::span<uint8_t> scanlineBuffer(buffer.data() + y * scanlineSize, scanlineSize);
+				interleavedToPlanarFloat(scanlineView, scanlineBuffer, width);
+				predictionEncodeRow(scanlineBuffer, scanlineView);
+			});
 	}
 
 
-	// Use libdeflate to deflate the incoming uncompressed data into the provided buffer using the compressor after which
-	// we insert the compressed data into an appropriately sized vector which we return.
+	// Use libdeflate to deflate the incoming uncompressed data into the provided buffer using this thread's compressor
+	// for the given level after which we insert the compressed data into an appropriately sized vector which we return.
 	// ---------------------------------------------------------------------------------------------------------------------
 	// ---------------------------------------------------------------------------------------------------------------------
 	template <typename T>
-	std::vector<uint8_t> Compress(const std::span<T> uncompressedData, std::span<uint8_t> buffer, libdeflate_compressor* compressor)
+	std::vector<uint8_t> Compress(const std::span<T> uncompressedData, std::span<uint8_t> buffer, const int compressionLevel)
 	{
 		PSAPI_PROFILE_FUNCTION();
 		std::vector<uint8_t> compressedData;
-		// These represent the header bytes of the zlib stream
-		const uint8_t compressionType = 0x78;
-		uint8_t compressionByte;
-		if constexpr (ZIP_COMPRESSION_LVL < 2)
-		{
-			compressionByte = 0x01;
-		}
-		else if constexpr(ZIP_COMPRESSION_LVL < 6)
-		{
-			compressionByte = 0x5E;
-		}
-		else if constexpr (ZIP_COMPRESSION_LVL < 8)
-		{
-			compressionByte = 0x9C;
-		}
-		else
-			compressionByte = 0xDA;
-		// Manually write the zlib header 
-		compressedData.push_back(compressionType);
-		compressedData.push_back(compressionByte);
+		// Manually write the zlib header, the first byte represents the compression method and window size
+		compressedData.push_back(0x78);
+		compressedData.push_back(ZlibHeaderByte(compressionLevel));
 
 
 		const uint8_t* inputBuffer = reinterpret_cast<const uint8_t*>(uncompressedData.data());
 		size_t inputBytes = uncompressedData.size() * sizeof(T);
-		size_t bytesUsed;
+		uint32_t adler32Checksum = 1;
+		if (ChunkCount(inputBytes) > 1)
+		{
+			// Large channels would otherwise be compressed entirely on a single thread
+			adler32Checksum = CompressChunked(std::span<const uint8_t>(inputBuffer, inputBytes), buffer, compressionLevel, compressedData);
+		}
+		else
 		{
-			bytesUsed = libdeflate_deflate_compress(compressor, inputBuffer, inputBytes,
+			libdeflate_compressor* compressor = GetCompressor(compressionLevel);
+			size_t bytesUsed = libdeflate_deflate_compress(compressor, inputBuffer, inputBytes,
 				buffer.data(), buffer.size());
 			if (bytesUsed == 0) {
 				PSAPI_LOG_ERROR("Zip", "Compression failed");
 			}
-		}
 
-		// Adjust the size of the output buffer to the actual size of compressed data
-		{
-			PSAPI_PROFILE_SCOPE("Zip Insert buffer");
-			compressedData.insert(compressedData.end(), buffer.begin(), buffer.begin() + bytesUsed);
+			// Adjust the size of the output buffer to the actual size of compressed data
+			{
+				PSAPI_PROFILE_SCOPE("Zip Insert buffer");
+				compressedData.insert(compressedData.end(), buffer.begin(), buffer.begin() + bytesUsed);
+			}
+			adler32Checksum = libdeflate_adler32(1, inputBuffer, inputBytes);
 		}
 
 		// Add the adler-32 checksum as big endian value
-		uint32_t adler32Checksum = libdeflate_adler32(1, reinterpret_cast<const uint8_t*>(uncompressedData.data()), uncompressedData.size() * sizeof(T));
 		// Push back the individual bytes of the adler checksum at the end
 		if constexpr (std::endian::native == std::endian::little)
 		{
@@ -184,54 +359,52 @@ namespace ZIP_Impl
 }
 
 
-// Compress a vector using the Deflate algorithm with default compression level. This is the optimized but less abstracted
-// version of this function taking a swap buffer as well as a pre-allocated compressor
+// Compress a vector using the Deflate algorithm with the given compression level. This is the optimized but less abstracted
+// version of this function taking a swap buffer which must be at least ZIP_Impl::CompressBound() bytes large
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <typename T>
-std::vector<uint8_t> CompressZIP(std::span<T> uncompressedIn, std::span<uint8_t> buffer, libdeflate_compressor* compressor)
+std::vector<uint8_t> CompressZIP(std::span<T> uncompressedIn, std::span<uint8_t> buffer, const int compressionLevel = ZIP_COMPRESSION_LVL)
 {
 	PSAPI_PROFILE_FUNCTION();
 	// Convert uncompressed data to native endianness in-place
 	endianEncodeBEArray<T>(uncompressedIn);
 
 	// Compress using Deflate ZIP
-	std::vector<uint8_t> compressedData = ZIP_Impl::Compress<T>(uncompressedIn, buffer, compressor);
+	std::vector<uint8_t> compressedData = ZIP_Impl::Compress<T>(uncompressedIn, buffer, compressionLevel);
 
 	return compressedData;
 }
 
 
-// Compress a vector using the Deflate algorithm with default compression level. This is the generic function taking
+// Compress a vector using the Deflate algorithm with the given compression level. This is the generic function taking
 // data and compressing it without any further information on what is used
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <typename T>
-std::vector<uint8_t> CompressZIP(std::vector<T>& uncompressedIn)
+std::vector<uint8_t> CompressZIP(std::vector<T>& uncompressedIn, const int compressionLevel = ZIP_COMPRESSION_LVL)
 {
 	PSAPI_PROFILE_FUNCTION();
 	// Convert uncompressed data to native endianness in-place
 	endianEncodeBEArray<T>(uncompressedIn);
 
-	// Allocate the compressor as well as a sufficiently large swap buffer
-	libdeflate_compressor* compressor = libdeflate_alloc_compressor(ZIP_COMPRESSION_LVL);
-	std::vector<uint8_t> buffer(libdeflate_zlib_compress_bound(compressor, uncompressedIn.size() * sizeof(T)));
+	// Allocate a sufficiently large swap buffer
+	std::vector<uint8_t> buffer(ZIP_Impl::CompressBound(uncompressedIn.size() * sizeof(T), compressionLevel));
 
 	// Compress using Deflate ZIP
-	std::vector<uint8_t> compressedData = ZIP_Impl::Compress<T>(uncompressedIn, buffer, compressor);
-
-	libdeflate_free_compressor(compressor);
+	std::vector<uint8_t> compressedData = ZIP_Impl::Compress<T>(uncompressedIn, buffer, compressionLevel);
 
 	return compressedData;
 }
 
 
-// Compress a vector using the Deflate algorithm with default compression level while prediction encoding the data. This 
-// is the optimized but less abstracted version of this function taking a swap buffer as well as a pre-allocated compressor.
+// Compress a vector using the Deflate algorithm with the given compression level while prediction encoding the data. This 
+// is the optimized but less abstracted version of this function taking a swap buffer which must be at least 
+// ZIP_Impl::CompressBound() bytes large
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <typename T>
-std::vector<uint8_t> CompressZIPPrediction(std::span<T> uncompressedIn, std::span<uint8_t> buffer, libdeflate_compressor* compressor, const uint32_t width, const uint32_t height)
+std::vector<uint8_t> CompressZIPPrediction(std::span<T> uncompressedIn, std::span<uint8_t> buffer, const uint32_t width, const uint32_t height, const int compressionLevel = ZIP_COMPRESSION_LVL)
 {
 	PSAPI_PROFILE_FUNCTION();
 
@@ -239,32 +412,29 @@ std::vector<uint8_t> CompressZIPPrediction(std::span<T> uncompressedIn, std::spa
 	ZIP_Impl::PredictionEncode<T>(uncompressedIn, buffer, width, height);
 
 	// Compress using Deflate ZIP
-	std::vector<uint8_t> compressedData = ZIP_Impl::Compress<T>(uncompressedIn, buffer, compressor);
+	std::vector<uint8_t> compressedData = ZIP_Impl::Compress<T>(uncompressedIn, buffer, compressionLevel);
 
 	return compressedData;
 }
 
 
-// Compress a vector using the Deflate algorithm with default compression level while prediction encoding the data. This 
-// is the optimized but less abstracted version of this function taking a swap buffer as well as a pre-allocated compressor.
+// Compress a vector using the Deflate algorithm with the given compression level while prediction encoding the data. This 
+// is the generic function taking data and compressing it without any further information on what is used
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <typename T>
-std::vector<uint8_t> CompressZIPPrediction(std::vector<T>& uncompressedIn, const uint32_t width, const uint32_t height)
+std::vector<uint8_t> CompressZIPPrediction(std::vector<T>& uncompressedIn, const uint32_t width, const uint32_t height, const int compressionLevel = ZIP_COMPRESSION_LVL)
 {
 	PSAPI_PROFILE_FUNCTION();
 
-	// Allocate the compressor as well as a sufficiently large swap buffer
-	libdeflate_compressor* compressor = libdeflate_alloc_compressor(ZIP_COMPRESSION_LVL);
-	std::vector<uint8_t> buffer(libdeflate_zlib_compress_bound(compressor, uncompressedIn.size() * sizeof(T)));
+	// Allocate a sufficiently large swap buffer
+	std::vector<uint8_t> buffer(ZIP_Impl::CompressBound(uncompressedIn.size() * sizeof(T), compressionLevel));
 
 	// Prediction encode as well as byteswapping in-place
 	ZIP_Impl::PredictionEncode<T>(uncompressedIn, buffer, width, height);
 
 	// Compress using Deflate ZIP
-	std::vector<uint8_t> compressedData = ZIP_Impl::Compress<T>(uncompressedIn, buffer, compressor);
-
-	libdeflate_free_compressor(compressor);
+	std::vector<uint8_t> compressedData = ZIP_Impl::Compress<T>(uncompressedIn, buffer, compressionLevel);
 
 	return compressedData;
 }
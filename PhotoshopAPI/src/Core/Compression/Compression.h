@@ -56,11 +56,45 @@ inline void DecompressData(ByteStream& stream, std::span<T> buffer, uint64_t off
 }
 
 
+/// Read and decompress only the scanlines [rowStart, rowStart + rowCount) of a single channel into the buffer, which must
+/// hold at least width * rowCount elements. Depending on the compression algorithm this only touches the compressed
+/// data of these scanlines (Raw, RLE) or only decodes these after inflating the whole channel (Zip, ZipPrediction).
+/// ---------------------------------------------------------------------------------------------------------------------
+/// ---------------------------------------------------------------------------------------------------------------------
+template <typename T>
+inline void DecompressDataRows(ByteStream& stream, std::span<T> buffer, uint64_t offset, const Enum::Compression& compression, const FileHeader& header, const uint32_t width, const uint32_t height, const uint64_t compressedSize, const uint32_t rowStart, const uint32_t rowCount)
+{
+	PSAPI_PROFILE_FUNCTION();
+	const uint64_t rowElements = static_cast<uint64_t>(width) * rowCount;
+	if (buffer.size() < rowElements) [[unlikely]]
+	{
+		PSAPI_LOG_ERROR("DecompressData", "Provided buffer is not large enough. Expected at least: %" PRIu64 " but got %zu instead", rowElements, buffer.size());
+	}
+
+	switch (compression)
+	{
+	case Enum::Compression::Rle:
+		DecompressRLERows<T>(stream, buffer, offset, header, width, height, rowStart, rowCount);
+		break;
+	case Enum::Compression::Zip:
+		DecompressZIPRows<T>(stream, buffer, offset, width, height, compressedSize, rowStart, rowCount);
+		break;
+	case Enum::Compression::ZipPrediction:
+		DecompressZIPPredictionRows<T>(stream, buffer, offset, width, height, compressedSize, rowStart, rowCount);
+		break;
+	default:
+		ReadBinaryArray<T>(stream, buffer.subspan(0, rowElements), offset + static_cast<uint64_t>(width) * rowStart * sizeof(T), rowElements * sizeof(T));
+		break;
+	}
+}
+
+
 // Compress an input datastream using the appropriate compression algorithm while encoding to BE order
 // RLE compression will encode the scanline sizes at the start of the data as well. This would equals to 
-// 2/4 * height bytes of additional data (2 bytes for PSD and 4 for PSB)
+// 2/4 * height bytes of additional data (2 bytes for PSD and 4 for PSB). The zipLevel is only used for Zip and 
+// ZipPrediction compression
 template <typename T>
-inline std::vector<uint8_t> CompressData(std::span<T> uncompressedIn, std::span<uint8_t> buffer, libdeflate_compressor* compressor, const Enum::Compression& compression, const FileHeader& header, const uint32_t width, const uint32_t height)
+inline std::vector<uint8_t> CompressData(std::span<T> uncompressedIn, std::span<uint8_t> buffer, const Enum::Compression& compression, const FileHeader& header, const uint32_t width, const uint32_t height, const int zipLevel = ZIP_COMPRESSION_LVL)
 {
 	if (compression == Enum::Compression::Raw)
 	{
@@ -75,15 +109,15 @@ inline std::vector<uint8_t> CompressData(std::span<T> uncompressedIn, std::span<
 	}
 	else if (compression == Enum::Compression::Rle)
 	{
-		return CompressRLE(uncompressedIn, buffer, header, width, height);
+		return CompressRLE(uncompressedIn, header, width, height);
 	}
 	else if (compression == Enum::Compression::Zip)
 	{
-		return CompressZIP(uncompressedIn, buffer, compressor);
+		return CompressZIP(uncompressedIn, buffer, zipLevel);
 	}
 	else if (compression == Enum::Compression::ZipPrediction)
 	{
-		return CompressZIPPrediction(uncompressedIn, buffer, compressor, width, height);
+		return CompressZIPPrediction(uncompressedIn, buffer, width, height, zipLevel);
 	}
 	else
 	{
@@ -94,9 +128,10 @@ inline std::vector<uint8_t> CompressData(std::span<T> uncompressedIn, std::span<
 
 // Compress an input datastream using the appropriate compression algorithm while encoding to BE order
 // RLE compression will encode the scanline sizes at the start of the data as well. This would equals to 
-// 2/4 * height bytes of additional data (2 bytes for PSD and 4 for PSB)
+// 2/4 * height bytes of additional data (2 bytes for PSD and 4 for PSB). The zipLevel is only used for Zip and 
+// ZipPrediction compression
 template <typename T>
-inline std::vector<uint8_t> CompressData(std::vector<T>& uncompressedIn, const Enum::Compression& compression, const FileHeader& header, const uint32_t width, const uint32_t height)
+inline std::vector<uint8_t> CompressData(std::vector<T>& uncompressedIn, const Enum::Compression& compression, const FileHeader& header, const uint32_t width, const uint32_t height, const int zipLevel = ZIP_COMPRESSION_LVL)
 {
 	if (compression == Enum::Compression::Raw)
 	{
@@ -111,11 +146,11 @@ inline std::vector<uint8_t> CompressData(std::vector<T>& uncompressedIn, const E
 	}
 	else if (compression == Enum::Compression::Zip)
 	{
-		return CompressZIP(uncompressedIn);
+		return CompressZIP(uncompressedIn, zipLevel);
 	}
 	else if (compression == Enum::Compression::ZipPrediction)
 	{
-		return CompressZIPPrediction(uncompressedIn, width, height);
+		return CompressZIPPrediction(uncompressedIn, width, height, zipLevel);
 	}
 	else
 	{
@@ -3,8 +3,17 @@
 
 PSAPI_NAMESPACE_BEGIN
 
-// We express the zip compression level as constexpr here but this is subject to change
+// The default zip compression level, this may be overridden at runtime per file or per channel in the range 
+// [ZIP_MIN_COMPRESSION_LVL, ZIP_MAX_COMPRESSION_LVL] which is the range supported by libdeflate
 constexpr auto ZIP_COMPRESSION_LVL = 4;
+constexpr auto ZIP_MIN_COMPRESSION_LVL = 0;
+constexpr auto ZIP_MAX_COMPRESSION_LVL = 12;
+
+// Zip compressed channels of at least ZIP_PARALLEL_MIN_SIZE bytes are split into chunks of ZIP_PARALLEL_CHUNK_SIZE bytes 
+// which are deflated in parallel and stitched back into a single zlib stream. Each chunk starts with an empty window 
+// so the chunks must be large enough for the compression ratio to be unaffected
+constexpr size_t ZIP_PARALLEL_CHUNK_SIZE = 1024 * 1024;
+constexpr size_t ZIP_PARALLEL_MIN_SIZE = 4 * ZIP_PARALLEL_CHUNK_SIZE;
 
 
 // Creates two vectors that can be used as iterators for an image by height or width. 
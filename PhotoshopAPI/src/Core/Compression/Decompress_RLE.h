@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 #include "Util/Logger.h"
 #include "Core/FileIO/Util.h"
 #include "Core/Endian/EndianByteSwap.h"
@@ -10,6 +11,9 @@
 #include "PhotoshopFile/FileHeader.h"
 #include "Util/Profiling/Perf/Instrumentor.h"
 #include "Util/FileUtil.h"
+#include "Util/CPUFeatures.h"
+#include "Util/ScratchArena.h"
+#include "Decompress_RLE_AVX2.h"
 
 #include <vector>
 #include <limits>
@@ -17,11 +21,6 @@
 #include <cstring>
 #include <inttypes.h>
 
-
-#ifdef __AVX2__
-#include "Decompress_RLE_AVX2.h"
-#endif
-
 // If we compile with C++<20 we replace the stdlib implementation with the compatibility
 // library
 #if (__cplusplus < 202002L)
@@ -132,6 +131,84 @@ namespace RLE_Impl
 }
 
 
+namespace RLE_Impl
+{
+    // Photoshop first stores the byte counts of all the scanlines, this is 2 or 4 bytes depending on 
+    // if the document is PSD or PSB
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline std::vector<uint32_t> ReadScanlineSizes(ByteStream& stream, uint64_t offset, const FileHeader& header, const uint32_t height)
+    {
+        std::vector<uint32_t> scanlineSizes;
+        scanlineSizes.reserve(height);
+        if (header.m_Version == Enum::Version::Psd)
+        {
+            std::vector<uint16_t> buff(height);
+            stream.read(Util::toWritableBytes(buff), offset);
+            endianDecodeBEArray<uint16_t>(buff);
+            for (auto item : buff)
+            {
+                scanlineSizes.push_back(item);
+            }
+        }
+        else
+        {
+            std::vector<uint32_t> buff(height);
+            stream.read(Util::toWritableBytes(buff), offset);
+            endianDecodeBEArray<uint32_t>(buff);
+            for (auto item : buff)
+            {
+                scanlineSizes.push_back(item);
+            }
+        }
+        return scanlineSizes;
+    }
+
+
+    // Decompress the given scanlines in parallel into the buffer, compressedData must hold exactly the compressed data
+    // described by scanlineSizes and buffer must hold at least width * scanlineSizes.size() elements. 
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    template<typename T>
+    void DecompressScanlines(std::span<const uint8_t> compressedData, std::span<const uint32_t> scanlineSizes, std::span<T> buffer, const uint32_t width)
+    {
+        // Compute the start of every compressed scanline to decompress them individually, the offsets and the indices 
+        // we iterate are kept in scratch memory as they are needed for every channel
+        const size_t numScanlines = scanlineSizes.size();
+        Scratch::Buffer offsetsBuffer = Scratch::acquire<uint64_t>(numScanlines + 1);
+        Scratch::Buffer verticalIterBuffer = Scratch::acquire<uint32_t>(numScanlines);
+        std::span<uint64_t> offsets = offsetsBuffer.as<uint64_t>(numScanlines + 1);
+        std::span<uint32_t> verticalIter = verticalIterBuffer.as<uint32_t>(numScanlines);
+        offsets[0] = 0u;
+        for (size_t i = 0; i < numScanlines; ++i)
+        {
+            offsets[i + 1] = offsets[i] + scanlineSizes[i];
+            verticalIter[i] = static_cast<uint32_t>(i);
+        }
+        {
+            PSAPI_PROFILE_SCOPE("DecompressPackBits");
+            // Decompress using the PackBits algorithm
+            const bool useAVX2 = CPU::hasAVX2();
+            Parallel::forEach(verticalIter.begin(), verticalIter.end(), [&](uint32_t index)
+                {
+                    auto compressedScanline = compressedData.subspan(offsets[index], offsets[index + 1] - offsets[index]);
+                    auto decompressedScanline = std::span<uint8_t>(reinterpret_cast<uint8_t*>(buffer.data()) + static_cast<uint64_t>(index) * width * sizeof(T), width * sizeof(T));
+#ifdef PSAPI_SIMD_AVX2
+                    if (useAVX2)
+                    {
+                        RLE_Impl::DecompressPackBitsAVX2<T>(compressedScanline, decompressedScanline);
+                        return;
+                    }
+#endif
+                    RLE_Impl::DecompressPackBits<T>(compressedScanline, decompressedScanline);
+                });
+        }
+        // Convert decompressed data to native endianness in-place
+        endianDecodeBEArray(std::span<T>(buffer.data(), static_cast<uint64_t>(width) * scanlineSizes.size()));
+    }
+}
+
+
 // Reads and decompresses a single channel using the packbits algorithm into the provided buffer. Buffer must be at least
 // large enough to hold width * height * sizeof(T)
 // ---------------------------------------------------------------------------------------------------------------------
@@ -148,31 +225,11 @@ void DecompressRLE(ByteStream& stream, std::span<T> buffer, uint64_t offset, con
             buffer.size());
     }
 
-    // Photoshop first stores the byte counts of all the scanlines, this is 2 or 4 bytes depending on 
-    // if the document is PSD or PSB
+    std::vector<uint32_t> scanlineSizes = RLE_Impl::ReadScanlineSizes(stream, offset, header, height);
     uint64_t scanlineTotalSize = 0u;
-    std::vector<uint32_t> scanlineSizes;
-    if (header.m_Version == Enum::Version::Psd)
+    for (auto item : scanlineSizes)
     {
-        std::vector<uint16_t> buff(height);
-        stream.read(Util::toWritableBytes(buff), offset);
-        endianDecodeBEArray<uint16_t>(buff);
-        for (auto item : buff)
-        {
-            scanlineTotalSize += item;
-            scanlineSizes.push_back(item);
-        }
-    }
-    else
-    {
-        std::vector<uint32_t> buff(height);
-        stream.read(Util::toWritableBytes(buff), offset);
-        endianDecodeBEArray<uint32_t>(buff);
-        for (auto item : buff)
-        {
-            scanlineTotalSize += item;
-            scanlineSizes.push_back(item);
-        }
+        scanlineTotalSize += item;
     }
 
     // Find out the size of the data without the scanline sizes. For example, if the document is 64x64 pixels in 8 bit mode we have 128 bytes of memory to store the scanline size
@@ -186,40 +243,47 @@ void DecompressRLE(ByteStream& stream, std::span<T> buffer, uint64_t offset, con
     }
 
     // Read the data without converting from BE to native as we need to decompress first
-    std::span<uint8_t> compressedData = stream.read(offset + SwapPsdPsb<uint16_t, uint32_t>(header.m_Version) * height, scanlineTotalSize);
+    std::span<const uint8_t> compressedData = stream.read(offset + SwapPsdPsb<uint16_t, uint32_t>(header.m_Version) * height, scanlineTotalSize);
+    RLE_Impl::DecompressScanlines<T>(compressedData, scanlineSizes, buffer, width);
+}
 
-    // Generate spans for every individual scanline to decompress them individually
-    std::vector<std::span<const uint8_t>> compressedDataSpans(height);
-    std::vector<std::span<uint8_t>> decompressedDataSpans(height);
-    std::vector<uint64_t> verticalIter;
-    {
-        uint64_t compressedStartIdx = 0;
-        for (uint64_t i = 0; i < static_cast<uint64_t>(height); ++i)
-        {
-            uint64_t compressedEndIdx = compressedStartIdx + scanlineSizes[i];
-            compressedDataSpans[i] = std::span<const uint8_t>(compressedData.begin() + compressedStartIdx, compressedData.begin() + compressedEndIdx);
-            compressedStartIdx = compressedEndIdx;
 
-            uint64_t decompressedStartIdx = i * width * sizeof(T);
-            decompressedDataSpans[i] = std::span<uint8_t>(reinterpret_cast<uint8_t*>(buffer.data()) + decompressedStartIdx, width * sizeof(T));
+// Reads and decompresses only the scanlines [rowStart, rowStart + rowCount) of a single channel into the provided buffer. 
+// As every scanline is compressed individually we never touch the compressed data of the other scanlines. Buffer must be
+// at least large enough to hold width * rowCount * sizeof(T)
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+template<typename T>
+void DecompressRLERows(ByteStream& stream, std::span<T> buffer, uint64_t offset, const FileHeader& header, const uint32_t width, const uint32_t height, const uint32_t rowStart, const uint32_t rowCount)
+{
+    PSAPI_PROFILE_FUNCTION();
 
-            verticalIter.push_back(i);
-        }
+    if (static_cast<uint64_t>(rowStart) + rowCount > height)
+    {
+        PSAPI_LOG_ERROR("DecompressRLE", "Requested rows %" PRIu32 "-%" PRIu32 " exceed the channel height of %" PRIu32, rowStart, rowStart + rowCount, height);
     }
+    if (buffer.size() < static_cast<uint64_t>(width) * static_cast<uint64_t>(rowCount))
     {
-        PSAPI_PROFILE_SCOPE("DecompressPackBits");
-        // Decompress using the PackBits algorithm
-        std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(), [&](auto index)
-            {
-#ifdef __AVX2__
-                RLE_Impl::DecompressPackBitsAVX2<T>(compressedDataSpans[index], decompressedDataSpans[index]);
-#else
-                RLE_Impl::DecompressPackBits<T>(compressedDataSpans[index], decompressedDataSpans[index]);
-#endif
-            });
+        PSAPI_LOG_ERROR("DecompressRLE", "Provided buffer is not large enough. Expected at least: %" PRIu64 " but got %" PRIu64 " instead",
+            static_cast<uint64_t>(width) * static_cast<uint64_t>(rowCount),
+            buffer.size());
+    }
+
+    std::vector<uint32_t> scanlineSizes = RLE_Impl::ReadScanlineSizes(stream, offset, header, height);
+    uint64_t dataOffset = offset + static_cast<uint64_t>(SwapPsdPsb<uint16_t, uint32_t>(header.m_Version)) * height;
+    for (uint32_t i = 0; i < rowStart; ++i)
+    {
+        dataOffset += scanlineSizes[i];
+    }
+    auto rowSizes = std::span<const uint32_t>(scanlineSizes.data() + rowStart, rowCount);
+    uint64_t rowsTotalSize = 0u;
+    for (auto item : rowSizes)
+    {
+        rowsTotalSize += item;
     }
-    // Convert decompressed data to native endianness in-place
-    endianDecodeBEArray(buffer);
+
+    std::span<const uint8_t> compressedData = stream.read(dataOffset, rowsTotalSize);
+    RLE_Impl::DecompressScanlines<T>(compressedData, rowSizes, buffer, width);
 }
 
 
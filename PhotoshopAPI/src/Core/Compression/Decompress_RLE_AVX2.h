@@ -1,15 +1,17 @@
 /*
-This header is not meant to be directly included since we at compile time include or skip this header in Decompress_RLE.h depending on if we 
-detect AVX2 SIMD intrinsics. Including this header in your project will lead to breaking compatibility with non-avx2 platforms.
+The kernels in this header are compiled for AVX2 independently of the flags of the translation unit they are included into and 
+may therefore only be called after checking CPU::hasAVX2() as is done in Decompress_RLE.h.
 */
 
 #pragma once
 
+#include "Macros.h"
+#include "Util/CPUFeatures.h"
+#include "Util/Profiling/Perf/Instrumentor.h"
+
 #include <vector>
 #include <cstring>
 
-#include "immintrin.h"
-
 // If we compile with C++<20 we replace the stdlib implementation with the compatibility
 // library
 #if (__cplusplus < 202002L)
@@ -18,6 +20,8 @@ detect AVX2 SIMD intrinsics. Including this header in your project will lead to
 #include <span>
 #endif
 
+#ifdef PSAPI_SIMD_AVX2
+
 PSAPI_NAMESPACE_BEGIN
 
 namespace RLE_Impl
@@ -26,7 +30,7 @@ namespace RLE_Impl
     // ---------------------------------------------------------------------------------------------------------------------
     // ---------------------------------------------------------------------------------------------------------------------
     template<typename T>
-    void DecompressPackBitsAVX2(std::span<const uint8_t> compressedData, std::span<uint8_t> decompressedData)
+    PSAPI_TARGET_AVX2 void DecompressPackBitsAVX2(std::span<const uint8_t> compressedData, std::span<uint8_t> decompressedData)
     {
         uint64_t i = 0;
         uint64_t idx = 0;   // Index into decompressedData
@@ -89,7 +93,7 @@ namespace RLE_Impl
     // ---------------------------------------------------------------------------------------------------------------------
     // ---------------------------------------------------------------------------------------------------------------------
     template<typename T>
-    std::vector<uint8_t> DecompressPackBitsAVX2(std::span<const uint8_t> compressedData, const uint32_t width, const uint32_t height)
+    PSAPI_TARGET_AVX2 std::vector<uint8_t> DecompressPackBitsAVX2(std::span<const uint8_t> compressedData, const uint32_t width, const uint32_t height)
     {
         PSAPI_PROFILE_FUNCTION();
         std::vector<uint8_t> decompressedData(sizeof(T) * static_cast<uint64_t>(width) * static_cast<uint64_t>(height));
@@ -153,4 +157,6 @@ namespace RLE_Impl
     }
 }
 
-PSAPI_NAMESPACE_END
\ No newline at end of file
+PSAPI_NAMESPACE_END
+
+#endif // PSAPI_SIMD_AVX2
@@ -1,17 +1,20 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 #include "Util/Logger.h"
 #include "Core/Endian/EndianByteSwap.h"
 #include "Core/Endian/EndianByteSwapArr.h"
 #include "CompressionUtil.h"
+#include "InterleavedToPlanar.h"
+#include "Prediction.h"
 #include "Core/Struct/ByteStream.h"
+#include "Util/ScratchArena.h"
 #include "Util/Profiling/Perf/Instrumentor.h"
 
 #include "libdeflate.h"
 
 #include <algorithm>
-#include <execution>
 #include <vector>
 #include <cstring>
 #include <bit>
@@ -31,23 +34,57 @@ PSAPI_NAMESPACE_BEGIN
 
 namespace ZIP_Impl
 {
+	// Per-thread libdeflate decompressor, this is cheaper to allocate than a compressor but reading many small layers
+	// (or files) would otherwise allocate and free one for every channel.
+	struct DecompressorCache
+	{
+		libdeflate_decompressor* decompressor = nullptr;
+
+		DecompressorCache() = default;
+		DecompressorCache(const DecompressorCache&) = delete;
+		DecompressorCache& operator=(const DecompressorCache&) = delete;
+
+		~DecompressorCache()
+		{
+			if (decompressor)
+			{
+				libdeflate_free_decompressor(decompressor);
+			}
+		}
+	};
+
+
+	// Get the decompressor owned by the calling thread, it must therefore not be shared across threads. The decompressor
+	// is only valid for as long as the thread is alive.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline libdeflate_decompressor* GetDecompressor()
+	{
+		thread_local DecompressorCache cache;
+		if (!cache.decompressor)
+		{
+			cache.decompressor = libdeflate_alloc_decompressor();
+			if (!cache.decompressor)
+			{
+				PSAPI_LOG_ERROR("UnZip", "Cannot allocate decompressor");
+			}
+		}
+		return cache.decompressor;
+	}
+
+
 	// Use libdeflate to decompress the incoming data into the provided buffer. The decompressedSize parameter refers to the 
 	// number of bytes, not to the number of elements
 	// ---------------------------------------------------------------------------------------------------------------------
 	// ---------------------------------------------------------------------------------------------------------------------
 	template <typename T>
-	void Decompress(const std::span<uint8_t> compressedData, std::span<T> buffer, const uint64_t decompressedSize)
+	void Decompress(const std::span<const uint8_t> compressedData, std::span<T> buffer, const uint64_t decompressedSize)
 	{
 		PSAPI_PROFILE_FUNCTION();
 
-		libdeflate_decompressor* decompressor = libdeflate_alloc_decompressor();
-		if (!decompressor) {
-			PSAPI_LOG_ERROR("UnZip", "Cannot allocate decompressor");
-		}
-
 		size_t bytesDecompressed;	// The actual uncompressed bytes, for now unused
 		auto res = libdeflate_zlib_decompress(
-			decompressor,
+			GetDecompressor(),
 			compressedData.data(),
 			compressedData.size(),
 			reinterpret_cast<uint8_t*>(buffer.data()),
@@ -66,8 +103,22 @@ namespace ZIP_Impl
 		{
 			PSAPI_LOG_ERROR("UnZip", "Inflate decompression failed due to having insufficient output space.");
 		}
+	}
 
-		libdeflate_free_decompressor(decompressor);
+
+	// Inflate a whole zip compressed channel into scratch memory holding width * height elements. Used by the region
+	// reads as libdeflate has no streaming interface and leaves its output undefined when it fails (including when 
+	// running out of output space), we therefore cannot stop after the scanlines we are interested in.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	Scratch::Buffer DecompressChannel(const std::span<const uint8_t> compressedData, const uint32_t width, const uint32_t height)
+	{
+		PSAPI_PROFILE_FUNCTION();
+		const uint64_t totalSize = static_cast<uint64_t>(width) * height;
+		Scratch::Buffer decompressedData = Scratch::acquire<T>(totalSize);
+		Decompress<T>(compressedData, decompressedData.as<T>(totalSize), totalSize);
+		return decompressedData;
 	}
 
 
@@ -78,19 +129,30 @@ namespace ZIP_Impl
 	void RemovePredictionEncoding(std::span<T> decompressedData, const uint32_t width, const uint32_t height)
 	{
 		PSAPI_PROFILE_FUNCTION();
-		// Convert decompressed data to native endianness in-place
-		endianDecodeBEArray<T>(decompressedData);
-
 		std::vector<uint32_t> verticalIter = createVerticalImageIterator(height);
 
-		// Perform prediction decoding per scanline of data in-place
-		std::for_each(std::execution::par, verticalIter.begin(), verticalIter.end(),
+		// Perform prediction decoding per scanline of data in-place, 16-bit data gets converted to native endianness
+		// in the same pass
+		Parallel::forEach(verticalIter.begin(), verticalIter.end(),
 			[&](uint32_t y)
 			{
-				for (uint64_t x = 1; x < width; ++x)
+				std::span<T> scanline(decompressedData.data() + static_cast<uint64_t>(width) * y, width);
+				if constexpr (std::is_same_v<T, uint8_t>)
+				{
+					predictionDecodeRow(std::span<const uint8_t>(scanline), scanline);
+				}
+				else if constexpr (std::is_same_v<T, uint16_t>)
+				{
+					predictionDecodeRow(scanline);
+				}
+				else
 				{
-					// Simple differencing: decode by adding the difference to the previous value
-					decompressedData[static_cast<uint64_t>(width) * y + x] += decompressedData[static_cast<uint64_t>(width) * y + x - 1];
+					endianDecodeBEArray<T>(scanline);
+					for (uint64_t x = 1; x < width; ++x)
+					{
+						// Simple differencing: decode by adding the difference to the previous value
+						scanline[x] += scanline[x - 1];
+					}
 				}
 			});
 	}
@@ -105,44 +167,26 @@ namespace ZIP_Impl
 	{
 		PSAPI_PROFILE_FUNCTION();
 
-		// We simply alias the vector to a span of uint8_t to perform our bytewise operations which modify decompressedData in place
-		const uint64_t dataSize = static_cast<uint64_t>(width) * height * sizeof(float32_t);
-		std::span<uint8_t> predictionDecodedData(reinterpret_cast<uint8_t*>(decompressedData.data()), dataSize);
-
-		// Perform prediction decoding per scanline of data in-place
-		uint64_t index = 0;
-		for (uint64_t y = 0; y < height; ++y)
-		{
-			++index;
-			for (uint64_t x = 1; x < static_cast<uint64_t>(width) * sizeof(float32_t); ++x)
-			{
-				// Simple differencing: decode by adding the difference to the previous value
-				uint8_t value = predictionDecodedData[index] + predictionDecodedData[index - 1];
-				predictionDecodedData[index] = value;
-
-				++index;
-			}
-		}
+		// We simply alias the data to a span of uint8_t to perform our bytewise operations which modify decompressedData in place
+		const uint64_t scanlineSize = static_cast<uint64_t>(width) * sizeof(float32_t);
+		std::vector<uint32_t> verticalIter = createVerticalImageIterator(height);
 
-		// We now need to shuffle the byte order back in its normal place as photoshop stores the bytes deinterleaved for 32 bit types.
-		// Imagine the following sequence of bytes, 1234 1234 1234 1234. If we would encode them literally it wouldnt give us much compression
-		// which is why Photoshop deinterleaves them to 1111 2222 3333 4444 to get better compression. We now need to reverse this interleaving that is done row-by-row
-		std::vector<float32_t> deinterleavedData(static_cast<uint64_t>(width) * height);
-		std::span<uint8_t> deinterleavedDataView(reinterpret_cast<uint8_t*>(deinterleavedData.data()), deinterleavedData.size() * sizeof(float32_t));
-		for (uint64_t y = 0; y < height; ++y)
-		{
-			for (uint64_t x = 0; x < width; ++x)
+		Parallel::forEach(verticalIter.begin(), verticalIter.end(),
+			[&](uint32_t y)
 			{
-				uint64_t rowIndex = y * width * sizeof(float32_t);
-				deinterleavedDataView[rowIndex + x * sizeof(float32_t) + 0] = predictionDecodedData[rowIndex + x];
-				deinterleavedDataView[rowIndex + x * sizeof(float32_t) + 1] = predictionDecodedData[rowIndex + static_cast<uint64_t>(width) + x];
-				deinterleavedDataView[rowIndex + x * sizeof(float32_t) + 2] = predictionDecodedData[rowIndex + static_cast<uint64_t>(width) * 2 + x];
-				deinterleavedDataView[rowIndex + x * sizeof(float32_t) + 3] = predictionDecodedData[rowIndex + static_cast<uint64_t>(width) * 3 + x];
-			}
-		}
-
-		endianDecodeBEArray<float32_t>(deinterleavedData);
-		std::memcpy(reinterpret_cast<char*>(decompressedData.data()), reinterpret_cast<char*>(deinterleavedData.data()), deinterleavedData.size() * sizeof(float32_t));
+				// Scratch scanline owned by the thread which is reused across rows and channels
+				thread_local std::vector<uint8_t> scanlineBuffer;
+				scanlineBuffer.resize(scanlineSize);
+				std::span<uint8_t> scanline(reinterpret_cast<uint8_t*>(decompressedData.data()) + scanlineSize * y, scanlineSize);
+
+				// Undo the bytewise differencing into the scratch buffer after which we need to shuffle the byte order back 
+				// in its normal place as photoshop stores the bytes deinterleaved for 32 bit types. Imagine the following 
+				// sequence of bytes, 1234 1234 1234 1234. If we would encode them literally it wouldnt give us much compression
+				// which is why Photoshop deinterleaves them to 1111 2222 3333 4444 to get better compression. We now need to 
+				// reverse this interleaving that is done row-by-row while also converting from BE to native.
+				predictionDecodeRow(scanline, scanlineBuffer);
+				planarToInterleavedFloat(scanlineBuffer, scanline, width);
+			});
 	}
 
 }
@@ -157,7 +201,7 @@ void DecompressZIP(ByteStream& stream, std::span<T> buffer, uint64_t offset, con
 {
 	PSAPI_PROFILE_FUNCTION();
 	// Read the data without converting from BE to native as we need to decompress first
-	std::span<uint8_t> compressedData = stream.read(offset, compressedSize);
+	std::span<const uint8_t> compressedData = stream.read(offset, compressedSize);
 
 	// Decompress using Inflate ZIP into the buffer
 	ZIP_Impl::Decompress<T>(compressedData, buffer, static_cast<uint64_t>(width) * height);
@@ -194,7 +238,7 @@ void DecompressZIPPrediction(ByteStream& stream, std::span<T> buffer, uint64_t o
 {
 	PSAPI_PROFILE_FUNCTION();
 	// Read the data without converting from BE to native as we need to decompress first
-	std::span<uint8_t> compressedData = stream.read(offset, compressedSize);
+	std::span<const uint8_t> compressedData = stream.read(offset, compressedSize);
 
 	// Decompress using Inflate ZIP into the buffer
 	ZIP_Impl::Decompress<T>(compressedData, buffer, static_cast<uint64_t>(width) * height);
@@ -204,6 +248,50 @@ void DecompressZIPPrediction(ByteStream& stream, std::span<T> buffer, uint64_t o
 }
 
 
+// Decompress only the scanlines [rowStart, rowStart + rowCount) of a zip compressed channel into the buffer which must be
+// at least width * rowCount elements large. While the whole channel is inflated, only the requested scanlines are
+// converted to native endianness and copied out.
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+template <typename T>
+void DecompressZIPRows(ByteStream& stream, std::span<T> buffer, uint64_t offset, const uint32_t width, const uint32_t height, const uint64_t compressedSize, const uint32_t rowStart, const uint32_t rowCount)
+{
+	PSAPI_PROFILE_FUNCTION();
+	if (rowStart + rowCount > height)
+	{
+		PSAPI_LOG_ERROR("UnZip", "Unable to decompress scanlines up to %u from a channel with only %u scanlines", rowStart + rowCount, height);
+	}
+	std::span<const uint8_t> compressedData = stream.read(offset, compressedSize);
+	Scratch::Buffer decompressedData = ZIP_Impl::DecompressChannel<T>(compressedData, width, height);
+
+	auto rows = decompressedData.as<T>(static_cast<uint64_t>(width) * (rowStart + rowCount)).subspan(static_cast<uint64_t>(width) * rowStart);
+	endianDecodeBEArray<T>(rows);
+	std::memcpy(buffer.data(), rows.data(), rows.size() * sizeof(T));
+}
+
+
+// Decompress only the scanlines [rowStart, rowStart + rowCount) of a zip compressed channel with prediction encoding 
+// into the buffer which must be at least width * rowCount elements large. As the prediction is applied per-scanline we
+// only have to decode the requested scanlines, the whole channel however still needs to be inflated.
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+template <typename T>
+void DecompressZIPPredictionRows(ByteStream& stream, std::span<T> buffer, uint64_t offset, const uint32_t width, const uint32_t height, const uint64_t compressedSize, const uint32_t rowStart, const uint32_t rowCount)
+{
+	PSAPI_PROFILE_FUNCTION();
+	if (rowStart + rowCount > height)
+	{
+		PSAPI_LOG_ERROR("UnZip", "Unable to decompress scanlines up to %u from a channel with only %u scanlines", rowStart + rowCount, height);
+	}
+	std::span<const uint8_t> compressedData = stream.read(offset, compressedSize);
+	Scratch::Buffer decompressedData = ZIP_Impl::DecompressChannel<T>(compressedData, width, height);
+
+	auto rows = decompressedData.as<T>(static_cast<uint64_t>(width) * (rowStart + rowCount)).subspan(static_cast<uint64_t>(width) * rowStart);
+	ZIP_Impl::RemovePredictionEncoding<T>(rows, width, rowCount);
+	std::memcpy(buffer.data(), rows.data(), rows.size() * sizeof(T));
+}
+
+
 // Decompress the given buffer using the Inflate algorithm with prediction decoding into a buffer equivalent to the size  
 // of width * height and return it. 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,434 @@
+#pragma once
+
+#include "Macros.h"
+#include "Util/Logger.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+
+// If we compile with C++<20 we replace the stdlib implementation with the compatibility
+// library
+#if (__cplusplus < 202002L)
+#include "tcb_span.hpp"
+#else
+#include <span>
+#endif
+
+
+PSAPI_NAMESPACE_BEGIN
+
+
+// Utilities for operating on raw deflate streams (RFC 1951) as well as the adler32 checksum of the zlib container
+// (RFC 1950). These allow us to stitch several independently compressed deflate streams into a single valid stream
+// which is required for compressing a single channel across multiple threads as libdeflate itself only ever produces
+// complete streams.
+namespace Deflate_Impl
+{
+	/// The position of the last block within a deflate stream, all offsets are given in bits from the start of the stream
+	struct StreamEnd
+	{
+		/// The bit offset of the BFINAL bit of the last block
+		size_t finalBlockBit = 0;
+		/// The bit offset directly after the end-of-block code of the last block
+		size_t endBit = 0;
+	};
+
+
+	// Little endian bit reader over a deflate stream. Bits are consumed from a 64-bit buffer which is refilled a whole 
+	// number of bytes at a time, reading past the end of the stream yields zeros which the callers detect by checking
+	// the position against the size of the stream.
+	struct BitReader
+	{
+		std::span<const uint8_t> data;
+		/// The next byte to be loaded into the buffer
+		size_t bytePos = 0;
+		uint64_t buffer = 0;
+		/// The number of valid bits in the buffer
+		uint32_t count = 0;
+
+		// Fill the buffer up to at least 56 valid bits
+		void refill() noexcept
+		{
+			if (bytePos + sizeof(uint64_t) <= data.size())
+			{
+				uint64_t value = 0;
+				if constexpr (std::endian::native == std::endian::little)
+				{
+					std::memcpy(&value, data.data() + bytePos, sizeof(uint64_t));
+				}
+				else
+				{
+					for (size_t i = 0; i < sizeof(uint64_t); ++i)
+					{
+						value |= static_cast<uint64_t>(data[bytePos + i]) << (i * 8);
+					}
+				}
+				buffer |= value << count;
+				bytePos += (63 - count) >> 3;
+				count |= 56;
+			}
+			else
+			{
+				while (count <= 56)
+				{
+					const uint64_t value = bytePos < data.size() ? data[bytePos] : 0;
+					buffer |= value << count;
+					++bytePos;
+					count += 8;
+				}
+			}
+		}
+
+		// The current position in bits from the start of the stream
+		size_t position() const noexcept
+		{
+			return bytePos * 8 - count;
+		}
+
+		// Consume the given number of bits which must already be in the buffer
+		void consume(const uint32_t bitCount) noexcept
+		{
+			buffer >>= bitCount;
+			count -= bitCount;
+		}
+
+		uint32_t bits(const uint32_t bitCount) noexcept
+		{
+			if (count < bitCount)
+			{
+				refill();
+			}
+			const uint32_t value = static_cast<uint32_t>(buffer & ((uint64_t{ 1 } << bitCount) - 1));
+			consume(bitCount);
+			return value;
+		}
+
+		// Skip to the next byte boundary
+		void align() noexcept
+		{
+			consume(count & 7);
+		}
+
+		// Move to the given byte position, discarding the buffer
+		void seek(const size_t newBytePos) noexcept
+		{
+			bytePos = newBytePos;
+			buffer = 0;
+			count = 0;
+		}
+	};
+
+
+	// Decoding table of a canonical huffman code indexed by the next `maxLength` bits of the stream. Each entry stores
+	// the symbol in the upper and the code length in the lower 4 bits with a length of 0 marking an invalid code.
+	struct HuffmanTable
+	{
+		std::vector<uint16_t> entries;
+		uint32_t maxLength = 0;
+
+		// Build the table from the code lengths of the symbols
+		void build(std::span<const uint8_t> lengths)
+		{
+			std::array<uint16_t, 16> lengthCount{};
+			for (const auto length : lengths)
+			{
+				++lengthCount[length];
+			}
+			lengthCount[0] = 0;
+			maxLength = 0;
+			for (uint32_t length = 1; length < lengthCount.size(); ++length)
+			{
+				if (lengthCount[length] > 0)
+				{
+					maxLength = length;
+				}
+			}
+			entries.assign(size_t{ 1 } << maxLength, 0);
+			if (maxLength == 0)
+			{
+				return;
+			}
+
+			// Compute the first canonical code for each code length
+			std::array<uint32_t, 16> nextCode{};
+			uint32_t code = 0;
+			for (uint32_t length = 1; length < nextCode.size(); ++length)
+			{
+				code = (code + lengthCount[length - 1]) << 1;
+				nextCode[length] = code;
+			}
+
+			for (size_t symbol = 0; symbol < lengths.size(); ++symbol)
+			{
+				const uint32_t length = lengths[symbol];
+				if (length == 0)
+				{
+					continue;
+				}
+				uint32_t canonical = nextCode[length]++;
+				if (canonical >= (1u << length))
+				{
+					PSAPI_LOG_ERROR("Deflate", "Over-subscribed huffman code encountered");
+				}
+				// Huffman codes are packed starting with their most significant bit so we index by the reversed code
+				uint32_t reversed = 0;
+				for (uint32_t i = 0; i < length; ++i)
+				{
+					reversed = (reversed << 1) | (canonical & 1u);
+					canonical >>= 1;
+				}
+				const uint16_t entry = static_cast<uint16_t>((symbol << 4) | length);
+				for (size_t i = reversed; i < entries.size(); i += size_t{ 1 } << length)
+				{
+					entries[i] = entry;
+				}
+			}
+		}
+
+		// Decode the next symbol, the reader must hold at least maxLength bits
+		uint32_t decode(BitReader& reader) const
+		{
+			const uint16_t entry = entries[reader.buffer & ((uint64_t{ 1 } << maxLength) - 1)];
+			if ((entry & 0xF) == 0)
+			{
+				PSAPI_LOG_ERROR("Deflate", "Invalid huffman code encountered at bit %zu", reader.position());
+			}
+			reader.consume(entry & 0xF);
+			return entry >> 4;
+		}
+	};
+
+
+	// Skip over the compressed symbols of a huffman coded block up to and including its end-of-block code
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline void SkipHuffmanBlock(BitReader& reader, const HuffmanTable& litLenTable, const HuffmanTable& distTable)
+	{
+		static constexpr std::array<uint8_t, 29> lengthExtraBits = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static constexpr std::array<uint8_t, 30> distExtraBits = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		// A full length/distance pair takes up at most 48 bits so we only refill once fewer bits than that are buffered
+		const size_t streamBits = reader.data.size() * 8;
+		while (true)
+		{
+			if (reader.count < 48)
+			{
+				reader.refill();
+				if (reader.position() > streamBits)
+				{
+					break;
+				}
+			}
+			const uint32_t symbol = litLenTable.decode(reader);
+			if (symbol < 256)
+			{
+				continue;
+			}
+			if (symbol == 256)
+			{
+				return;
+			}
+			if (symbol - 257 >= lengthExtraBits.size())
+			{
+				PSAPI_LOG_ERROR("Deflate", "Invalid length symbol %u encountered", symbol);
+			}
+			reader.consume(lengthExtraBits[symbol - 257]);
+			const uint32_t distSymbol = distTable.decode(reader);
+			if (distSymbol >= distExtraBits.size())
+			{
+				PSAPI_LOG_ERROR("Deflate", "Invalid distance symbol %u encountered", distSymbol);
+			}
+			reader.consume(distExtraBits[distSymbol]);
+		}
+		PSAPI_LOG_ERROR("Deflate", "Unexpected end of stream while skipping huffman block");
+	}
+
+
+	// Read the code length tables at the start of a dynamic huffman block
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline void ReadDynamicTables(BitReader& reader, HuffmanTable& litLenTable, HuffmanTable& distTable)
+	{
+		static constexpr std::array<uint8_t, 19> codeLengthOrder = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+		const uint32_t numLitLen = reader.bits(5) + 257;
+		const uint32_t numDist = reader.bits(5) + 1;
+		const uint32_t numCodeLength = reader.bits(4) + 4;
+
+		std::array<uint8_t, 19> codeLengthLengths{};
+		for (uint32_t i = 0; i < numCodeLength; ++i)
+		{
+			codeLengthLengths[codeLengthOrder[i]] = static_cast<uint8_t>(reader.bits(3));
+		}
+		HuffmanTable codeLengthTable;
+		codeLengthTable.build(codeLengthLengths);
+
+		// The literal/length and distance code lengths are run-length encoded as one sequence
+		std::array<uint8_t, 288 + 32> lengths{};
+		uint32_t count = 0;
+		while (count < numLitLen + numDist)
+		{
+			reader.refill();
+			const uint32_t symbol = codeLengthTable.decode(reader);
+			uint32_t repeat = 0;
+			uint8_t value = 0;
+			if (symbol < 16)
+			{
+				lengths[count++] = static_cast<uint8_t>(symbol);
+				continue;
+			}
+			else if (symbol == 16)
+			{
+				if (count == 0)
+				{
+					PSAPI_LOG_ERROR("Deflate", "Encountered a repeat code without a previous code length");
+				}
+				value = lengths[count - 1];
+				repeat = 3 + reader.bits(2);
+			}
+			else if (symbol == 17)
+			{
+				repeat = 3 + reader.bits(3);
+			}
+			else
+			{
+				repeat = 11 + reader.bits(7);
+			}
+			if (count + repeat > numLitLen + numDist)
+			{
+				PSAPI_LOG_ERROR("Deflate", "Code length repeat overruns the number of codes");
+			}
+			std::fill_n(lengths.begin() + count, repeat, value);
+			count += repeat;
+		}
+
+		litLenTable.build(std::span<const uint8_t>(lengths.data(), numLitLen));
+		distTable.build(std::span<const uint8_t>(lengths.data() + numLitLen, numDist));
+	}
+
+
+	// Walk the blocks of a raw deflate stream and return the position of its last block as well as the bit position the
+	// stream ends at. This decodes the huffman symbols without producing any output.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline StreamEnd FindStreamEnd(std::span<const uint8_t> stream)
+	{
+		BitReader reader{ stream };
+		HuffmanTable litLenTable;
+		HuffmanTable distTable;
+
+		static const auto fixedTables = []()
+			{
+				std::array<uint8_t, 288> litLenLengths{};
+				std::fill(litLenLengths.begin(), litLenLengths.begin() + 144, static_cast<uint8_t>(8));
+				std::fill(litLenLengths.begin() + 144, litLenLengths.begin() + 256, static_cast<uint8_t>(9));
+				std::fill(litLenLengths.begin() + 256, litLenLengths.begin() + 280, static_cast<uint8_t>(7));
+				std::fill(litLenLengths.begin() + 280, litLenLengths.end(), static_cast<uint8_t>(8));
+				std::array<uint8_t, 30> distLengths{};
+				distLengths.fill(5);
+
+				std::pair<HuffmanTable, HuffmanTable> tables;
+				tables.first.build(litLenLengths);
+				tables.second.build(distLengths);
+				return tables;
+			}();
+
+		const size_t streamBits = stream.size() * 8;
+		while (reader.position() < streamBits)
+		{
+			const size_t blockBit = reader.position();
+			const bool isFinal = reader.bits(1);
+			const uint32_t blockType = reader.bits(2);
+			if (blockType == 0)
+			{
+				reader.align();
+				const uint32_t length = reader.bits(16);
+				const uint32_t invLength = reader.bits(16);
+				if ((length ^ 0xFFFF) != invLength)
+				{
+					PSAPI_LOG_ERROR("Deflate", "Stored block length does not match its complement");
+				}
+				reader.seek(reader.position() / 8 + length);
+			}
+			else if (blockType == 1)
+			{
+				SkipHuffmanBlock(reader, fixedTables.first, fixedTables.second);
+			}
+			else if (blockType == 2)
+			{
+				ReadDynamicTables(reader, litLenTable, distTable);
+				SkipHuffmanBlock(reader, litLenTable, distTable);
+			}
+			else
+			{
+				PSAPI_LOG_ERROR("Deflate", "Invalid block type 3 encountered at bit %zu", blockBit);
+			}
+
+			if (reader.position() > streamBits)
+			{
+				break;
+			}
+			if (isFinal)
+			{
+				return StreamEnd{ blockBit, reader.position() };
+			}
+		}
+		PSAPI_LOG_ERROR("Deflate", "Unexpected end of deflate stream, no final block found");
+		return StreamEnd{};
+	}
+
+
+	// Turn a complete raw deflate stream into a non-final, byte-aligned part of a larger stream. This clears the BFINAL
+	// bit of its last block and terminates it with an empty stored block (the equivalent of a zlib Z_SYNC_FLUSH) such
+	// that another deflate stream may directly follow it. Returns the new size of the stream in bytes, the stream must
+	// have at least 5 bytes of capacity past its size.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline size_t MakeNonFinal(std::span<uint8_t> stream, const size_t streamSize)
+	{
+		const StreamEnd end = FindStreamEnd(std::span<const uint8_t>(stream.data(), streamSize));
+		stream[end.finalBlockBit >> 3] &= static_cast<uint8_t>(~(1u << (end.finalBlockBit & 7)));
+
+		// The empty stored block header (BFINAL=0, BTYPE=00) is made up of 3 zero bits which we can place in the zero
+		// padding of the last byte if there is enough room. Otherwise it spills into an additional zero byte
+		size_t size = (end.endBit + 7) >> 3;
+		const size_t paddingBits = size * 8 - end.endBit;
+		if (paddingBits < 3)
+		{
+			stream[size++] = 0x00;
+		}
+		// LEN and NLEN of the stored block
+		stream[size++] = 0x00;
+		stream[size++] = 0x00;
+		stream[size++] = 0xFF;
+		stream[size++] = 0xFF;
+		return size;
+	}
+
+
+	// Combine the adler32 checksums of two consecutive pieces of data into the checksum of the concatenated data
+	// where secondLength is the size of the second piece in bytes. This is the same approach as zlib's adler32_combine.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline uint32_t Adler32Combine(const uint32_t first, const uint32_t second, const uint64_t secondLength)
+	{
+		constexpr uint32_t base = 65521u;
+		const uint32_t remainder = static_cast<uint32_t>(secondLength % base);
+		uint64_t sum1 = first & 0xFFFFu;
+		uint64_t sum2 = (static_cast<uint64_t>(remainder) * sum1) % base;
+		sum1 += (second & 0xFFFFu) + base - 1;
+		sum2 += ((first >> 16) & 0xFFFFu) + ((second >> 16) & 0xFFFFu) + base - remainder;
+		sum1 %= base;
+		sum2 %= base;
+		return static_cast<uint32_t>(sum1 | (sum2 << 16));
+	}
+}
+
+
+PSAPI_NAMESPACE_END
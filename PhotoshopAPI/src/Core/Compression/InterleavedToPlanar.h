@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Util/Profiling/Perf/Instrumentor.h"
+#include "Util/CPUFeatures.h"
 
 #include <vector>
 #include <algorithm>
@@ -14,10 +15,6 @@
 #include <span>
 #endif
 
-#ifdef __AVX2__
-#include "immintrin.h"
-#endif
-
 
 PSAPI_NAMESPACE_BEGIN
 
@@ -26,13 +23,13 @@ namespace ZIP_Impl
     namespace
     {
 
-#ifdef __AVX2__
+#ifdef PSAPI_SIMD_AVX2
         // Interleave 32 floats (4 256-bit wide simd registers) at once converting them from interleaved to planar order
         // Storing them in the appropriate byte_* views. There must be at least 128 bytes available in the 
         // interleaved_bytes as well as at least 32 bytes for each of the byte_* spans. 
         // We have a separate offset for indexing into the interleaved_bytes and each of the byte_* views.
         // For reference, interleaved_offset should be 4x byte_offset
-        inline void interleavedToPlanar32(
+        PSAPI_TARGET_AVX2 inline void interleavedToPlanar32(
             const std::span<uint8_t> interleavedData,
             std::span<uint8_t> byte0,
             std::span<uint8_t> byte1,
@@ -95,6 +92,80 @@ namespace ZIP_Impl
                 _mm256_storeu_si256((__m256i*)(byte3.data() + byteOffset), _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(byte23_0, byte23_1), permute_mask));
             }
         }
+
+        // Interleave 32 floats at once, going from planar to interleaved byte order (1111 2222 3333 4444 -> 1234 1234 1234 1234)
+        // while converting from big endian to native (little) endian. There must be at least 32 bytes available in each of the
+        // byte* spans from byteOffset and 128 bytes in interleavedData from interleavedOffset.
+        PSAPI_TARGET_AVX2 inline void planarToInterleaved32(
+            const std::span<const uint8_t> byte0,
+            const std::span<const uint8_t> byte1,
+            const std::span<const uint8_t> byte2,
+            const std::span<const uint8_t> byte3,
+            std::span<uint8_t> interleavedData,
+            size_t byteOffset,
+            size_t interleavedOffset)
+        {
+            // byte0 holds the most significant byte so on little endian it goes last
+            const __m256i plane0 = _mm256_loadu_si256((const __m256i*)(byte3.data() + byteOffset));
+            const __m256i plane1 = _mm256_loadu_si256((const __m256i*)(byte2.data() + byteOffset));
+            const __m256i plane2 = _mm256_loadu_si256((const __m256i*)(byte1.data() + byteOffset));
+            const __m256i plane3 = _mm256_loadu_si256((const __m256i*)(byte0.data() + byteOffset));
+
+            // Unpacking works per 128-bit lane so the low lanes hold the floats [0, 16) and the high lanes [16, 32)
+            const __m256i bytes01_lo = _mm256_unpacklo_epi8(plane0, plane1);
+            const __m256i bytes01_hi = _mm256_unpackhi_epi8(plane0, plane1);
+            const __m256i bytes23_lo = _mm256_unpacklo_epi8(plane2, plane3);
+            const __m256i bytes23_hi = _mm256_unpackhi_epi8(plane2, plane3);
+
+            const __m256i floats0 = _mm256_unpacklo_epi16(bytes01_lo, bytes23_lo);  // 0-3 and 16-19
+            const __m256i floats1 = _mm256_unpackhi_epi16(bytes01_lo, bytes23_lo);  // 4-7 and 20-23
+            const __m256i floats2 = _mm256_unpacklo_epi16(bytes01_hi, bytes23_hi);  // 8-11 and 24-27
+            const __m256i floats3 = _mm256_unpackhi_epi16(bytes01_hi, bytes23_hi);  // 12-15 and 28-31
+
+            __m256i* out = (__m256i*)(interleavedData.data() + interleavedOffset);
+            _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(floats0, floats1, 0x20));
+            _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(floats2, floats3, 0x20));
+            _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(floats0, floats1, 0x31));
+            _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(floats2, floats3, 0x31));
+        }
+
+        // Convert as many whole blocks of 32 floats of the scanline from interleaved to planar order as possible, returning 
+        // the number of converted floats
+        PSAPI_TARGET_AVX2 inline uint32_t interleavedToPlanarFloatAVX2(
+            const std::span<uint8_t> interleavedData,
+            std::span<uint8_t> byte0,
+            std::span<uint8_t> byte1,
+            std::span<uint8_t> byte2,
+            std::span<uint8_t> byte3,
+            const uint32_t width)
+        {
+            const uint32_t numVecs = width / 32;
+            for (size_t i = 0; i < numVecs; ++i)
+            {
+                size_t interleavedOffset = i * 32 * sizeof(float32_t);  // Number of 4-byte pairs we have iterated
+                size_t byteOffset = i * 32;                             // Number of bytes we have iterated
+                interleavedToPlanar32(interleavedData, byte0, byte1, byte2, byte3, interleavedOffset, byteOffset);
+            }
+            return numVecs * 32;
+        }
+
+        // Convert as many whole blocks of 32 floats of the scanline from planar to interleaved order as possible, returning 
+        // the number of converted floats
+        PSAPI_TARGET_AVX2 inline uint32_t planarToInterleavedFloatAVX2(
+            const std::span<const uint8_t> byte0,
+            const std::span<const uint8_t> byte1,
+            const std::span<const uint8_t> byte2,
+            const std::span<const uint8_t> byte3,
+            std::span<uint8_t> interleavedData,
+            const uint32_t width)
+        {
+            uint32_t start = 0;
+            for (; start + 32 <= width; start += 32)
+            {
+                planarToInterleaved32(byte0, byte1, byte2, byte3, interleavedData, start, static_cast<size_t>(start) * sizeof(float32_t));
+            }
+            return start;
+        }
 #endif
     }
 
@@ -115,21 +186,17 @@ namespace ZIP_Impl
         std::span<uint8_t> byte2View(planarBuffer.data() + 2 * width, width);
         std::span<uint8_t> byte3View(planarBuffer.data() + 3 * width, width);
 
-#ifdef __AVX2__
-        uint32_t numVecs = width / 32;   // Number of vectors we can convert using SIMD
-        uint32_t numScalar = width % 32; // Number of scalar operations we need to do to "finish" the data
-
-        for (size_t i = 0; i < numVecs; ++i)
+        uint32_t start = 0;
+#ifdef PSAPI_SIMD_AVX2
+        if (CPU::hasAVX2())
         {
-            size_t interleavedOffset = i * 32 * sizeof(float32_t);  // Number of 4-byte pairs we have iterated
-            size_t byteOffset = i * 32;                             // Number of bytes we have iterated
-
-            interleavedToPlanar32(interleavedData, byte0View, byte1View, byte2View, byte3View, interleavedOffset, byteOffset);
+            start = interleavedToPlanarFloatAVX2(interleavedData, byte0View, byte1View, byte2View, byte3View, width);
         }
-        for (uint32_t i = 0; i < numScalar; ++i)
+#endif
+        for (uint32_t i = start; i < width; ++i)
         {
-            size_t offsetInterleaved = static_cast<size_t>(numVecs) * 32 * sizeof(float32_t) + i * sizeof(float32_t);
-            size_t offsetPlanar = static_cast<size_t>(numVecs) * 32 + i;
+            size_t offsetInterleaved = static_cast<size_t>(i) * sizeof(float32_t);
+            size_t offsetPlanar = i;
             if constexpr (std::endian::native == std::endian::little)
             {
                 byte0View[offsetPlanar] = interleavedData[offsetInterleaved + 3];
@@ -145,27 +212,50 @@ namespace ZIP_Impl
                 byte3View[offsetPlanar] = interleavedData[offsetInterleaved + 3];
             }
         }
-#else
-        for (uint32_t i = 0; i < width; ++i)
+    }
+
+    // Go from planar byte order back to an interleaved array of floats
+    // i.e. 1111 2222 3333 4444 -> 1234 1234 1234 1234 while converting from big-endian to native order. This is the inverse
+    // of interleavedToPlanarFloat(). planarData represents a single scanline of width * sizeof(float32_t) bytes and 
+    // interleavedData must be at least as large, the two may not overlap.
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline void planarToInterleavedFloat(std::span<const uint8_t> planarData, std::span<uint8_t> interleavedData, const uint32_t width)
+    {
+        // Input planar views
+        std::span<const uint8_t> byte0View(planarData.data() + 0 * static_cast<size_t>(width), width);
+        std::span<const uint8_t> byte1View(planarData.data() + 1 * static_cast<size_t>(width), width);
+        std::span<const uint8_t> byte2View(planarData.data() + 2 * static_cast<size_t>(width), width);
+        std::span<const uint8_t> byte3View(planarData.data() + 3 * static_cast<size_t>(width), width);
+
+        uint32_t start = 0;
+#ifdef PSAPI_SIMD_AVX2
+        if constexpr (std::endian::native == std::endian::little)
         {
-            size_t offsetInterleaved = i * sizeof(float32_t);
-            size_t offsetPlanar = i;
+            if (CPU::hasAVX2())
+            {
+                start = planarToInterleavedFloatAVX2(byte0View, byte1View, byte2View, byte3View, interleavedData, width);
+            }
+        }
+#endif
+        for (uint32_t i = start; i < width; ++i)
+        {
+            size_t offsetInterleaved = static_cast<size_t>(i) * sizeof(float32_t);
             if constexpr (std::endian::native == std::endian::little)
             {
-                byte0View[offsetPlanar] = interleavedData[offsetInterleaved + 3];
-                byte1View[offsetPlanar] = interleavedData[offsetInterleaved + 2];
-                byte2View[offsetPlanar] = interleavedData[offsetInterleaved + 1];
-                byte3View[offsetPlanar] = interleavedData[offsetInterleaved + 0];
+                interleavedData[offsetInterleaved + 3] = byte0View[i];
+                interleavedData[offsetInterleaved + 2] = byte1View[i];
+                interleavedData[offsetInterleaved + 1] = byte2View[i];
+                interleavedData[offsetInterleaved + 0] = byte3View[i];
             }
             else
             {
-                byte0View[offsetPlanar] = interleavedData[offsetInterleaved + 0];
-                byte1View[offsetPlanar] = interleavedData[offsetInterleaved + 1];
-                byte2View[offsetPlanar] = interleavedData[offsetInterleaved + 2];
-                byte3View[offsetPlanar] = interleavedData[offsetInterleaved + 3];
+                interleavedData[offsetInterleaved + 0] = byte0View[i];
+                interleavedData[offsetInterleaved + 1] = byte1View[i];
+                interleavedData[offsetInterleaved + 2] = byte2View[i];
+                interleavedData[offsetInterleaved + 3] = byte3View[i];
             }
         }
-#endif
     }
 
 }
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "Macros.h"
+#include "Util/CPUFeatures.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+
+// If we compile with C++<20 we replace the stdlib implementation with the compatibility
+// library
+#if (__cplusplus < 202002L)
+#include "tcb_span.hpp"
+#else
+#include <span>
+#endif
+
+
+// Kernels for the per-scanline prediction (delta) coding used by the ZipPrediction compression. Encoding replaces each
+// value with its difference to the previous value on the scanline while decoding is the inverse prefix sum. 16-bit data
+// is additionally converted from/to big endian within the same pass.
+
+PSAPI_NAMESPACE_BEGIN
+
+namespace ZIP_Impl
+{
+    namespace Prediction_Impl
+    {
+        inline uint16_t byteSwapIfLE(const uint16_t value) noexcept
+        {
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                return static_cast<uint16_t>((value >> 8) | (value << 8));
+            }
+            else
+            {
+                return value;
+            }
+        }
+
+#ifdef PSAPI_SIMD_AVX2
+        // Swap the bytes of each 16-bit element within a 128-bit lane
+        PSAPI_TARGET_AVX2 inline __m256i byteSwapMask16()
+        {
+            return _mm256_setr_epi8(
+                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+            );
+        }
+
+        // Compute the inclusive prefix sum of the 32 bytes of the vector and add the carry (the broadcast running sum of
+        // the previous vector). The sums are first computed per 128-bit lane in log2(16) steps after which the total of
+        // the low lane gets added to the high lane. Returns the result while updating the carry.
+        PSAPI_TARGET_AVX2 inline __m256i prefixSum8(__m256i value, __m256i& carry)
+        {
+            const __m256i lastByte = _mm256_set1_epi8(15);
+            value = _mm256_add_epi8(value, _mm256_slli_si256(value, 1));
+            value = _mm256_add_epi8(value, _mm256_slli_si256(value, 2));
+            value = _mm256_add_epi8(value, _mm256_slli_si256(value, 4));
+            value = _mm256_add_epi8(value, _mm256_slli_si256(value, 8));
+
+            const __m256i laneSum = _mm256_shuffle_epi8(value, lastByte);
+            value = _mm256_add_epi8(value, _mm256_permute2x128_si256(laneSum, laneSum, 0x08));
+            value = _mm256_add_epi8(value, carry);
+
+            const __m256i total = _mm256_shuffle_epi8(value, lastByte);
+            carry = _mm256_permute2x128_si256(total, total, 0x11);
+            return value;
+        }
+
+        // Same as prefixSum8 but operating on 16 16-bit elements
+        PSAPI_TARGET_AVX2 inline __m256i prefixSum16(__m256i value, __m256i& carry)
+        {
+            const __m256i lastWord = _mm256_setr_epi8(
+                14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15,
+                14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15
+            );
+            value = _mm256_add_epi16(value, _mm256_slli_si256(value, 2));
+            value = _mm256_add_epi16(value, _mm256_slli_si256(value, 4));
+            value = _mm256_add_epi16(value, _mm256_slli_si256(value, 8));
+
+            const __m256i laneSum = _mm256_shuffle_epi8(value, lastWord);
+            value = _mm256_add_epi16(value, _mm256_permute2x128_si256(laneSum, laneSum, 0x08));
+            value = _mm256_add_epi16(value, carry);
+
+            const __m256i total = _mm256_shuffle_epi8(value, lastWord);
+            carry = _mm256_permute2x128_si256(total, total, 0x11);
+            return value;
+        }
+
+        // Decode the scanline 32 bytes at a time, returning the number of decoded bytes
+        PSAPI_TARGET_AVX2 inline size_t predictionDecodeRowAVX2(std::span<const uint8_t> src, std::span<uint8_t> dst)
+        {
+            size_t x = 0;
+            __m256i carry = _mm256_setzero_si256();
+            for (; x + 32 <= src.size(); x += 32)
+            {
+                const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src.data() + x));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst.data() + x), prefixSum8(value, carry));
+            }
+            return x;
+        }
+
+        // Decode the scanline 16 values at a time, returning the number of decoded values
+        PSAPI_TARGET_AVX2 inline size_t predictionDecodeRowAVX2(std::span<uint16_t> row)
+        {
+            size_t x = 0;
+            const __m256i swapMask = byteSwapMask16();
+            __m256i carry = _mm256_setzero_si256();
+            for (; x + 16 <= row.size(); x += 16)
+            {
+                __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row.data() + x));
+                value = _mm256_shuffle_epi8(value, swapMask);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(row.data() + x), prefixSum16(value, carry));
+            }
+            return x;
+        }
+
+        // Encode the scanline back to front 32 bytes at a time, returning the number of bytes at the front that are left
+        // to encode. Each vector reads one element past its start which must not have been overwritten yet
+        PSAPI_TARGET_AVX2 inline size_t predictionEncodeRowAVX2(std::span<const uint8_t> src, std::span<uint8_t> dst)
+        {
+            size_t x = src.size();
+            while (x >= 33)
+            {
+                x -= 32;
+                const __m256i curr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src.data() + x));
+                const __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src.data() + x - 1));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst.data() + x), _mm256_sub_epi8(curr, prev));
+            }
+            return x;
+        }
+
+        // Encode the scanline back to front 16 values at a time, returning the number of values at the front that are left
+        // to encode
+        PSAPI_TARGET_AVX2 inline size_t predictionEncodeRowAVX2(std::span<uint16_t> row)
+        {
+            size_t x = row.size();
+            const __m256i swapMask = byteSwapMask16();
+            while (x >= 17)
+            {
+                x -= 16;
+                const __m256i curr = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row.data() + x));
+                const __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row.data() + x - 1));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(row.data() + x), _mm256_shuffle_epi8(_mm256_sub_epi16(curr, prev), swapMask));
+            }
+            return x;
+        }
+#endif
+    }
+
+
+    // Reverse the prediction encoding of a scanline of bytes from src into dst which must be the same size. src and dst
+    // may point to the same memory
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline void predictionDecodeRow(std::span<const uint8_t> src, std::span<uint8_t> dst)
+    {
+        size_t x = 0;
+#ifdef PSAPI_SIMD_AVX2
+        if (CPU::hasAVX2())
+        {
+            x = Prediction_Impl::predictionDecodeRowAVX2(src, dst);
+        }
+#endif
+        uint8_t prev = x > 0 ? dst[x - 1] : 0;
+        for (; x < src.size(); ++x)
+        {
+            prev = static_cast<uint8_t>(prev + src[x]);
+            dst[x] = prev;
+        }
+    }
+
+
+    // Reverse the prediction encoding of a scanline of big endian 16-bit values in-place, converting them to native
+    // endianness
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline void predictionDecodeRow(std::span<uint16_t> row)
+    {
+        size_t x = 0;
+#ifdef PSAPI_SIMD_AVX2
+        if (CPU::hasAVX2())
+        {
+            x = Prediction_Impl::predictionDecodeRowAVX2(row);
+        }
+#endif
+        uint16_t prev = x > 0 ? row[x - 1] : 0;
+        for (; x < row.size(); ++x)
+        {
+            prev = static_cast<uint16_t>(prev + Prediction_Impl::byteSwapIfLE(row[x]));
+            row[x] = prev;
+        }
+    }
+
+
+    // Prediction encode a scanline of bytes from src into dst which must be the same size. src and dst may point to the
+    // same memory as we iterate the scanline back to front
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline void predictionEncodeRow(std::span<const uint8_t> src, std::span<uint8_t> dst)
+    {
+        size_t x = src.size();
+#ifdef PSAPI_SIMD_AVX2
+        if (CPU::hasAVX2())
+        {
+            x = Prediction_Impl::predictionEncodeRowAVX2(src, dst);
+        }
+#endif
+        for (; x > 1; --x)
+        {
+            dst[x - 1] = static_cast<uint8_t>(src[x - 1] - src[x - 2]);
+        }
+        if (!src.empty())
+        {
+            dst[0] = src[0];
+        }
+    }
+
+
+    // Prediction encode a scanline of native 16-bit values in-place, converting them to big endian
+    // ---------------------------------------------------------------------------------------------------------------------
+    // ---------------------------------------------------------------------------------------------------------------------
+    inline void predictionEncodeRow(std::span<uint16_t> row)
+    {
+        size_t x = row.size();
+#ifdef PSAPI_SIMD_AVX2
+        if (CPU::hasAVX2())
+        {
+            x = Prediction_Impl::predictionEncodeRowAVX2(row);
+        }
+#endif
+        for (; x > 1; --x)
+        {
+            row[x - 1] = Prediction_Impl::byteSwapIfLE(static_cast<uint16_t>(row[x - 1] - row[x - 2]));
+        }
+        if (!row.empty())
+        {
+            row[0] = Prediction_Impl::byteSwapIfLE(row[0]);
+        }
+    }
+}
+
+PSAPI_NAMESPACE_END
@@ -2,8 +2,14 @@
 
 #include "Macros.h"
 #include "Util/Logger.h"
+#include "Util/CPUFeatures.h"
 
-#include <immintrin.h>
+#include <cstdint>
+#include <type_traits>
+#include <bit>
+
+// The kernels in this header are only available on x86 and must only be called after checking CPU::hasAVX2()
+#ifdef PSAPI_SIMD_AVX2
 
 PSAPI_NAMESPACE_BEGIN
 
@@ -13,7 +19,7 @@ namespace byteShufffleImpl
 	// This function requires the data span to be 32 wide (256 bit register / 8 bits).
 	// Please perform checks on whether a byte shuffle is even required before using
 	// this function
-	inline void byteShuffleAVX2_2Wide(uint8_t* data)
+	PSAPI_TARGET_AVX2 inline void byteShuffleAVX2_2Wide(uint8_t* data)
 	{
 		// Load our span into a 256 wide register
 		__m256i vec = _mm256_loadu_si256(reinterpret_cast<__m256i*>(&data[0]));
@@ -34,7 +40,7 @@ namespace byteShufffleImpl
 	// This function requires the data span to be 32 wide (256 bit register / 8 bits)
 	// Please perform checks on whether a byte shuffle is even required before using
 	// this function
-	inline void byteShuffleAVX2_4Wide(uint8_t* data)
+	PSAPI_TARGET_AVX2 inline void byteShuffleAVX2_4Wide(uint8_t* data)
 	{
 		// Load our span into a 256 wide register
 		__m256i vec = _mm256_loadu_si256(reinterpret_cast<__m256i*>(&data[0]));
@@ -55,7 +61,7 @@ namespace byteShufffleImpl
 	// This function requires the data span to be 32 wide (256 bit register / 8 bits)
 	// Please perform checks on whether a byte shuffle is even required before using
 	// this function
-	inline void byteShuffleAVX2_8Wide(uint8_t* data)
+	PSAPI_TARGET_AVX2 inline void byteShuffleAVX2_8Wide(uint8_t* data)
 	{
 		__m256i vec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
 
@@ -77,7 +83,7 @@ namespace byteShufffleImpl
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <typename T>
-void byteShuffleAVX2_BE(uint8_t* data)
+inline void byteShuffleAVX2_BE([[maybe_unused]] uint8_t* data)
 {
 }
 
@@ -86,7 +92,7 @@ void byteShuffleAVX2_BE(uint8_t* data)
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <typename T>
-inline void byteShuffleAVX2_LE(uint8_t* data)
+PSAPI_TARGET_AVX2 inline void byteShuffleAVX2_LE(uint8_t* data)
 {
 	static_assert(std::is_trivially_copyable_v<T>,
 				  "byteShuffleAVX2_LE requires trivially copyable types");
@@ -115,4 +121,27 @@ inline void byteShuffleAVX2_LE(uint8_t* data)
 	}
 }
 
-PSAPI_NAMESPACE_END
\ No newline at end of file
+
+// Byteswap numVecs consecutive 256-bit vectors starting at data in-place. Keeping the loop inside of the AVX2 function
+// allows the compiler to inline the shuffles which it wouldn't do across the target boundary
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+template <typename T>
+PSAPI_TARGET_AVX2 inline void byteShuffleAVX2Block(uint8_t* data, uint64_t numVecs)
+{
+	for (uint64_t i = 0; i < numVecs; ++i)
+	{
+		if constexpr (std::endian::native == std::endian::little)
+		{
+			byteShuffleAVX2_LE<T>(data + i * 32);
+		}
+		else
+		{
+			byteShuffleAVX2_BE<T>(data + i * 32);
+		}
+	}
+}
+
+PSAPI_NAMESPACE_END
+
+#endif // PSAPI_SIMD_AVX2
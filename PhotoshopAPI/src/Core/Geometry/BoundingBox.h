@@ -7,6 +7,7 @@
 
 #include <array>
 #include <optional>
+#include <span>
 
 PSAPI_NAMESPACE_BEGIN
 
@@ -149,9 +150,9 @@ namespace Geometry
         }
 
         /// Compute the bounding box over a set of points.
-        /// \param points A vector of points to enclose.
+        /// \param points The points to enclose.
         /// \return The bounding box that minimally encloses all the points.
-        static BoundingBox compute(const std::vector<Point2D<T>>& points)
+        static BoundingBox compute(std::span<const Point2D<T>> points)
         {
             BoundingBox bbox;
             bbox.minimum = Point2D<T>(std::numeric_limits<T>::max(), std::numeric_limits<T>::max());
@@ -169,9 +170,9 @@ namespace Geometry
 
 
         /// Compute the bounding box over a set of vertices.
-        /// \param vertices A vector of vertices to enclose.
+        /// \param vertices The vertices to enclose.
         /// \return The bounding box that minimally encloses all the vertices.
-        static BoundingBox compute(const std::vector<Vertex<T>>& vertices)
+        static BoundingBox compute(std::span<const Vertex<T>> vertices)
         {
             BoundingBox bbox;
             bbox.minimum = Point2D<T>(std::numeric_limits<T>::max(), std::numeric_limits<T>::max());
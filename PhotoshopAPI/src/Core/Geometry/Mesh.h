@@ -5,6 +5,7 @@
 #include "Util/Profiling/Perf/Instrumentor.h"
 
 #include <vector>
+#include <array>
 #include <memory>
 #include <cmath>
 #include <span>
@@ -417,6 +418,67 @@ namespace Geometry
             return Point2D<double>(-1.0, -1.0); // No valid UV coordinate found
         }
 
+        /// Rasterize the uv coordinates of the given faces onto a regular grid of sample points. This is the forward
+        /// equivalent of calling `uv_coordinate()` for every sample point but its cost is proportional to the area the
+        /// faces cover rather than requiring a lookup per sample.
+        /// 
+        /// The sample at grid index (x, y) lies at `origin + (x, y) * step`. Each face is split into the same two 
+        /// triangles `uv_coordinate()` uses whose edge functions are evaluated across the samples within their bounding 
+        /// box. Samples already holding a uv coordinate are not overwritten such that, like `uv_coordinate()`, the first 
+        /// face (and triangle) covering a sample wins.
+        /// 
+        /// \param origin       The position of the first sample
+        /// \param step         The distance between two adjacent samples along both axes
+        /// \param grid_width   The number of samples along the x axis
+        /// \param grid_height  The number of samples along the y axis
+        /// \param faces        The indices of the faces to rasterize
+        /// \param out          The grid to write into of grid_width * grid_height samples, this must be filled with 
+        ///                     {-1, -1} for any sample not yet covered.
+        void rasterize_uv(
+            Point2D<T> origin, 
+            T step, 
+            size_t grid_width, 
+            size_t grid_height, 
+            std::span<const size_t> faces, 
+            std::span<Point2D<double>> out) const
+        {
+            if (out.size() != grid_width * grid_height)
+            {
+                PSAPI_LOG_ERROR("Mesh", "Unable to rasterize uv coordinates, the output holds %zu samples rather than the expected %zu", out.size(), grid_width * grid_height);
+            }
+            if (grid_width == 0 || grid_height == 0)
+            {
+                return;
+            }
+
+            for (size_t face_index : faces)
+            {
+                const Face<T, 4>& face = m_Faces[face_index];
+                const Vertex<T>& v0 = m_Vertices[face.vertex_idx(0)];
+                const Vertex<T>& v1 = m_Vertices[face.vertex_idx(1)];
+                const Vertex<T>& v2 = m_Vertices[face.vertex_idx(2)];
+                const Vertex<T>& v3 = m_Vertices[face.vertex_idx(3)];
+
+                // Limit the triangles to the samples within the face's bbox, this matches the rejection done by uv_coordinate()
+                const auto& face_bbox = face.bbox();
+                const T min_x = std::ceil((face_bbox.minimum.x - origin.x) / step);
+                const T max_x = std::floor((face_bbox.maximum.x - origin.x) / step);
+                const T min_y = std::ceil((face_bbox.minimum.y - origin.y) / step);
+                const T max_y = std::floor((face_bbox.maximum.y - origin.y) / step);
+                if (max_x < 0 || max_y < 0 || min_x > static_cast<T>(grid_width - 1) || min_y > static_cast<T>(grid_height - 1))
+                {
+                    continue;
+                }
+                const size_t x_begin = static_cast<size_t>(std::max<T>(min_x, 0));
+                const size_t x_end = static_cast<size_t>(std::min<T>(max_x, static_cast<T>(grid_width - 1))) + 1;
+                const size_t y_begin = static_cast<size_t>(std::max<T>(min_y, 0));
+                const size_t y_end = static_cast<size_t>(std::min<T>(max_y, static_cast<T>(grid_height - 1))) + 1;
+
+                rasterize_triangle(v0, v1, v3, origin, step, grid_width, x_begin, x_end, y_begin, y_end, out);
+                rasterize_triangle(v0, v2, v3, origin, step, grid_width, x_begin, x_end, y_begin, y_end, out);
+            }
+        }
+
         BoundingBox<T> bbox() const noexcept
         {
             return m_BoundingBox;
@@ -465,7 +527,7 @@ namespace Geometry
                     size_t v2_idx = v0_idx + x_divisions;       // bottom-left vertex
                     size_t v3_idx = v2_idx + 1;                 // bottom-right vertex
 
-                    std::vector<Vertex<T>> face_vertices = { m_Vertices[v0_idx], m_Vertices[v1_idx], m_Vertices[v2_idx], m_Vertices[v3_idx] };
+                    std::array<Vertex<T>, 4> face_vertices = { m_Vertices[v0_idx], m_Vertices[v1_idx], m_Vertices[v2_idx], m_Vertices[v3_idx] };
 
                     auto& created_face = m_Faces.emplace_back();
                     created_face.vertex_indices({ v0_idx, v1_idx, v2_idx, v3_idx });
@@ -482,7 +544,7 @@ namespace Geometry
             for (Face<T, 4>& _face : m_Faces)
             {
                 auto face_indices = _face.vertex_indices();
-                std::vector<Vertex<T>> points = { m_Vertices[face_indices[0]], m_Vertices[face_indices[1]], m_Vertices[face_indices[2]],m_Vertices[face_indices[3]] };
+                std::array<Vertex<T>, 4> points = { m_Vertices[face_indices[0]], m_Vertices[face_indices[1]], m_Vertices[face_indices[2]], m_Vertices[face_indices[3]] };
 
                 _face.bbox(BoundingBox<T>::compute(points));
             }
@@ -524,6 +586,78 @@ namespace Geometry
         }
 
 
+        /// Rasterize the uv coordinates of the triangle (a, b, c) onto the given sample range of the grid. Like 
+        /// point_in_triangle() the edges are inclusive and the winding of the triangle does not matter.
+        void rasterize_triangle(
+            const Vertex<T>& a,
+            const Vertex<T>& b,
+            const Vertex<T>& c,
+            Point2D<T> origin,
+            T step,
+            size_t grid_width,
+            size_t x_begin,
+            size_t x_end,
+            size_t y_begin,
+            size_t y_end,
+            std::span<Point2D<double>> out) const
+        {
+            // Each edge function is of the form e(p) = dx * p.x + dy * p.y + offset and is zero along the edge u -> v. 
+            // The edge function opposite of a vertex divided by the triangles (doubled) area is that vertex' barycentric 
+            // weight, meaning it is positive (or negative for the opposite winding) for all samples within the triangle
+            struct EdgeFunction
+            {
+                double dx = 0;
+                double dy = 0;
+                double offset = 0;
+
+                EdgeFunction(Point2D<T> u, Point2D<T> v)
+                    : dx(-(v.y - u.y)), dy(v.x - u.x), offset((v.y - u.y) * u.x - (v.x - u.x) * u.y) {}
+            };
+            const EdgeFunction edge_a(b.point(), c.point());
+            const EdgeFunction edge_b(c.point(), a.point());
+            const EdgeFunction edge_c(a.point(), b.point());
+
+            const double area = edge_a.dx * a.point().x + edge_a.dy * a.point().y + edge_a.offset;
+            if (area == 0.0)
+            {
+                return;
+            }
+            const Point2D<double> uv_a = a.uv() / area;
+            const Point2D<double> uv_b = b.uv() / area;
+            const Point2D<double> uv_c = c.uv() / area;
+
+            for (size_t y = y_begin; y < y_end; ++y)
+            {
+                const double position_y = origin.y + static_cast<double>(y) * step;
+                // Evaluate the part of the edge functions that is constant across the row once
+                const double row_a = edge_a.dy * position_y + edge_a.offset;
+                const double row_b = edge_b.dy * position_y + edge_b.offset;
+                const double row_c = edge_c.dy * position_y + edge_c.offset;
+
+                for (size_t x = x_begin; x < x_end; ++x)
+                {
+                    Point2D<double>& sample = out[y * grid_width + x];
+                    if (sample.x != -1.0 || sample.y != -1.0)
+                    {
+                        continue;
+                    }
+                    const double position_x = origin.x + static_cast<double>(x) * step;
+                    const double weight_a = edge_a.dx * position_x + row_a;
+                    const double weight_b = edge_b.dx * position_x + row_b;
+                    const double weight_c = edge_c.dx * position_x + row_c;
+
+                    const bool has_neg = weight_a < 0 || weight_b < 0 || weight_c < 0;
+                    const bool has_pos = weight_a > 0 || weight_b > 0 || weight_c > 0;
+                    if (has_neg && has_pos)
+                    {
+                        continue;
+                    }
+                    sample = uv_a * weight_a + uv_b * weight_b + uv_c * weight_c;
+                }
+            }
+        }
+
+
         bool point_in_quad(Point2D<T> p, Point2D<T> v0, Point2D<T> v1, Point2D<T> v3, Point2D<T> v2) const
         {
             // Check if the point is inside either of the triangles formed by splitting the quad
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
+#include "Util/CPUFeatures.h"
 
 
 #include "ImageBuffer.h"
@@ -8,6 +10,12 @@
 #include <type_traits>
 #include <concepts>
 #include <ranges>
+#include <array>
+#include <span>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <optional>
 
 #include <fmt/format.h>
 #include <OpenImageIO/Imath.h>
@@ -32,6 +40,20 @@ namespace Composite
 		/// concept for a compositing kernel taking the canvas value, the layer value as well as the layer alpha.
 		template <typename T, typename KernelFunc>
 		concept kernel = std::is_invocable_r_v<T, KernelFunc, T, T, T, T>;
+
+		/// concept for a separable blend mode, combining a single (non-premultiplied) canvas and layer component.
+		template <typename BlendOp, typename _Precision>
+		concept separable_blend = requires(_Precision value)
+		{
+			{ BlendOp::template apply<_Precision>(value, value) } -> std::convertible_to<_Precision>;
+		};
+
+		/// concept for a non-separable blend mode, combining all three (non-premultiplied) color components at once.
+		template <typename BlendOp, typename _Precision>
+		concept nonseparable_blend = requires(std::array<_Precision, 3> color)
+		{
+			{ BlendOp::template apply<_Precision>(color, color) } -> std::convertible_to<std::array<_Precision, 3>>;
+		};
 	}
 
 
@@ -45,12 +67,14 @@ namespace Composite
 			template <typename T>
 			constexpr T calc_max_t()
 			{
-				constexpr T max_t = std::numeric_limits<T>::max();
 				if constexpr (concepts::is_floating_v<T>)
 				{
-					max_t = static_cast<T>(1.0f);
+					return static_cast<T>(1.0f);
+				}
+				else
+				{
+					return std::numeric_limits<T>::max();
 				}
-				return max_t;
 			}
 
 
@@ -118,7 +142,521 @@ namespace Composite
 			}
 		}
 
+
+		/// Separable blend modes, these combine a single canvas component `cb` and layer component `cs` (both in the 
+		/// range 0-1 and not premultiplied) into the blended component. The formulas follow the W3C compositing spec 
+		/// which matches Photoshop with the exception of minor differences in e.g. SoftLight.
+		namespace separable
+		{
+			struct normal
+			{
+				template <typename P>
+				static P apply([[maybe_unused]] P cb, P cs) { return cs; }
+			};
+
+			struct multiply
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return cb * cs; }
+			};
+
+			struct screen
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return cb + cs - cb * cs; }
+			};
+
+			struct hard_light
+			{
+				template <typename P>
+				static P apply(P cb, P cs)
+				{
+					const P two_cs = cs + cs;
+					if (cs <= static_cast<P>(0.5f))
+					{
+						return multiply::apply<P>(cb, two_cs);
+					}
+					return screen::apply<P>(cb, two_cs - static_cast<P>(1));
+				}
+			};
+
+			struct overlay
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return hard_light::apply<P>(cs, cb); }
+			};
+
+			struct soft_light
+			{
+				template <typename P>
+				static P apply(P cb, P cs)
+				{
+					const P one = static_cast<P>(1);
+					if (cs <= static_cast<P>(0.5f))
+					{
+						return cb - (one - cs - cs) * cb * (one - cb);
+					}
+					P d = static_cast<P>(std::sqrt(cb));
+					if (cb <= static_cast<P>(0.25f))
+					{
+						d = ((static_cast<P>(16) * cb - static_cast<P>(12)) * cb + static_cast<P>(4)) * cb;
+					}
+					return cb + (cs + cs - one) * (d - cb);
+				}
+			};
+
+			struct color_dodge
+			{
+				template <typename P>
+				static P apply(P cb, P cs)
+				{
+					const P one = static_cast<P>(1);
+					if (cb <= static_cast<P>(0))
+					{
+						return static_cast<P>(0);
+					}
+					if (cs >= one)
+					{
+						return one;
+					}
+					return std::min<P>(one, cb / (one - cs));
+				}
+			};
+
+			struct color_burn
+			{
+				template <typename P>
+				static P apply(P cb, P cs)
+				{
+					const P one = static_cast<P>(1);
+					if (cb >= one)
+					{
+						return one;
+					}
+					if (cs <= static_cast<P>(0))
+					{
+						return static_cast<P>(0);
+					}
+					return one - std::min<P>(one, (one - cb) / cs);
+				}
+			};
+
+			struct linear_dodge
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return std::min<P>(static_cast<P>(1), cb + cs); }
+			};
+
+			struct linear_burn
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return std::max<P>(static_cast<P>(0), cb + cs - static_cast<P>(1)); }
+			};
+
+			struct darken
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return std::min<P>(cb, cs); }
+			};
+
+			struct lighten
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return std::max<P>(cb, cs); }
+			};
+
+			struct difference
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return cb > cs ? cb - cs : cs - cb; }
+			};
+
+			struct exclusion
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return cb + cs - static_cast<P>(2) * cb * cs; }
+			};
+
+			struct subtract
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return std::max<P>(static_cast<P>(0), cb - cs); }
+			};
+
+			struct divide
+			{
+				template <typename P>
+				static P apply(P cb, P cs)
+				{
+					if (cs <= static_cast<P>(0))
+					{
+						return cb <= static_cast<P>(0) ? static_cast<P>(0) : static_cast<P>(1);
+					}
+					return std::min<P>(static_cast<P>(1), cb / cs);
+				}
+			};
+
+			struct vivid_light
+			{
+				template <typename P>
+				static P apply(P cb, P cs)
+				{
+					if (cs <= static_cast<P>(0.5f))
+					{
+						return color_burn::apply<P>(cb, cs + cs);
+					}
+					return color_dodge::apply<P>(cb, cs + cs - static_cast<P>(1));
+				}
+			};
+
+			struct linear_light
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return std::clamp<P>(cb + cs + cs - static_cast<P>(1), static_cast<P>(0), static_cast<P>(1)); }
+			};
+
+			struct pin_light
+			{
+				template <typename P>
+				static P apply(P cb, P cs)
+				{
+					if (cs <= static_cast<P>(0.5f))
+					{
+						return std::min<P>(cb, cs + cs);
+					}
+					return std::max<P>(cb, cs + cs - static_cast<P>(1));
+				}
+			};
+
+			struct hard_mix
+			{
+				template <typename P>
+				static P apply(P cb, P cs) { return cb + cs >= static_cast<P>(1) ? static_cast<P>(1) : static_cast<P>(0); }
+			};
+		}
+
+
+		/// Non-separable blend modes, these combine all three color components of the canvas `cb` and layer `cs` (in the
+		/// range 0-1 and not premultiplied) at once. These are only defined for RGB.
+		namespace nonseparable
+		{
+			namespace impl
+			{
+				template <typename P>
+				P lum(const std::array<P, 3>& c)
+				{
+					return static_cast<P>(0.3f) * c[0] + static_cast<P>(0.59f) * c[1] + static_cast<P>(0.11f) * c[2];
+				}
+
+				template <typename P>
+				std::array<P, 3> clip_color(std::array<P, 3> c)
+				{
+					const P l = lum<P>(c);
+					const P n = std::min<P>({ c[0], c[1], c[2] });
+					const P x = std::max<P>({ c[0], c[1], c[2] });
+					if (n < static_cast<P>(0) && l != n)
+					{
+						for (auto& value : c)
+						{
+							value = l + (value - l) * l / (l - n);
+						}
+					}
+					if (x > static_cast<P>(1) && x != l)
+					{
+						for (auto& value : c)
+						{
+							value = l + (value - l) * (static_cast<P>(1) - l) / (x - l);
+						}
+					}
+					return c;
+				}
+
+				template <typename P>
+				std::array<P, 3> set_lum(std::array<P, 3> c, P l)
+				{
+					const P d = l - lum<P>(c);
+					for (auto& value : c)
+					{
+						value += d;
+					}
+					return clip_color<P>(c);
+				}
+
+				template <typename P>
+				P sat(const std::array<P, 3>& c)
+				{
+					return std::max<P>({ c[0], c[1], c[2] }) - std::min<P>({ c[0], c[1], c[2] });
+				}
+
+				template <typename P>
+				std::array<P, 3> set_sat(std::array<P, 3> c, P s)
+				{
+					const P n = std::min<P>({ c[0], c[1], c[2] });
+					const P range = std::max<P>({ c[0], c[1], c[2] }) - n;
+					for (auto& value : c)
+					{
+						value = range > static_cast<P>(0) ? (value - n) * s / range : static_cast<P>(0);
+					}
+					return c;
+				}
+			}
+
+			struct hue
+			{
+				template <typename P>
+				static std::array<P, 3> apply(const std::array<P, 3>& cb, const std::array<P, 3>& cs)
+				{
+					return impl::set_lum<P>(impl::set_sat<P>(cs, impl::sat<P>(cb)), impl::lum<P>(cb));
+				}
+			};
+
+			struct saturation
+			{
+				template <typename P>
+				static std::array<P, 3> apply(const std::array<P, 3>& cb, const std::array<P, 3>& cs)
+				{
+					return impl::set_lum<P>(impl::set_sat<P>(cb, impl::sat<P>(cs)), impl::lum<P>(cb));
+				}
+			};
+
+			struct color
+			{
+				template <typename P>
+				static std::array<P, 3> apply(const std::array<P, 3>& cb, const std::array<P, 3>& cs)
+				{
+					return impl::set_lum<P>(cs, impl::lum<P>(cb));
+				}
+			};
+
+			struct luminosity
+			{
+				template <typename P>
+				static std::array<P, 3> apply(const std::array<P, 3>& cb, const std::array<P, 3>& cs)
+				{
+					return impl::set_lum<P>(cb, impl::lum<P>(cs));
+				}
+			};
+
+			struct darker_color
+			{
+				template <typename P>
+				static std::array<P, 3> apply(const std::array<P, 3>& cb, const std::array<P, 3>& cs)
+				{
+					return impl::lum<P>(cs) < impl::lum<P>(cb) ? cs : cb;
+				}
+			};
+
+			struct lighter_color
+			{
+				template <typename P>
+				static std::array<P, 3> apply(const std::array<P, 3>& cb, const std::array<P, 3>& cs)
+				{
+					return impl::lum<P>(cs) > impl::lum<P>(cb) ? cs : cb;
+				}
+			};
+		}
+
+
+		namespace impl
+		{
+			/// Composite the blended result over the canvas given the premultiplied canvas and layer components `cb` and 
+			/// `cs` with their alphas as well as the result of the blend mode.
+			template <typename _Precision>
+			inline _Precision compose(_Precision cb, _Precision ab, _Precision cs, _Precision as, _Precision blended)
+			{
+				const _Precision one = static_cast<_Precision>(1);
+				return cs * (one - ab) + cb * (one - as) + as * ab * blended;
+			}
+
+			/// Revert the premultiplication of a component by its alpha, returning 0 for fully transparent pixels.
+			template <typename _Precision>
+			inline _Precision unpremultiply(_Precision value, _Precision alpha)
+			{
+				if (alpha <= static_cast<_Precision>(0))
+				{
+					return static_cast<_Precision>(0);
+				}
+				return std::min<_Precision>(static_cast<_Precision>(1), value / alpha);
+			}
+		}
+
+
+		/// Composite a single premultiplied layer value over a premultiplied canvas value using the given separable
+		/// blend mode. For `separable::normal` this is equivalent to `kernel::normal`.
+		template <typename T, typename _Precision, typename BlendOp>
+			requires concepts::precision<_Precision> && concepts::separable_blend<BlendOp, _Precision>
+		inline T separable_blend(T _canvas_pixel, T _canvas_alpha, T _layer_pixel, T _layer_alpha)
+		{
+			if constexpr (std::is_same_v<BlendOp, separable::normal>)
+			{
+				return normal<T, _Precision>(_canvas_pixel, _canvas_alpha, _layer_pixel, _layer_alpha);
+			}
+			else
+			{
+				const _Precision max_t = static_cast<_Precision>(impl::calc_max_t<T>());
+				const _Precision canvas  = static_cast<_Precision>(_canvas_pixel) / max_t;
+				const _Precision c_alpha = static_cast<_Precision>(_canvas_alpha) / max_t;
+				const _Precision layer   = static_cast<_Precision>(_layer_pixel) / max_t;
+				const _Precision l_alpha = static_cast<_Precision>(_layer_alpha) / max_t;
+
+				const _Precision blended = BlendOp::template apply<_Precision>(
+					impl::unpremultiply<_Precision>(canvas, c_alpha), 
+					impl::unpremultiply<_Precision>(layer, l_alpha)
+				);
+				_Precision result = impl::compose<_Precision>(canvas, c_alpha, layer, l_alpha, blended);
+
+				result = result * max_t;
+				result = impl::round_and_clamp_integral<T, _Precision>(result);
+				return static_cast<T>(result);
+			}
+		}
+
+
+		/// Composite a single premultiplied RGB layer pixel over a premultiplied RGB canvas pixel using the given 
+		/// non-separable blend mode.
+		template <typename T, typename _Precision, typename BlendOp>
+			requires concepts::precision<_Precision> && concepts::nonseparable_blend<BlendOp, _Precision>
+		inline std::array<T, 3> nonseparable_blend(const std::array<T, 3>& _canvas_pixel, T _canvas_alpha, const std::array<T, 3>& _layer_pixel, T _layer_alpha)
+		{
+			const _Precision max_t = static_cast<_Precision>(impl::calc_max_t<T>());
+			const _Precision c_alpha = static_cast<_Precision>(_canvas_alpha) / max_t;
+			const _Precision l_alpha = static_cast<_Precision>(_layer_alpha) / max_t;
+
+			std::array<_Precision, 3> canvas{};
+			std::array<_Precision, 3> layer{};
+			std::array<_Precision, 3> canvas_color{};
+			std::array<_Precision, 3> layer_color{};
+			for (size_t i = 0; i < 3; ++i)
+			{
+				canvas[i] = static_cast<_Precision>(_canvas_pixel[i]) / max_t;
+				layer[i] = static_cast<_Precision>(_layer_pixel[i]) / max_t;
+				canvas_color[i] = impl::unpremultiply<_Precision>(canvas[i], c_alpha);
+				layer_color[i] = impl::unpremultiply<_Precision>(layer[i], l_alpha);
+			}
+			const auto blended = BlendOp::template apply<_Precision>(canvas_color, layer_color);
+
+			std::array<T, 3> result{};
+			for (size_t i = 0; i < 3; ++i)
+			{
+				_Precision value = impl::compose<_Precision>(canvas[i], c_alpha, layer[i], l_alpha, blended[i]) * max_t;
+				result[i] = static_cast<T>(impl::round_and_clamp_integral<T, _Precision>(value));
+			}
+			return result;
+		}
+
 	}
+}
+
+PSAPI_NAMESPACE_END
+
+
+#include "Composite_AVX2.h"
+
+
+PSAPI_NAMESPACE_BEGIN
+
+namespace Composite
+{
+
+	namespace kernel
+	{
+		/// Blend a row of premultiplied layer values over the row of premultiplied canvas values in-place. When running
+		/// on a CPU with AVX2 and a `_Precision` of float 8 values are processed at once, the remainder is processed scalar.
+		template <typename T, typename _Precision, typename BlendOp>
+			requires concepts::precision<_Precision> && concepts::separable_blend<BlendOp, _Precision>
+		void separable_row(std::span<T> canvas, std::span<const T> canvas_alpha, std::span<const T> layer, std::span<const T> layer_alpha)
+		{
+			size_t x = 0;
+#ifdef PSAPI_SIMD_AVX2
+			if constexpr (std::is_same_v<_Precision, float>)
+			{
+				if (CPU::hasAVX2())
+				{
+					x = avx2::separable_row<T, BlendOp>(canvas, canvas_alpha, layer, layer_alpha);
+				}
+			}
+#endif
+			for (; x < canvas.size(); ++x)
+			{
+				canvas[x] = separable_blend<T, _Precision, BlendOp>(canvas[x], canvas_alpha[x], layer[x], layer_alpha[x]);
+			}
+		}
+
+
+		/// Blend a row of premultiplied RGB layer values over the row of premultiplied RGB canvas values in-place. When
+		/// running on a CPU with AVX2 and a `_Precision` of float 8 pixels are processed at once, the remainder is processed scalar.
+		template <typename T, typename _Precision, typename BlendOp>
+			requires concepts::precision<_Precision> && concepts::nonseparable_blend<BlendOp, _Precision>
+		void nonseparable_row(std::array<std::span<T>, 3> canvas, std::span<const T> canvas_alpha, std::array<std::span<const T>, 3> layer, std::span<const T> layer_alpha)
+		{
+			size_t x = 0;
+#ifdef PSAPI_SIMD_AVX2
+			if constexpr (std::is_same_v<_Precision, float>)
+			{
+				if (CPU::hasAVX2())
+				{
+					x = avx2::nonseparable_row<T, BlendOp>(canvas, canvas_alpha, layer, layer_alpha);
+				}
+			}
+#endif
+			for (; x < canvas_alpha.size(); ++x)
+			{
+				const auto result = nonseparable_blend<T, _Precision, BlendOp>(
+					{ canvas[0][x], canvas[1][x], canvas[2][x] }, 
+					canvas_alpha[x], 
+					{ layer[0][x], layer[1][x], layer[2][x] },
+					layer_alpha[x]
+				);
+				canvas[0][x] = result[0];
+				canvas[1][x] = result[1];
+				canvas[2][x] = result[2];
+			}
+		}
+
+
+		/// Composite a row of layer alpha values over the canvas alpha in-place.
+		template <typename T, typename _Precision>
+			requires concepts::precision<_Precision>
+		void alpha_row(std::span<T> canvas_alpha, std::span<const T> layer_alpha)
+		{
+			size_t x = 0;
+#ifdef PSAPI_SIMD_AVX2
+			if constexpr (std::is_same_v<_Precision, float>)
+			{
+				if (CPU::hasAVX2())
+				{
+					x = avx2::alpha_row<T>(canvas_alpha, layer_alpha);
+				}
+			}
+#endif
+			for (; x < canvas_alpha.size(); ++x)
+			{
+				canvas_alpha[x] = alpha<T, _Precision>(canvas_alpha[x], layer_alpha[x]);
+			}
+		}
+
+
+		/// Turn a row composited source-over into a row composited source-atop by removing the contribution of the layer
+		/// where the canvas was transparent. `canvas_alpha` must be the canvas alpha before compositing, combined with not 
+		/// updating the canvas alpha this composites the layer only onto the opaque parts of the canvas.
+		template <typename T, typename _Precision>
+			requires concepts::precision<_Precision>
+		void atop_row(std::span<T> canvas, std::span<const T> canvas_alpha, std::span<const T> layer)
+		{
+			const _Precision max_t = static_cast<_Precision>(impl::calc_max_t<T>());
+			for (size_t x = 0; x < canvas.size(); ++x)
+			{
+				const _Precision c_alpha = static_cast<_Precision>(canvas_alpha[x]) / max_t;
+				_Precision result = static_cast<_Precision>(canvas[x]) - static_cast<_Precision>(layer[x]) * (static_cast<_Precision>(1) - c_alpha);
+				canvas[x] = static_cast<T>(impl::round_and_clamp_integral<T, _Precision>(result));
+			}
+		}
+	}
+
+
+	/// The edge length of the square tiles the canvas is split into for compositing. A tile of a single channel at 32-bit
+	/// is 256KB which alongside the scratch buffers keeps the working set of each thread within L2 cache.
+	constexpr size_t s_tile_size = 256;
 
 
 	/// Implementation details of the compositing logic dealing with iterating the images and applying the kernels.
@@ -126,50 +664,51 @@ namespace Composite
 	{
 		namespace rgb
 		{
+			/// A rectangular region of the canvas in canvas coordinates, the maximum is exclusive.
+			struct Region
+			{
+				size_t min_x = 0, max_x = 0, min_y = 0, max_y = 0;
 
-			/// Template function to iterate and apply an image layering kernel (one for each blendmode) for RGB channels.
-			/// this works on the principle that the compositing for RGB is separable unlike for e.g. CMYK which needs to be
-			/// handled differently.
-			/// 
-			/// This takes care of a couple of things:
-			/// - Compose the two layers on top of one another using the computed alpha (from alpha, mask and opacity)
-			/// - Compose the alpha channels of these two together 
-			/// - Iterate only what is necessary by taking the intersection of the canvas bbox and the layer bbox.
-			/// 
-			/// Compositing only happens for any channels that are present both on the canvas and layer but for all practical
-			/// purposes it can be assumed that both the canvas and layer will hold at least the same color components with 
-			/// the main differences being the presence of alpha channels and/or masks.
-			/// If the canvas holds no alpha we generate a new one and modify it in-place. The alpha will then be updated according
-			/// to the computation.
-			/// 
-			/// \tparam T 
-			///		The bit-depth of the image data
-			/// \tparam _Precision 
-			///		The precision at which to perform the computation (for integral types). If passing floating point image it would
-			///		be be best to have `_Precision` be the same as `T` as this would make a lot of the conversion a no-op.
-			/// \tparam KernelFunc
-			///		The kernel function to apply to the image, must satisfy `concepts::kernel`. I.e. the kernel must take a canvas pixel
-			///		value, a layer pixel value and the layer alpha. see `kernel::normal` for an example.
-			/// 
-			/// \param canvas 
-			///		The canvas onto which to draw the layer with the given kernel.
-			/// \param layer
-			///		The layer to compose on top of the canvas
-			/// \param kernel_func
-			///		The kernel to apply to the color channels of the image (alpha is handled separately)
+				size_t width() const noexcept { return max_x - min_x; }
+				size_t height() const noexcept { return max_y - min_y; }
+			};
+
+
+			/// Per-thread scratch buffers reused across tiles and layers such that compositing does not allocate once
+			/// the buffers have grown to the size of a tile.
+			template <typename T, typename _Precision>
+			struct TileScratch
+			{
+				/// The coverage of the layer from its mask and opacity.
+				std::vector<_Precision> coverage;
+				/// The layers' alpha multiplied by its coverage.
+				std::vector<T> alpha;
+				/// The layers' color channels multiplied by its coverage, holds up to 3 channels back to back.
+				std::vector<T> color;
+			};
+
+			template <typename T, typename _Precision>
+			TileScratch<T, _Precision>& tile_scratch()
+			{
+				thread_local TileScratch<T, _Precision> scratch;
+				return scratch;
+			}
+
+
+			/// Validate the canvas and compute the region the layer covers on it, returning std::nullopt if there is nothing
+			/// to composite.
 			/// 
 			/// \throws std::invalid_argument If the canvas has a mask channel.
 			/// \throws std::invalid_argument If the canvas has a non-one opacity.
-			template <typename T, typename _Precision, typename KernelFunc>
-				requires concepts::precision<_Precision> && concepts::kernel<T, KernelFunc>
-			void iter_apply(Render::ImageBuffer<T>& canvas, Render::ConstImageBuffer<T>& layer, KernelFunc kernel_func)
+			template <typename T>
+			std::optional<Region> compute_region(Render::ImageBuffer<T>& canvas, Render::ConstImageBuffer<T>& layer)
 			{
 				if (canvas.channels.size() == 0 || layer.channels.size() == 0)
 				{
 					PSAPI_LOG_DEBUG("Composite", 
 						"Skipping compositing of layer '%s' as either the layer or the canvas has no channels. Canvas channels: %zu; Layer channels: %zu", 
 						layer.metadata.name.c_str(), canvas.channels.size(), layer.channels.size());
-					return;
+					return std::nullopt;
 				}
 
 				if (canvas.has_mask())
@@ -188,104 +727,340 @@ namespace Composite
 				if (!_intersected_bbox)
 				{
 					PSAPI_LOG_DEBUG("Composite", "Skipping compositing of layer '%s' as the intersected bbox is 0-sized.", layer.metadata.name.c_str());
-					return;
+					return std::nullopt;
 				}
 				auto intersected_bbox = _intersected_bbox.value();
 
-				// Limit the computation to the region of interest (ROI) of the layer to avoid iterating channels outside of the 
-				size_t min_y = std::max<size_t>(static_cast<size_t>(std::round(intersected_bbox.minimum.y)), 0);
-				size_t max_y = std::min<size_t>(static_cast<size_t>(std::round(intersected_bbox.maximum.y)), canvas.height - 1);
-				size_t min_x = std::max<size_t>(static_cast<size_t>(std::round(intersected_bbox.minimum.x)), 0);
-				size_t max_x = std::min<size_t>(static_cast<size_t>(std::round(intersected_bbox.maximum.x)), canvas.width - 1);
-
-				auto vertical_iter = std::views::iota(min_y, max_y);
-				auto horizontal_iter = std::views::iota(min_x, max_x);
+				Region region{};
+				region.min_y = static_cast<size_t>(std::max<int>(intersected_bbox.minimum.y, 0));
+				region.max_y = std::min<size_t>(static_cast<size_t>(std::max<int>(intersected_bbox.maximum.y, 0)), canvas.height);
+				region.min_x = static_cast<size_t>(std::max<int>(intersected_bbox.minimum.x, 0));
+				region.max_x = std::min<size_t>(static_cast<size_t>(std::max<int>(intersected_bbox.maximum.x, 0)), canvas.width);
+				if (region.min_x >= region.max_x || region.min_y >= region.max_y)
+				{
+					return std::nullopt;
+				}
+				return region;
+			}
 
-				auto canvas_alpha = canvas.template compute_alpha<_Precision>(canvas.width, canvas.height);
-				auto layer_alpha = layer.template compute_alpha<_Precision>(canvas.width, canvas.height);
 
-				for (auto [_index, canvas_channel] : canvas.channels)
+			/// Split the region into the tiles of the canvas' tile grid it intersects, clipping the tiles to the region.
+			inline std::vector<Region> compute_tiles(const Region& region)
+			{
+				std::vector<Region> tiles;
+				for (size_t tile_y = region.min_y / s_tile_size * s_tile_size; tile_y < region.max_y; tile_y += s_tile_size)
 				{
-					// Since we tackle alpha separately we want to ignore it here
-					if (_index == -1)
+					for (size_t tile_x = region.min_x / s_tile_size * s_tile_size; tile_x < region.max_x; tile_x += s_tile_size)
 					{
-						continue;
+						Region tile{};
+						tile.min_x = std::max(tile_x, region.min_x);
+						tile.max_x = std::min(tile_x + s_tile_size, region.max_x);
+						tile.min_y = std::max(tile_y, region.min_y);
+						tile.max_y = std::min(tile_y + s_tile_size, region.max_y);
+						tiles.push_back(tile);
 					}
-					// Some layers may not have all channels present, if that is the case we simply skip it
-					if (!layer.channels.contains(_index))
+				}
+				return tiles;
+			}
+
+
+			/// Get a view over the row `y` (in canvas coordinates) of the given channel clipped to the region. `origin`
+			/// is the top left of the channel in canvas coordinates.
+			template <typename T, bool is_const>
+			auto row_view(const Render::ChannelBuffer<T, is_const>& channel, Geometry::Point2D<int> origin, const Region& region, size_t y)
+			{
+				const size_t offset = channel.index(region.min_x - origin.x, y - origin.y);
+				return channel.buffer.subspan(offset, region.width());
+			}
+
+
+			/// The layer as seen by a single tile, providing rows of its alpha and color channels with the mask and 
+			/// opacity of the layer already applied. Where the layer has neither the rows are views directly into the
+			/// layers' channels, otherwise they are computed into the threads' scratch buffers.
+			template <typename T, typename _Precision>
+			struct LayerTile
+			{
+				const Region& tile;
+				Render::ConstImageBuffer<T>& layer;
+				Geometry::Point2D<int> origin;
+				TileScratch<T, _Precision>& scratch;
+				bool has_coverage = false;
+
+				/// Initialize the tile computing the coverage and alpha of the layer if required.
+				LayerTile(const Region& tile_, Render::ConstImageBuffer<T>& layer_, Geometry::Point2D<int> origin_, size_t num_color_channels)
+					: tile(tile_), layer(layer_), origin(origin_), scratch(tile_scratch<T, _Precision>())
+				{
+					has_coverage = layer.has_mask() || layer.metadata.opacity != 1.0f;
+					const size_t size = tile.width() * tile.height();
+					const _Precision max_t = static_cast<_Precision>(kernel::impl::calc_max_t<T>());
+
+					if (has_coverage)
 					{
-						continue;
+						scratch.coverage.assign(size, static_cast<_Precision>(layer.metadata.opacity));
+						if (layer.mask)
+						{
+							apply_mask(max_t);
+						}
+						scratch.color.resize(size * num_color_channels);
 					}
-					
-					const auto layer_channel = layer.channels.at(_index);
 
-					// Iterate the channels and apply the kernel.
-					std::for_each(std::execution::par_unseq, vertical_iter.begin(), vertical_iter.end(), [&](size_t y)
+					if (has_coverage || !layer.has_alpha())
+					{
+						scratch.alpha.resize(size);
+						for (size_t y = tile.min_y; y < tile.max_y; ++y)
 						{
-							for (auto x : horizontal_iter)
+							const auto alpha_row = std::span<T>(scratch.alpha).subspan((y - tile.min_y) * tile.width(), tile.width());
+							if (layer.has_alpha())
+							{
+								const auto source_row = row_view(layer.channels.at(-1), origin, tile, y);
+								std::copy(source_row.begin(), source_row.end(), alpha_row.begin());
+							}
+							else
 							{
-								Geometry::Point2D<int> _point = { static_cast<int>(x), static_cast<int>(y) };
-								const auto point_canvas = _point - canvas_bbox.minimum;
-								const auto point_layer = _point - layer_bbox.minimum;
-
-								auto idx_canvas = canvas_channel.index(point_canvas.x, point_canvas.y);
-								auto idx_layer = layer_channel.index(point_layer.x, point_layer.y);
-
-								// Apply the kernel
-								canvas_channel.buffer[idx_canvas] = kernel_func(
-									canvas_channel.pixel(point_canvas.x, point_canvas.y), 
-									canvas_alpha[idx_canvas],
-									layer_channel.pixel(point_layer.x, point_layer.y),
-									layer_alpha[idx_layer]
-									);
+								std::fill(alpha_row.begin(), alpha_row.end(), static_cast<T>(max_t));
 							}
-						});
+						}
+						if (has_coverage)
+						{
+							scale_by_coverage(std::span<T>(scratch.alpha));
+						}
+					}
 				}
-				
+
+				/// The alpha of the layer for row `y` in canvas coordinates
+				std::span<const T> alpha(size_t y) const
 				{
-					// since all of these are the same size we can just grab any channel for our index calculations
-					const auto& [_ci, _canvas_channel] = *canvas.channels.begin();
-					const auto& [_li, _layer_channel] = *layer.channels.begin();
+					if (!has_coverage && layer.has_alpha())
+					{
+						return row_view(layer.channels.at(-1), origin, tile, y);
+					}
+					return std::span<const T>(scratch.alpha).subspan((y - tile.min_y) * tile.width(), tile.width());
+				}
 
-					if (canvas_alpha.size() < _canvas_channel.size())
+				/// Prepare the color channel `index` of the layer placing it at `slot` within the scratch buffers.
+				void prepare_color(int index, size_t slot)
+				{
+					if (!has_coverage)
+					{
+						return;
+					}
+					const size_t size = tile.width() * tile.height();
+					auto color = std::span<T>(scratch.color).subspan(slot * size, size);
+					const auto& channel = layer.channels.at(index);
+					for (size_t y = tile.min_y; y < tile.max_y; ++y)
 					{
-						throw std::runtime_error("Internal error: canvas alpha is larger than canvas channels");
+						const auto source_row = row_view(channel, origin, tile, y);
+						std::copy(source_row.begin(), source_row.end(), color.begin() + (y - tile.min_y) * tile.width());
 					}
-					if (layer_alpha.size() < _layer_channel.size())
+					scale_by_coverage(color);
+				}
+
+				/// The color channel `index` of the layer for row `y` in canvas coordinates, `prepare_color` must have been
+				/// called for the given index and slot first.
+				std::span<const T> color(int index, size_t slot, size_t y) const
+				{
+					if (!has_coverage)
 					{
-						throw std::runtime_error("Internal error: layer alpha is larger than layer channels");
+						return row_view(layer.channels.at(index), origin, tile, y);
 					}
+					const size_t size = tile.width() * tile.height();
+					return std::span<const T>(scratch.color).subspan(slot * size + (y - tile.min_y) * tile.width(), tile.width());
+				}
+
+			private:
+				/// Multiply the coverage by the mask, where the tile lies outside of the mask the masks' default color is used.
+				void apply_mask(_Precision max_t)
+				{
+					const auto& mask = layer.mask.value();
+					const auto mask_bbox = mask.bbox();
+					const _Precision mask_default = static_cast<_Precision>(layer.metadata.mask_default_value.value_or(0)) / static_cast<_Precision>(255);
 
-					// Apply the alpha compositing as the last step.
-					std::for_each(std::execution::par_unseq, vertical_iter.begin(), vertical_iter.end(), [&](size_t y)
+					for (size_t y = tile.min_y; y < tile.max_y; ++y)
+					{
+						_Precision* coverage = scratch.coverage.data() + (y - tile.min_y) * tile.width();
+						for (size_t x = tile.min_x; x < tile.max_x; ++x)
 						{
-							for (auto x : horizontal_iter)
+							const int mask_x = static_cast<int>(x) - mask_bbox.minimum.x;
+							const int mask_y = static_cast<int>(y) - mask_bbox.minimum.y;
+							_Precision value = mask_default;
+							if (mask_x >= 0 && mask_y >= 0 && static_cast<size_t>(mask_x) < mask.width && static_cast<size_t>(mask_y) < mask.height)
 							{
-								Geometry::Point2D<int> _point = { static_cast<int>(x), static_cast<int>(y) };
-								const auto point_canvas = _point - canvas_bbox.minimum;
-								const auto point_layer = _point - layer_bbox.minimum;
+								value = static_cast<_Precision>(mask.buffer[mask.index(mask_x, mask_y)]) / max_t;
+							}
+							coverage[x - tile.min_x] *= value;
+						}
+					}
+				}
 
-								auto idx_canvas = _canvas_channel.index(point_canvas.x, point_canvas.y);
-								auto idx_layer = _layer_channel.index(point_layer.x, point_layer.y);
+				void scale_by_coverage(std::span<T> values) const
+				{
+					for (size_t i = 0; i < values.size(); ++i)
+					{
+						const _Precision value = static_cast<_Precision>(values[i]) * scratch.coverage[i];
+						values[i] = static_cast<T>(kernel::impl::round_and_clamp_integral<T, _Precision>(value));
+					}
+				}
+			};
 
-								// Apply the kernel and compute alpha and pixel values
-								T alpha = kernel::alpha(canvas_alpha[idx_canvas], layer_alpha[idx_layer]);
-								canvas_alpha[idx_canvas] = alpha;
-							}
-						});
 
-				}				
+			/// Prepare the canvas and layer for compositing and run `tile_func(tile, layer_tile, canvas_alpha)` for all the
+			/// tiles of the canvas the layer covers in parallel. Afterwards the alpha of the layer is composited onto the 
+			/// canvas alpha unless `preserve_alpha` is set.
+			template <typename T, typename _Precision, typename TileFunc>
+			void iter_tiles(Render::ImageBuffer<T>& canvas, Render::ConstImageBuffer<T>& layer, size_t num_color_channels, bool preserve_alpha, TileFunc tile_func)
+			{
+				auto _region = compute_region(canvas, layer);
+				if (!_region)
+				{
+					return;
+				}
+
+				// If the canvas holds no alpha this generates it once, all subsequent calls return a view over it. The layers'
+				// alpha on the other hand is only ever computed one tile at a time.
+				auto canvas_alpha = canvas.template compute_alpha<_Precision>(canvas.width, canvas.height);
+				const auto canvas_alpha_channel = Render::ChannelBuffer<T>(canvas_alpha, canvas.width, canvas.height);
+				const auto origin = layer.channels.begin()->second.bbox().minimum;
+
+				const auto tiles = compute_tiles(_region.value());
+				Parallel::forEach(tiles.begin(), tiles.end(), [&](const Region& tile)
+					{
+						LayerTile<T, _Precision> layer_tile(tile, layer, origin, num_color_channels);
+						tile_func(tile, layer_tile, canvas_alpha_channel);
+						if (preserve_alpha)
+						{
+							return;
+						}
 
-				// We do not want to clear the alpha of the canvas since we are modifying it in-place
-				// allowing the next iteration to just have canvas.compute_alpha return a view over it.
-				layer.clear_cached_alpha();
+						// Apply the alpha compositing as the last step as the color compositing depends on the previous alpha
+						for (size_t y = tile.min_y; y < tile.max_y; ++y)
+						{
+							kernel::alpha_row<T, _Precision>(row_view(canvas_alpha_channel, { 0, 0 }, tile, y), layer_tile.alpha(y));
+						}
+					});
 			}
 
+
+			/// Template function to iterate and apply a separable blend mode to the canvas one tile at a time. This works 
+			/// on the principle that the compositing for RGB is separable unlike for e.g. CMYK which needs to be
+			/// handled differently.
+			/// 
+			/// This takes care of a couple of things:
+			/// - Compose the two layers on top of one another using the computed alpha (from alpha, mask and opacity)
+			/// - Compose the alpha channels of these two together 
+			/// - Iterate only the tiles intersecting both the canvas bbox and the layer bbox.
+			/// 
+			/// Compositing only happens for any channels that are present both on the canvas and layer but for all practical
+			/// purposes it can be assumed that both the canvas and layer will hold at least the same color components with 
+			/// the main differences being the presence of alpha channels and/or masks.
+			/// If the canvas holds no alpha we generate a new one and modify it in-place. The alpha will then be updated according
+			/// to the computation.
+			/// 
+			/// \tparam T 
+			///		The bit-depth of the image data
+			/// \tparam _Precision 
+			///		The precision at which to perform the computation (for integral types). If passing floating point image it would
+			///		be be best to have `_Precision` be the same as `T` as this would make a lot of the conversion a no-op.
+			/// \tparam BlendOp
+			///		The blend mode to apply, must satisfy `concepts::separable_blend`. see `kernel::separable` for the available modes.
+			/// 
+			/// \param canvas 
+			///		The canvas onto which to draw the layer with the given kernel.
+			/// \param layer
+			///		The layer to compose on top of the canvas
+			/// \param preserve_alpha
+			///		Whether to only composite onto the opaque parts of the canvas leaving its alpha as-is (source-atop).
+			/// 
+			/// \throws std::invalid_argument If the canvas has a mask channel.
+			/// \throws std::invalid_argument If the canvas has a non-one opacity.
+			template <typename T, typename _Precision, typename BlendOp>
+				requires concepts::precision<_Precision> && concepts::separable_blend<BlendOp, _Precision>
+			void iter_apply(Render::ImageBuffer<T>& canvas, Render::ConstImageBuffer<T>& layer, bool preserve_alpha = false)
+			{
+				// Only the channels present on both the canvas and the layer are composited, alpha is handled separately.
+				std::vector<int> indices;
+				for (const auto& [index, _channel] : canvas.channels)
+				{
+					if (index != -1 && layer.channels.contains(index))
+					{
+						indices.push_back(index);
+					}
+				}
+
+				iter_tiles<T, _Precision>(canvas, layer, 1, preserve_alpha, [&](const Region& tile, LayerTile<T, _Precision>& layer_tile, const Render::ChannelBuffer<T>& canvas_alpha)
+					{
+						for (int index : indices)
+						{
+							const auto& canvas_channel = canvas.channels.at(index);
+							layer_tile.prepare_color(index, 0);
+							for (size_t y = tile.min_y; y < tile.max_y; ++y)
+							{
+								kernel::separable_row<T, _Precision, BlendOp>(
+									row_view(canvas_channel, { 0, 0 }, tile, y),
+									row_view(canvas_alpha, { 0, 0 }, tile, y),
+									layer_tile.color(index, 0, y),
+									layer_tile.alpha(y)
+								);
+								if (preserve_alpha)
+								{
+									kernel::atop_row<T, _Precision>(row_view(canvas_channel, { 0, 0 }, tile, y), row_view(canvas_alpha, { 0, 0 }, tile, y), layer_tile.color(index, 0, y));
+								}
+							}
+						}
+					});
+			}
+
+
+			/// Template function to iterate and apply a non-separable blend mode to the canvas one tile at a time. Unlike
+			/// `iter_apply` this requires both the canvas and layer to hold the color channels 0, 1 and 2.
+			/// 
+			/// \throws std::invalid_argument If the canvas has a mask channel.
+			/// \throws std::invalid_argument If the canvas has a non-one opacity.
+			/// \throws std::invalid_argument If either the canvas or the layer do not hold RGB channels.
+			template <typename T, typename _Precision, typename BlendOp>
+				requires concepts::precision<_Precision> && concepts::nonseparable_blend<BlendOp, _Precision>
+			void iter_apply_nonseparable(Render::ImageBuffer<T>& canvas, Render::ConstImageBuffer<T>& layer, bool preserve_alpha = false)
+			{
+				for (int index : { 0, 1, 2 })
+				{
+					if (!canvas.channels.contains(index) || !layer.channels.contains(index))
+					{
+						throw std::invalid_argument(fmt::format("Unable to composite layer '{}' with a non-separable blendmode as it requires RGB channels on both the canvas and layer", layer.metadata.name));
+					}
+				}
+
+				const std::array<Render::ChannelBuffer<T>, 3> canvas_channels = { canvas.channels.at(0), canvas.channels.at(1), canvas.channels.at(2) };
+				iter_tiles<T, _Precision>(canvas, layer, 3, preserve_alpha, [&](const Region& tile, LayerTile<T, _Precision>& layer_tile, const Render::ChannelBuffer<T>& canvas_alpha)
+					{
+						for (int index : { 0, 1, 2 })
+						{
+							layer_tile.prepare_color(index, static_cast<size_t>(index));
+						}
+						for (size_t y = tile.min_y; y < tile.max_y; ++y)
+						{
+							kernel::nonseparable_row<T, _Precision, BlendOp>(
+								{ row_view(canvas_channels[0], { 0, 0 }, tile, y), row_view(canvas_channels[1], { 0, 0 }, tile, y), row_view(canvas_channels[2], { 0, 0 }, tile, y) },
+								row_view(canvas_alpha, { 0, 0 }, tile, y),
+								{ layer_tile.color(0, 0, y), layer_tile.color(1, 1, y), layer_tile.color(2, 2, y) },
+								layer_tile.alpha(y)
+							);
+							if (preserve_alpha)
+							{
+								for (size_t i = 0; i < 3; ++i)
+								{
+									kernel::atop_row<T, _Precision>(row_view(canvas_channels[i], { 0, 0 }, tile, y), row_view(canvas_alpha, { 0, 0 }, tile, y), layer_tile.color(static_cast<int>(i), i, y));
+								}
+							}
+						}
+					});
+			}
 		}
 	}
 
 
-	/// Composite a layer over the canvas using the given blendmode (not all yet supported).
+	/// Composite a layer over the canvas using the given blendmode (all modes except Dissolve are supported). Both the 
+	/// canvas and layer colors are expected to be premultiplied by their alpha channel, the mask and opacity of the layer
+	/// are applied while compositing. The canvas is processed in tiles of `s_tile_size` such that only the tiles covered
+	/// by the layer are visited and no layer-sized intermediate buffers are allocated.
 	/// in this context the canvas is nothing special and could just be another layer but in most cases
 	/// we will be compositing down to the photoshop canvas itself.
 	/// 
@@ -293,7 +1068,8 @@ namespace Composite
 	///		The bit-depth of the image data
 	/// \tparam _Precision 
 	///		The precision at which to perform the computation (for integral types). If passing floating point image it would
-	///		be be best to have `_Precision` be the same as `T` as this would make a lot of the conversion a no-op.
+	///		be be best to have `_Precision` be the same as `T` as this would make a lot of the conversion a no-op. Only a 
+	///		precision of float is vectorized.
 	/// 
 	/// \param canvas 
 	///		The canvas onto which to draw the layer with the given blendmode.
@@ -301,24 +1077,53 @@ namespace Composite
 	///		The layer to compose on top of the canvas
 	/// \param blend_mode
 	///		The blend mode to apply
+	/// \param preserve_alpha
+	///		Whether to composite the layer only onto the opaque parts of the canvas without modifying the canvas alpha 
+	///		(source-atop). This is how layers clipped to a clipping base are evaluated.
 	/// 
 	/// \throws std::invalid_argument If the canvas has a mask channel.
 	/// \throws std::invalid_argument If the canvas has a non-one opacity.
+	/// \throws std::invalid_argument If a non-separable blendmode (e.g. Hue) is used on non-RGB data.
 	/// \throws std::runtime_error	  If the given blendmode is not yet implemented
 	template <typename T, typename _Precision = float>
 		requires concepts::precision<_Precision>
-	void composite_rgb(Render::ImageBuffer<T>& canvas, Render::ConstImageBuffer<T>& layer, Enum::BlendMode blend_mode)
+	void composite_rgb(Render::ImageBuffer<T>& canvas, Render::ConstImageBuffer<T>& layer, Enum::BlendMode blend_mode, bool preserve_alpha = false)
 	{
-		if (blend_mode == Enum::BlendMode::Normal)
-		{
-			impl::rgb::iter_apply<T, _Precision>(canvas, layer, kernel::normal<T, _Precision>);
-		}
-		else
+		namespace sep = kernel::separable;
+		namespace nonsep = kernel::nonseparable;
+		switch (blend_mode)
 		{
+		case Enum::BlendMode::Normal:		impl::rgb::iter_apply<T, _Precision, sep::normal>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Darken:		impl::rgb::iter_apply<T, _Precision, sep::darken>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Multiply:		impl::rgb::iter_apply<T, _Precision, sep::multiply>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::ColorBurn:	impl::rgb::iter_apply<T, _Precision, sep::color_burn>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::LinearBurn:	impl::rgb::iter_apply<T, _Precision, sep::linear_burn>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Lighten:		impl::rgb::iter_apply<T, _Precision, sep::lighten>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Screen:		impl::rgb::iter_apply<T, _Precision, sep::screen>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::ColorDodge:	impl::rgb::iter_apply<T, _Precision, sep::color_dodge>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::LinearDodge:	impl::rgb::iter_apply<T, _Precision, sep::linear_dodge>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Overlay:		impl::rgb::iter_apply<T, _Precision, sep::overlay>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::SoftLight:	impl::rgb::iter_apply<T, _Precision, sep::soft_light>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::HardLight:	impl::rgb::iter_apply<T, _Precision, sep::hard_light>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::VividLight:	impl::rgb::iter_apply<T, _Precision, sep::vivid_light>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::LinearLight:	impl::rgb::iter_apply<T, _Precision, sep::linear_light>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::PinLight:		impl::rgb::iter_apply<T, _Precision, sep::pin_light>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::HardMix:		impl::rgb::iter_apply<T, _Precision, sep::hard_mix>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Difference:	impl::rgb::iter_apply<T, _Precision, sep::difference>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Exclusion:	impl::rgb::iter_apply<T, _Precision, sep::exclusion>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Subtract:		impl::rgb::iter_apply<T, _Precision, sep::subtract>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Divide:		impl::rgb::iter_apply<T, _Precision, sep::divide>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::DarkerColor:	impl::rgb::iter_apply_nonseparable<T, _Precision, nonsep::darker_color>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::LighterColor:	impl::rgb::iter_apply_nonseparable<T, _Precision, nonsep::lighter_color>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Hue:			impl::rgb::iter_apply_nonseparable<T, _Precision, nonsep::hue>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Saturation:	impl::rgb::iter_apply_nonseparable<T, _Precision, nonsep::saturation>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Color:		impl::rgb::iter_apply_nonseparable<T, _Precision, nonsep::color>(canvas, layer, preserve_alpha); break;
+		case Enum::BlendMode::Luminosity:	impl::rgb::iter_apply_nonseparable<T, _Precision, nonsep::luminosity>(canvas, layer, preserve_alpha); break;
+		default:
 			std::string blend_mode_str = Enum::getBlendMode<Enum::BlendMode, std::string>(blend_mode).value_or("Unknown");
 			throw std::runtime_error(fmt::format("blendmode {} is not yet implemented for compositing", blend_mode_str));
 		}
 	}
 }
 
-PSAPI_NAMESPACE_END
\ No newline at end of file
+PSAPI_NAMESPACE_END
@@ -0,0 +1,386 @@
+/*
+The kernels in this header are compiled for AVX2 independently of the flags of the translation unit they are included into and
+may therefore only be called after checking CPU::hasAVX2() as is done in Composite.h.
+*/
+
+#pragma once
+
+#include "Macros.h"
+#include "Util/CPUFeatures.h"
+
+#include <array>
+#include <span>
+#include <type_traits>
+#include <cstdint>
+
+#ifdef PSAPI_SIMD_AVX2
+
+PSAPI_NAMESPACE_BEGIN
+
+namespace Composite::kernel::avx2
+{
+	namespace impl
+	{
+		/// Load 8 consecutive values of type T and normalize them to the 0-1 range by multiplying with `inv_max`
+		template <typename T>
+		PSAPI_TARGET_AVX2 inline __m256 load(const T* ptr, __m256 inv_max)
+		{
+			if constexpr (std::is_same_v<T, uint8_t>)
+			{
+				const __m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(ptr));
+				return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(values)), inv_max);
+			}
+			else if constexpr (std::is_same_v<T, uint16_t>)
+			{
+				const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+				return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(values)), inv_max);
+			}
+			else
+			{
+				static_assert(std::is_same_v<T, float32_t>, "Unsupported type for AVX2 compositing");
+				return _mm256_loadu_ps(ptr);
+			}
+		}
+
+		/// Scale the 8 normalized values back to the range of T and store them, rounding and clamping for integral types.
+		template <typename T>
+		PSAPI_TARGET_AVX2 inline void store(T* ptr, __m256 value, __m256 max)
+		{
+			if constexpr (std::is_same_v<T, float32_t>)
+			{
+				_mm256_storeu_ps(ptr, value);
+			}
+			else
+			{
+				value = _mm256_mul_ps(value, max);
+				value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), max);
+				const __m256i integral = _mm256_cvttps_epi32(_mm256_add_ps(value, _mm256_set1_ps(0.5f)));
+				const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(integral), _mm256_extracti128_si256(integral, 1));
+				if constexpr (std::is_same_v<T, uint8_t>)
+				{
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(ptr), _mm_packus_epi16(packed, packed));
+				}
+				else
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(ptr), packed);
+				}
+			}
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 one() { return _mm256_set1_ps(1.0f); }
+		PSAPI_TARGET_AVX2 inline __m256 half() { return _mm256_set1_ps(0.5f); }
+		PSAPI_TARGET_AVX2 inline __m256 le(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+		PSAPI_TARGET_AVX2 inline __m256 lt(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		PSAPI_TARGET_AVX2 inline __m256 ge(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		PSAPI_TARGET_AVX2 inline __m256 gt(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		PSAPI_TARGET_AVX2 inline __m256 neq(__m256 a, __m256 b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ); }
+		/// Select `a` where `mask` is set, `b` otherwise
+		PSAPI_TARGET_AVX2 inline __m256 select(__m256 mask, __m256 a, __m256 b) { return _mm256_blendv_ps(b, a, mask); }
+
+		/// Vectorized equivalent of `kernel::impl::unpremultiply`
+		PSAPI_TARGET_AVX2 inline __m256 unpremultiply(__m256 value, __m256 alpha)
+		{
+			const __m256 result = _mm256_min_ps(one(), _mm256_div_ps(value, alpha));
+			return _mm256_and_ps(result, gt(alpha, _mm256_setzero_ps()));
+		}
+
+		/// Vectorized equivalent of `kernel::impl::compose`
+		PSAPI_TARGET_AVX2 inline __m256 compose(__m256 cb, __m256 ab, __m256 cs, __m256 as, __m256 blended)
+		{
+			const __m256 source = _mm256_mul_ps(cs, _mm256_sub_ps(one(), ab));
+			const __m256 backdrop = _mm256_mul_ps(cb, _mm256_sub_ps(one(), as));
+			return _mm256_add_ps(_mm256_add_ps(source, backdrop), _mm256_mul_ps(_mm256_mul_ps(as, ab), blended));
+		}
+	}
+
+
+	/// Vectorized separable blend modes, these mirror the scalar implementations in `kernel::separable` and are
+	/// dispatched on the type of the tag.
+	namespace blend
+	{
+		using namespace impl;
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::normal, [[maybe_unused]] __m256 cb, __m256 cs) { return cs; }
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::multiply, __m256 cb, __m256 cs) { return _mm256_mul_ps(cb, cs); }
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::screen, __m256 cb, __m256 cs)
+		{
+			return _mm256_sub_ps(_mm256_add_ps(cb, cs), _mm256_mul_ps(cb, cs));
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::hard_light, __m256 cb, __m256 cs)
+		{
+			const __m256 two_cs = _mm256_add_ps(cs, cs);
+			return select(le(cs, half()),
+				apply(separable::multiply{}, cb, two_cs),
+				apply(separable::screen{}, cb, _mm256_sub_ps(two_cs, one()))
+			);
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::overlay, __m256 cb, __m256 cs) { return apply(separable::hard_light{}, cs, cb); }
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::soft_light, __m256 cb, __m256 cs)
+		{
+			const __m256 darken = _mm256_sub_ps(cb,
+				_mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(one(), cs), cs), cb), _mm256_sub_ps(one(), cb)));
+
+			__m256 d = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(16.0f), cb), _mm256_set1_ps(12.0f)), cb);
+			d = _mm256_mul_ps(_mm256_add_ps(d, _mm256_set1_ps(4.0f)), cb);
+			d = select(le(cb, _mm256_set1_ps(0.25f)), d, _mm256_sqrt_ps(cb));
+			const __m256 lighten = _mm256_add_ps(cb, _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(cs, cs), one()), _mm256_sub_ps(d, cb)));
+
+			return select(le(cs, half()), darken, lighten);
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::color_dodge, __m256 cb, __m256 cs)
+		{
+			__m256 result = _mm256_min_ps(one(), _mm256_div_ps(cb, _mm256_sub_ps(one(), cs)));
+			result = select(ge(cs, one()), one(), result);
+			return select(le(cb, _mm256_setzero_ps()), _mm256_setzero_ps(), result);
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::color_burn, __m256 cb, __m256 cs)
+		{
+			__m256 result = _mm256_sub_ps(one(), _mm256_min_ps(one(), _mm256_div_ps(_mm256_sub_ps(one(), cb), cs)));
+			result = select(le(cs, _mm256_setzero_ps()), _mm256_setzero_ps(), result);
+			return select(ge(cb, one()), one(), result);
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::linear_dodge, __m256 cb, __m256 cs) { return _mm256_min_ps(one(), _mm256_add_ps(cb, cs)); }
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::linear_burn, __m256 cb, __m256 cs)
+		{
+			return _mm256_max_ps(_mm256_setzero_ps(), _mm256_sub_ps(_mm256_add_ps(cb, cs), one()));
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::darken, __m256 cb, __m256 cs) { return _mm256_min_ps(cb, cs); }
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::lighten, __m256 cb, __m256 cs) { return _mm256_max_ps(cb, cs); }
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::difference, __m256 cb, __m256 cs)
+		{
+			// Clear the sign bit to get the absolute value
+			return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _mm256_sub_ps(cb, cs));
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::exclusion, __m256 cb, __m256 cs)
+		{
+			return _mm256_sub_ps(_mm256_add_ps(cb, cs), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), cb), cs));
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::subtract, __m256 cb, __m256 cs) { return _mm256_max_ps(_mm256_setzero_ps(), _mm256_sub_ps(cb, cs)); }
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::divide, __m256 cb, __m256 cs)
+		{
+			const __m256 result = _mm256_min_ps(one(), _mm256_div_ps(cb, cs));
+			const __m256 zero_divisor = select(le(cb, _mm256_setzero_ps()), _mm256_setzero_ps(), one());
+			return select(le(cs, _mm256_setzero_ps()), zero_divisor, result);
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::vivid_light, __m256 cb, __m256 cs)
+		{
+			const __m256 two_cs = _mm256_add_ps(cs, cs);
+			return select(le(cs, half()),
+				apply(separable::color_burn{}, cb, two_cs),
+				apply(separable::color_dodge{}, cb, _mm256_sub_ps(two_cs, one()))
+			);
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::linear_light, __m256 cb, __m256 cs)
+		{
+			const __m256 result = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(cb, cs), cs), one());
+			return _mm256_min_ps(_mm256_max_ps(result, _mm256_setzero_ps()), one());
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::pin_light, __m256 cb, __m256 cs)
+		{
+			const __m256 two_cs = _mm256_add_ps(cs, cs);
+			return select(le(cs, half()),
+				_mm256_min_ps(cb, two_cs),
+				_mm256_max_ps(cb, _mm256_sub_ps(two_cs, one()))
+			);
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 apply(separable::hard_mix, __m256 cb, __m256 cs)
+		{
+			return _mm256_and_ps(ge(_mm256_add_ps(cb, cs), one()), one());
+		}
+
+
+		/// Vectorized non-separable blend modes, these mirror the scalar implementations in `kernel::nonseparable` and
+		/// operate on 8 pixels of all 3 RGB components at once. This is a plain aggregate rather than a std::array as
+		/// GCC drops the alignment attributes of __m256 when it is passed as a template argument.
+		struct rgb
+		{
+			__m256 r;
+			__m256 g;
+			__m256 b;
+		};
+
+		PSAPI_TARGET_AVX2 inline __m256 lum(const rgb& c)
+		{
+			const __m256 rg = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.3f), c.r), _mm256_mul_ps(_mm256_set1_ps(0.59f), c.g));
+			return _mm256_add_ps(rg, _mm256_mul_ps(_mm256_set1_ps(0.11f), c.b));
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 min3(const rgb& c) { return _mm256_min_ps(_mm256_min_ps(c.r, c.g), c.b); }
+		PSAPI_TARGET_AVX2 inline __m256 max3(const rgb& c) { return _mm256_max_ps(_mm256_max_ps(c.r, c.g), c.b); }
+
+		PSAPI_TARGET_AVX2 inline rgb clip_color(rgb c)
+		{
+			const __m256 l = lum(c);
+			const __m256 n = min3(c);
+			const __m256 x = max3(c);
+
+			// The denominators may be zero for lanes that are masked out, these are discarded by the select.
+			const __m256 below = _mm256_and_ps(lt(n, _mm256_setzero_ps()), neq(l, n));
+			const __m256 below_scale = _mm256_sub_ps(l, n);
+			for (__m256* value : { &c.r, &c.g, &c.b })
+			{
+				const __m256 clipped = _mm256_add_ps(l, _mm256_div_ps(_mm256_mul_ps(_mm256_sub_ps(*value, l), l), below_scale));
+				*value = select(below, clipped, *value);
+			}
+			const __m256 above = _mm256_and_ps(gt(x, one()), neq(x, l));
+			const __m256 above_scale = _mm256_sub_ps(x, l);
+			const __m256 one_minus_l = _mm256_sub_ps(one(), l);
+			for (__m256* value : { &c.r, &c.g, &c.b })
+			{
+				const __m256 clipped = _mm256_add_ps(l, _mm256_div_ps(_mm256_mul_ps(_mm256_sub_ps(*value, l), one_minus_l), above_scale));
+				*value = select(above, clipped, *value);
+			}
+			return c;
+		}
+
+		PSAPI_TARGET_AVX2 inline rgb set_lum(rgb c, __m256 l)
+		{
+			const __m256 d = _mm256_sub_ps(l, lum(c));
+			return clip_color({ _mm256_add_ps(c.r, d), _mm256_add_ps(c.g, d), _mm256_add_ps(c.b, d) });
+		}
+
+		PSAPI_TARGET_AVX2 inline __m256 sat(const rgb& c) { return _mm256_sub_ps(max3(c), min3(c)); }
+
+		PSAPI_TARGET_AVX2 inline rgb set_sat(rgb c, __m256 s)
+		{
+			const __m256 n = min3(c);
+			const __m256 range = _mm256_sub_ps(max3(c), n);
+			const __m256 valid = gt(range, _mm256_setzero_ps());
+			for (__m256* value : { &c.r, &c.g, &c.b })
+			{
+				*value = _mm256_and_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_sub_ps(*value, n), s), range), valid);
+			}
+			return c;
+		}
+
+		PSAPI_TARGET_AVX2 inline rgb apply(nonseparable::hue, const rgb& cb, const rgb& cs) { return set_lum(set_sat(cs, sat(cb)), lum(cb)); }
+
+		PSAPI_TARGET_AVX2 inline rgb apply(nonseparable::saturation, const rgb& cb, const rgb& cs) { return set_lum(set_sat(cb, sat(cs)), lum(cb)); }
+
+		PSAPI_TARGET_AVX2 inline rgb apply(nonseparable::color, const rgb& cb, const rgb& cs) { return set_lum(cs, lum(cb)); }
+
+		PSAPI_TARGET_AVX2 inline rgb apply(nonseparable::luminosity, const rgb& cb, const rgb& cs) { return set_lum(cb, lum(cs)); }
+
+		PSAPI_TARGET_AVX2 inline rgb apply(nonseparable::darker_color, const rgb& cb, const rgb& cs)
+		{
+			const __m256 mask = lt(lum(cs), lum(cb));
+			return { select(mask, cs.r, cb.r), select(mask, cs.g, cb.g), select(mask, cs.b, cb.b) };
+		}
+
+		PSAPI_TARGET_AVX2 inline rgb apply(nonseparable::lighter_color, const rgb& cb, const rgb& cs)
+		{
+			const __m256 mask = gt(lum(cs), lum(cb));
+			return { select(mask, cs.r, cb.r), select(mask, cs.g, cb.g), select(mask, cs.b, cb.b) };
+		}
+	}
+
+
+	/// Blend the row of premultiplied layer values over the premultiplied canvas values 8 at a time, returning the number
+	/// of processed elements. The remainder is left for the caller to process.
+	template <typename T, typename BlendOp>
+	PSAPI_TARGET_AVX2 size_t separable_row(std::span<T> canvas, std::span<const T> canvas_alpha, std::span<const T> layer, std::span<const T> layer_alpha)
+	{
+		const size_t simd_size = canvas.size() - canvas.size() % 8;
+		const __m256 max = _mm256_set1_ps(static_cast<float>(kernel::impl::calc_max_t<T>()));
+		const __m256 inv_max = _mm256_set1_ps(1.0f / static_cast<float>(kernel::impl::calc_max_t<T>()));
+
+		for (size_t x = 0; x < simd_size; x += 8)
+		{
+			const __m256 cb = impl::load(canvas.data() + x, inv_max);
+			const __m256 cs = impl::load(layer.data() + x, inv_max);
+			const __m256 as = impl::load(layer_alpha.data() + x, inv_max);
+
+			__m256 result;
+			if constexpr (std::is_same_v<BlendOp, separable::normal>)
+			{
+				result = _mm256_add_ps(cs, _mm256_mul_ps(cb, _mm256_sub_ps(impl::one(), as)));
+			}
+			else
+			{
+				const __m256 ab = impl::load(canvas_alpha.data() + x, inv_max);
+				const __m256 blended = blend::apply(BlendOp{}, impl::unpremultiply(cb, ab), impl::unpremultiply(cs, as));
+				result = impl::compose(cb, ab, cs, as, blended);
+			}
+			impl::store(canvas.data() + x, result, max);
+		}
+		return simd_size;
+	}
+
+
+	/// Blend the row of premultiplied RGB layer values over the premultiplied RGB canvas values 8 pixels at a time,
+	/// returning the number of processed pixels. The remainder is left for the caller to process.
+	template <typename T, typename BlendOp>
+	PSAPI_TARGET_AVX2 size_t nonseparable_row(std::array<std::span<T>, 3> canvas, std::span<const T> canvas_alpha, std::array<std::span<const T>, 3> layer, std::span<const T> layer_alpha)
+	{
+		const size_t simd_size = canvas_alpha.size() - canvas_alpha.size() % 8;
+		const __m256 max = _mm256_set1_ps(static_cast<float>(kernel::impl::calc_max_t<T>()));
+		const __m256 inv_max = _mm256_set1_ps(1.0f / static_cast<float>(kernel::impl::calc_max_t<T>()));
+
+		for (size_t x = 0; x < simd_size; x += 8)
+		{
+			const __m256 ab = impl::load(canvas_alpha.data() + x, inv_max);
+			const __m256 as = impl::load(layer_alpha.data() + x, inv_max);
+
+			const blend::rgb cb = {
+				impl::load(canvas[0].data() + x, inv_max),
+				impl::load(canvas[1].data() + x, inv_max),
+				impl::load(canvas[2].data() + x, inv_max)
+			};
+			const blend::rgb cs = {
+				impl::load(layer[0].data() + x, inv_max),
+				impl::load(layer[1].data() + x, inv_max),
+				impl::load(layer[2].data() + x, inv_max)
+			};
+			const blend::rgb canvas_color = { impl::unpremultiply(cb.r, ab), impl::unpremultiply(cb.g, ab), impl::unpremultiply(cb.b, ab) };
+			const blend::rgb layer_color = { impl::unpremultiply(cs.r, as), impl::unpremultiply(cs.g, as), impl::unpremultiply(cs.b, as) };
+
+			const blend::rgb blended = blend::apply(BlendOp{}, canvas_color, layer_color);
+			impl::store(canvas[0].data() + x, impl::compose(cb.r, ab, cs.r, as, blended.r), max);
+			impl::store(canvas[1].data() + x, impl::compose(cb.g, ab, cs.g, as, blended.g), max);
+			impl::store(canvas[2].data() + x, impl::compose(cb.b, ab, cs.b, as, blended.b), max);
+		}
+		return simd_size;
+	}
+
+
+	/// Composite the row of layer alpha values over the canvas alpha 8 at a time, returning the number of processed
+	/// elements. The remainder is left for the caller to process.
+	template <typename T>
+	PSAPI_TARGET_AVX2 size_t alpha_row(std::span<T> canvas_alpha, std::span<const T> layer_alpha)
+	{
+		const size_t simd_size = canvas_alpha.size() - canvas_alpha.size() % 8;
+		const __m256 max = _mm256_set1_ps(static_cast<float>(kernel::impl::calc_max_t<T>()));
+		const __m256 inv_max = _mm256_set1_ps(1.0f / static_cast<float>(kernel::impl::calc_max_t<T>()));
+
+		for (size_t x = 0; x < simd_size; x += 8)
+		{
+			const __m256 ab = impl::load(canvas_alpha.data() + x, inv_max);
+			const __m256 as = impl::load(layer_alpha.data() + x, inv_max);
+			impl::store(canvas_alpha.data() + x, _mm256_add_ps(as, _mm256_mul_ps(ab, _mm256_sub_ps(impl::one(), as))), max);
+		}
+		return simd_size;
+	}
+}
+
+PSAPI_NAMESPACE_END
+
+#endif // PSAPI_SIMD_AVX2
@@ -1,11 +1,11 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 #include "Util/Logger.h"
 
 #include <vector>
 #include <algorithm>
-#include <execution>
 
 // If we compile with C++<20 we replace the stdlib implementation with the compatibility
 // library
@@ -66,7 +66,7 @@ namespace Render
 		// Perform deinterleaving
 		const std::size_t spans_size = spans.size();
 		auto indices = std::views::iota(static_cast<std::size_t>(0), spans.front().size());
-		std::for_each(std::execution::par_unseq, indices.begin(), indices.end(), [&](auto idx)
+		Parallel::forEach(indices.begin(), indices.end(), [&](auto idx)
 			{
 				const std::size_t interleaved_base_idx = idx * spans_size;
 				for (std::size_t i = 0; i < spans_size; ++i)
@@ -116,7 +116,7 @@ namespace Render
 		// Perform deinterleaving
 		const std::size_t spans_size = channel_spans.size();
 		auto indices = std::views::iota(static_cast<std::size_t>(0), channel_spans.front().size());
-		std::for_each(std::execution::par_unseq, indices.begin(), indices.end(), [&](auto idx)
+		Parallel::forEach(indices.begin(), indices.end(), [&](auto idx)
 			{
 				const std::size_t interleaved_base_idx = idx * spans_size;
 				for (std::size_t i = 0; i < spans_size; ++i)
@@ -160,7 +160,7 @@ namespace Render
 
 		// Allocate vectors for each channel
 		std::vector<std::vector<T>> channels(num_channels);
-		std::for_each(std::execution::par_unseq, channels.begin(), channels.end(), [channel_size](std::vector<T>& channel)
+		Parallel::forEach(channels.begin(), channels.end(), [channel_size](std::vector<T>& channel)
 			{
 				channel = std::vector<T>(channel_size);
 			});
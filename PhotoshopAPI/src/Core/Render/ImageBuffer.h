@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 
 #include <vector>
 #include <cmath>
@@ -853,7 +854,7 @@ namespace Render
                     auto horizontal_iter = std::views::iota(min_x, max_x);
                     const auto alpha_width = this->alpha().width;
 
-                    std::for_each(std::execution::par_unseq, vertical_iter.begin(), vertical_iter.end(), [&](size_t y)
+                    Parallel::forEach(vertical_iter.begin(), vertical_iter.end(), [&](size_t y)
                         {
                             for (auto x : horizontal_iter)
                             {
@@ -874,7 +875,7 @@ namespace Render
             // Apply the opacity
             if (this->metadata.opacity != 1.0f)
             {
-                std::for_each(std::execution::par_unseq, _alpha.begin(), _alpha.end(), [&](auto& value)
+                Parallel::forEach(_alpha.begin(), _alpha.end(), [&](auto& value)
                     {
                         value = value * this->metadata.opacity;
                     });
@@ -935,14 +936,8 @@ namespace Render
 
             if (this->mask)
             {
-                auto mask_width = this->mask.value().width;
-                auto mask_height = this->mask.value().height;
-
-                auto absolute_mask_position = this->mask.value().position;
-
-                auto _bbox = Geometry::BoundingBox<int>(Geometry::Point2D<int>(0, 0), Geometry::Point2D<int>(mask_width, mask_height));
-                _bbox.offset(absolute_mask_position);
-                mask_bbox.emplace(std::move(_bbox));
+                // The mask is positioned by its center just like the other channels
+                mask_bbox.emplace(this->mask.value().bbox());
             }
 
             auto absolute_position = this->metadata.position;
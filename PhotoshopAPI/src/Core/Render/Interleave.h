@@ -1,12 +1,12 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 #include "Util/Logger.h"
 #include "Util/Profiling/Perf/Instrumentor.h"
 
 #include <vector>
 #include <algorithm>
-#include <execution>
 #include <ranges>
 
 // If we compile with C++<20 we replace the stdlib implementation with the compatibility
@@ -65,7 +65,7 @@ namespace Render
 		}
 
 		auto indices = std::views::iota(static_cast<std::size_t>(0), first.size());
-		std::for_each(std::execution::par_unseq, indices.begin(), indices.end(), [&buffer, &spans, &first](auto idx)
+		Parallel::forEach(indices.begin(), indices.end(), [&buffer, &spans, &first](auto idx)
 			{
 				const std::size_t start_idx = spans.size() * idx;
 				for (size_t i = 0; i < spans.size(); ++i)
@@ -144,7 +144,7 @@ namespace Render
 		}
 
 		auto indices = std::views::iota(static_cast<std::size_t>(0), spans.front().size());
-		std::for_each(std::execution::par_unseq, indices.begin(), indices.end(), [&buffer, &spans](auto idx)
+		Parallel::forEach(indices.begin(), indices.end(), [&buffer, &spans](auto idx)
 			{
 				const std::size_t start_idx = spans.size() * idx;
 				for (size_t i = 0; i < spans.size(); ++i)
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "Macros.h"
+#include "Util/Parallel.h"
+
+#include "Core/Geometry/Point.h"
+#include "ImageBuffer.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <ranges>
+#include <type_traits>
+
+
+PSAPI_NAMESPACE_BEGIN
+
+namespace Render
+{
+
+    /// Mip pyramid of a single channel, holding successive reductions of the image each being half the size of the
+    /// previous one (rounded up) down to a single pixel. These are used for sampling an image which is scaled down
+    /// without aliasing by picking the level whose pixels roughly match the size of the area being sampled.
+    ///
+    /// The full resolution image (level 0) is not stored on the pyramid, only the reduced levels from 1 onwards are.
+    /// This avoids keeping a duplicate of what is usually the largest image around, the full resolution image is
+    /// instead passed along when sampling.
+    template <typename T>
+    struct MipPyramid
+    {
+        MipPyramid() = default;
+
+        /// Build the pyramid for the given image, reducing each level by box filtering 2x2 pixels of the previous level.
+        /// Odd dimensions replicate the last row or column of the previous level.
+        explicit MipPyramid(ConstChannelBuffer<T> image) : m_Width(image.width), m_Height(image.height)
+        {
+            PSAPI_PROFILE_FUNCTION();
+            ConstChannelBuffer<T> previous = image;
+            while (previous.width > 1 || previous.height > 1)
+            {
+                const size_t width = (previous.width + 1) / 2;
+                const size_t height = (previous.height + 1) / 2;
+                std::vector<T> level(width * height);
+
+                auto vertical_iter = std::views::iota(static_cast<size_t>(0), height);
+                Parallel::forEach(vertical_iter.begin(), vertical_iter.end(), [&](size_t y)
+                    {
+                        const size_t y0 = std::min(y * 2, previous.height - 1);
+                        const size_t y1 = std::min(y * 2 + 1, previous.height - 1);
+                        for (size_t x = 0; x < width; ++x)
+                        {
+                            const size_t x0 = std::min(x * 2, previous.width - 1);
+                            const size_t x1 = std::min(x * 2 + 1, previous.width - 1);
+
+                            float sum = static_cast<float>(previous.buffer[y0 * previous.width + x0]);
+                            sum += static_cast<float>(previous.buffer[y0 * previous.width + x1]);
+                            sum += static_cast<float>(previous.buffer[y1 * previous.width + x0]);
+                            sum += static_cast<float>(previous.buffer[y1 * previous.width + x1]);
+
+                            level[y * width + x] = to_value(sum * 0.25f);
+                        }
+                    });
+
+                m_Levels.push_back(std::move(level));
+                m_Sizes.push_back({ width, height });
+                previous = ConstChannelBuffer<T>(m_Levels.back(), width, height);
+            }
+        }
+
+        /// The number of reduced levels held by the pyramid, this does not include the full resolution image
+        size_t num_levels() const noexcept { return m_Levels.size(); }
+
+        /// Check whether the pyramid holds no levels, sampling it will then always sample the full resolution image
+        bool empty() const noexcept { return m_Levels.empty(); }
+
+        /// The width and height of the full resolution image the pyramid was built from
+        size_t width() const noexcept { return m_Width; }
+        size_t height() const noexcept { return m_Height; }
+
+        /// Get a view over the given level where level 1 is the first reduced level. The full resolution image is not
+        /// held on the pyramid so level 0 cannot be retrieved.
+        ConstChannelBuffer<T> level(size_t index) const
+        {
+            if (index == 0 || index > m_Levels.size())
+            {
+                PSAPI_LOG_ERROR("MipPyramid", "Unable to get mip level %zu, the pyramid holds the levels 1-%zu", index, m_Levels.size());
+            }
+            return ConstChannelBuffer<T>(m_Levels[index - 1], m_Sizes[index - 1][0], m_Sizes[index - 1][1]);
+        }
+
+        /// The number of bytes held by all the levels of the pyramid
+        size_t byte_size() const noexcept
+        {
+            size_t size = 0;
+            for (const auto& level : m_Levels)
+            {
+                size += level.size() * sizeof(T);
+            }
+            return size;
+        }
+
+        /// Sample the image at the given normalized uv coordinate and level of detail, interpolating trilinearly between
+        /// the two levels closest to it. A level of detail of `n` corresponds to the area sampled being 2^n pixels wide
+        /// on the full resolution image, anything at or below 0 samples the full resolution `image` bilinearly.
+        ///
+        /// The reduced levels are sampled clamping to their edges rather than fading to black like the full resolution
+        /// image as a single pixel of these may already cover a significant part of the output.
+        ///
+        /// \param image    The full resolution image the pyramid was built from
+        /// \param uv       The normalized uv coordinate to sample
+        /// \param lod      The level of detail to sample at
+        template <typename U>
+        T sample_trilinear_uv(ConstChannelBuffer<T> image, const Geometry::Point2D<U> uv, float lod) const
+        {
+            if (lod <= 0.0f || m_Levels.empty())
+            {
+                return image.template sample_bilinear_uv<U>(uv);
+            }
+            lod = std::min(lod, static_cast<float>(m_Levels.size()));
+
+            const size_t lower = static_cast<size_t>(std::floor(lod));
+            const size_t upper = std::min(lower + 1, m_Levels.size());
+            const float weight = lod - static_cast<float>(lower);
+
+            const float lower_value = static_cast<float>(lower == 0 ? image.template sample_bilinear_uv<U>(uv) : sample_level(lower, uv));
+            if (weight == 0.0f || upper == lower)
+            {
+                return to_value(lower_value);
+            }
+            const float upper_value = static_cast<float>(sample_level(upper, uv));
+            return to_value(lower_value + weight * (upper_value - lower_value));
+        }
+
+    private:
+
+        std::vector<std::vector<T>> m_Levels;
+        std::vector<std::array<size_t, 2>> m_Sizes;
+
+        size_t m_Width = 0;
+        size_t m_Height = 0;
+
+        /// Convert a value computed in float back to T, rounding it for integral types rather than truncating
+        static T to_value(float value)
+        {
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                return static_cast<T>(value);
+            }
+            else
+            {
+                return static_cast<T>(std::round(value));
+            }
+        }
+
+        /// Bilinearly sample the given reduced level, clamping the coordinate to the centers of the edge pixels
+        template <typename U>
+        T sample_level(size_t index, const Geometry::Point2D<U> uv) const
+        {
+            const auto buffer = level(index);
+            const U x = std::clamp<U>(uv.x * static_cast<U>(buffer.width) - static_cast<U>(.5), 0, static_cast<U>(buffer.width - 1));
+            const U y = std::clamp<U>(uv.y * static_cast<U>(buffer.height) - static_cast<U>(.5), 0, static_cast<U>(buffer.height - 1));
+            return buffer.template sample_bilinear<U, false>(Geometry::Point2D<U>(x, y));
+        }
+    };
+
+}
+
+PSAPI_NAMESPACE_END
@@ -42,13 +42,9 @@ void ByteStream::read(std::span<uint8_t> buffer)
 	{
 		PSAPI_LOG_ERROR("ByteStream", "Trying to read too much data, maximum is %" PRIu64 " but got %" PRIu64 " instead", m_Size, m_Offset + buffer.size());
 	}
-	if (m_Buffer.size() - 1 < m_Offset + buffer.size())
-	{
-		PSAPI_LOG_ERROR("ByteStream", "Trying to read too much data, maximum is %zu but got %" PRIu64 " instead", m_Buffer.size() - 1, m_Offset + buffer.size());
-	}
 
-	// Use memcpy to copy data from m_Buffer to the provided buffer
-	std::memcpy(buffer.data(), m_Buffer.data() + m_Offset, buffer.size());
+	// Use memcpy to copy data from our data to the provided buffer
+	std::memcpy(buffer.data(), data() + m_Offset, buffer.size());
 	m_Offset += buffer.size();
 }
 
@@ -69,35 +65,31 @@ void ByteStream::read(std::span<uint8_t> buffer, uint64_t offset)
 	}
 	if (offset + buffer.size() > m_Size)
 	{
-		PSAPI_LOG_ERROR("ByteStream", "Trying to read too much data, maximum is %" PRIu64 " but got %" PRIu64 " instead", m_Size, m_Offset + buffer.size());
-	}
-	if (m_Buffer.size() < offset + buffer.size())
-	{
-		PSAPI_LOG_ERROR("ByteStream", "Trying to read too much data, maximum is %zu but got %" PRIu64 " instead", m_Buffer.size() - 1, m_Offset + buffer.size());
+		PSAPI_LOG_ERROR("ByteStream", "Trying to read too much data, maximum is %" PRIu64 " but got %" PRIu64 " instead", m_Size, offset + buffer.size());
 	}
 
-	// Use memcpy to copy data from m_Buffer to the provided buffer
-	std::memcpy(buffer.data(), m_Buffer.data() + offset, buffer.size());
+	// Use memcpy to copy data from our data to the provided buffer
+	std::memcpy(buffer.data(), data() + offset, buffer.size());
 }
 
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
-std::span<uint8_t> ByteStream::read(uint64_t size)
+std::span<const uint8_t> ByteStream::read(uint64_t size)
 {
 	PSAPI_PROFILE_FUNCTION();
 	if (m_Offset + size > m_Size)
 	{
 		PSAPI_LOG_ERROR("ByteStream", "Trying to read too much data, maximum is %" PRIu64 " but got %" PRIu64 " instead", m_Size, m_Offset + size);
 	}
-	return std::span<uint8_t>(m_Buffer.data() + m_Offset, size);
+	return std::span<const uint8_t>(data() + m_Offset, size);
 }
 
 
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
-std::span<uint8_t> ByteStream::read(uint64_t offset, uint64_t size)
+std::span<const uint8_t> ByteStream::read(uint64_t offset, uint64_t size)
 {
 	PSAPI_PROFILE_FUNCTION();
 	if (offset > m_Size)
@@ -108,7 +100,7 @@ std::span<uint8_t> ByteStream::read(uint64_t offset, uint64_t size)
 	{
 		PSAPI_LOG_ERROR("ByteStream", "Trying to read too much data, maximum is %" PRIu64 " but got %" PRIu64 " instead", m_Size, m_Offset + size);
 	}
-	return std::span<uint8_t>(m_Buffer.data() + offset, size);
+	return std::span<const uint8_t>(data() + offset, size);
 }
 
 
@@ -117,13 +109,21 @@ std::span<uint8_t> ByteStream::read(uint64_t offset, uint64_t size)
 ByteStream::ByteStream(File& document, const uint64_t offset, const uint64_t size)
 {
 	PSAPI_PROFILE_FUNCTION();
+	m_Size = size;
+	m_FileOffset = offset;
+
+	// Memory mapped documents are read straight from the mapping (and therefore the page cache), only in-memory
+	// documents have to be copied as their storage may be reallocated while we hold on to it
+	if (auto view = document.mappedView(offset, size); view.has_value())
+	{
+		m_MappedData = view.value().data();
+		return;
+	}
 	{
 		PSAPI_PROFILE_SCOPE("Vector malloc");
 		m_Buffer = std::vector<uint8_t>(size);
 	}
-	m_Size = size;
 	document.readFromOffset(m_Buffer, offset);
-	m_FileOffset = offset;
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -34,17 +34,23 @@ struct ByteStream
 	// m_Offset variable 
 	void read(std::span<uint8_t> buffer, uint64_t offset);
 
-	std::span<uint8_t> read(uint64_t size);
-	std::span<uint8_t> read(uint64_t offset, uint64_t size);
+	// Get a view of n bytes at the current (or given) offset without copying them
+	std::span<const uint8_t> read(uint64_t size);
+	std::span<const uint8_t> read(uint64_t offset, uint64_t size);
 
 	ByteStream() = default;
-	// Initialize a ByteStream from a given document and read the size into the ByteStream object
+	// Initialize a ByteStream from a given document. If the document is memory mapped the stream is a view into
+	// the mapping and must not outlive the document, otherwise the data is copied into the ByteStream object
 	ByteStream(File& document, const uint64_t offset, const uint64_t size);
 
 	ByteStream(std::vector<uint8_t> buffer);
 
 private:
+	// Pointer to the start of our data, this is either the memory mapped document or our own buffer
+	inline const uint8_t* data() const noexcept { return m_MappedData ? m_MappedData : m_Buffer.data(); };
+
 	std::vector<uint8_t> m_Buffer;
+	const uint8_t* m_MappedData = nullptr;	// Points into the document's memory mapping if we don't own the data, m_Buffer is empty in that case
 	uint64_t m_Offset = 0u;	// Internal offset for our data
 	uint64_t m_FileOffset = 0u; // The location in the file we are at
 	uint64_t m_Size = 0u;	// Total size of the buffer
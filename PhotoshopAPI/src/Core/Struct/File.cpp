@@ -4,9 +4,41 @@
 #include "Profiling/Perf/Instrumentor.h"
 
 #include <algorithm>
+#include <limits>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 PSAPI_NAMESPACE_BEGIN
 
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+const uint8_t* File::cursorData() const noexcept
+{
+	if (const auto* memory_buffer = std::get_if<std::vector<uint8_t>>(&m_Storage))
+	{
+		return memory_buffer->data();
+	}
+	if (m_DocumentMMap.is_open())
+	{
+		return m_DocumentMMap.data();
+	}
+	return nullptr;
+}
+
+
 // --------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------
 void File::read(std::span<uint8_t> buffer)
@@ -17,16 +49,17 @@ void File::read(std::span<uint8_t> buffer)
 		return;
 	}
 
-	if (std::holds_alternative<std::vector<uint8_t>>(m_Storage))
+	// Memory mapped or in-memory documents are read as a plain cursor over the data without locking, this is what 
+	// the whole metadata parse (layer records, tagged blocks, descriptors) runs on so it is kept as cheap as possible.
+	if (const uint8_t* data = cursorData())
 	{
-		const auto& memory_buffer = std::get<std::vector<uint8_t>>(m_Storage);
 		if (m_Offset + buffer.size() > m_Size) [[unlikely]]
 		{
-			PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be read from offset %" PRIu64 " as it would exceed the memory buffer size of %" PRIu64 "",
-				buffer.size(), m_Offset, m_Size);
+			PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be read from offset %" PRIu64 " as it would exceed the document size of %" PRIu64 "",
+				static_cast<uint64_t>(buffer.size()), m_Offset, m_Size);
 			return;
 		}
-		std::memcpy(buffer.data(), memory_buffer.data() + static_cast<size_t>(m_Offset), buffer.size());
+		std::memcpy(buffer.data(), data + static_cast<size_t>(m_Offset), buffer.size());
 		m_Offset += buffer.size();
 		return;
 	}
@@ -80,6 +113,22 @@ void File::readFromOffset(std::span<uint8_t> buffer, const uint64_t offset)
 }
 
 
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+std::optional<std::span<const uint8_t>> File::mappedView(const uint64_t offset, const uint64_t size) const
+{
+	if (!std::holds_alternative<std::filesystem::path>(m_Storage) || !m_DocumentMMap.is_open())
+	{
+		return std::nullopt;
+	}
+	if (offset + size > m_DocumentMMap.size()) [[unlikely]]
+	{
+		PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be viewed from offset %" PRIu64 " as it would exceed the file size of %" PRIu64 "", size, offset, m_DocumentMMap.size());
+	}
+	return std::span<const uint8_t>(m_DocumentMMap.data() + offset, size);
+}
+
+
 // --------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------
 void File::write(std::span<uint8_t> buffer)
@@ -101,85 +150,163 @@ void File::write(std::span<uint8_t> buffer)
 	}
 
 	std::lock_guard<std::mutex> guard(m_Mutex);
-	m_Size += buffer.size();
+	// We may be overwriting previously written data (e.g. when back-patching size markers) in which case the file doesn't grow
 	m_Offset += buffer.size();
+	m_Size = std::max<uint64_t>(m_Size, m_Offset);
 	m_Document.write(reinterpret_cast<char*>(buffer.data()), buffer.size());
 }
 
 
-// -------------------------------------------------------------------------------- 
 // --------------------------------------------------------------------------------
-void File::skip(int64_t size)
+// --------------------------------------------------------------------------------
+void File::preallocate(const uint64_t size)
 {
-	if (std::holds_alternative<std::vector<uint8_t>>(m_Storage))
+	PSAPI_PROFILE_FUNCTION();
+	if (auto* memory_buffer = std::get_if<std::vector<uint8_t>>(&m_Storage))
 	{
-		if (size <= 0)
+		if (size > memory_buffer->size())
 		{
-			return;
+			memory_buffer->resize(static_cast<size_t>(size), 0u);
 		}
-		if (m_Offset + static_cast<uint64_t>(size) > m_Size)
-		{
-			PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be skipped from offset %" PRIu64 " as it would exceed the memory buffer size of %" PRIu64 "",
-				size, m_Offset, m_Size);
-			return;
-		}
-		m_Offset += static_cast<uint64_t>(size);
+		m_Size = std::max<uint64_t>(m_Size, size);
 		return;
 	}
 
 	std::lock_guard<std::mutex> guard(m_Mutex);
-	if (size <= 0)
+	// Make sure anything still buffered by the file stream lands on disk before we grow the file underneath it
+	m_Document.flush();
+#ifdef _WIN32
+	if (m_WriteHandle == nullptr)
 	{
+		PSAPI_LOG_ERROR("File", "Unable to preallocate %" PRIu64 " bytes as the document is not open for writing", size);
 		return;
 	}
-	if (m_Offset + size > m_Size)
+	LARGE_INTEGER current_size{};
+	GetFileSizeEx(static_cast<HANDLE>(m_WriteHandle), &current_size);
+	if (size > static_cast<uint64_t>(current_size.QuadPart))
 	{
-		PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be skipped from offset %" PRIu64 " as it would exceed the file size of %" PRIu64 "", size, m_Offset, m_Size);
+		FILE_END_OF_FILE_INFO end_of_file{};
+		end_of_file.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+		if (!SetFileInformationByHandle(static_cast<HANDLE>(m_WriteHandle), FileEndOfFileInfo, &end_of_file, sizeof(end_of_file)))
+		{
+			PSAPI_LOG_ERROR("File", "Unable to preallocate %" PRIu64 " bytes, failed with error code %lu", size, GetLastError());
+		}
 	}
-	m_Document.ignore(size);
-	m_Offset += size;
+#else
+	if (m_WriteHandle < 0)
+	{
+		PSAPI_LOG_ERROR("File", "Unable to preallocate %" PRIu64 " bytes as the document is not open for writing", size);
+		return;
+	}
+	struct stat file_stat{};
+	if (fstat(m_WriteHandle, &file_stat) == 0 && size > static_cast<uint64_t>(file_stat.st_size))
+	{
+		if (ftruncate(m_WriteHandle, static_cast<off_t>(size)) != 0)
+		{
+			PSAPI_LOG_ERROR("File", "Unable to preallocate %" PRIu64 " bytes, failed with errno %i", size, errno);
+		}
+	}
+#endif
+	m_Size = std::max<uint64_t>(m_Size, size);
 }
 
 
 // --------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------
-void File::setOffset(const uint64_t offset)
+void File::writeToOffset(std::span<const uint8_t> buffer, const uint64_t offset)
 {
-	if (std::holds_alternative<std::vector<uint8_t>>(m_Storage))
+	PSAPI_PROFILE_FUNCTION();
+	if (buffer.size() == 0)
+	{
+		return;
+	}
+	if (offset + buffer.size() > m_Size) [[unlikely]]
+	{
+		PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be written to offset %" PRIu64 " as it would exceed the preallocated size of %" PRIu64 "",
+			static_cast<uint64_t>(buffer.size()), offset, m_Size);
+		return;
+	}
+
+	if (auto* memory_buffer = std::get_if<std::vector<uint8_t>>(&m_Storage))
+	{
+		std::memcpy(memory_buffer->data() + static_cast<size_t>(offset), buffer.data(), buffer.size());
+		return;
+	}
+
+	// Positional writes may be partial, so we loop until the whole buffer made it to disk
+	size_t written = 0;
+	while (written < buffer.size())
 	{
-		if (offset > m_Size)
+#ifdef _WIN32
+		const DWORD chunk_size = static_cast<DWORD>(std::min<size_t>(buffer.size() - written, (std::numeric_limits<DWORD>::max)()));
+		const uint64_t chunk_offset = offset + written;
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(chunk_offset & 0xFFFFFFFFull);
+		overlapped.OffsetHigh = static_cast<DWORD>(chunk_offset >> 32u);
+		DWORD chunk_written = 0;
+		if (m_WriteHandle == nullptr || !WriteFile(static_cast<HANDLE>(m_WriteHandle), buffer.data() + written, chunk_size, &chunk_written, &overlapped))
 		{
-			PSAPI_LOG_ERROR("File", "Cannot set offset to %" PRIu64 " as it would exceed the memory buffer size of %" PRIu64 ".", offset, m_Size);
+			PSAPI_LOG_ERROR("File", "Failed to write %zu bytes at offset %" PRIu64 "", buffer.size() - written, chunk_offset);
 			return;
 		}
-		m_Offset = offset;
-		return;
+		written += chunk_written;
+#else
+		const ssize_t chunk_written = pwrite(m_WriteHandle, buffer.data() + written, buffer.size() - written, static_cast<off_t>(offset + written));
+		if (chunk_written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (chunk_written <= 0)
+		{
+			PSAPI_LOG_ERROR("File", "Failed to write %zu bytes at offset %" PRIu64 ", failed with errno %i", buffer.size() - written, offset + written, errno);
+			return;
+		}
+		written += static_cast<size_t>(chunk_written);
+#endif
 	}
+}
 
-	std::lock_guard<std::mutex> guard(m_Mutex);
-	if (offset == m_Offset)
+
+// -------------------------------------------------------------------------------- 
+// --------------------------------------------------------------------------------
+void File::skip(int64_t size)
+{
+	if (size <= 0)
 	{
 		return;
 	}
-	if (offset > m_Size)
+
+	if (cursorData())
 	{
-		PSAPI_LOG_ERROR("File", "Cannot set offset to %" PRIu64 " as it would exceed the file size of %" PRIu64 ".", offset, m_Size);
+		if (m_Offset + static_cast<uint64_t>(size) > m_Size) [[unlikely]]
+		{
+			PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be skipped from offset %" PRIu64 " as it would exceed the document size of %" PRIu64 "",
+				size, m_Offset, m_Size);
+			return;
+		}
+		m_Offset += static_cast<uint64_t>(size);
 		return;
 	}
-	m_Offset = offset;
-	m_Document.seekg(offset, std::ios::beg);
+
+	std::lock_guard<std::mutex> guard(m_Mutex);
+	if (m_Offset + size > m_Size)
+	{
+		PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be skipped from offset %" PRIu64 " as it would exceed the file size of %" PRIu64 "", size, m_Offset, m_Size);
+	}
+	m_Document.ignore(size);
+	m_Offset += size;
 }
 
 
 // --------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------
-void File::set_offset(const uint64_t offset)
+void File::setOffset(const uint64_t offset)
 {
-	if (std::holds_alternative<std::vector<uint8_t>>(m_Storage))
+	if (cursorData())
 	{
-		if (offset > m_Size)
+		if (offset > m_Size) [[unlikely]]
 		{
-			PSAPI_LOG_ERROR("File", "Cannot set offset to %" PRIu64 " as it would exceed the memory buffer size of %" PRIu64 ".", offset, m_Size);
+			PSAPI_LOG_ERROR("File", "Cannot set offset to %" PRIu64 " as it would exceed the document size of %" PRIu64 ".", offset, m_Size);
 			return;
 		}
 		m_Offset = offset;
@@ -201,26 +328,33 @@ void File::set_offset(const uint64_t offset)
 }
 
 
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+void File::set_offset(const uint64_t offset)
+{
+	setOffset(offset);
+}
+
+
 
 // --------------------------------------------------------------------------------
 // --------------------------------------------------------------------------------
 void File::setOffsetAndRead(char* buffer, const uint64_t offset, const uint64_t size)
 {
-	if (std::holds_alternative<std::vector<uint8_t>>(m_Storage))
+	if (const uint8_t* data = cursorData())
 	{
-		const auto& memory_buffer = std::get<std::vector<uint8_t>>(m_Storage);
 		if (offset > m_Size) [[unlikely]]
 		{
-			PSAPI_LOG_ERROR("File", "Cannot set offset to %" PRIu64 " as it would exceed the memory buffer size of %" PRIu64 ".", offset, m_Size);
+			PSAPI_LOG_ERROR("File", "Cannot set offset to %" PRIu64 " as it would exceed the document size of %" PRIu64 ".", offset, m_Size);
 			return;
 		}
 		if (offset + size > m_Size) [[unlikely]]
 		{
-			PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be read from offset %" PRIu64 " as it would exceed the memory buffer size of %" PRIu64 "",
+			PSAPI_LOG_ERROR("File", "Size %" PRIu64 " cannot be read from offset %" PRIu64 " as it would exceed the document size of %" PRIu64 "",
 				size, offset, m_Size);
 			return;
 		}
-		std::memcpy(buffer, reinterpret_cast<const char*>(memory_buffer.data() + static_cast<size_t>(offset)), static_cast<size_t>(size));
+		std::memcpy(buffer, data + static_cast<size_t>(offset), static_cast<size_t>(size));
 		m_Offset = offset + size;
 		return;
 	}
@@ -262,6 +396,7 @@ File::File(std::filesystem::path file, const FileParams params)
 	}
 	m_Offset = 0;
 	m_Size = 0;
+	m_LazyChannelData = params.lazyChannelData && params.doRead;
 
 	// Check if the file exists and otherwise create it
 	if (params.doRead == true)
@@ -310,6 +445,20 @@ File::File(std::filesystem::path file, const FileParams params)
 		PSAPI_LOG_ERROR("File", "Failed to open file: %s", file.u8string().c_str());
 	}	
 
+	// Alongside the (buffered) file stream we hold a native handle for positional writes from multiple threads
+	if (!params.doRead && m_Document.is_open())
+	{
+#ifdef _WIN32
+		HANDLE handle = CreateFileW(file.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle != INVALID_HANDLE_VALUE)
+		{
+			m_WriteHandle = handle;
+		}
+#else
+		m_WriteHandle = ::open(file.c_str(), O_WRONLY | O_CLOEXEC);
+#endif
+	}
+
 	m_Storage = file;
 }
 
@@ -322,6 +471,23 @@ File::File(std::vector<uint8_t> buffer)
 	m_Size = static_cast<uint64_t>(std::get<std::vector<uint8_t>>(m_Storage).size());
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+File::~File()
+{
+#ifdef _WIN32
+	if (m_WriteHandle != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(m_WriteHandle));
+	}
+#else
+	if (m_WriteHandle >= 0)
+	{
+		::close(m_WriteHandle);
+	}
+#endif
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 bool File::can_read(const uint64_t size) const noexcept
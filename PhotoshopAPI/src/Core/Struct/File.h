@@ -5,7 +5,9 @@
 
 #include <filesystem>
 #include <fstream>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <variant>
 #include <vector>
 #include <cstring>
@@ -25,18 +27,28 @@
 PSAPI_NAMESPACE_BEGIN
 
 
-/// Thread-safe read and write by using a std::mutex to block any reading operations
-struct File
+/// Binary document which is either backed by a file on disk or held in memory.
+/// 
+/// Files opened for reading are memory mapped, sequential reads (read, skip, setOffset) are then a bounds-checked
+/// cursor over the mapping which neither locks nor goes through the file stream. These share a single offset and are
+/// therefore meant to be driven from a single thread, parallel readers should use readFromOffset() or mappedView()
+/// instead. Writing to disk goes through the file stream and is guarded by m_Mutex.
+/// 
+/// Files that are held by a std::shared_ptr may additionally be referenced by lazily decoded channels
+/// which keep the document alive until all of them are decoded or released.
+struct File : public std::enable_shared_from_this<File>
 {
 	struct FileParams
 	{
 		bool doRead;
 		bool forceOverwrite;
-		FileParams() : doRead(true), forceOverwrite(false) {};
+		/// If true (and the File is owned by a std::shared_ptr) the layer channels are not decoded on read
+		/// but instead keep a reference to their compressed data in the document, decoding it on first access.
+		bool lazyChannelData;
+		FileParams() : doRead(true), forceOverwrite(false), lazyChannelData(false) {};
 	};
 
-	// Use this mutex as well for locking throughout the application when IO functions
-	// are involved
+	// Guards the file stream, only used when the document is neither memory mapped nor held in memory
 	std::mutex m_Mutex;
 
 	/// Read n bytes from the file into the input buffer, make sure the buffer is 
@@ -52,11 +64,31 @@ struct File
 	// --------------------------------------------------------------------------------
 	void readFromOffset(std::span<uint8_t> buffer, const uint64_t offset);
 
+	/// Return a read-only view into the memory mapped document without copying any data. Returns std::nullopt if the 
+	/// document is not memory mapped, e.g. if it is held in memory or opened for writing. The view is only valid for 
+	/// as long as the File is alive.
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	std::optional<std::span<const uint8_t>> mappedView(const uint64_t offset, const uint64_t size) const;
+
 	/// Write n bytes to the file from the input span.
 	// --------------------------------------------------------------------------------
 	// --------------------------------------------------------------------------------
 	void write(std::span<uint8_t> buffer);
 
+	/// Grow the document to at least the given size ahead of writing into it with writeToOffset(). This must not be
+	/// called while any other write is in flight.
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	void preallocate(const uint64_t size);
+
+	/// Write the buffer at the given offset using positional I/O (pwrite on posix systems) without moving the 
+	/// internal offset marker. This is safe to call from any thread as long as the written regions don't overlap and
+	/// lie within the size previously passed to preallocate().
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	void writeToOffset(std::span<const uint8_t> buffer, const uint64_t offset);
+
 
 	/// Skip n bytes in the file and increment our position marker, checks if the offset 
 	/// is possible or if it would exceed the file size. Note: this is an int64_t
@@ -123,6 +155,13 @@ struct File
 	};
 
 
+	/// Return whether channel image data should be decoded lazily on access rather than on read. Only 
+	/// has an effect if the File is owned by a std::shared_ptr.
+	// --------------------------------------------------------------------------------
+	// --------------------------------------------------------------------------------
+	inline bool lazyChannelData() const noexcept { return m_LazyChannelData; }
+
+
 	/// Return whether we can read the given file from the document or if it would exceed the file size
 	// --------------------------------------------------------------------------------
 	// --------------------------------------------------------------------------------
@@ -136,13 +175,25 @@ struct File
 
 	File(std::vector<uint8_t> buffer);
 
+	~File();
+
 
 private:
+	/// Pointer to the start of the document if it is held in memory or memory mapped, nullptr if we have to go 
+	/// through the file stream.
+	const uint8_t* cursorData() const noexcept;
+
 	std::variant<std::filesystem::path, std::vector<uint8_t>> m_Storage{};
 	std::fstream m_Document;	// The file stream that represents our document
 	mio::ummap_source m_DocumentMMap;
 	uint64_t m_Size;			// The total size of the document
 	uint64_t m_Offset;			// The current document offset.
+	bool m_LazyChannelData = false;	// Whether channels should be decoded lazily, see FileParams::lazyChannelData
+#ifdef _WIN32
+	void* m_WriteHandle = nullptr;	// Native handle used for positional writes, only open when writing to disk
+#else
+	int m_WriteHandle = -1;			// Native handle used for positional writes, only open when writing to disk
+#endif
 };
 
 PSAPI_NAMESPACE_END
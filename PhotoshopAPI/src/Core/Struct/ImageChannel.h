@@ -4,12 +4,19 @@
 #include "Util/Enum.h"
 #include "Util/Profiling/Perf/Instrumentor.h"
 #include "PhotoshopFile/FileHeader.h"
+#include "Core/Struct/File.h"
+#include "Core/Struct/ByteStream.h"
+#include "Core/Compression/Compression.h"
+#include "Core/Geometry/BoundingBox.h"
 
 #include <compressed/channel.h>
 
 #include <vector>
+#include <algorithm>
 #include <limits>
 #include <cassert>
+#include <memory>
+#include <optional>
 #include <span>
 
 
@@ -27,6 +34,25 @@ template <typename T>
 concept is_bitdepth = std::is_same_v<T, bpp8_t> || std::is_same_v<T, bpp16_t> || std::is_same_v<T, bpp32_t>;
 
 
+/// Describes a channel that is still held PSD-compressed inside of the document it was read from. 
+/// A channel_wrapper holding one of these only decodes the data once it is actually accessed.
+struct lazy_channel_source
+{
+	/// The document the channel lives in, this is kept open for as long as any channel references it.
+	std::shared_ptr<File> document = nullptr;
+	/// The offset of the compressed data in the document, this excludes the 2-byte compression marker.
+	uint64_t offset = 0u;
+	/// The size of the compressed data in the document, this excludes the 2-byte compression marker.
+	uint64_t size = 0u;
+	/// The compression codec the data is stored with on disk.
+	Enum::Compression compression = Enum::Compression::Raw;
+	/// The header of the source document, required to decode e.g. the RLE scanline sizes.
+	FileHeader header{};
+	uint32_t width = 0u;
+	uint32_t height = 0u;
+};
+
+
 struct channel_wrapper
 {
 
@@ -106,6 +132,79 @@ struct channel_wrapper
 		m_YCoord = y_coord;
 	}
 
+	/// Initialize a channel which defers decoding of its data until it is first accessed. The write compression
+	/// is initialized to the codec the data is stored with on disk.
+	channel_wrapper(
+		lazy_channel_source source,
+		Enum::ChannelIDInfo channel_id,
+		float x_coord,
+		float y_coord
+	)
+	{
+		if (!source.document)
+		{
+			throw std::invalid_argument("Unable to construct a lazy channel without a valid source document");
+		}
+		m_PhotoshopCompression = source.compression;
+		m_LazySource = std::move(source);
+		m_ChannelID = channel_id;
+		m_XCoord = x_coord;
+		m_YCoord = y_coord;
+	}
+
+	/// Whether the channel is still held compressed in its source document and has not been decoded yet.
+	bool is_lazy() const noexcept
+	{
+		return m_LazySource.has_value();
+	}
+
+	/// The source the channel will be decoded from, only holds a value if `is_lazy()` is true.
+	const std::optional<lazy_channel_source>& lazy_source() const noexcept
+	{
+		return m_LazySource;
+	}
+
+	/// Whether the PSD-compressed payload the channel was read with can be written as-is, skipping the
+	/// decode/encode roundtrip. This is only the case if the channel was not modified since reading (any modification
+	/// replaces or decodes the channel) and the requested compression and file layout match the source.
+	bool is_passthrough(Enum::Compression compression, const FileHeader& header) const noexcept
+	{
+		if (!m_LazySource)
+		{
+			return false;
+		}
+		if (m_LazySource->compression != compression || m_LazySource->header.m_Depth != header.m_Depth)
+		{
+			return false;
+		}
+		// An explicitly requested zip level means we want the data re-encoded
+		if (m_ZipLevel && (compression == Enum::Compression::Zip || compression == Enum::Compression::ZipPrediction))
+		{
+			return false;
+		}
+		// RLE stores its scanline sizes as 2 bytes in psd and 4 bytes in psb files, so we can't mix these
+		if (compression == Enum::Compression::Rle && m_LazySource->header.m_Version != header.m_Version)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	/// Read the PSD-compressed payload of a channel that `is_lazy()` from its source document, this excludes the
+	/// 2-byte compression marker.
+	///
+	/// \throws std::runtime_error if the channel is not lazy
+	std::vector<uint8_t> read_compressed() const
+	{
+		if (!m_LazySource)
+		{
+			throw std::runtime_error("Unable to read the compressed payload of a channel that is not backed by a source document");
+		}
+		std::vector<uint8_t> data(m_LazySource->size);
+		m_LazySource->document->readFromOffset(std::span<uint8_t>(data), m_LazySource->offset);
+		return data;
+	}
+
 	Enum::Compression compression_codec() const noexcept
 	{
 		return m_PhotoshopCompression;
@@ -115,6 +214,24 @@ struct channel_wrapper
 		m_PhotoshopCompression = compcode;
 	}
 
+	/// The zip compression level (0-12) the channel is written with if its compression codec is Zip or ZipPrediction.
+	/// If unset the level the file is written with is used instead.
+	std::optional<int> zip_level() const noexcept
+	{
+		return m_ZipLevel;
+	}
+	/// Set the zip compression level (0-12) the channel is written with.
+	///
+	/// 	hrows std::invalid_argument if the level is outside of the range supported
+	void zip_level(std::optional<int> level)
+	{
+		if (level)
+		{
+			ZIP_Impl::ValidateCompressionLevel(level.value());
+		}
+		m_ZipLevel = level;
+	}
+
 	Enum::ChannelIDInfo channel_id_info() const noexcept
 	{
 		return m_ChannelID;
@@ -127,6 +244,10 @@ struct channel_wrapper
 	/// Get the width of the uncompressed ImageChannel
 	uint32_t width() const 
 	{ 
+		if (m_LazySource)
+		{
+			return m_LazySource->width;
+		}
 		return std::visit([](const auto& var) -> uint32_t
 		{
 			if constexpr (std::is_same_v<std::remove_cvref_t<decltype(var)>, std::monostate>)
@@ -147,6 +268,10 @@ struct channel_wrapper
 	// /// Get the height of the uncompressed ImageChannel
 	uint32_t height() const 
 	{ 
+		if (m_LazySource)
+		{
+			return m_LazySource->height;
+		}
 		return std::visit([](const auto& var) -> uint32_t
 		{
 			if constexpr (std::is_same_v<std::remove_cvref_t<decltype(var)>, std::monostate>)
@@ -173,6 +298,11 @@ struct channel_wrapper
 	/// Get the total number of chunks held in the ImageChannel
 	size_t num_chunks() const 
 	{
+		// A lazy channel has not been split into chunks yet, it is decoded as a whole.
+		if (m_LazySource)
+		{
+			return 1;
+		}
 		return std::visit([](const auto& var) -> size_t
 		{
 			if constexpr (std::is_same_v<std::remove_cvref_t<decltype(var)>, std::monostate>)
@@ -192,6 +322,10 @@ struct channel_wrapper
 
 	size_t byte_size() const
 	{
+		if (m_LazySource)
+		{
+			return this->element_size() * bytes_per_element(m_LazySource->header.m_Depth);
+		}
 		return std::visit([](const auto& var) -> size_t
 		{
 			if constexpr (std::is_same_v<std::remove_cvref_t<decltype(var)>, std::monostate>)
@@ -211,6 +345,10 @@ struct channel_wrapper
 
 	size_t element_size() const
 	{
+		if (m_LazySource)
+		{
+			return static_cast<size_t>(m_LazySource->width) * m_LazySource->height;
+		}
 		return std::visit([](const auto& var) -> size_t
 		{
 			if constexpr (std::is_same_v<std::remove_cvref_t<decltype(var)>, std::monostate>)
@@ -235,6 +373,17 @@ struct channel_wrapper
 		requires is_bitdepth<T>
 	compressed::channel<T> extract_channel()
 	{
+		if (m_LazySource)
+		{
+			std::vector<T> data = this->decode_lazy<T>();
+			auto channel = compressed::channel<T>(
+				std::span<const T>(data.begin(), data.end()),
+				static_cast<size_t>(m_LazySource->width),
+				static_cast<size_t>(m_LazySource->height)
+			);
+			m_LazySource = std::nullopt;
+			return channel;
+		}
 		auto channel = std::move(std::get<compressed::channel<T>>(m_Channel));
 		m_Channel.emplace<std::monostate>(); // reset to empty state
 		return channel;
@@ -244,6 +393,10 @@ struct channel_wrapper
 		requires is_bitdepth<T>
 	std::vector<T> get_data() const
 	{
+		if (m_LazySource)
+		{
+			return this->decode_lazy<T>();
+		}
 		const auto& channel = std::get<compressed::channel<T>>(m_Channel);
 		return channel.get_decompressed();
 	}
@@ -252,6 +405,12 @@ struct channel_wrapper
 		requires is_bitdepth<T>
 	std::vector<T> extract_data()
 	{
+		if (m_LazySource)
+		{
+			auto data = this->decode_lazy<T>();
+			m_LazySource = std::nullopt;
+			return data;
+		}
 		// Extract the channel
 		auto channel = this->extract_channel<T>();
 		return channel.get_decompressed();
@@ -262,6 +421,22 @@ struct channel_wrapper
 		requires is_bitdepth<T>
 	void get_data(std::span<T> buffer) const
 	{
+		if (m_LazySource)
+		{
+			if (buffer.size() != this->element_size())
+			{
+				throw std::invalid_argument(
+					std::format(
+						"Unable to retrieve image data from lazy channel as input size does not match output size."
+						" Expected exactly {} elements in the passed buffer but instead received {} elements",
+						this->element_size(), buffer.size()
+					)
+				);
+			}
+			this->decode_lazy<T>(buffer);
+			return;
+		}
+
 		const auto& channel = std::get<compressed::channel<T>>(m_Channel);
 		if (buffer.size() != channel.uncompressed_size())
 		{
@@ -286,19 +461,154 @@ struct channel_wrapper
 		}
 	}
 
+	/// \brief Retrieve only the pixels covered by the given region of the channel
+	///
+	/// The region is in channel-local pixel coordinates with the minimum being inclusive and the maximum exclusive.
+	/// Only the data intersecting the region is decoded: channels still backed by their source document decode
+	/// just the covered scanlines while in-memory channels decompress just the chunks overlapping them.
+	///
+	/// \throws std::invalid_argument if the region is empty or not fully contained within the channel
+	/// \throws std::bad_variant_access if the requested type is not that of the channel
+	template <typename T>
+		requires is_bitdepth<T>
+	std::vector<T> get_data(const Geometry::BoundingBox<int>& roi) const
+	{
+		PSAPI_PROFILE_FUNCTION();
+		const auto channel_width = this->width();
+		const auto channel_height = this->height();
+		if (roi.width() <= 0 || roi.height() <= 0 || roi.minimum.x < 0 || roi.minimum.y < 0 ||
+			roi.maximum.x > static_cast<int>(channel_width) || roi.maximum.y > static_cast<int>(channel_height))
+		{
+			throw std::invalid_argument(
+				std::format(
+					"Unable to retrieve region [({}, {}), ({}, {})) from a channel of size {}x{}, the region must be"
+					" non-empty and lie fully within the channel",
+					roi.minimum.x, roi.minimum.y, roi.maximum.x, roi.maximum.y, channel_width, channel_height
+				)
+			);
+		}
+
+		const auto row_start = static_cast<uint32_t>(roi.minimum.y);
+		const auto row_count = static_cast<uint32_t>(roi.height());
+		std::vector<T> rows(static_cast<size_t>(channel_width) * row_count);
+
+		if (m_LazySource)
+		{
+			const auto& source = m_LazySource.value();
+			if (Enum::bit_depth_from_t<T>() != source.header.m_Depth)
+			{
+				throw std::bad_variant_access();
+			}
+			// Photoshop stores empty channels as a bare compression marker, these decode to zeros
+			if (source.size > 0)
+			{
+				ByteStream stream(*source.document, source.offset, source.size);
+				DecompressDataRows<T>(stream, std::span<T>(rows), 0u, source.compression, source.header, source.width, source.height, source.size, row_start, row_count);
+			}
+		}
+		else
+		{
+			// Decompress only the chunks overlapping the requested scanlines and copy over the overlapping part
+			const auto& channel = std::get<compressed::channel<T>>(m_Channel);
+			const size_t first = static_cast<size_t>(channel_width) * row_start;
+			const size_t last = first + rows.size();
+			std::vector<T> chunk_buffer;
+			size_t chunk_begin = 0;
+			for (size_t chunk_idx = 0; chunk_idx < channel.num_chunks() && chunk_begin < last; ++chunk_idx)
+			{
+				const size_t chunk_end = chunk_begin + channel.chunk_elems(chunk_idx);
+				if (chunk_end > first)
+				{
+					chunk_buffer.resize(channel.chunk_elems(chunk_idx));
+					channel.get_chunk(std::span<T>(chunk_buffer), chunk_idx);
+
+					const size_t copy_begin = std::max(first, chunk_begin);
+					const size_t copy_end = std::min(last, chunk_end);
+					std::copy(
+						chunk_buffer.begin() + (copy_begin - chunk_begin),
+						chunk_buffer.begin() + (copy_end - chunk_begin),
+						rows.begin() + (copy_begin - first)
+					);
+				}
+				chunk_begin = chunk_end;
+			}
+		}
+
+		const auto roi_width = static_cast<size_t>(roi.width());
+		if (roi_width == channel_width)
+		{
+			return rows;
+		}
+		std::vector<T> cropped(roi_width * row_count);
+		for (size_t y = 0; y < row_count; ++y)
+		{
+			const auto row_begin = rows.begin() + y * channel_width + roi.minimum.x;
+			std::copy(row_begin, row_begin + roi_width, cropped.begin() + y * roi_width);
+		}
+		return cropped;
+	}
+
 
 private:
 
 	/// This does not indicate the compression method of the channel in memory 
 	/// but rather the compression method it writes the PhotoshopFile with
 	Enum::Compression m_PhotoshopCompression = Enum::Compression::ZipPrediction;
+	/// Per-channel override of the zip compression level, see zip_level()
+	std::optional<int> m_ZipLevel = std::nullopt;
 	/// Information about what channel this actually is
 	Enum::ChannelIDInfo m_ChannelID = { Enum::ChannelID::Red, 1 };
 	/// The underlying compressed channel. May only be uint8_t, uint16_t or float32_t.
 	compressed_channel_variant m_Channel = {};
+	/// If set, the channel has not been decoded yet and m_Channel is empty. The data is instead decoded from 
+	/// the source document on access.
+	std::optional<lazy_channel_source> m_LazySource = std::nullopt;
 
 	float m_XCoord = 0.0f;
 	float m_YCoord = 0.0f;
+
+	static size_t bytes_per_element(Enum::BitDepth depth)
+	{
+		if (depth == Enum::BitDepth::BD_16)
+		{
+			return sizeof(bpp16_t);
+		}
+		if (depth == Enum::BitDepth::BD_32)
+		{
+			return sizeof(bpp32_t);
+		}
+		return sizeof(bpp8_t);
+	}
+
+	/// Decode the lazy source into the given buffer which must hold exactly width * height elements.
+	template <typename T>
+		requires is_bitdepth<T>
+	void decode_lazy(std::span<T> buffer) const
+	{
+		PSAPI_PROFILE_FUNCTION();
+		const auto& source = m_LazySource.value();
+		if (Enum::bit_depth_from_t<T>() != source.header.m_Depth)
+		{
+			throw std::bad_variant_access();
+		}
+		// Photoshop stores empty channels as a bare compression marker, these decode to zeros
+		if (source.size == 0)
+		{
+			std::fill(buffer.begin(), buffer.end(), T{});
+			return;
+		}
+		ByteStream stream(*source.document, source.offset, source.size);
+		DecompressData<T>(stream, buffer, 0u, source.compression, source.header, source.width, source.height, source.size);
+	}
+
+	template <typename T>
+		requires is_bitdepth<T>
+	std::vector<T> decode_lazy() const
+	{
+		std::vector<T> data(this->element_size());
+		this->decode_lazy<T>(std::span<T>(data));
+		return data;
+	}
 };
 
 
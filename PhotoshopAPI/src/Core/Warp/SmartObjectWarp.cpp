@@ -1044,6 +1044,40 @@ namespace SmartObject
 	}
 
 
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	std::vector<std::vector<size_t>> Warp::bin_faces(
+		const Geometry::QuadMesh<double>& warp_mesh,
+		size_t min_y,
+		size_t max_y,
+		size_t rows_per_band,
+		size_t padding)
+	{
+		const size_t num_rows = max_y - min_y;
+		const size_t num_bands = (num_rows + rows_per_band - 1) / rows_per_band;
+		std::vector<std::vector<size_t>> band_faces(num_bands);
+
+		const auto& faces = warp_mesh.faces();
+		for (size_t face_index = 0; face_index < faces.size(); ++face_index)
+		{
+			const auto& face_bbox = faces[face_index].bbox();
+			const double first_row = std::floor(face_bbox.minimum.y) - static_cast<double>(min_y) - static_cast<double>(padding);
+			const double last_row = std::floor(face_bbox.maximum.y) - static_cast<double>(min_y) + static_cast<double>(padding);
+			if (last_row < 0 || first_row >= static_cast<double>(num_rows))
+			{
+				continue;
+			}
+			const size_t first_band = static_cast<size_t>(std::max(first_row, 0.0)) / rows_per_band;
+			const size_t last_band = std::min(static_cast<size_t>(last_row) / rows_per_band, num_bands - 1);
+			for (size_t band = first_band; band <= last_band; ++band)
+			{
+				band_faces[band].push_back(face_index);
+			}
+		}
+		return band_faces;
+	}
+
+
 	// ---------------------------------------------------------------------------------------------------------------------
 	// ---------------------------------------------------------------------------------------------------------------------
 	std::vector<Geometry::Point2D<double>> Warp::get_transformed_source_points() const
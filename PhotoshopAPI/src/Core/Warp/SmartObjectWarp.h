@@ -1,11 +1,14 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
+#include "Util/ScratchArena.h"
 
 #include "Core/Struct/DescriptorStructure.h"
 
 #include "Core/Render/Render.h"
 #include "Core/Render/ImageBuffer.h"
+#include "Core/Render/MipPyramid.h"
 #include "Core/Geometry/Point.h"
 #include "Core/Geometry/Mesh.h"
 #include "Core/Geometry/MeshOperations.h"
@@ -13,6 +16,7 @@
 
 
 #include <array>
+#include <span>
 
 
 PSAPI_NAMESPACE_BEGIN
@@ -82,6 +86,9 @@ namespace SmartObject
 		/// are from { 0 - 4000, 0 - 2000 } the `buffer` parameter should cover these.
 		/// If this isn't the case the function won't fail but the image will not contain the full warped picture.
 		/// 
+		/// If you wish to warp several channels with the same warp prefer the overload taking multiple buffers
+		/// as it only looks up the uv coordinates on the mesh once for all of them.
+		/// 
 		/// \tparam supersample_resolution The number of times to supersample mesh collisions within a given pixel along 
 		///								   one axis, the default value of 4 implies that we sample 4x4 = 16 times per pixel.
 		/// 
@@ -95,8 +102,46 @@ namespace SmartObject
 		/// 
 		template <typename T, size_t supersample_resolution = 4>
 		void apply(Render::ChannelBuffer<T> buffer, Render::ConstChannelBuffer<T> image, const Geometry::QuadMesh<double>& warp_mesh) const
+		{
+			apply<T, supersample_resolution>(std::span<Render::ChannelBuffer<T>>(&buffer, 1), std::span<const Render::ConstChannelBuffer<T>>(&image, 1), warp_mesh);
+		}
+
+		/// Apply the warp to multiple channels at once by warping each of the `images` into the `buffers` at the same index.
+		/// As the mesh (and therefore the uv coordinate of each pixel) is identical for all the channels we look up the 
+		/// uv coordinates once per row and then resample all the channels from them. The `buffers` must all share the 
+		/// same dimensions while the `images` may differ in size.
+		/// 
+		/// \tparam supersample_resolution The number of times to supersample mesh collisions within a given pixel along 
+		///								   one axis, the default value of 4 implies that we sample 4x4 = 16 times per pixel.
+		/// 
+		/// \param buffers		The buffers to render into, one per channel
+		/// 
+		/// \param images		The images to warp using the local warp struct, one per channel
+		/// 
+		/// \param warp_mesh	The mesh to apply the warp with. Can be gotten using `SmartObjectWarp::mesh()`
+		template <typename T, size_t supersample_resolution = 4>
+		void apply(std::span<Render::ChannelBuffer<T>> buffers, std::span<const Render::ConstChannelBuffer<T>> images, const Geometry::QuadMesh<double>& warp_mesh) const
 		{
 			PSAPI_PROFILE_FUNCTION();
+			static_assert(supersample_resolution * supersample_resolution <= std::numeric_limits<uint8_t>::max(), "The per-pixel sample counts are stored as uint8_t");
+
+			if (buffers.size() != images.size())
+			{
+				PSAPI_LOG_ERROR("SmartObjectWarp", "Unable to apply warp, got %zu buffers but %zu images", buffers.size(), images.size());
+			}
+			if (buffers.empty())
+			{
+				return;
+			}
+			const size_t width = buffers.front().width;
+			const size_t height = buffers.front().height;
+			for (const auto& buffer : buffers)
+			{
+				if (buffer.width != width || buffer.height != height)
+				{
+					PSAPI_LOG_ERROR("SmartObjectWarp", "Unable to apply warp, all the buffers must share the same dimensions");
+				}
+			}
 
 			// Limit the computation of the warp to the region of interest (ROI) of the mesh itself.
 			// that way we just skip any pixels that we know wont have any warp to it
@@ -104,78 +149,580 @@ namespace SmartObject
 			bbox.pad(static_cast<double>(supersample_resolution));
 
 			size_t min_y = static_cast<size_t>(std::max<double>(std::round(bbox.minimum.y), static_cast<double>(0)));
-			size_t max_y = static_cast<size_t>(std::min<double>(std::round(bbox.maximum.y), static_cast<double>(buffer.height - 1)));
+			size_t max_y = static_cast<size_t>(std::min<double>(std::round(bbox.maximum.y), static_cast<double>(height - 1)));
 			size_t min_x = static_cast<size_t>(std::max<double>(std::round(bbox.minimum.x), static_cast<double>(0)));
-			size_t max_x = static_cast<size_t>(std::min<double>(std::round(bbox.maximum.x), static_cast<double>(buffer.width - 1)));
+			size_t max_x = static_cast<size_t>(std::min<double>(std::round(bbox.maximum.x), static_cast<double>(width - 1)));
+			if (min_x > max_x)
+			{
+				return;
+			}
 
 			auto vertical_iter = std::views::iota(min_y, max_y);
-			std::for_each(std::execution::par_unseq, vertical_iter.begin(), vertical_iter.end(), [&](const size_t y)
+			Parallel::forEach(vertical_iter.begin(), vertical_iter.end(), [&](const size_t y)
 				{
 					constexpr double failure_condition = -1.0f;
 					constexpr T max_t = std::is_same_v<T, float32_t> ? static_cast<T>(1) : std::numeric_limits<T>::max();
 
 					constexpr size_t total_supersamples = supersample_resolution * supersample_resolution;
-
+					const size_t row_width = max_x - min_x + 1;
+
+					// The way this works is that on creation of the mesh from the bezier we actually
+					// initialize UV coordinates that are equally spaced, this is irrespective of the
+					// divisions the bezier was created with. 
+					// By then sampling the uv coordinate on the mesh for each pixel in the buffer 
+					// we essentially know what part of the original image belongs to the warped mesh 
+					// as we can treat the original (unwarped) image as a UV space from 0-1.
+					// 
+					// We first collect the uv coordinates of all the (sub-)pixels of this row that hit the mesh,
+					// storing them packed per pixel. Every channel is then resampled from this list which is where 
+					// the bulk of the work happens. We bilinearly sample the source images to avoid artifacts 
+					// from nearest neighbour sampling.
+					Scratch::Buffer uv_scratch = Scratch::acquire<Geometry::Point2D<double>>(row_width * total_supersamples);
+					Scratch::Buffer count_scratch = Scratch::acquire<uint8_t>(row_width);
+					std::span<Geometry::Point2D<double>> uvs = uv_scratch.as<Geometry::Point2D<double>>(row_width * total_supersamples);
+					std::span<uint8_t> counts = count_scratch.as<uint8_t>(row_width);
+
+					size_t num_uvs = 0;
 					for (size_t x = min_x; x <= max_x; ++x)
 					{
-						// The way this works is that on creation of the mesh from the bezier we actually
-						// initialize UV coordinates that are equally spaced, this is irrespective of the
-						// divisions the bezier was created with. 
-						// By then sampling the uv coordinate on the mesh for each pixel in the buffer 
-						// (the position Point2D we initialize below) we essentially know what part
-						// of the original image belongs to the warped mesh as we can treat the 
-						// original (unwarped) image as a UV space from 0-1.
-						// 
-						// We then bilinearly sample the source image to avoid artifacts from nearest 
-						// neighbour sampling.
-
-						// Simplify the code at compile time already if not supersampling
-						if constexpr (supersample_resolution == 1)
+						uint8_t count = 0;
+						for (size_t sy = 0; sy < supersample_resolution; ++sy)
 						{
-							auto position = Geometry::Point2D<double>(static_cast<double>(x), static_cast<double>(y));
-							auto uv = warp_mesh.uv_coordinate(position);
+							double subpixel_y = y + static_cast<double>(sy) / supersample_resolution;
 
-							// If the uv coordinate is outside of the image we dont bother with it.
-							// We can check against the exact -1.0f here as that is what we return
-							if (uv != failure_condition)
+							for (size_t sx = 0; sx < supersample_resolution; ++sx)
 							{
-								size_t idx = y * buffer.width + x;
-								buffer.buffer[idx] = image.template sample_bilinear_uv<double>(uv);
+								double subpixel_x = x + static_cast<double>(sx) / supersample_resolution;
+
+								auto uv = warp_mesh.uv_coordinate(Geometry::Point2D<double>(subpixel_x, subpixel_y));
+
+								// If the uv coordinate is outside of the image we dont bother with it.
+								// We can check against the exact -1.0f here as that is what we return
+								if (uv != failure_condition)
+								{
+									uvs[num_uvs++] = uv;
+									++count;
+								}
 							}
 						}
-						else
+						counts[x - min_x] = count;
+					}
+					if (num_uvs == 0)
+					{
+						return;
+					}
+
+					for (size_t channel = 0; channel < buffers.size(); ++channel)
+					{
+						auto& buffer = buffers[channel];
+						const auto& image = images[channel];
+
+						size_t uv_idx = 0;
+						for (size_t x = min_x; x <= max_x; ++x)
 						{
-							bool sampled = false;
-							float accumulated_color = 0;
+							const uint8_t count = counts[x - min_x];
+							if (count == 0)
+							{
+								continue;
+							}
+
+							size_t idx = y * buffer.width + x;
+							// Simplify the code at compile time already if not supersampling
+							if constexpr (supersample_resolution == 1)
+							{
+								buffer.buffer[idx] = image.template sample_bilinear_uv<double>(uvs[uv_idx++]);
+							}
+							else
+							{
+								float accumulated_color = 0;
+								for (uint8_t i = 0; i < count; ++i)
+								{
+									accumulated_color += image.template sample_bilinear_uv<double>(uvs[uv_idx++]);
+								}
+								buffer.buffer[idx] = static_cast<T>(std::clamp<double>(accumulated_color / total_supersamples, 0.0, static_cast<double>(max_t)));
+							}
+						}
+					}
+				});
+		}
+
+
+		/// Apply the warp to multiple channels at once like `apply()` but rather than looking up the face containing each
+		/// sample on the mesh, the faces are rasterized onto the samples directly. The output is in bands of rows, 
+		/// for each of which we rasterize the uv coordinates of all faces overlapping it after which all the channels
+		/// are resampled from the rasterized coordinates. This makes the cost proportional to the area covered by 
+		/// the mesh. The results match `apply()` up to floating point differences in the interpolated uv coordinates.
+		/// 
+		/// \tparam supersample_resolution The number of times to supersample mesh collisions within a given pixel along 
+		///								   one axis, the default value of 4 implies that we sample 4x4 = 16 times per pixel.
+		/// 
+		/// \param buffers		The buffers to render into, one per channel. These must all share the same dimensions
+		/// 
+		/// \param images		The images to warp using the local warp struct, one per channel
+		/// 
+		/// \param warp_mesh	The mesh to apply the warp with. Can be gotten using `SmartObjectWarp::mesh()`
+		template <typename T, size_t supersample_resolution = 4>
+		void apply_rasterized(std::span<Render::ChannelBuffer<T>> buffers, std::span<const Render::ConstChannelBuffer<T>> images, const Geometry::QuadMesh<double>& warp_mesh) const
+		{
+			PSAPI_PROFILE_FUNCTION();
+
+			if (buffers.size() != images.size())
+			{
+				PSAPI_LOG_ERROR("SmartObjectWarp", "Unable to apply warp, got %zu buffers but %zu images", buffers.size(), images.size());
+			}
+			if (buffers.empty())
+			{
+				return;
+			}
+			const size_t width = buffers.front().width;
+			const size_t height = buffers.front().height;
+			for (const auto& buffer : buffers)
+			{
+				if (buffer.width != width || buffer.height != height)
+				{
+					PSAPI_LOG_ERROR("SmartObjectWarp", "Unable to apply warp, all the buffers must share the same dimensions");
+				}
+			}
+
+			// Limit the computation of the warp to the region of interest (ROI) of the mesh itself, this is identical
+			// to the region apply() computes
+			auto bbox = warp_mesh.bbox();
+			bbox.pad(static_cast<double>(supersample_resolution));
+
+			size_t min_y = static_cast<size_t>(std::max<double>(std::round(bbox.minimum.y), static_cast<double>(0)));
+			size_t max_y = static_cast<size_t>(std::min<double>(std::round(bbox.maximum.y), static_cast<double>(height - 1)));
+			size_t min_x = static_cast<size_t>(std::max<double>(std::round(bbox.minimum.x), static_cast<double>(0)));
+			size_t max_x = static_cast<size_t>(std::min<double>(std::round(bbox.maximum.x), static_cast<double>(width - 1)));
+			if (min_x > max_x || min_y >= max_y)
+			{
+				return;
+			}
+
+			constexpr size_t total_supersamples = supersample_resolution * supersample_resolution;
+			const size_t row_width = max_x - min_x + 1;
+			const size_t grid_width = row_width * supersample_resolution;
+
+			// Size the bands such that each of them rasterizes roughly a million samples, keeping the per-thread
+			// scratch memory bounded while amortizing the setup of the faces overlapping multiple bands
+			constexpr size_t samples_per_band = size_t(1) << 20;
+			const size_t rows_per_band = std::clamp<size_t>(samples_per_band / (grid_width * supersample_resolution), 1, 64);
+			const size_t num_bands = (max_y - min_y + rows_per_band - 1) / rows_per_band;
+
+			const auto band_faces = bin_faces(warp_mesh, min_y, max_y, rows_per_band, 0);
+
+			auto band_iter = std::views::iota(size_t(0), num_bands);
+			Parallel::forEach(band_iter.begin(), band_iter.end(), [&](const size_t band)
+				{
+					constexpr T max_t = std::is_same_v<T, float32_t> ? static_cast<T>(1) : std::numeric_limits<T>::max();
+
+					if (band_faces[band].empty())
+					{
+						return;
+					}
+					const size_t band_min_y = min_y + band * rows_per_band;
+					const size_t band_max_y = std::min(band_min_y + rows_per_band, max_y);
+					const size_t grid_height = (band_max_y - band_min_y) * supersample_resolution;
+
+					// Rasterize the uv coordinates of all the (sub-)pixels in this band
+					Scratch::Buffer uv_scratch = Scratch::acquire<Geometry::Point2D<double>>(grid_width * grid_height);
+					std::span<Geometry::Point2D<double>> uvs = uv_scratch.as<Geometry::Point2D<double>>(grid_width * grid_height);
+					std::fill(uvs.begin(), uvs.end(), Geometry::Point2D<double>(-1.0, -1.0));
+					warp_mesh.rasterize_uv(
+						Geometry::Point2D<double>(static_cast<double>(min_x), static_cast<double>(band_min_y)),
+						1.0 / supersample_resolution,
+						grid_width,
+						grid_height,
+						band_faces[band],
+						uvs);
+
+					// Resample every channel from the rasterized coordinates, accumulating the samples in the same order
+					// as apply() does
+					for (size_t channel = 0; channel < buffers.size(); ++channel)
+					{
+						auto& buffer = buffers[channel];
+						const auto& image = images[channel];
 
-							// Perform the supersampling steps
-							for (size_t sy = 0; sy < supersample_resolution; ++sy)
+						for (size_t y = band_min_y; y < band_max_y; ++y)
+						{
+							const size_t grid_y = (y - band_min_y) * supersample_resolution;
+							for (size_t x = min_x; x <= max_x; ++x)
 							{
-								double subpixel_y = y + static_cast<double>(sy) / supersample_resolution;
+								const size_t grid_x = (x - min_x) * supersample_resolution;
+
+								bool sampled = false;
+								float accumulated_color = 0;
+								for (size_t sy = 0; sy < supersample_resolution; ++sy)
+								{
+									const auto* row = uvs.data() + (grid_y + sy) * grid_width + grid_x;
+									for (size_t sx = 0; sx < supersample_resolution; ++sx)
+									{
+										if (row[sx].x != -1.0 || row[sx].y != -1.0)
+										{
+											sampled = true;
+											accumulated_color += image.template sample_bilinear_uv<double>(row[sx]);
+										}
+									}
+								}
+								if (!sampled)
+								{
+									continue;
+								}
+
+								size_t idx = y * buffer.width + x;
+								if constexpr (supersample_resolution == 1)
+								{
+									buffer.buffer[idx] = static_cast<T>(accumulated_color);
+								}
+								else
+								{
+									buffer.buffer[idx] = static_cast<T>(std::clamp<double>(accumulated_color / total_supersamples, 0.0, static_cast<double>(max_t)));
+								}
+							}
+						}
+					}
+				});
+		}
+
+
+		/// Apply the warp to multiple channels at once like `apply_rasterized()` but supersampling adaptively. Rather than
+		/// always taking supersample_resolution^2 samples per pixel we first rasterize a single uv coordinate per pixel 
+		/// from which we detect the pixels that actually need the additional samples:
+		/// 
+		/// - Pixels along the silhouette of the mesh (where the coverage of the pixel and its neighbours differs) look
+		///   up all of their samples on the mesh just like `apply()` does, giving the same anti-aliased edges.
+		/// - Pixels whose footprint on the source image (estimated from the uv jacobian) spans more than a pixel would
+		///   alias if only sampled once. These take all the samples, extrapolating their uv coordinates from the jacobian.
+		/// - Pixels within a pixel of the source image's border where the bilinear samples fade out are supersampled 
+		///   the same way.
+		/// - All other pixels are sampled once at the center of their samples. As their footprint is within a pixel
+		///   of the source image the bilinear interpolation already covers all the pixels contributing to them.
+		/// 
+		/// For warps magnifying or keeping the scale of the image this reduces the work to roughly a single sample per
+		/// pixel while minifying warps still get fully supersampled (see the overload taking mip pyramids for those).
+		/// The output is not bit-identical to `apply()` as singly sampled pixels are not box filtered.
+		/// 
+		/// \tparam supersample_resolution The number of times to supersample the pixels needing it along one axis, the 
+		///								   default value of 4 implies that we sample these 4x4 = 16 times.
+		/// 
+		/// \param buffers		The buffers to render into, one per channel. These must all share the same dimensions
+		/// 
+		/// \param images		The images to warp using the local warp struct, one per channel
+		/// 
+		/// \param warp_mesh	The mesh to apply the warp with. Can be gotten using `SmartObjectWarp::mesh()`
+		template <typename T, size_t supersample_resolution = 4>
+		void apply_adaptive(std::span<Render::ChannelBuffer<T>> buffers, std::span<const Render::ConstChannelBuffer<T>> images, const Geometry::QuadMesh<double>& warp_mesh) const
+		{
+			apply_adaptive<T, supersample_resolution>(buffers, images, std::span<const Render::MipPyramid<T>* const>(), warp_mesh);
+		}
+
+		/// Apply the warp adaptively like the overload above while sampling the parts of the images that are scaled 
+		/// down from their mip pyramids. Rather than supersampling these on the full resolution image (which still
+		/// aliases once the image is scaled down by more than the supersample resolution) we pick the level matching
+		/// the footprint of the pixel from the uv jacobian and interpolate trilinearly between the two closest levels.
+		/// 
+		/// This changes the sampling of the pixels as follows:
+		/// 
+		/// - Pixels in the interior of the mesh take a single sample, at the level matching their footprint.
+		/// - Pixels along the silhouette of the mesh or the border of the image are still supersampled, each sample 
+		///   being taken at the level matching the footprint of the sample rather than that of the whole pixel.
+		/// 
+		/// \tparam supersample_resolution The number of times to supersample the pixels needing it along one axis, the 
+		///								   default value of 4 implies that we sample these 4x4 = 16 times.
+		/// 
+		/// \param buffers		The buffers to render into, one per channel. These must all share the same dimensions
+		/// 
+		/// \param images		The images to warp using the local warp struct, one per channel
+		/// 
+		/// \param pyramids	The mip pyramids of the `images`, one per channel. A pyramid may be a nullptr in which case
+		///						the full resolution image is sampled for that channel. If no pyramids are passed at all 
+		///						this is identical to the overload above.
+		/// 
+		/// \param warp_mesh	The mesh to apply the warp with. Can be gotten using `SmartObjectWarp::mesh()`
+		template <typename T, size_t supersample_resolution = 4>
+		void apply_adaptive(
+			std::span<Render::ChannelBuffer<T>> buffers, 
+			std::span<const Render::ConstChannelBuffer<T>> images, 
+			std::span<const Render::MipPyramid<T>* const> pyramids, 
+			const Geometry::QuadMesh<double>& warp_mesh) const
+		{
+			PSAPI_PROFILE_FUNCTION();
+			static_assert(supersample_resolution * supersample_resolution < std::numeric_limits<uint8_t>::max(), "The per-pixel sample counts are stored as uint8_t");
+
+			if (buffers.size() != images.size())
+			{
+				PSAPI_LOG_ERROR("SmartObjectWarp", "Unable to apply warp, got %zu buffers but %zu images", buffers.size(), images.size());
+			}
+			if (!pyramids.empty())
+			{
+				if (pyramids.size() != images.size())
+				{
+					PSAPI_LOG_ERROR("SmartObjectWarp", "Unable to apply warp, got %zu mip pyramids but %zu images", pyramids.size(), images.size());
+				}
+				for (size_t i = 0; i < pyramids.size(); ++i)
+				{
+					if (pyramids[i] && !pyramids[i]->empty() && (pyramids[i]->width() != images[i].width || pyramids[i]->height() != images[i].height))
+					{
+						PSAPI_LOG_ERROR("SmartObjectWarp", "Unable to apply warp, the mip pyramid at index %zu was not built from the image at the same index", i);
+					}
+				}
+			}
+			if (buffers.empty())
+			{
+				return;
+			}
+			const size_t width = buffers.front().width;
+			const size_t height = buffers.front().height;
+			for (const auto& buffer : buffers)
+			{
+				if (buffer.width != width || buffer.height != height)
+				{
+					PSAPI_LOG_ERROR("SmartObjectWarp", "Unable to apply warp, all the buffers must share the same dimensions");
+				}
+			}
+
+			// Limit the computation of the warp to the region of interest (ROI) of the mesh itself, this is identical
+			// to the region apply() computes
+			auto bbox = warp_mesh.bbox();
+			bbox.pad(static_cast<double>(supersample_resolution));
+
+			size_t min_y = static_cast<size_t>(std::max<double>(std::round(bbox.minimum.y), static_cast<double>(0)));
+			size_t max_y = static_cast<size_t>(std::min<double>(std::round(bbox.maximum.y), static_cast<double>(height - 1)));
+			size_t min_x = static_cast<size_t>(std::max<double>(std::round(bbox.minimum.x), static_cast<double>(0)));
+			size_t max_x = static_cast<size_t>(std::min<double>(std::round(bbox.maximum.x), static_cast<double>(width - 1)));
+			if (min_x > max_x || min_y >= max_y)
+			{
+				return;
+			}
+
+			constexpr size_t total_supersamples = supersample_resolution * supersample_resolution;
+			// Marks a pixel as being sampled once rather than holding the number of its samples
+			constexpr uint8_t single_sample = std::numeric_limits<uint8_t>::max();
+			// The offset from the pixel's origin to the center of its samples, this is where we take the single sample
+			constexpr double sample_center = static_cast<double>(supersample_resolution - 1) / (2 * supersample_resolution);
+
+			const bool use_mips = !pyramids.empty();
+			const size_t row_width = max_x - min_x + 1;
+			// The grid holds one sample per pixel with a one pixel border on all sides for the neighbours
+			const size_t grid_width = row_width + 2;
+
+			// The footprint is measured in pixels of the largest source image such that no channel aliases
+			double footprint_scale_x = 0.0;
+			double footprint_scale_y = 0.0;
+			for (const auto& image : images)
+			{
+				footprint_scale_x = std::max(footprint_scale_x, static_cast<double>(image.width));
+				footprint_scale_y = std::max(footprint_scale_y, static_cast<double>(image.height));
+			}
+
+			// Size the bands the same way apply_rasterized() does, keeping the memory for the samples of the pixels
+			// bounded in the case of every pixel being supersampled
+			constexpr size_t samples_per_band = size_t(1) << 20;
+			const size_t rows_per_band = std::clamp<size_t>(samples_per_band / (row_width * total_supersamples), 1, 64);
+			const size_t num_bands = (max_y - min_y + rows_per_band - 1) / rows_per_band;
+			const auto band_faces = bin_faces(warp_mesh, min_y, max_y, rows_per_band, 1);
+
+			auto band_iter = std::views::iota(size_t(0), num_bands);
+			Parallel::forEach(band_iter.begin(), band_iter.end(), [&](const size_t band)
+				{
+					constexpr T max_t = std::is_same_v<T, float32_t> ? static_cast<T>(1) : std::numeric_limits<T>::max();
 
-								for (size_t sx = 0; sx < supersample_resolution; ++sx)
+					if (band_faces[band].empty())
+					{
+						return;
+					}
+					const size_t band_min_y = min_y + band * rows_per_band;
+					const size_t band_max_y = std::min(band_min_y + rows_per_band, max_y);
+					const size_t band_height = band_max_y - band_min_y;
+					const size_t grid_height = band_height + 2;
+
+					// Rasterize the uv coordinates at the center of each pixel's samples, including the border
+					Scratch::Buffer grid_scratch = Scratch::acquire<Geometry::Point2D<double>>(grid_width * grid_height);
+					std::span<Geometry::Point2D<double>> grid = grid_scratch.as<Geometry::Point2D<double>>(grid_width * grid_height);
+					std::fill(grid.begin(), grid.end(), Geometry::Point2D<double>(-1.0, -1.0));
+					warp_mesh.rasterize_uv(
+						Geometry::Point2D<double>(static_cast<double>(min_x) - 1.0 + sample_center, static_cast<double>(band_min_y) - 1.0 + sample_center),
+						1.0,
+						grid_width,
+						grid_height,
+						band_faces[band],
+						grid);
+
+					// Decide on the samples of every pixel and collect them packed per pixel like apply() does
+					Scratch::Buffer uv_scratch = Scratch::acquire<Geometry::Point2D<double>>(row_width * band_height * total_supersamples);
+					Scratch::Buffer count_scratch = Scratch::acquire<uint8_t>(row_width * band_height);
+					std::span<Geometry::Point2D<double>> uvs = uv_scratch.as<Geometry::Point2D<double>>(row_width * band_height * total_supersamples);
+					std::span<uint8_t> counts = count_scratch.as<uint8_t>(row_width * band_height);
+					// The level of detail to sample each pixel's samples at, only used when sampling mip pyramids
+					Scratch::Buffer lod_scratch = Scratch::acquire<float>(row_width * band_height);
+					std::span<float> lods = lod_scratch.as<float>(row_width * band_height);
+
+					auto is_covered = [](Geometry::Point2D<double> uv) { return uv.x != -1.0 || uv.y != -1.0; };
+
+					size_t num_uvs = 0;
+					for (size_t y = band_min_y; y < band_max_y; ++y)
+					{
+						const size_t grid_y = y - band_min_y + 1;
+						for (size_t x = min_x; x <= max_x; ++x)
+						{
+							const size_t grid_x = x - min_x + 1;
+							const auto center = grid[grid_y * grid_width + grid_x];
+							uint8_t& count = counts[(y - band_min_y) * row_width + (x - min_x)];
+							float& lod = lods[(y - band_min_y) * row_width + (x - min_x)];
+							lod = 0.0f;
+
+							size_t num_covered = 0;
+							for (size_t ny = grid_y - 1; ny <= grid_y + 1; ++ny)
+							{
+								for (size_t nx = grid_x - 1; nx <= grid_x + 1; ++nx)
 								{
-									double subpixel_x = x + static_cast<double>(sx) / supersample_resolution;
+									num_covered += is_covered(grid[ny * grid_width + nx]);
+								}
+							}
 
-									auto position = Geometry::Point2D<double>(subpixel_x, subpixel_y);
-									auto uv = warp_mesh.uv_coordinate(position);
+							if (num_covered == 0)
+							{
+								count = 0;
+							}
+							else if (num_covered < 9)
+							{
+								// The silhouette of the mesh passes through this pixel, look up the samples on the mesh
+								std::array<Geometry::Point2D<double>, total_supersamples> samples;
+								count = 0;
+								for (size_t sy = 0; sy < supersample_resolution; ++sy)
+								{
+									double subpixel_y = y + static_cast<double>(sy) / supersample_resolution;
+									for (size_t sx = 0; sx < supersample_resolution; ++sx)
+									{
+										double subpixel_x = x + static_cast<double>(sx) / supersample_resolution;
+										auto uv = warp_mesh.uv_coordinate(Geometry::Point2D<double>(subpixel_x, subpixel_y));
+										samples[sy * supersample_resolution + sx] = uv;
+										if (is_covered(uv))
+										{
+											uvs[num_uvs++] = uv;
+											++count;
+										}
+									}
+								}
 
-									// If the uv coordinate is outside of the image we dont bother with it.
-									// We can check against the exact -1.0f here as that is what we return
-									if (uv != failure_condition)
+								// As the neighbours are not all covered we estimate the footprint of the samples from 
+								// the distance between adjacent samples instead
+								if (use_mips)
+								{
+									double footprint = 0.0;
+									for (size_t sy = 0; sy < supersample_resolution; ++sy)
+									{
+										for (size_t sx = 0; sx < supersample_resolution; ++sx)
+										{
+											const auto& sample = samples[sy * supersample_resolution + sx];
+											if (!is_covered(sample))
+											{
+												continue;
+											}
+											if (sx + 1 < supersample_resolution && is_covered(samples[sy * supersample_resolution + sx + 1]))
+											{
+												const auto delta = samples[sy * supersample_resolution + sx + 1] - sample;
+												footprint = std::max(footprint, std::hypot(delta.x * footprint_scale_x, delta.y * footprint_scale_y));
+											}
+											if (sy + 1 < supersample_resolution && is_covered(samples[(sy + 1) * supersample_resolution + sx]))
+											{
+												const auto delta = samples[(sy + 1) * supersample_resolution + sx] - sample;
+												footprint = std::max(footprint, std::hypot(delta.x * footprint_scale_x, delta.y * footprint_scale_y));
+											}
+										}
+									}
+									lod = footprint > 1.0 ? static_cast<float>(std::log2(footprint)) : 0.0f;
+								}
+							}
+							else
+							{
+								// Estimate the uv jacobian from the neighbouring pixels
+								const auto du = (grid[grid_y * grid_width + grid_x + 1] - grid[grid_y * grid_width + grid_x - 1]) / 2.0;
+								const auto dv = (grid[(grid_y + 1) * grid_width + grid_x] - grid[(grid_y - 1) * grid_width + grid_x]) / 2.0;
+								const double footprint_x = std::hypot(du.x * footprint_scale_x, du.y * footprint_scale_y);
+								const double footprint_y = std::hypot(dv.x * footprint_scale_x, dv.y * footprint_scale_y);
+
+								// Within a pixel of the source image's border the bilinear samples fade out, this edge
+								// needs to be supersampled just like the silhouette of the mesh
+								const bool near_border = 
+									center.x * footprint_scale_x < 1.0 || center.x * footprint_scale_x > footprint_scale_x - 1.0 ||
+									center.y * footprint_scale_y < 1.0 || center.y * footprint_scale_y > footprint_scale_y - 1.0;
+
+								const double footprint = std::max(footprint_x, footprint_y);
+								if (footprint <= 1.0 && !near_border)
+								{
+									uvs[num_uvs++] = center;
+									count = single_sample;
+								}
+								else if (use_mips && !near_border)
+								{
+									// Sample the level whose pixels match the footprint of the whole pixel
+									uvs[num_uvs++] = center;
+									count = single_sample;
+									lod = static_cast<float>(std::log2(footprint));
+								}
+								else
+								{
+									if (use_mips && footprint > supersample_resolution)
+									{
+										lod = static_cast<float>(std::log2(footprint / supersample_resolution));
+									}
+									for (size_t sy = 0; sy < supersample_resolution; ++sy)
 									{
-										sampled = true;
-										accumulated_color += image.template sample_bilinear_uv<double>(uv);
+										const double offset_y = static_cast<double>(sy) / supersample_resolution - sample_center;
+										for (size_t sx = 0; sx < supersample_resolution; ++sx)
+										{
+											const double offset_x = static_cast<double>(sx) / supersample_resolution - sample_center;
+											uvs[num_uvs++] = center + du * offset_x + dv * offset_y;
+										}
 									}
+									count = static_cast<uint8_t>(total_supersamples);
 								}
 							}
+						}
+					}
+					if (num_uvs == 0)
+					{
+						return;
+					}
+
+					for (size_t channel = 0; channel < buffers.size(); ++channel)
+					{
+						auto& buffer = buffers[channel];
+						const auto& image = images[channel];
+						const Render::MipPyramid<T>* pyramid = use_mips ? pyramids[channel] : nullptr;
+						auto sample = [&](Geometry::Point2D<double> uv, float lod)
+							{
+								if (pyramid)
+								{
+									return pyramid->template sample_trilinear_uv<double>(image, uv, lod);
+								}
+								return image.template sample_bilinear_uv<double>(uv);
+							};
 
-							if (sampled)
+						size_t uv_idx = 0;
+						for (size_t y = band_min_y; y < band_max_y; ++y)
+						{
+							for (size_t x = min_x; x <= max_x; ++x)
 							{
-								T final_value = static_cast<T>(std::clamp<double>(accumulated_color / total_supersamples, 0.0, static_cast<double>(max_t)));
+								const uint8_t count = counts[(y - band_min_y) * row_width + (x - min_x)];
+								if (count == 0)
+								{
+									continue;
+								}
+								const float lod = lods[(y - band_min_y) * row_width + (x - min_x)];
 
 								size_t idx = y * buffer.width + x;
-								buffer.buffer[idx] = final_value;
+								if (count == single_sample)
+								{
+									buffer.buffer[idx] = sample(uvs[uv_idx++], lod);
+									continue;
+								}
+								float accumulated_color = 0;
+								for (uint8_t i = 0; i < count; ++i)
+								{
+									accumulated_color += sample(uvs[uv_idx++], lod);
+								}
+								buffer.buffer[idx] = static_cast<T>(std::clamp<double>(accumulated_color / total_supersamples, 0.0, static_cast<double>(max_t)));
 							}
 						}
 					}
@@ -202,7 +749,7 @@ namespace SmartObject
 		{
 			auto warp_surface = surface();
 			auto warp_mesh = warp_surface.mesh(buffer.width / resolution, buffer.height / resolution);
-			apply<T, supersample_resolution>(buffer, image, warp_mesh, resolution);
+			apply<T, supersample_resolution>(buffer, image, warp_mesh);
 		}
 
 		/// Generates a default warp, this should be the main entry point if you wish to author a custom warp.
@@ -541,6 +1088,15 @@ namespace SmartObject
 		/// Return the warp points with the transformations described by m_AffineTransform and m_NonAffineTransform applied to them
 		std::vector<Geometry::Point2D<double>> get_transformed_source_points() const;
 
+		/// Bin the faces of the mesh into bands of `rows_per_band` rows covering the rows [min_y, max_y) by the rows their
+		/// bounding box overlaps. Each face is additionally added to the bands within `padding` rows of it.
+		static std::vector<std::vector<size_t>> bin_faces(
+			const Geometry::QuadMesh<double>& warp_mesh,
+			size_t min_y,
+			size_t max_y,
+			size_t rows_per_band,
+			size_t padding);
+
 		/// Deserialize the common components between the quilt and normal warp
 		static void _deserialize_common(Warp& warpStruct, const Descriptors::Descriptor* warpDescriptor);
 
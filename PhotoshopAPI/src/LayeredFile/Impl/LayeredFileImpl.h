@@ -15,6 +15,8 @@
 #include "LayeredFile/fwd.h"
 
 #include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 PSAPI_NAMESPACE_BEGIN
 
@@ -38,6 +40,38 @@ namespace _Impl
 		return data;
 	}
 
+	/// Get the number of color channels (excluding any alpha channels) the given color mode stores
+	inline uint16_t num_color_channels(Enum::ColorMode colormode)
+	{
+		if (colormode == Enum::ColorMode::RGB || colormode == Enum::ColorMode::Lab)
+		{
+			return 3u;
+		}
+		else if (colormode == Enum::ColorMode::CMYK)
+		{
+			return 4u;
+		}
+		return 1u;
+	}
+
+	/// Decode the merged composite held by the ImageData section into a map of channel index to data. Color channels
+	/// are mapped to their index within the color mode, the first channel following these is treated as the transparency
+	/// and mapped to -1 while any further alpha channels keep their position as index.
+	template <typename T>
+	std::unordered_map<int, std::vector<T>> decode_composite(const ImageData& image_data, Enum::ColorMode colormode)
+	{
+		std::unordered_map<int, std::vector<T>> composite;
+		auto channels = image_data.decode<T>();
+		const auto num_color = num_color_channels(colormode);
+		for (size_t i = 0; i < channels.size(); ++i)
+		{
+			const int index = i == num_color ? -1 : static_cast<int>(i);
+			composite[index] = std::move(channels[i]);
+		}
+		return composite;
+	}
+
+
 	/// Identify the type of layer the current layer record represents and return a layerVariant object (std::variant<ImageLayer, GroupLayer ...>)
 	/// initialized with the given layer record and corresponding channel image data.
 	/// This function was heavily inspired by the psd-tools library as they have the most coherent parsing of this information
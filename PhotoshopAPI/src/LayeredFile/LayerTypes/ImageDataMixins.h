@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 
 #include "MaskDataMixin.h"
 
@@ -331,7 +332,7 @@ protected:
 
 		std::mutex img_data_mutex;
 
-		std::for_each(std::execution::par_unseq, keys.begin(), keys.end(), [&](auto key) 
+		Parallel::forEach(keys.begin(), keys.end(), [&](auto key) 
 			{
 				auto vec = std::vector<T>(data_size);
 				std::lock_guard<std::mutex> lock(img_data_mutex);
@@ -1,11 +1,13 @@
 #pragma once
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 #include "Util/Enum.h"
 #include "Layer.h"
 #include "ImageDataMixins.h"
 
 #include "Core/Struct/ImageChannel.h"
+#include "Core/Geometry/BoundingBox.h"
 #include "PhotoshopFile/LayerAndMaskInformation.h"
 #include "LayeredFile/concepts.h"
 
@@ -57,13 +59,46 @@ public:
 		return WritableImageDataMixin<T>::m_ImageData.size();
 	}
 
-	void set_write_compression(Enum::Compression _compcode) override
+	void set_write_compression(Enum::Compression _compcode, std::optional<int> zip_level = std::nullopt) override
 	{
 		for (const auto& [_, channel_ptr] : WritableImageDataMixin<T>::m_ImageData)
 		{
 			channel_ptr->compression_codec(_compcode);
+			channel_ptr->zip_level(zip_level);
 		}
-		Layer<T>::set_mask_compression(_compcode);
+		Layer<T>::set_mask_compression(_compcode, zip_level);
+	}
+
+	using WritableImageDataMixin<T>::get_channel;
+
+	/// Get only the given region of the channel held at the given index
+	///
+	/// Only the data covering the region is decoded, for channels which were lazily read this means only the
+	/// scanlines intersecting the region are decoded from the document making this considerably cheaper than
+	/// calling `get_channel()` and cropping for small regions on large layers.
+	///
+	/// \param _id The channel to retrieve, index -2 retrieves the mask channel
+	/// \param roi The region in layer-local pixel coordinates (mask-local for the mask channel), the minimum is
+	///			   inclusive and the maximum exclusive.
+	///
+	/// \throws std::invalid_argument if the channel does not exist or the region is empty or exceeds the channel bounds
+	///
+	/// \return The `roi.width()` * `roi.height()` pixels of the region in scanline order
+	std::vector<T> get_channel(int _id, Geometry::BoundingBox<int> roi)
+	{
+		return evaluate_channel_region(_id, roi);
+	}
+
+	/// Get only the given region of the channel, see `get_channel(int, Geometry::BoundingBox<int>)`
+	std::vector<T> get_channel(Enum::ChannelID _id, Geometry::BoundingBox<int> roi)
+	{
+		return evaluate_channel_region(_id, roi);
+	}
+
+	/// Get only the given region of the channel, see `get_channel(int, Geometry::BoundingBox<int>)`
+	std::vector<T> get_channel(Enum::ChannelIDInfo _id, Geometry::BoundingBox<int> roi)
+	{
+		return evaluate_channel_region(_id, roi);
 	}
 
 	/// Generate an ImageLayer instance ready to be used in a LayeredFile document. 
@@ -427,7 +462,7 @@ protected:
 
 		// Allocate image data and then fill it by decompressing in parallel
 		data_type data = WritableImageDataMixin<T>::parallel_alloc_image_data(_channel_indices, channel_size);
-		std::for_each(std::execution::par_unseq, data.begin(), data.end(), [&](auto& pair)
+		Parallel::forEach(data.begin(), data.end(), [&](auto& pair)
 			{
 				auto& [key, channel_buffer] = pair;
 				auto idinfo = Enum::toChannelIDInfo(key, Layer<T>::m_ColorMode);
@@ -459,6 +494,22 @@ protected:
 		return WritableImageDataMixin<T>::m_ImageData.at(idinfo)->template get_data<T>();
 	}
 
+	std::vector<T> evaluate_channel_region(std::variant<int, Enum::ChannelID, Enum::ChannelIDInfo> _id, const Geometry::BoundingBox<int>& roi)
+	{
+		auto idinfo = WritableImageDataMixin<T>::idinfo_from_variant(_id, Layer<T>::m_ColorMode);
+		// short-circuit masks
+		if (idinfo == Layer<T>::s_mask_index && Layer<T>::has_mask())
+		{
+			return Layer<T>::get_mask(roi);
+		}
+
+		if (!WritableImageDataMixin<T>::m_ImageData.contains(idinfo))
+		{
+			throw std::invalid_argument(fmt::format("ImageLayer '{}': Invalid channel '{}' accessed while calling get_channel()", Layer<T>::m_LayerName, Enum::channelIDToString(idinfo.id)));
+		}
+		return WritableImageDataMixin<T>::m_ImageData.at(idinfo)->template get_data<T>(roi);
+	}
+
 	void impl_set_mask(const std::span<const T> data, int32_t width, int32_t height, float center_x, float center_y) override
 	{
 		Layer<T>::set_mask(data, width, height);
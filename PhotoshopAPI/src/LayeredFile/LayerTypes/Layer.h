@@ -200,9 +200,13 @@ struct Layer : public MaskMixin<T>
 	/// Setting this therefore has a near-zero runtime cost.
 	/// 
 	/// \param _compcode The new compression setting.
-	virtual void set_write_compression(Enum::Compression _compcode)
+	/// \param zip_level The zip compression level (0-12) to write with if the codec is Zip or ZipPrediction. This 
+	///		overrides the level passed to `LayeredFile::write()`. If not provided the level of the file is used.
+	/// 
+	/// \throws std::invalid_argument if the zip level is outside of the supported range
+	virtual void set_write_compression(Enum::Compression _compcode, std::optional<int> zip_level = std::nullopt)
 	{
-		MaskMixin<T>::set_mask_compression(_compcode);
+		MaskMixin<T>::set_mask_compression(_compcode, zip_level);
 	}
 
 	Layer() : m_IsVisible(true), m_Opacity(255) {};
@@ -421,7 +425,7 @@ protected:
 	/// 0 - 255 despite the appearance being 0-100 in photoshop
 	uint8_t m_Opacity{};
 	/// 0 - 255 despite the appearance being 0-100 in photoshop
-	uint8_t m_Fill{};
+	uint8_t m_Fill = 255u;
 
 	uint32_t m_Width{};
 
@@ -95,6 +95,18 @@ struct MaskMixin
 		PSAPI_LOG_WARNING("Mask", "No mask channel exists on the layer, get_mask() will return an empty channel");
 	}
 
+	/// Retrieves only the given region (in mask-local coordinates) of the mask channel data, see 
+	/// `ImageLayer::get_channel(int, Geometry::BoundingBox<int>)`. Returns an empty vector if there is no mask.
+	std::vector<T> get_mask(const Geometry::BoundingBox<int>& roi) const
+	{
+		if (this->has_mask())
+		{
+			return m_MaskData.value()->template get_data<T>(roi);
+		}
+		PSAPI_LOG_WARNING("Mask", "No mask channel exists on the layer, get_mask() will return an empty channel");
+		return std::vector<T>();
+	}
+
 	/// \brief Extract the compressed mask channel used internally.
 	/// 
 	/// \throws std::runtime_error if no mask is present (as checked by ``has_mask``).
@@ -259,11 +271,16 @@ struct MaskMixin
 	/// If `has_mask()` evaluates to false this is a no-op.
 	/// 
 	/// \param _compcode The compression codec to apply on-write.
-	void set_mask_compression(Enum::Compression _compcode) noexcept
+	/// \param zip_level The zip compression level (0-12) to apply on-write if the codec is Zip or ZipPrediction. If not 
+	///		provided the level the file is written with is used.
+	/// 
+	/// \throws std::invalid_argument if the zip level is outside of the supported range
+	void set_mask_compression(Enum::Compression _compcode, std::optional<int> zip_level = std::nullopt)
 	{
 		if (this->has_mask())
 		{
 			this->m_MaskData.value()->compression_codec(_compcode);
+			this->m_MaskData.value()->zip_level(zip_level);
 		}
 	}
 
@@ -115,13 +115,14 @@ struct SmartObjectLayer final: public Layer<T>, public ImageDataMixin<T>
 		return ImageDataMixin<T>::m_ImageData.size();
 	}
 
-	void set_write_compression(Enum::Compression _compcode) override
+	void set_write_compression(Enum::Compression _compcode, std::optional<int> zip_level = std::nullopt) override
 	{
 		for (const auto& [_, channel_ptr] : ImageDataMixin<T>::m_ImageData)
 		{
 			channel_ptr->compression_codec(_compcode);
+			channel_ptr->zip_level(zip_level);
 		}
-		Layer<T>::set_mask_compression(_compcode);
+		Layer<T>::set_mask_compression(_compcode, zip_level);
 	}
 
 	SmartObjectLayer() = default;
@@ -220,6 +221,25 @@ struct SmartObjectLayer final: public Layer<T>, public ImageDataMixin<T>
 	}
 
 
+	/// Whether the warp is supersampled adaptively when evaluating the image data, see `adaptive_supersampling(bool)`
+	bool adaptive_supersampling() const noexcept { return m_AdaptiveSupersampling; }
+
+	/// Set whether to supersample the warp adaptively when evaluating the image data. Rather than taking 4x4 samples
+	/// for every pixel only the edges of the smart object get supersampled while the parts of it which are scaled 
+	/// down are sampled from mip pyramids of the original image data (see `SmartObject::Warp::apply_adaptive()`).
+	/// This is considerably faster and avoids aliasing on heavily scaled down smart objects, it is intended for e.g. 
+	/// interactive previews or thumbnails. The mip pyramids are cached on the linked layer and therefore shared 
+	/// between all smart objects linking the same file. Defaults to `false`.
+	void adaptive_supersampling(bool enabled)
+	{
+		if (enabled != m_AdaptiveSupersampling)
+		{
+			m_AdaptiveSupersampling = enabled;
+			invalidate_cache();
+		}
+	}
+
+
 	/// Replace the smart object with the given path keeping transformations as well 
 	/// as warp in place.
 	/// 
@@ -633,9 +653,10 @@ struct SmartObjectLayer final: public Layer<T>, public ImageDataMixin<T>
 	// Override the to_photoshop method to specialize for smart objects.
 	std::tuple<LayerRecord, ChannelImageData> to_photoshop() override
 	{
-		// Evaluate transforms and image data to be sure these are up to date
+		// Evaluate transforms and image data to be sure these are up to date. We only need the warped channels to be 
+		// stored on the layer so rather than retrieving all of them through evaluate_image_data() we warp them directly
 		evaluate_transforms();
-		evaluate_image_data();
+		this->evaluate_warp(this->warped_channel_indices());
 
 		PascalString lrName = Layer<T>::generate_name();
 		ChannelExtents extents = generate_extents(ChannelCoordinates(Layer<T>::m_Width, Layer<T>::m_Height, Layer<T>::m_CenterX, Layer<T>::m_CenterY));
@@ -791,6 +812,9 @@ private:
 	/// Resolution in DPI
 	double m_Resolution = 72.0f;
 
+	/// Whether to supersample the warp adaptively rather than with a fixed number of samples per pixel
+	bool m_AdaptiveSupersampling = false;
+
 	/// Internal values for roundtripping:
 
 	/// Hash of the layer itself, doesn't seem to relate back to the LinkedLayers and instead is just a uuid
@@ -927,6 +951,41 @@ private:
 		return m_MeshCache;
 	}
 
+	/// Compute a fingerprint of everything (apart from the linked layer) affecting the result of evaluate_warp() to
+	/// key the document's WarpCache with. The mesh is expected to already be moved to the origin such that instances
+	/// only differing in their placement share the same fingerprint. Positions are quantized to 1/2^20th of a pixel
+	/// to not miss out on meshes which only differ by floating point noise.
+	uint64_t warp_fingerprint(const Geometry::QuadMesh<double>& normalized_mesh) const
+	{
+		// FNV-1a
+		uint64_t fingerprint = 14695981039346656037ull;
+		auto combine = [&](uint64_t value)
+			{
+				for (size_t i = 0; i < sizeof(value); ++i)
+				{
+					fingerprint ^= (value >> (i * 8)) & 0xFF;
+					fingerprint *= 1099511628211ull;
+				}
+			};
+		auto combine_double = [&](double value)
+			{
+				combine(static_cast<uint64_t>(std::llround(value * 1048576.0)));
+			};
+
+		combine(Layer<T>::width());
+		combine(Layer<T>::height());
+		combine(m_AdaptiveSupersampling);
+		combine(normalized_mesh.vertices().size());
+		for (const auto& vertex : normalized_mesh.vertices())
+		{
+			combine_double(vertex.point().x);
+			combine_double(vertex.point().y);
+			combine_double(vertex.uv().x);
+			combine_double(vertex.uv().y);
+		}
+		return fingerprint;
+	}
+
 protected:
 
 	/// Evaluates the transformation (updates center coordinates and width/height) meaning grabbing the bbox width and height will give the 
@@ -956,29 +1015,29 @@ protected:
 			throw std::runtime_error(fmt::format("SmartObjectLayer '{}': Unexpected failure while evaluating the image data: m_LinkedLayers is a nullptr", Layer<T>::m_LayerName));
 		}
 
-		constexpr auto s_alpha_idinfo = Enum::ChannelIDInfo{ Enum::ChannelID::Alpha, static_cast<int16_t>(-1) };
-		const std::shared_ptr<LinkedLayerData<T>> linked_layer = m_LinkedLayers->at(m_Hash);
-
-		// Construct all the channel indices including alpha and mask
-		auto all_channel_indices = linked_layer->channel_indices();
-		if (std::find(all_channel_indices.begin(), all_channel_indices.end(), s_alpha_idinfo) == all_channel_indices.end())
+		// Masks and channels which are still cached are retrieved individually while all the others get warped together
+		// as that way we only have to look up the warp's uv coordinates once for all of them
+		data_type out{};
+		if (Layer<T>::has_mask())
 		{
-			// We always insert an alpha channel
-			all_channel_indices.push_back(s_alpha_idinfo);
+			out[Layer<T>::s_mask_index.index] = this->evaluate_channel(Layer<T>::s_mask_index);
 		}
-		if (Layer<T>::has_mask())
+		std::vector<Enum::ChannelIDInfo> to_warp;
+		for (const auto& item : this->warped_channel_indices())
 		{
-			all_channel_indices.push_back(Layer<T>::s_mask_index);
+			if (this->is_cache_valid(item))
+			{
+				out[item.index] = this->evaluate_channel(item);
+			}
+			else
+			{
+				to_warp.push_back(item);
+			}
 		}
-
-		// evaluate all the channels and return them. This could be a bit 
-		// more efficient by preallocating the channels in parallel but since 
-		// evaluate_channel calls the apply function which is already parallelized
-		// we will keep it like this
-		data_type out{};
-		for (auto& item : all_channel_indices)
+		auto warped = this->evaluate_warp(to_warp);
+		for (size_t i = 0; i < to_warp.size(); ++i)
 		{
-			out[item.index] = this->evaluate_channel(item);
+			out[to_warp[i].index] = *warped[i];
 		}
 
 		return out;
@@ -988,7 +1047,6 @@ protected:
 	{
 		PSAPI_PROFILE_FUNCTION();
 		auto idinfo = ImageDataMixin<T>::idinfo_from_variant(_id, Layer<T>::m_ColorMode);
-		constexpr auto s_alpha_idinfo = Enum::ChannelIDInfo{ Enum::ChannelID::Alpha, static_cast<int16_t>(-1) };
 
 		if (!m_LinkedLayers)
 		{
@@ -1014,17 +1072,58 @@ protected:
 			}
 			return ImageDataMixin<T>::m_ImageData.at(idinfo)->template get_data<T>();
 		}
-		else
+		auto warped = this->evaluate_warp({ idinfo });
+		return *warped.front();
+	};
+
+	/// Evaluate the warp for all the given channels at once, caching and returning the results in the same order. 
+	/// Masks are not valid to pass here.
+	/// 
+	/// Channels which another smart object of the document already warped identically (same linked layer, warp 
+	/// and resolution) are retrieved from the document's WarpCache rather than being warped again. The results are
+	/// shared with the WarpCache rather than copied, they must therefore not be modified.
+	std::vector<std::shared_ptr<const std::vector<T>>> evaluate_warp(const std::vector<Enum::ChannelIDInfo>& channels)
+	{
+		PSAPI_PROFILE_FUNCTION();
+		constexpr auto s_alpha_idinfo = Enum::ChannelIDInfo{ Enum::ChannelID::Alpha, static_cast<int16_t>(-1) };
+		if (channels.empty())
 		{
-			// Evaluate the warp and cache the result.
-			auto linked_layer = m_LinkedLayers->at(m_Hash);
+			return {};
+		}
+		auto linked_layer = m_LinkedLayers->at(m_Hash);
+		auto& warp_cache = m_LinkedLayers->warp_cache();
 
-			// The alpha channel may not necessarily exist on the image data, however we always
-			// want to create it if that is the case. Other channels we do not generate though.
-			std::vector<T> image_data;
+		auto& warp_mesh = this->evaluate_mesh_or_get_cached();
+		auto bbox = warp_mesh.bbox();
+		// Push the transform to zero
+		warp_mesh.move(-bbox.minimum);
+
+		// Retrieve the channels that were already warped, only warping the rest
+		const uint64_t fingerprint = warp_fingerprint(warp_mesh);
+		std::vector<std::shared_ptr<const std::vector<T>>> channel_warps(channels.size());
+		std::vector<size_t> to_warp;
+		for (size_t i = 0; i < channels.size(); ++i)
+		{
+			if (auto cached = warp_cache.get({ m_Hash, fingerprint, channels[i] }))
+			{
+				channel_warps[i] = std::move(cached);
+			}
+			else
+			{
+				to_warp.push_back(i);
+			}
+		}
+
+		// The alpha channel may not necessarily exist on the image data, however we always
+		// want to create it if that is the case. Other channels we do not generate though.
+		std::vector<std::vector<T>> image_data(to_warp.size());
+		std::vector<Render::ConstChannelBuffer<T>> orig_buffers;
+		for (size_t i = 0; i < to_warp.size(); ++i)
+		{
+			const auto& idinfo = channels[to_warp[i]];
 			if (linked_layer->has_channel(idinfo))
 			{
-				image_data = linked_layer->get_channel(idinfo);
+				image_data[i] = linked_layer->get_channel(idinfo);
 			}
 			else if (idinfo == s_alpha_idinfo)
 			{
@@ -1033,56 +1132,121 @@ protected:
 				{
 					value = 1.0f;
 				}
-				image_data = std::vector<T>(linked_layer->width() * linked_layer->height(), value);
+				image_data[i] = std::vector<T>(linked_layer->width() * linked_layer->height(), value);
 			}
 			else
 			{
+				warp_mesh.move(bbox.minimum);
 				throw std::invalid_argument(fmt::format(
 					"SmartObjectLayer '{}': Invalid channel '{}' accessed while calling evaluate_channel(). This does not exist on the smart object",
 					Layer<T>::m_LayerName,
 					Enum::channelIDToString(idinfo.id))
 				);
 			}
-			Render::ConstChannelBuffer<T> orig_buffer(image_data, linked_layer->width(), linked_layer->height());
+			orig_buffers.emplace_back(image_data[i], linked_layer->width(), linked_layer->height());
+		}
+
+		// Generate the warped result
+		std::vector<Render::ChannelBuffer<T>> channel_warp_buffers;
+		for (size_t index : to_warp)
+		{
+			auto channel_warp = std::make_shared<std::vector<T>>(this->width() * this->height());
+			channel_warp_buffers.emplace_back(*channel_warp, this->width(), this->height());
+			channel_warps[index] = std::move(channel_warp);
+		}
 
-			// Generate the warped result
-			std::vector<T> channel_warp(this->width() * this->height());
-			Render::ChannelBuffer<T> channel_warp_buffer(channel_warp, this->width(), this->height());
+		// Finally apply the warp to all channels at once and store the cache. We rasterize the mesh rather than looking
+		// up the uv coordinate of each sample as that is considerably cheaper for the dense meshes we generate
+		if (to_warp.empty())
+		{
+			// Everything was cached already
+		}
+		else if (m_AdaptiveSupersampling)
+		{
+			// Sample the parts of the image that are scaled down from the mip pyramids cached on the linked layer, 
+			// a synthesized alpha channel is constant and therefore doesn't need one. We hold on to the pyramids for the
+			// duration of the warp as the linked layer may clear its pyramids in the meantime.
+			std::vector<std::shared_ptr<const Render::MipPyramid<T>>> held_pyramids;
+			std::vector<const Render::MipPyramid<T>*> pyramids;
+			for (size_t index : to_warp)
+			{
+				const auto& idinfo = channels[index];
+				held_pyramids.push_back(linked_layer->has_channel(idinfo) ? linked_layer->mip_pyramid(idinfo) : nullptr);
+				pyramids.push_back(held_pyramids.back().get());
+			}
+			m_SmartObjectWarp.apply_adaptive<T>(
+				std::span<Render::ChannelBuffer<T>>(channel_warp_buffers),
+				std::span<const Render::ConstChannelBuffer<T>>(orig_buffers),
+				std::span<const Render::MipPyramid<T>* const>(pyramids),
+				warp_mesh);
+		}
+		else
+		{
+			m_SmartObjectWarp.apply_rasterized<T>(
+				std::span<Render::ChannelBuffer<T>>(channel_warp_buffers), 
+				std::span<const Render::ConstChannelBuffer<T>>(orig_buffers), 
+				warp_mesh);
+		}
+		if (warp_cache.byte_budget() > 0)
+		{
+			for (size_t index : to_warp)
+			{
+				warp_cache.insert({ m_Hash, fingerprint, channels[index] }, channel_warps[index]);
+			}
+		}
 
-			auto& warp_mesh = this->evaluate_mesh_or_get_cached();
-			auto bbox = warp_mesh.bbox();
-			// Push the transform to zero
-			warp_mesh.move(-bbox.minimum);
+		for (size_t i = 0; i < channels.size(); ++i)
+		{
+			const auto& idinfo = channels[i];
 
-			// Restore the saved compression codec of the channel (if previously evaluated).
+			// Restore the saved compression codec and zip level of the channel (if previously evaluated).
 			auto compression_codec = Enum::Compression::ZipPrediction;
+			std::optional<int> zip_level = std::nullopt;
 			if (ImageDataMixin<T>::m_ImageData.contains(idinfo))
 			{
 				compression_codec = ImageDataMixin<T>::m_ImageData[idinfo]->compression_codec();
+				zip_level = ImageDataMixin<T>::m_ImageData[idinfo]->zip_level();
 			}
 
-			// Finally apply the warp and store the cache
-			m_SmartObjectWarp.apply(channel_warp_buffer, orig_buffer, warp_mesh);
 			ImageDataMixin<T>::m_ImageData[idinfo] = std::make_unique<channel_wrapper>(
 				compression_codec,
-				channel_warp,
+				std::span<const T>(*channel_warps[i]),
 				idinfo,
 				Layer<T>::width(),
 				Layer<T>::height(),
 				Layer<T>::m_CenterX,
 				Layer<T>::m_CenterY
 			);
+			ImageDataMixin<T>::m_ImageData[idinfo]->zip_level(zip_level);
 			this->store_was_cached(idinfo);
+		}
 
-			// Pop back the transform to make sure we don't have the object at zero for other evaluation
-			warp_mesh.move(bbox.minimum);
+		// Pop back the transform to make sure we don't have the object at zero for other evaluation
+		warp_mesh.move(bbox.minimum);
+
+		return channel_warps;
+	}
 
-			return channel_warp;
-		}
-	};
 
 private:
 
+	/// All the channels generated by warping the linked layer, these are the channels of the linked layer as well as
+	/// an alpha channel which we always generate. The mask is not included as it isn't warped.
+	std::vector<Enum::ChannelIDInfo> warped_channel_indices() const
+	{
+		if (!m_LinkedLayers)
+		{
+			throw std::runtime_error(fmt::format("SmartObjectLayer '{}': Unexpected failure while evaluating the image data: m_LinkedLayers is a nullptr", Layer<T>::m_LayerName));
+		}
+		constexpr auto s_alpha_idinfo = Enum::ChannelIDInfo{ Enum::ChannelID::Alpha, static_cast<int16_t>(-1) };
+		auto channel_indices = m_LinkedLayers->at(m_Hash)->channel_indices();
+		if (std::find(channel_indices.begin(), channel_indices.end(), s_alpha_idinfo) == channel_indices.end())
+		{
+			channel_indices.push_back(s_alpha_idinfo);
+		}
+		return channel_indices;
+	}
+
 	/// Construct the SmartObjectLayer, initializing the structure and populating the warp (if necessary).
 	void construct(Layer<T>::Params& parameters, std::filesystem::path filepath, LinkedLayerType linkage, std::optional<SmartObject::Warp> warp = std::nullopt)
 	{
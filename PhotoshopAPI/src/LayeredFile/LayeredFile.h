@@ -18,6 +18,8 @@
 #include "LayeredFile/Util/GenerateColorModeData.h"
 #include "LayeredFile/Util/GenerateImageResources.h"
 #include "LayeredFile/Util/GenerateLayerMaskInfo.h"
+#include "LayeredFile/Util/GenerateImageData.h"
+#include "LayeredFile/Util/Flatten.h"
 #include "LayeredFile/Util/ClearLinkedLayers.h"
 
 #include <variant>
@@ -53,6 +55,17 @@ enum class LayerOrder
 };
 
 
+/// Options controlling how a LayeredFile is written to disk, see `LayeredFile::write()`.
+struct WriteOptions
+{
+	/// The zip compression level (0-12) Zip and ZipPrediction compressed channels are written with. Lower levels are 
+	/// faster to write while higher levels produce smaller files. Individual layers may override this through 
+	/// `Layer::set_write_compression()`. If unset we write with a balanced default level and channels that were read 
+	/// lazily and not modified since keep their original compressed data.
+	std::optional<int> zip_level = std::nullopt;
+};
+
+
 
 /// \brief Represents a layered file structure.
 /// 
@@ -83,6 +96,13 @@ struct LayeredFile
 	float dpi() const noexcept { return m_DotsPerInch; }
 	void dpi(float resolution) { m_DotsPerInch = resolution; }
 
+	/// Whether to flatten the layers into the merged composite on write. If false (the default) we write an empty
+	/// composite which Photoshop ignores but other applications reading only the composite will see as blank.
+	/// Only RGB and Grayscale files are currently supported.
+	bool& write_composite() noexcept { return m_WriteComposite; }
+	bool write_composite() const noexcept { return m_WriteComposite; }
+	void write_composite(bool value) noexcept { m_WriteComposite = value; }
+
 	/// The files' width from 1 - 300,000
 	uint64_t& width() noexcept { return m_Width; }
 	uint64_t width() const noexcept { return m_Width; }
@@ -180,6 +200,8 @@ struct LayeredFile
 			m_UnparsedBlocks = document->m_LayerMaskInfo.m_AdditionalLayerInfo.value().get_base_tagged_blocks();
 		}
 
+		m_Composite = document->m_ImageData;
+
 		m_Layers = _Impl::template build_layer_hierarchy<T>(*this, std::move(document));
 		if (m_Layers.size() == 0)
 		{
@@ -480,6 +502,51 @@ struct LayeredFile
 		return generate_flattened_layers_impl(LayerOrder::forward);
 	}
 
+	/// \brief Decode the merged composite image the file was read with.
+	///
+	/// This is the composite Photoshop stored alongside the layers, see `read_composite()` for details. It reflects the
+	/// document as it was on disk and is not updated by any layer modifications. For files not read from disk this 
+	/// returns an empty map. The composite is only decoded on access, calling this repeatedly decodes it again.
+	///
+	/// \return The composite channels, each holding `width()` * `height()` pixels of the document
+	std::unordered_map<int, std::vector<T>> composite() const
+	{
+		return _Impl::decode_composite<T>(m_Composite, m_ColorMode);
+	}
+
+	/// \brief Flatten the layer hierarchy into a single image.
+	///
+	/// Unlike `composite()` this evaluates the current state of the layers. Only visible layers intersecting the region 
+	/// of interest are evaluated, honoring their blend mode, opacity, fill and pixel mask. Clipping masks are blended
+	/// as a group (Photoshop's default) and groups are either composited as pass-through or isolated depending on their
+	/// blend mode. Layer effects, adjustment layers and the Dissolve blend mode are not supported, the latter falls back
+	/// to Normal.
+	///
+	/// \param roi The region of the canvas to flatten, clipped to the canvas. Defaults to the whole canvas.
+	/// \param options Options controlling the output, see `FlattenOptions`.
+	///
+	/// \throws std::invalid_argument if the roi does not intersect the canvas
+	/// \throws std::invalid_argument if the document is neither RGB nor Grayscale
+	///
+	/// \return The color channels alongside the alpha on index -1, each holding `roi.width()` * `roi.height()` pixels
+	std::unordered_map<int, std::vector<T>> flatten(std::optional<Geometry::BoundingBox<int>> roi = std::nullopt, const FlattenOptions& options = {})
+	{
+		PSAPI_PROFILE_FUNCTION();
+		auto region = Geometry::BoundingBox<int>(Geometry::Point2D<int>(0, 0), Geometry::Point2D<int>(static_cast<int>(m_Width), static_cast<int>(m_Height)));
+		if (roi)
+		{
+			auto _region = Geometry::BoundingBox<int>::intersect(region, roi.value());
+			if (!_region || _region->width() <= 0 || _region->height() <= 0)
+			{
+				throw std::invalid_argument("Unable to flatten the file as the given roi does not intersect the canvas");
+			}
+			region = _region.value();
+		}
+
+		_Impl::FlattenContext<T> context{};
+		return _Impl::flatten_layers<T>(m_Layers, m_ColorMode, region, options, context);
+	}
+
 	/// \brief Gets the total number of channels in the document.
 	///
 	/// \return The total number of channels in the document.
@@ -492,25 +559,7 @@ struct LayeredFile
 		}
 
 		uint16_t numChannels = hasAlpha ? 1u : 0u;
-		if (m_ColorMode == Enum::ColorMode::RGB ||
-			m_ColorMode == Enum::ColorMode::Lab)
-		{
-			numChannels += 3u;
-		}
-		else if (m_ColorMode == Enum::ColorMode::CMYK)
-		{
-			numChannels += 4u;
-		}
-		else if (
-			m_ColorMode == Enum::ColorMode::Bitmap ||
-			m_ColorMode == Enum::ColorMode::Indexed ||
-			m_ColorMode == Enum::ColorMode::Grayscale ||
-			m_ColorMode == Enum::ColorMode::Duotone ||
-			m_ColorMode == Enum::ColorMode::Multichannel
-			)
-		{
-			numChannels += 1u;
-		}
+		numChannels += _Impl::num_color_channels(m_ColorMode);
 		return numChannels;
 	}
 
@@ -542,12 +591,21 @@ struct LayeredFile
 	/// PhotoshopFile instance to the user
 	/// 
 	/// \param filePath the path on disk of the file to be read
-	/// \param callback the callback which reports back the current progress and task to the user
-	static LayeredFile<T> read(const std::filesystem::path& filePath, ProgressCallback& callback)
+	/// \param callback the callback which reports back the current progress and task to the user. Cancelling it (or 
+	///		  exceeding its deadline) stops the read between layers and channels, throwing an OperationCancelled
+	/// \param lazy_channels If true, channels are not decoded on read but rather keep a reference to their 
+	///		  compressed data in the file which is decoded on first access (e.g. via `get_channel()`). This makes 
+	///		  reading near-instant for files where only the metadata or a few layers are of interest. The file 
+	///		  is kept open until all channels referencing it are decoded, modified or destroyed.
+	///		  Channels that are not modified (or whose compression is not changed) are written back with their
+	///		  original compressed data, skipping the decode/encode roundtrip entirely.
+	static LayeredFile<T> read(const std::filesystem::path& filePath, ProgressCallback& callback, const bool lazy_channels = false)
 	{
-		auto inputFile = File(filePath);
+		File::FileParams params = {};
+		params.lazyChannelData = lazy_channels;
+		auto inputFile = std::make_shared<File>(filePath, params);
 		auto psDocumentPtr = std::make_unique<PhotoshopFile>();
-		psDocumentPtr->read(inputFile, callback);
+		psDocumentPtr->read(*inputFile, callback);
 
 		if constexpr (std::is_same_v<T, bpp8_t>)
 		{
@@ -573,7 +631,12 @@ struct LayeredFile
 					Enum::bitDepthToUint(psDocumentPtr->m_Header.m_Depth));
 			}
 		}
-		return LayeredFile<T>({ std::move(psDocumentPtr), filePath });
+		auto layeredFile = LayeredFile<T>(std::move(psDocumentPtr), filePath);
+		if (lazy_channels)
+		{
+			layeredFile.m_LazySourcePath = filePath;
+		}
+		return layeredFile;
 	}
 
 	/// \brief read and create a LayeredFile from disk
@@ -589,6 +652,35 @@ struct LayeredFile
 		return LayeredFile<T>::read(filePath, callback);
 	}
 
+	/// \brief read only the merged composite image stored in the file on disk
+	///
+	/// Photoshop stores a flattened composite of the whole layer hierarchy at the end of the file if it was saved 
+	/// with 'Maximize Compatibility'. This seeks straight to that section without parsing any of the layers, making 
+	/// it a cheap way to e.g. generate thumbnails or previews. The channels are keyed by their index within the
+	/// color mode with the transparency (if present) being stored at index -1.
+	/// 
+	/// Files saved without 'Maximize Compatibility' (or written by the PhotoshopAPI) will usually hold an empty 
+	/// (white or black) composite instead.
+	///
+	/// \param filePath the path on disk of the file to be read
+	///
+	/// \return The composite channels, each holding `width()` * `height()` pixels of the document
+	static std::unordered_map<int, std::vector<T>> read_composite(const std::filesystem::path& filePath)
+	{
+		File::FileParams params = {};
+		// Allows us to decode directly from the memory mapped document
+		params.lazyChannelData = true;
+		auto inputFile = std::make_shared<File>(filePath, params);
+		PhotoshopFile document{};
+		document.readComposite(*inputFile);
+		if (document.m_Header.m_Depth != Enum::bit_depth_from_t<T>())
+		{
+			PSAPI_LOG_ERROR("LayeredFile", "Tried to read the composite of a %d-bit file with a %d-bit LayeredFile instantiation",
+				Enum::bitDepthToUint(document.m_Header.m_Depth), Enum::bitDepthToUint(Enum::bit_depth_from_t<T>()));
+		}
+		return _Impl::decode_composite<T>(document.m_ImageData, document.m_Header.m_ColorMode);
+	}
+
 	/// \brief write the LayeredFile instance to disk, consumes and invalidates the instance
 	/// 
 	/// Simplify the writing of a LayeredFile by abstracting away the step of 
@@ -600,8 +692,28 @@ struct LayeredFile
 	/// \param callback the callback which reports back the current progress and task to the user
 	/// \param forceOvewrite Whether to forcefully overwrite the file or fail if the file already exists
 	static void write(LayeredFile<T>&& layeredFile, const std::filesystem::path& filePath, ProgressCallback& callback, const bool forceOvewrite = true)
+	{
+		LayeredFile<T>::write(std::move(layeredFile), filePath, WriteOptions{}, callback, forceOvewrite);
+	}
+
+	/// \brief write the LayeredFile instance to disk with the given options, consumes and invalidates the instance
+	/// 
+	/// \param layeredFile The LayeredFile to consume, invalidates it
+	/// \param filePath The path on disk of the file to be written
+	/// \param options Options controlling e.g. the zip compression level, see `WriteOptions`
+	/// \param callback the callback which reports back the current progress and task to the user, cancelling it stops
+	///		  the write. The partially written file is removed if the write is cancelled or fails
+	/// \param forceOvewrite Whether to forcefully overwrite the file or fail if the file already exists
+	/// 
+	/// \throws std::invalid_argument if the zip level of the options is outside of the supported range
+	/// \throws OperationCancelled if the callback was cancelled or its deadline passed before the write completed
+	static void write(LayeredFile<T>&& layeredFile, const std::filesystem::path& filePath, const WriteOptions& options, ProgressCallback& callback, const bool forceOvewrite = true)
 	{
 		_Impl::validate_file(layeredFile);
+		if (options.zip_level)
+		{
+			ZIP_Impl::ValidateCompressionLevel(options.zip_level.value());
+		}
 
 		File::FileParams params = {};
 		params.doRead = false;
@@ -613,9 +725,46 @@ struct LayeredFile
 				"Writing out a CMYK file without an embedded ICC Profile. The output image data will likely look very wrong");
 		}
 
-		auto outputFile = File(filePath, params);
-		auto psdOutDocumentPtr = layered_to_photoshop(std::move(layeredFile), filePath);
-		psdOutDocumentPtr->write(outputFile, callback);
+		// If the file was read lazily its channels may still reference the file we are about to overwrite, we therefore
+		// write to a sibling file first and only swap it in once all channels were encoded and the source was released.
+		const bool overwritesLazySource = layeredFile.m_LazySourcePath.has_value()
+			&& std::filesystem::exists(filePath)
+			&& std::filesystem::equivalent(filePath, layeredFile.m_LazySourcePath.value());
+		std::filesystem::path outputPath = filePath;
+		if (overwritesLazySource)
+		{
+			// Keep the extension as the header version is deduced from it
+			outputPath.replace_filename(filePath.stem().string() + ".psapi_tmp" + filePath.extension().string());
+		}
+
+		bool createdOutput = false;
+		try
+		{
+			{
+				auto outputFile = File(outputPath, params);
+				createdOutput = true;
+				auto psdOutDocumentPtr = layered_to_photoshop(std::move(layeredFile), filePath, options);
+				// The composite may reference the source document as well, the instance is invalidated either way
+				layeredFile.m_Composite = ImageData{};
+				psdOutDocumentPtr->write(outputFile, callback);
+			}
+			// The output file must be closed before we are able to swap it in
+			if (overwritesLazySource)
+			{
+				std::filesystem::rename(outputPath, filePath);
+			}
+		}
+		catch (...)
+		{
+			// Don't leave a truncated file behind no matter why the write failed, at this point the output file was
+			// already closed. If we never opened it there is nothing of ours to remove.
+			if (createdOutput)
+			{
+				std::error_code ec;
+				std::filesystem::remove(outputPath, ec);
+			}
+			throw;
+		}
 	}
 
 	/// \brief write the LayeredFile instance to disk, consumes and invalidates the instance
@@ -633,6 +782,20 @@ struct LayeredFile
 		LayeredFile<T>::write(std::move(layeredFile), filePath, callback, forceOvewrite);
 	}
 
+	/// \brief write the LayeredFile instance to disk with the given options, consumes and invalidates the instance
+	/// 
+	/// \param layeredFile The LayeredFile to consume, invalidates it
+	/// \param filePath The path on disk of the file to be written
+	/// \param options Options controlling e.g. the zip compression level, see `WriteOptions`
+	/// \param forceOvewrite Whether to forcefully overwrite the file or fail if the file already exists
+	/// 
+	/// \throws std::invalid_argument if the zip level of the options is outside of the supported range
+	static void write(LayeredFile<T>&& layeredFile, const std::filesystem::path& filePath, const WriteOptions& options, const bool forceOvewrite = true)
+	{
+		ProgressCallback callback{};
+		LayeredFile<T>::write(std::move(layeredFile), filePath, options, callback, forceOvewrite);
+	}
+
 	/// \brief Remove the global Txt2 (TextEngineData) block to trigger Photoshop's text update dialog.
 	///
 	/// The global `Txt2` block is a document-level cache token that Photoshop uses to decide
@@ -691,6 +854,15 @@ private:
 	/// Stores all unparsed tagged blocks that we want to pass through on read/write.
 	std::vector<std::shared_ptr<TaggedBlock>> m_UnparsedBlocks;
 
+	/// The merged composite section the file was read with, this is only decoded on access via `composite()`
+	ImageData m_Composite{};
+
+	/// Whether to generate the merged composite from the layers on write
+	bool m_WriteComposite = false;
+
+	/// If the file was read with lazy channels this holds the path it was read from as channels may still reference it.
+	std::optional<std::filesystem::path> m_LazySourcePath = std::nullopt;
+
 	std::vector<std::shared_ptr<Layer<T>>> generate_flattened_layers_impl(const LayerOrder order)
 	{
 		if (order == LayerOrder::forward)
@@ -761,8 +933,12 @@ std::shared_ptr<LayerType<T>> find_layer_as(const std::string path, const Layere
 /// 
 /// \note This will not fill any specific TaggedBlocks or ResourceBlocks beyond what is required
 /// to create the layer structure.
+/// 
+/// \param layered_file The LayeredFile to consume, invalidates it
+/// \param file_path The path the PhotoshopFile will be written to
+/// \param options The options the PhotoshopFile will be written with
 template <typename T>
-std::unique_ptr<PhotoshopFile> layered_to_photoshop(LayeredFile<T>&& layered_file, std::filesystem::path file_path)
+std::unique_ptr<PhotoshopFile> layered_to_photoshop(LayeredFile<T>&& layered_file, std::filesystem::path file_path, const WriteOptions& options = {})
 {
 	PSAPI_PROFILE_FUNCTION();
 
@@ -772,8 +948,9 @@ std::unique_ptr<PhotoshopFile> layered_to_photoshop(LayeredFile<T>&& layered_fil
 	FileHeader header = generate_header<T>(layered_file);
 	ColorModeData colorModeData = generate_colormodedata<T>(layered_file);
 	ImageResources imageResources = generate_imageresources<T>(layered_file);
-	LayerAndMaskInformation lrMaskInfo = generate_layermaskinfo<T>(layered_file, file_path);
-	ImageData imageData = ImageData(layered_file.num_channels());
+	// The composite must be generated before the layer data is consumed by the layer and mask information
+	ImageData imageData = generate_imagedata<T>(layered_file);
+	LayerAndMaskInformation lrMaskInfo = generate_layermaskinfo<T>(layered_file, file_path, options.zip_level);
 
 	return std::make_unique<PhotoshopFile>(header, colorModeData, std::move(imageResources), std::move(lrMaskInfo), imageData);
 }
@@ -2,10 +2,13 @@
 
 
 #include "Macros.h"
+#include "Util/Parallel.h"
 
 #include "PsdPsbReader.h"
+#include "WarpCache.h"
 #include "Core/Render/Render.h"
 #include "Core/Render/ImageBuffer.h"
+#include "Core/Render/MipPyramid.h"
 #include "Core/Render/Deinterleave.h"
 #include "Core/Struct/ImageChannel.h"
 #include "Core/TaggedBlocks/LinkedLayerTaggedBlock.h"
@@ -19,6 +22,7 @@
 #include <filesystem>
 #include <string>
 #include <memory>
+#include <mutex>
 
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/imagebufalgo.h>
@@ -164,7 +168,7 @@ struct LinkedLayerData
 		data_type out;
 		std::mutex mutex;
 
-		std::for_each(std::execution::par_unseq , m_ImageData.begin(), m_ImageData.end(), [&](const auto& pair)
+		Parallel::forEach(m_ImageData.begin(), m_ImageData.end(), [&](const auto& pair)
 			{
 				const auto& key = pair.first;
 				const auto& channel = pair.second;
@@ -220,6 +224,36 @@ struct LinkedLayerData
 		return resampled_data;
 	}
 
+	/// Get the mip pyramid of the given channel, building it on first access. The pyramid is cached on the linked layer 
+	/// such that all smart objects referencing this file share it. These are used for sampling the image data without
+	/// aliasing when it is scaled down.
+	/// 
+	/// The pyramid is shared rather than referenced such that clearing the pyramids while a smart object is sampling
+	/// from it doesn't free it from under it.
+	/// 
+	/// Throws if the channel does not exist on the linked layer.
+	std::shared_ptr<const Render::MipPyramid<T>> mip_pyramid(Enum::ChannelIDInfo _id)
+	{
+		std::lock_guard<std::mutex> lock(m_MipPyramidMutex);
+		if (auto it = m_MipPyramids.find(_id); it != m_MipPyramids.end())
+		{
+			return it->second;
+		}
+
+		std::vector<T> data = get_channel(_id);
+		auto pyramid = std::make_shared<const Render::MipPyramid<T>>(Render::ConstChannelBuffer<T>(data, m_Width, m_Height));
+		m_MipPyramids.emplace(_id, pyramid);
+		return pyramid;
+	}
+
+	/// Release the memory held by the cached mip pyramids, these will be rebuilt the next time they are accessed.
+	/// Pyramids currently in use by smart objects are only freed once these are done with them.
+	void clear_mip_pyramids()
+	{
+		std::lock_guard<std::mutex> lock(m_MipPyramidMutex);
+		m_MipPyramids.clear();
+	}
+
 	/// Get the width and height of the image data stored on the linked layer.
 	std::array<size_t, 2> size() const noexcept { return { m_Width, m_Height }; }
 
@@ -274,6 +308,10 @@ private:
 	/// Raw file data
 	std::vector<uint8_t> m_RawData;
 
+	/// Mip pyramids of the channels in m_ImageData, these are built lazily by mip_pyramid()
+	std::unordered_map<Enum::ChannelIDInfo, std::shared_ptr<const Render::MipPyramid<T>>, Enum::ChannelIDInfoHasher> m_MipPyramids;
+	std::mutex m_MipPyramidMutex;
+
 	size_t m_Width = 1;
 	size_t m_Height = 1;
 
@@ -402,7 +440,7 @@ private:
 
 		/// Extract the image data and store it in our m_ImageData
 		std::mutex insertion_mutex;
-		std::for_each(std::execution::par_unseq, channelnames.begin(), channelnames.end(), [&](auto name)
+		Parallel::forEach(channelnames.begin(), channelnames.end(), [&](auto name)
 			{
 				/// Extract all indices from 0-2 as these will represent our RGB channels,
 				/// we handle alpha separately
@@ -583,8 +621,14 @@ struct LinkedLayers
 	void erase(const std::string& hash)
 	{
 		m_LinkedLayerData.erase(hash);
+		m_WarpCache.erase(hash);
 	}
 
+	/// Retrieve the document-level cache of warped smart object channels. This may be used to e.g. adjust its 
+	/// byte budget or release its memory.
+	WarpCache<T>& warp_cache() noexcept { return m_WarpCache; }
+	const WarpCache<T>& warp_cache() const noexcept { return m_WarpCache; }
+
 
 	/// Check whether the LinkedLayers are empty (i.e. hold no children).
 	bool empty()
@@ -632,6 +676,9 @@ struct LinkedLayers
 private: 
 	std::unordered_map<std::string, std::shared_ptr<LinkedLayerData<T>>> m_LinkedLayerData;
 
+	/// Warped channels shared across all the smart objects of the document
+	WarpCache<T> m_WarpCache;
+
 };
 
 
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "Macros.h"
+#include "Util/Enum.h"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+PSAPI_NAMESPACE_BEGIN
+
+
+/// Document-level cache of the warped channels of smart objects. Documents often place the same linked layer many times
+/// with identical transforms (e.g. repeated logos or pattern tiles) which would otherwise all decode and warp the
+/// original image data independently. The cache is shared by all the smart objects of a document through the
+/// `LinkedLayers` such that all but the first of these reuse the warped result.
+///
+/// Entries are keyed on the hash of the linked layer, a fingerprint of everything else affecting the warped result
+/// (computed by the smart object) and the channel. Once the cached data exceeds the byte budget the least recently
+/// used entries get evicted.
+template <typename T>
+struct WarpCache
+{
+	/// The default byte budget of 256MiB
+	static constexpr size_t s_DefaultByteBudget = size_t(256) << 20;
+
+	struct Key
+	{
+		/// The hash of the linked layer the channel was warped from
+		std::string hash;
+		/// Fingerprint of the warp mesh, output resolution and sampling settings
+		uint64_t fingerprint = 0;
+		/// The channel that was warped
+		Enum::ChannelIDInfo channel{};
+
+		bool operator==(const Key& other) const
+		{
+			return hash == other.hash && fingerprint == other.fingerprint && channel == other.channel;
+		}
+	};
+
+	using value_type = std::shared_ptr<const std::vector<T>>;
+
+	WarpCache() = default;
+	WarpCache(const WarpCache&) = delete;
+	WarpCache& operator=(const WarpCache&) = delete;
+
+	/// Retrieve the cached channel for the given key marking it as the most recently used, returns a nullptr if
+	/// there is no such entry.
+	value_type get(const Key& key)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_Lookup.find(key);
+		if (it == m_Lookup.end())
+		{
+			return nullptr;
+		}
+		m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+		return it->second->second;
+	}
+
+	/// Insert the channel into the cache (replacing any previous entry for the key) after which the least recently
+	/// used entries are evicted until we are back within the byte budget. Channels larger than the whole budget are
+	/// not cached.
+	void insert(Key key, value_type data)
+	{
+		if (!data)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (auto it = m_Lookup.find(key); it != m_Lookup.end())
+		{
+			erase_entry(it->second);
+		}
+		const size_t size = data->size() * sizeof(T);
+		if (size > m_ByteBudget)
+		{
+			return;
+		}
+
+		m_Entries.emplace_front(key, std::move(data));
+		m_Lookup[std::move(key)] = m_Entries.begin();
+		m_ByteSize += size;
+		evict();
+	}
+
+	/// Remove all the cached channels warped from the given linked layer
+	void erase(const std::string& hash)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto it = m_Entries.begin(); it != m_Entries.end();)
+		{
+			auto next = std::next(it);
+			if (it->first.hash == hash)
+			{
+				erase_entry(it);
+			}
+			it = next;
+		}
+	}
+
+	/// Remove all the cached channels
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Entries.clear();
+		m_Lookup.clear();
+		m_ByteSize = 0;
+	}
+
+	/// The number of channels currently cached
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Entries.size();
+	}
+
+	/// The number of bytes held by all the cached channels
+	size_t byte_size() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_ByteSize;
+	}
+
+	/// The maximum number of bytes the cached channels may hold, defaults to 256MiB
+	size_t byte_budget() const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_ByteBudget;
+	}
+
+	/// Set the maximum number of bytes the cached channels may hold, evicting entries if we are now over the budget.
+	/// A budget of 0 disables the cache.
+	void byte_budget(size_t budget)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_ByteBudget = budget;
+		evict();
+	}
+
+private:
+
+	struct KeyHasher
+	{
+		std::size_t operator()(const Key& key) const
+		{
+			std::size_t seed = std::hash<std::string>()(key.hash);
+			seed ^= std::hash<uint64_t>()(key.fingerprint) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+			seed ^= Enum::ChannelIDInfoHasher()(key.channel) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+			return seed;
+		}
+	};
+
+	using entry_list = std::list<std::pair<Key, value_type>>;
+
+	/// The cached channels ordered from most to least recently used
+	entry_list m_Entries;
+	std::unordered_map<Key, typename entry_list::iterator, KeyHasher> m_Lookup;
+
+	size_t m_ByteSize = 0;
+	size_t m_ByteBudget = s_DefaultByteBudget;
+	mutable std::mutex m_Mutex;
+
+	void erase_entry(typename entry_list::iterator it)
+	{
+		m_ByteSize -= it->second->size() * sizeof(T);
+		m_Lookup.erase(it->first);
+		m_Entries.erase(it);
+	}
+
+	/// Evict the least recently used entries until we are within the byte budget
+	void evict()
+	{
+		while (m_ByteSize > m_ByteBudget && !m_Entries.empty())
+		{
+			erase_entry(std::prev(m_Entries.end()));
+		}
+	}
+};
+
+
+PSAPI_NAMESPACE_END
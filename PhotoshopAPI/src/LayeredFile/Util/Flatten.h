@@ -0,0 +1,636 @@
+#pragma once
+
+#include "Macros.h"
+#include "Util/Enum.h"
+#include "Core/Geometry/BoundingBox.h"
+#include "Core/Render/ImageBuffer.h"
+#include "Core/Render/Composite.h"
+#include "LayeredFile/LayerTypes/Layer.h"
+#include "LayeredFile/LayerTypes/GroupLayer.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+#include "LayeredFile/LayerTypes/ImageDataMixins.h"
+#include "Profiling/Perf/Instrumentor.h"
+
+#include <vector>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <span>
+
+PSAPI_NAMESPACE_BEGIN
+
+
+/// Options controlling how the layers of a LayeredFile are flattened, see `LayeredFile::flatten()`.
+struct FlattenOptions
+{
+	/// Whether to return the color channels premultiplied by the alpha rather than as straight colors which is how
+	/// Photoshop stores its layers.
+	bool premultiplied = false;
+
+	/// If set, the flattened image is matted against a solid background of this value (in the range 0-1, e.g. 1.0 for
+	/// white) which matches the merged composite Photoshop stores. The alpha is returned unchanged. Takes precedence
+	/// over `premultiplied`.
+	std::optional<float> matte;
+};
+
+
+namespace _Impl
+{
+	/// State shared across the flattening of a layer hierarchy. This pools the scratch buffers groups and clipping masks
+	/// are composited into and holds on to the decoded image data of layers which cannot decode a region of their
+	/// channels. It may be kept alive across multiple calls to `flatten_layers()`, e.g. when flattening band by band.
+	template <typename T>
+	struct FlattenContext
+	{
+		/// Released scratch channels ready to be reused.
+		std::vector<std::vector<T>> pool;
+
+		/// The image data of layers which cannot decode a region of their channels (e.g. SmartObjects) alongside the
+		/// bottom of their extents on the canvas.
+		std::unordered_map<const Layer<T>*, std::pair<int, std::unordered_map<int, std::vector<T>>>> cached_data;
+
+		/// The layers we already warned about, such that we only warn once per layer.
+		std::unordered_set<const Layer<T>*> warned;
+
+		/// Get a zero-initialized scratch channel of the given size, reusing a previously released one if possible.
+		std::vector<T> acquire(size_t size)
+		{
+			if (pool.empty())
+			{
+				return std::vector<T>(size, T{});
+			}
+			auto buffer = std::move(pool.back());
+			pool.pop_back();
+			buffer.assign(size, T{});
+			return buffer;
+		}
+
+		/// Return a scratch channel to the pool.
+		void release(std::vector<T>&& buffer)
+		{
+			if (buffer.capacity() > 0)
+			{
+				pool.push_back(std::move(buffer));
+			}
+		}
+
+		/// Release the cached image data of all the layers ending above the given canvas row.
+		void release_cached_above(int y)
+		{
+			std::erase_if(cached_data, [y](const auto& item) { return item.second.first <= y; });
+		}
+	};
+
+
+	/// A premultiplied canvas covering the region of interest holding the color channels followed by the alpha. The
+	/// channels are taken from and returned to the pool of the context.
+	template <typename T>
+	struct FlattenCanvas
+	{
+		FlattenContext<T>& context;
+		Geometry::BoundingBox<int> bbox;
+		std::vector<std::vector<T>> channels;
+
+		FlattenCanvas(FlattenContext<T>& context_, Geometry::BoundingBox<int> bbox_, size_t num_color_channels)
+			: context(context_), bbox(bbox_)
+		{
+			for (size_t i = 0; i < num_color_channels + 1; ++i)
+			{
+				channels.push_back(context.acquire(size()));
+			}
+		}
+
+		FlattenCanvas(const FlattenCanvas&) = delete;
+		FlattenCanvas& operator=(const FlattenCanvas&) = delete;
+
+		~FlattenCanvas()
+		{
+			for (auto& channel : channels)
+			{
+				context.release(std::move(channel));
+			}
+		}
+
+		size_t width() const noexcept { return static_cast<size_t>(bbox.width()); }
+		size_t height() const noexcept { return static_cast<size_t>(bbox.height()); }
+		size_t size() const noexcept { return width() * height(); }
+		size_t num_color_channels() const noexcept { return channels.size() - 1; }
+		std::vector<T>& alpha() noexcept { return channels.back(); }
+
+		/// Create an image buffer over the canvas to composite onto.
+		Render::ImageBuffer<T> image_buffer()
+		{
+			std::unordered_map<int, Render::ChannelBuffer<T>> buffers;
+			for (size_t i = 0; i < num_color_channels(); ++i)
+			{
+				buffers[static_cast<int>(i)] = Render::ChannelBuffer<T>(std::span<T>(channels[i]), width(), height());
+			}
+			buffers[-1] = Render::ChannelBuffer<T>(std::span<T>(alpha()), width(), height());
+			return Render::ImageBuffer<T>(buffers, "canvas");
+		}
+	};
+
+
+	/// The extents of the layer on the canvas, the maximum is exclusive.
+	template <typename T>
+	Geometry::BoundingBox<int> layer_extents(const Layer<T>& layer)
+	{
+		const int left = static_cast<int>(std::round(layer.center_x() - 0.5f * layer.width()));
+		const int top = static_cast<int>(std::round(layer.center_y() - 0.5f * layer.height()));
+		return Geometry::BoundingBox<int>(
+			Geometry::Point2D<int>(left, top),
+			Geometry::Point2D<int>(left + static_cast<int>(layer.width()), top + static_cast<int>(layer.height()))
+		);
+	}
+
+
+	/// Copy the given region out of a buffer of `width` pixels per scanline.
+	template <typename T>
+	std::vector<T> crop_region(const std::vector<T>& data, size_t width, const Geometry::BoundingBox<int>& roi)
+	{
+		const size_t roi_width = static_cast<size_t>(roi.width());
+		std::vector<T> out(roi_width * static_cast<size_t>(roi.height()));
+		for (int y = roi.minimum.y; y < roi.maximum.y; ++y)
+		{
+			auto src = data.begin() + static_cast<size_t>(y) * width + roi.minimum.x;
+			std::copy(src, src + roi_width, out.begin() + static_cast<size_t>(y - roi.minimum.y) * roi_width);
+		}
+		return out;
+	}
+
+
+	/// Retrieve the given layer-local region of a channel, returns std::nullopt if the layer does not hold the channel.
+	template <typename T>
+	std::optional<std::vector<T>> layer_channel_region(
+		FlattenContext<T>& context,
+		const std::shared_ptr<Layer<T>>& layer,
+		ImageDataMixin<T>& image_data,
+		const Geometry::BoundingBox<int>& extents,
+		int index,
+		const Geometry::BoundingBox<int>& roi)
+	{
+		if (auto image_layer = std::dynamic_pointer_cast<ImageLayer<T>>(layer))
+		{
+			const auto indices = image_layer->channel_indices(false);
+			if (std::find(indices.begin(), indices.end(), index) == indices.end())
+			{
+				return std::nullopt;
+			}
+			return image_layer->get_channel(index, roi);
+		}
+
+		auto it = context.cached_data.find(layer.get());
+		if (it == context.cached_data.end())
+		{
+			it = context.cached_data.emplace(layer.get(), std::make_pair(extents.maximum.y, image_data.get_image_data())).first;
+		}
+		const auto& data = it->second.second;
+		if (!data.contains(index))
+		{
+			return std::nullopt;
+		}
+		return crop_region(data.at(index), static_cast<size_t>(extents.width()), roi);
+	}
+
+
+	/// Retrieve the layer mask for the given canvas region, pixels outside of the masks' bbox are filled with the
+	/// masks' default color. Returns std::nullopt if the layer has no (enabled) mask.
+	template <typename T>
+	std::optional<std::vector<T>> layer_mask_region(Layer<T>& layer, const Geometry::BoundingBox<int>& region)
+	{
+		if (!layer.has_mask() || layer.mask_disabled())
+		{
+			return std::nullopt;
+		}
+
+		T default_value = static_cast<T>(layer.mask_default_color() / 255.0f);
+		if constexpr (std::is_integral_v<T>)
+		{
+			default_value = static_cast<T>(std::round(layer.mask_default_color() / 255.0f * std::numeric_limits<T>::max()));
+		}
+		const size_t region_width = static_cast<size_t>(region.width());
+		std::vector<T> mask(region_width * static_cast<size_t>(region.height()), default_value);
+
+		const auto mask_position = layer.mask_position();
+		const int mask_left = static_cast<int>(std::round(mask_position.x - 0.5 * layer.mask_width()));
+		const int mask_top = static_cast<int>(std::round(mask_position.y - 0.5 * layer.mask_height()));
+		const auto mask_extents = Geometry::BoundingBox<int>(
+			Geometry::Point2D<int>(mask_left, mask_top),
+			Geometry::Point2D<int>(mask_left + static_cast<int>(layer.mask_width()), mask_top + static_cast<int>(layer.mask_height()))
+		);
+
+		auto _overlap = Geometry::BoundingBox<int>::intersect(region, mask_extents);
+		if (!_overlap || _overlap->width() == 0 || _overlap->height() == 0)
+		{
+			return mask;
+		}
+		auto overlap = _overlap.value();
+		auto mask_roi = overlap;
+		mask_roi.offset(-mask_extents.minimum);
+		const auto data = layer.get_mask(mask_roi);
+
+		const size_t overlap_width = static_cast<size_t>(overlap.width());
+		for (int y = overlap.minimum.y; y < overlap.maximum.y; ++y)
+		{
+			auto src = data.begin() + static_cast<size_t>(y - overlap.minimum.y) * overlap_width;
+			auto dst = mask.begin() + static_cast<size_t>(y - region.minimum.y) * region_width + (overlap.minimum.x - region.minimum.x);
+			std::copy(src, src + overlap_width, dst);
+		}
+		return mask;
+	}
+
+
+	/// Multiply the clipping alpha into the mask, if there is no mask the clipping alpha becomes the mask.
+	template <typename T>
+	void apply_clip(std::optional<std::vector<T>>& mask, std::vector<T> clip)
+	{
+		if (!mask)
+		{
+			mask = std::move(clip);
+			return;
+		}
+		constexpr float max_t = std::is_integral_v<T> ? static_cast<float>(std::numeric_limits<T>::max()) : 1.0f;
+		std::transform(mask->begin(), mask->end(), clip.begin(), mask->begin(), [](T value, T clip_value)
+			{
+				const float result = static_cast<float>(value) * static_cast<float>(clip_value) / max_t;
+				return static_cast<T>(std::is_integral_v<T> ? std::round(result) : result);
+			});
+	}
+
+
+	/// Whether the given blend mode operates on all color components at once and therefore requires RGB data.
+	inline bool is_nonseparable_blendmode(Enum::BlendMode blend_mode)
+	{
+		switch (blend_mode)
+		{
+		case Enum::BlendMode::DarkerColor:
+		case Enum::BlendMode::LighterColor:
+		case Enum::BlendMode::Hue:
+		case Enum::BlendMode::Saturation:
+		case Enum::BlendMode::Color:
+		case Enum::BlendMode::Luminosity:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+
+	/// Recursively composites a layer hierarchy onto a canvas covering the region of interest. Groups and clipping
+	/// masks are composited into scratch canvases taken from the pool of the context.
+	template <typename T>
+	struct LayerFlattener
+	{
+		FlattenContext<T>& context;
+		Geometry::BoundingBox<int> roi;
+		size_t num_color_channels = 0;
+		bool is_rgb = true;
+
+		/// Composite the given layers (in top-to-bottom order as they are stored) onto the canvas from the bottom up.
+		void composite_stack(const std::vector<std::shared_ptr<Layer<T>>>& layers, FlattenCanvas<T>& canvas)
+		{
+			int index = static_cast<int>(layers.size()) - 1;
+			while (index >= 0)
+			{
+				const auto& base = layers[index];
+
+				// The layers clipped to the base directly follow it in the stack, these are hidden alongside the base.
+				std::vector<std::shared_ptr<Layer<T>>> clipped;
+				int next = index - 1;
+				while (next >= 0 && layers[next] && layers[next]->clipping_mask())
+				{
+					if (layers[next]->visible())
+					{
+						clipped.push_back(layers[next]);
+					}
+					--next;
+				}
+				index = next;
+
+				if (!base || !base->visible())
+				{
+					continue;
+				}
+				if (clipped.empty())
+				{
+					draw_node(base, canvas, false);
+				}
+				else
+				{
+					draw_clipping_group(base, clipped, canvas);
+				}
+			}
+		}
+
+		/// Composite a single layer or group with its own blend mode and opacity. If a clipping alpha (covering the
+		/// region of interest) is given the node is only composited where it is opaque.
+		void draw_node(const std::shared_ptr<Layer<T>>& node, FlattenCanvas<T>& canvas, bool preserve_alpha, const std::vector<T>* clip = nullptr)
+		{
+			if (auto group = std::dynamic_pointer_cast<GroupLayer<T>>(node))
+			{
+				draw_group(group, canvas, group->blendmode(), group->opacity(), preserve_alpha, clip);
+				return;
+			}
+			draw_layer(node, canvas, resolve_blendmode(*node), node->opacity() * node->fill(), preserve_alpha, clip);
+		}
+
+		/// Composite the base layer and the layers clipped to it. Like Photoshops' default of blending clipped layers
+		/// as a group these are composited in isolation with the clipped layers only affecting the opaque parts of the
+		/// base. The result is then composited using the blend mode and opacity of the base.
+		///
+		/// The fill of the base only hides its own pixels, the clipped layers are still clipped to its full coverage.
+		void draw_clipping_group(const std::shared_ptr<Layer<T>>& base, const std::vector<std::shared_ptr<Layer<T>>>& clipped, FlattenCanvas<T>& canvas)
+		{
+			FlattenCanvas<T> scratch(context, roi, num_color_channels);
+			Enum::BlendMode blend_mode = Enum::BlendMode::Normal;
+			auto group = std::dynamic_pointer_cast<GroupLayer<T>>(base);
+			if (group)
+			{
+				draw_group(group, scratch, Enum::BlendMode::Normal, 1.0f, false);
+				if (group->blendmode() != Enum::BlendMode::Passthrough)
+				{
+					blend_mode = resolve_blendmode(*group);
+				}
+			}
+			else
+			{
+				blend_mode = resolve_blendmode(*base);
+			}
+
+			if (group || base->fill() >= 1.0f)
+			{
+				if (!group)
+				{
+					draw_layer(base, scratch, Enum::BlendMode::Normal, 1.0f, false);
+				}
+				for (const auto& layer : clipped)
+				{
+					draw_node(layer, scratch, true);
+				}
+			}
+			else
+			{
+				// The alpha of the scratch no longer describes the coverage of the base so we clip the layers to the 
+				// alpha of the unfilled base instead of preserving the alpha of the scratch
+				std::vector<T> clip;
+				{
+					FlattenCanvas<T> coverage(context, roi, num_color_channels);
+					draw_layer(base, coverage, Enum::BlendMode::Normal, 1.0f, false);
+					clip = coverage.alpha();
+				}
+				draw_layer(base, scratch, Enum::BlendMode::Normal, base->fill(), false);
+				for (const auto& layer : clipped)
+				{
+					draw_node(layer, scratch, false, &clip);
+				}
+			}
+			draw_scratch(scratch, canvas, blend_mode, base->opacity(), std::nullopt, false);
+		}
+
+		/// Composite a group. Pass-through groups composite their children directly onto the backdrop and blend
+		/// between the backdrop and the result using the groups' opacity and mask. All other groups are isolated, i.e.
+		/// their children are composited onto a transparent canvas which is then composited using the groups' blend mode.
+		void draw_group(const std::shared_ptr<GroupLayer<T>>& group, FlattenCanvas<T>& canvas, Enum::BlendMode blend_mode, float opacity, bool preserve_alpha, const std::vector<T>* clip = nullptr)
+		{
+			if (opacity <= 0.0f)
+			{
+				return;
+			}
+			auto mask = layer_mask_region(*group, roi);
+			if (clip)
+			{
+				apply_clip(mask, *clip);
+			}
+
+			if (blend_mode == Enum::BlendMode::Passthrough && !preserve_alpha && !clip)
+			{
+				if (opacity == 1.0f && !mask)
+				{
+					composite_stack(group->layers(), canvas);
+					return;
+				}
+
+				FlattenCanvas<T> scratch(context, roi, num_color_channels);
+				for (size_t i = 0; i < canvas.channels.size(); ++i)
+				{
+					std::copy(canvas.channels[i].begin(), canvas.channels[i].end(), scratch.channels[i].begin());
+				}
+				composite_stack(group->layers(), scratch);
+				blend_with_backdrop(scratch, canvas, opacity, mask);
+				return;
+			}
+
+			if (blend_mode == Enum::BlendMode::Passthrough)
+			{
+				blend_mode = Enum::BlendMode::Normal;
+			}
+			else
+			{
+				blend_mode = resolve_blendmode(*group, blend_mode);
+			}
+			FlattenCanvas<T> scratch(context, roi, num_color_channels);
+			composite_stack(group->layers(), scratch);
+			draw_scratch(scratch, canvas, blend_mode, opacity, std::move(mask), preserve_alpha);
+		}
+
+		/// Composite the part of a pixel layer overlapping the region of interest onto the canvas.
+		void draw_layer(const std::shared_ptr<Layer<T>>& layer, FlattenCanvas<T>& canvas, Enum::BlendMode blend_mode, float opacity, bool preserve_alpha, const std::vector<T>* clip = nullptr)
+		{
+			auto image_data = dynamic_cast<ImageDataMixin<T>*>(layer.get());
+			if (!image_data || layer->width() == 0 || layer->height() == 0 || opacity <= 0.0f)
+			{
+				return;
+			}
+			const auto extents = layer_extents(*layer);
+			auto _region = Geometry::BoundingBox<int>::intersect(extents, roi);
+			if (!_region || _region->width() <= 0 || _region->height() <= 0)
+			{
+				return;
+			}
+			const auto region = _region.value();
+			auto layer_roi = region;
+			layer_roi.offset(-extents.minimum);
+
+			const size_t width = static_cast<size_t>(region.width());
+			const size_t height = static_cast<size_t>(region.height());
+			constexpr float max_t = std::is_integral_v<T> ? static_cast<float>(std::numeric_limits<T>::max()) : 1.0f;
+
+			// The compositing expects colors premultiplied by the alpha, the mask and opacity are applied while compositing
+			auto alpha = layer_channel_region(context, layer, *image_data, extents, -1, layer_roi);
+			std::vector<std::vector<T>> color(num_color_channels);
+			bool has_pixels = alpha.has_value();
+			for (size_t i = 0; i < num_color_channels; ++i)
+			{
+				auto channel = layer_channel_region(context, layer, *image_data, extents, static_cast<int>(i), layer_roi);
+				has_pixels |= channel.has_value();
+				color[i] = std::move(channel).value_or(std::vector<T>(width * height, T{}));
+				if (alpha)
+				{
+					std::transform(color[i].begin(), color[i].end(), alpha->begin(), color[i].begin(), [](T value, T a)
+						{
+							const float result = static_cast<float>(value) * static_cast<float>(a) / max_t;
+							return static_cast<T>(std::is_integral_v<T> ? std::round(result) : result);
+						});
+				}
+			}
+			// Layers holding only a mask have no pixels to contribute
+			if (!has_pixels)
+			{
+				return;
+			}
+			auto mask = layer_mask_region(*layer, region);
+			if (clip)
+			{
+				auto clip_region = region;
+				clip_region.offset(-roi.minimum);
+				apply_clip(mask, crop_region(*clip, canvas.width(), clip_region));
+			}
+
+			// The layers' buffer is positioned by its center relative to the canvas
+			const int position_x = region.minimum.x - roi.minimum.x + static_cast<int>(width / 2);
+			const int position_y = region.minimum.y - roi.minimum.y + static_cast<int>(height / 2);
+			std::unordered_map<int, Render::ConstChannelBuffer<T>> channels;
+			for (size_t i = 0; i < num_color_channels; ++i)
+			{
+				channels[static_cast<int>(i)] = Render::ConstChannelBuffer<T>(std::span<const T>(color[i]), width, height, position_x, position_y);
+			}
+			if (alpha)
+			{
+				channels[-1] = Render::ConstChannelBuffer<T>(std::span<const T>(alpha.value()), width, height, position_x, position_y);
+			}
+			if (mask)
+			{
+				channels[-2] = Render::ConstChannelBuffer<T>(std::span<const T>(mask.value()), width, height, position_x, position_y);
+			}
+			auto layer_buffer = Render::ConstImageBuffer<T>(channels, layer->name(), 0, Geometry::Point2D<int>(position_x, position_y), opacity);
+			auto canvas_buffer = canvas.image_buffer();
+			Composite::composite_rgb<T, float>(canvas_buffer, layer_buffer, blend_mode, preserve_alpha);
+		}
+
+		/// Composite a scratch canvas covering the region of interest onto the canvas.
+		void draw_scratch(FlattenCanvas<T>& scratch, FlattenCanvas<T>& canvas, Enum::BlendMode blend_mode, float opacity, std::optional<std::vector<T>> mask, bool preserve_alpha)
+		{
+			const size_t width = scratch.width();
+			const size_t height = scratch.height();
+			const int position_x = static_cast<int>(width / 2);
+			const int position_y = static_cast<int>(height / 2);
+
+			std::unordered_map<int, Render::ConstChannelBuffer<T>> channels;
+			for (size_t i = 0; i < scratch.num_color_channels(); ++i)
+			{
+				channels[static_cast<int>(i)] = Render::ConstChannelBuffer<T>(std::span<const T>(scratch.channels[i]), width, height, position_x, position_y);
+			}
+			channels[-1] = Render::ConstChannelBuffer<T>(std::span<const T>(scratch.alpha()), width, height, position_x, position_y);
+			if (mask)
+			{
+				channels[-2] = Render::ConstChannelBuffer<T>(std::span<const T>(mask.value()), width, height, position_x, position_y);
+			}
+			auto layer_buffer = Render::ConstImageBuffer<T>(channels, "scratch", 0, Geometry::Point2D<int>(position_x, position_y), opacity);
+			auto canvas_buffer = canvas.image_buffer();
+			Composite::composite_rgb<T, float>(canvas_buffer, layer_buffer, blend_mode, preserve_alpha);
+		}
+
+		/// Interpolate between the backdrop (canvas) and the composited result by the given opacity and mask.
+		void blend_with_backdrop(FlattenCanvas<T>& result, FlattenCanvas<T>& canvas, float opacity, const std::optional<std::vector<T>>& mask)
+		{
+			constexpr float max_t = std::is_integral_v<T> ? static_cast<float>(std::numeric_limits<T>::max()) : 1.0f;
+			for (size_t c = 0; c < canvas.channels.size(); ++c)
+			{
+				auto& backdrop = canvas.channels[c];
+				const auto& composited = result.channels[c];
+				for (size_t i = 0; i < backdrop.size(); ++i)
+				{
+					const float weight = mask ? opacity * static_cast<float>(mask.value()[i]) / max_t : opacity;
+					const float value = static_cast<float>(backdrop[i]) + (static_cast<float>(composited[i]) - static_cast<float>(backdrop[i])) * weight;
+					backdrop[i] = static_cast<T>(std::is_integral_v<T> ? std::round(value) : value);
+				}
+			}
+		}
+
+		/// Resolve the blend mode to composite the layer with, falling back to Normal for unsupported blend modes.
+		Enum::BlendMode resolve_blendmode(const Layer<T>& layer, std::optional<Enum::BlendMode> blend_mode = std::nullopt)
+		{
+			const auto mode = blend_mode.value_or(layer.blendmode());
+			if (mode == Enum::BlendMode::Dissolve || mode == Enum::BlendMode::Passthrough || (!is_rgb && is_nonseparable_blendmode(mode)))
+			{
+				if (context.warned.insert(&layer).second)
+				{
+					PSAPI_LOG_WARNING("Flatten", "The blend mode of layer '%s' is not supported for flattening, it will be composited as 'Normal'", layer.name().c_str());
+				}
+				return Enum::BlendMode::Normal;
+			}
+			return mode;
+		}
+	};
+
+
+	/// Flatten the given layers (in top-to-bottom order) into the region of interest of the canvas, returning the color
+	/// channels alongside the alpha on index -1. Each channel holds `roi.width() * roi.height()` pixels.
+	///
+	/// \throws std::invalid_argument if the color mode is neither RGB nor Grayscale
+	template <typename T>
+	std::unordered_map<int, std::vector<T>> flatten_layers(
+		const std::vector<std::shared_ptr<Layer<T>>>& layers,
+		Enum::ColorMode colormode,
+		const Geometry::BoundingBox<int>& roi,
+		const FlattenOptions& options,
+		FlattenContext<T>& context)
+	{
+		PSAPI_PROFILE_FUNCTION();
+		if (colormode != Enum::ColorMode::RGB && colormode != Enum::ColorMode::Grayscale)
+		{
+			throw std::invalid_argument("Flattening layers is only supported for RGB and Grayscale documents");
+		}
+
+		const size_t num_color_channels = colormode == Enum::ColorMode::RGB ? 3u : 1u;
+		LayerFlattener<T> flattener{ context, roi, num_color_channels, colormode == Enum::ColorMode::RGB };
+		FlattenCanvas<T> canvas(context, roi, num_color_channels);
+		flattener.composite_stack(layers, canvas);
+
+		constexpr float max_t = std::is_integral_v<T> ? static_cast<float>(std::numeric_limits<T>::max()) : 1.0f;
+		const auto& alpha = canvas.alpha();
+		std::unordered_map<int, std::vector<T>> result;
+		for (size_t c = 0; c < num_color_channels; ++c)
+		{
+			auto channel = std::move(canvas.channels[c]);
+			if (options.matte)
+			{
+				const float background = options.matte.value() * max_t;
+				std::transform(channel.begin(), channel.end(), alpha.begin(), channel.begin(), [&](T value, T a)
+					{
+						const float matted = static_cast<float>(value) + background * (1.0f - static_cast<float>(a) / max_t);
+						if constexpr (std::is_integral_v<T>)
+						{
+							return static_cast<T>(std::clamp(std::round(matted), 0.0f, max_t));
+						}
+						return static_cast<T>(matted);
+					});
+			}
+			else if (!options.premultiplied)
+			{
+				std::transform(channel.begin(), channel.end(), alpha.begin(), channel.begin(), [&](T value, T a)
+					{
+						if (a == T{})
+						{
+							return T{};
+						}
+						const float straight = static_cast<float>(value) * max_t / static_cast<float>(a);
+						if constexpr (std::is_integral_v<T>)
+						{
+							return static_cast<T>(std::clamp(std::round(straight), 0.0f, max_t));
+						}
+						return static_cast<T>(straight);
+					});
+			}
+			result[static_cast<int>(c)] = std::move(channel);
+		}
+		result[-1] = std::move(canvas.alpha());
+		return result;
+	}
+}
+
+
+PSAPI_NAMESPACE_END
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Macros.h"
+#include "Util/Enum.h"
+#include "Core/Geometry/BoundingBox.h"
+#include "Core/Compression/Compress_RLE.h"
+#include "Core/Endian/EndianByteSwapArr.h"
+#include "PhotoshopFile/ImageData.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/Util/Flatten.h"
+#include "LayeredFile/LayerTypes/Layer.h"
+#include "Profiling/Perf/Instrumentor.h"
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <span>
+
+PSAPI_NAMESPACE_BEGIN
+
+
+namespace _Impl
+{
+	/// The number of scanlines flattened at once while generating the merged image data. Only the pixels of a single band
+	/// are ever held decoded, the finished band is immediately RLE compressed.
+	constexpr int s_composite_band_height = 256;
+
+	/// RLE compress the scanlines of a single band of a channel, appending them to the compressed data and scanline sizes.
+	template <typename T>
+	void compress_band(std::vector<T>& band_data, size_t width, size_t height, std::vector<uint8_t>& compressed, std::vector<uint32_t>& scanline_sizes)
+	{
+		endianEncodeBEArray(std::span<T>(band_data));
+
+		std::vector<uint32_t> sizes = RLE_Impl::CompressScanlines(std::span<const T>(band_data), static_cast<uint32_t>(width), static_cast<uint32_t>(height), compressed, compressed.size());
+		scanline_sizes.insert(scanline_sizes.end(), sizes.begin(), sizes.end());
+	}
+}
+
+
+/// Generate the ImageData section based on the layeredFile. Unless `write_composite()` is set this section holds
+/// an empty composite. Otherwise the layers are flattened band by band (see `LayeredFile::flatten()`) and the result 
+/// is RLE compressed on the fly such that only a single band of pixels is ever held decoded. Transparent areas are
+/// matted against white similar to how Photoshop stores its composite.
+///
+/// This must be called before the layer data is consumed by e.g. `generate_layermaskinfo()`.
+template <typename T>
+ImageData generate_imagedata(LayeredFile<T>& layered_file)
+{
+	PSAPI_PROFILE_FUNCTION();
+	const uint16_t num_channels = layered_file.num_channels();
+	if (!layered_file.write_composite())
+	{
+		return ImageData(num_channels);
+	}
+	if (layered_file.colormode() != Enum::ColorMode::RGB && layered_file.colormode() != Enum::ColorMode::Grayscale)
+	{
+		PSAPI_LOG_WARNING("ImageData", "Generating the merged composite is only supported for RGB and Grayscale files, writing an empty composite instead");
+		return ImageData(num_channels);
+	}
+
+	const uint16_t num_color_channels = _Impl::num_color_channels(layered_file.colormode());
+	const int width = static_cast<int>(layered_file.width());
+	const int height = static_cast<int>(layered_file.height());
+
+	std::vector<std::vector<uint8_t>> compressed(num_channels);
+	std::vector<std::vector<uint32_t>> scanline_sizes(num_channels);
+	for (auto& sizes : scanline_sizes)
+	{
+		sizes.reserve(layered_file.height());
+	}
+
+	// Matte the composite against white like Photoshop does
+	FlattenOptions options{};
+	options.matte = 1.0f;
+	_Impl::FlattenContext<T> context{};
+	for (int band_top = 0; band_top < height; band_top += _Impl::s_composite_band_height)
+	{
+		const int band_bottom = std::min(band_top + _Impl::s_composite_band_height, height);
+		const size_t band_height = static_cast<size_t>(band_bottom - band_top);
+		const auto band = Geometry::BoundingBox<int>(Geometry::Point2D<int>(0, band_top), Geometry::Point2D<int>(width, band_bottom));
+
+		auto band_data = _Impl::flatten_layers<T>(layered_file.layers(), layered_file.colormode(), band, options, context);
+		// Release any fully evaluated layers once we are past them
+		context.release_cached_above(band_bottom);
+
+		for (uint16_t i = 0; i < num_channels; ++i)
+		{
+			if (i < num_color_channels)
+			{
+				_Impl::compress_band(band_data.at(i), static_cast<size_t>(width), band_height, compressed[i], scanline_sizes[i]);
+			}
+			else if (i == num_color_channels)
+			{
+				_Impl::compress_band(band_data.at(-1), static_cast<size_t>(width), band_height, compressed[i], scanline_sizes[i]);
+			}
+			else
+			{
+				auto empty = std::vector<T>(static_cast<size_t>(width) * band_height, T{});
+				_Impl::compress_band(empty, static_cast<size_t>(width), band_height, compressed[i], scanline_sizes[i]);
+			}
+		}
+	}
+
+	return ImageData(num_channels, std::move(compressed), std::move(scanline_sizes));
+}
+
+
+PSAPI_NAMESPACE_END
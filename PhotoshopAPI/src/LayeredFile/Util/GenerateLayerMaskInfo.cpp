@@ -17,7 +17,7 @@ PSAPI_NAMESPACE_BEGIN
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <typename T>
-LayerAndMaskInformation generate_layermaskinfo(LayeredFile<T>& layeredFile, std::filesystem::path file_path)
+LayerAndMaskInformation generate_layermaskinfo(LayeredFile<T>& layeredFile, std::filesystem::path file_path, std::optional<int> zip_level)
 {
 	PSAPI_LOG_ERROR("LayeredFile", "Cannot construct layer and mask information section if type is not uint8_t, uint16_t or float32_t");
 	return LayerAndMaskInformation();
@@ -26,9 +26,9 @@ LayerAndMaskInformation generate_layermaskinfo(LayeredFile<T>& layeredFile, std:
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <>
-LayerAndMaskInformation generate_layermaskinfo(LayeredFile<uint8_t>& layeredFile,std::filesystem::path file_path)
+LayerAndMaskInformation generate_layermaskinfo(LayeredFile<uint8_t>& layeredFile, std::filesystem::path file_path, std::optional<int> zip_level)
 {
-	LayerInfo lrInfo = generate_layerinfo<uint8_t>(layeredFile);
+	LayerInfo lrInfo = generate_layerinfo<uint8_t>(layeredFile, zip_level);
 	// This section is mainly there for backwards compatibility it seems and from initial testing
 	// does not appear to really be relevant for documents
 	GlobalLayerMaskInfo maskInfo{};
@@ -59,10 +59,10 @@ LayerAndMaskInformation generate_layermaskinfo(LayeredFile<uint8_t>& layeredFile
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <>
-LayerAndMaskInformation generate_layermaskinfo(LayeredFile<uint16_t>& layeredFile, std::filesystem::path file_path)
+LayerAndMaskInformation generate_layermaskinfo(LayeredFile<uint16_t>& layeredFile, std::filesystem::path file_path, std::optional<int> zip_level)
 {
 	LayerInfo emptyLrInfo{};
-	LayerInfo lrInfo = generate_layerinfo<uint16_t>(layeredFile);
+	LayerInfo lrInfo = generate_layerinfo<uint16_t>(layeredFile, zip_level);
 	// This section is mainly there for backwards compatibility it seems and from initial testing
 	// does not appear to really be relevant for documents
 	GlobalLayerMaskInfo maskInfo{};
@@ -92,10 +92,10 @@ LayerAndMaskInformation generate_layermaskinfo(LayeredFile<uint16_t>& layeredFil
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <>
-LayerAndMaskInformation generate_layermaskinfo(LayeredFile<float32_t>& layeredFile, std::filesystem::path file_path)
+LayerAndMaskInformation generate_layermaskinfo(LayeredFile<float32_t>& layeredFile, std::filesystem::path file_path, std::optional<int> zip_level)
 {
 	LayerInfo emptyLrInfo{};
-	LayerInfo lrInfo = generate_layerinfo<float32_t>(layeredFile);
+	LayerInfo lrInfo = generate_layerinfo<float32_t>(layeredFile, zip_level);
 	// This section is mainly there for backwards compatibility it seems and from initial testing
 	// does not appear to really be relevant for documents
 	GlobalLayerMaskInfo maskInfo{};
@@ -125,7 +125,7 @@ LayerAndMaskInformation generate_layermaskinfo(LayeredFile<float32_t>& layeredFi
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <typename T>
-LayerInfo generate_layerinfo(LayeredFile<T>& layeredFile)
+LayerInfo generate_layerinfo(LayeredFile<T>& layeredFile, std::optional<int> zip_level)
 {
 	// We must first for each layer generate a layer records as well as channelImageData using the reversed flat layers
 	std::vector<std::shared_ptr<Layer<T>>> flatLayers = layeredFile.flat_layers(std::nullopt, LayerOrder::reverse);
@@ -146,7 +146,9 @@ LayerInfo generate_layerinfo(LayeredFile<T>& layeredFile)
 		imageData.push_back(std::move(lrImageData));
 	}
 
-	return LayerInfo(std::move(layerRecords), std::move(imageData));
+	LayerInfo lrInfo(std::move(layerRecords), std::move(imageData));
+	lrInfo.m_ZipLevel = zip_level;
+	return lrInfo;
 }
 
 
@@ -6,17 +6,19 @@
 #include "LayeredFile/LayeredFile.h"
 
 #include <memory>
+#include <optional>
 
 PSAPI_NAMESPACE_BEGIN
 
 
-// Generate a layer and mask information section based on the information in the LayeredFile
+// Generate a layer and mask information section based on the information in the LayeredFile. The zip level
+// is the file-wide zip compression level the layer image data will be written with, if set.
 template <typename T>
-LayerAndMaskInformation generate_layermaskinfo(LayeredFile<T>& layeredFile, std::filesystem::path file_path);
+LayerAndMaskInformation generate_layermaskinfo(LayeredFile<T>& layeredFile, std::filesystem::path file_path, std::optional<int> zip_level = std::nullopt);
 
 
 template <typename T>
-LayerInfo generate_layerinfo(LayeredFile<T>& layeredFile);
+LayerInfo generate_layerinfo(LayeredFile<T>& layeredFile, std::optional<int> zip_level = std::nullopt);
 
 
 // Generates the accompanying layer data (LayerRecord and ChannelImageData) for each of the layers in the scene
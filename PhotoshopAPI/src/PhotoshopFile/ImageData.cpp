@@ -0,0 +1,65 @@
+#include "ImageData.h"
+
+#include "FileHeader.h"
+#include "Macros.h"
+#include "Enum.h"
+#include "Core/FileIO/Read.h"
+#include "Core/Struct/File.h"
+#include "Core/Struct/Section.h"
+#include "Profiling/Perf/Instrumentor.h"
+
+#include <vector>
+#include <memory>
+#include <filesystem>
+
+#include <cstdint>
+
+PSAPI_NAMESPACE_BEGIN
+
+
+// --------------------------------------------------------------------------------
+// --------------------------------------------------------------------------------
+void ImageData::read(File& document, const FileHeader& header, const uint64_t offset)
+{
+	PSAPI_PROFILE_FUNCTION();
+
+	FileSection::initialize(offset, 0u);
+	if (offset + 2u > document.getSize())
+	{
+		PSAPI_LOG_WARNING("ImageData", "Document does not contain a merged image data section, skipping it");
+		return;
+	}
+	FileSection::size(document.getSize() - offset);
+
+	document.setOffset(offset);
+	m_Compression = Enum::compressionMap.at(ReadBinaryData<uint16_t>(document));
+	m_Header = header;
+	m_NumChannels = header.m_NumChannels;
+	m_DataOffset = offset + 2u;
+	m_DataSize = FileSection::size() - 2u;
+
+	// If the document is kept alive by lazily decoded channels we can reference it directly, otherwise we only
+	// remember where to find the payload as the composite is rarely accessed and may be very large.
+	if (document.lazyChannelData())
+	{
+		if (auto sharedDocument = document.weak_from_this().lock())
+		{
+			m_Document = std::move(sharedDocument);
+			return;
+		}
+	}
+	if (const auto path = document.getPath(); !path.empty())
+	{
+		m_Path = std::filesystem::absolute(path);
+		m_WriteTime = std::filesystem::last_write_time(m_Path);
+		m_FileSize = document.getSize();
+		return;
+	}
+	// Documents read from memory cannot be reopened so we hold on to a copy of the compressed payload
+	auto data = std::make_shared<std::vector<uint8_t>>(m_DataSize);
+	document.readFromOffset(std::span<uint8_t>(*data), m_DataOffset);
+	m_Data = std::move(data);
+}
+
+
+PSAPI_NAMESPACE_END
@@ -4,11 +4,20 @@
 #include "Util/Enum.h"
 #include "Core/Struct/File.h"
 #include "Core/Struct/Section.h"
+#include "Core/Struct/ByteStream.h"
+#include "Core/FileIO/Read.h"
 #include "Core/FileIO/Write.h"
+#include "Core/Compression/Compression.h"
 #include "Core/Compression/Compress_RLE.h"
+#include "PhotoshopFile/FileHeader.h"
 
 #include "blosc2.h"
 
+#include <memory>
+#include <vector>
+#include <limits>
+#include <filesystem>
+
 
 PSAPI_NAMESPACE_BEGIN
 
@@ -56,6 +65,40 @@ namespace ImageDataImpl
 		}
 	}
 
+	/// Write out channels that were already RLE compressed, the scanline sizes are stored as uint32_t regardless of 
+	/// the version and only narrowed on write as the version is only known once we write.
+	inline void writePrecompressedData(File& document, const FileHeader& header, const std::vector<std::vector<uint32_t>>& scanlineSizes, std::vector<std::vector<uint8_t>>& compressedData)
+	{
+		// First write all the scanline sizes, then the compressed data
+		for (const auto& channelSizes : scanlineSizes)
+		{
+			if (header.m_Version == Enum::Version::Psd)
+			{
+				std::vector<uint16_t> narrowedSizes(channelSizes.size());
+				for (size_t i = 0; i < channelSizes.size(); ++i)
+				{
+					if (channelSizes[i] > (std::numeric_limits<uint16_t>::max)()) [[unlikely]]
+					{
+						PSAPI_LOG_ERROR("ImageData", "Scanline size would exceed the size of a uint16_t, this is not valid");
+					}
+					narrowedSizes[i] = static_cast<uint16_t>(channelSizes[i]);
+				}
+				WriteBinaryArray<uint16_t>(document, std::move(narrowedSizes));
+			}
+			else
+			{
+				// we must copy here as we otherwise byteswap the stored sizes
+				auto data = channelSizes;
+				WriteBinaryArray<uint32_t>(document, std::move(data));
+			}
+		}
+		for (auto& channelData : compressedData)
+		{
+			// Single bytes are not affected by the endian encoding so we can write these directly
+			WriteBinaryArray<uint8_t>(document, channelData);
+		}
+	}
+
 	template <typename T>
 	void writeRawData(File& document, const FileHeader& header, std::vector<T>&& uncompressedData)
 	{
@@ -68,16 +111,78 @@ namespace ImageDataImpl
 ///
 /// When writing out data we fill it with empty pixels using Rle compression, this is due to Photoshop unfortunately requiring
 /// it to be present. Due to this compression step we can usually save lots of data over what Photoshop writes out
+///
+/// On read we only parse the compression marker and remember where the compressed payload is stored, the composite is 
+/// only read and decoded once requested through `decode()`. For documents read with lazy channel data the payload is
+/// read from the source document which is kept open, otherwise the document is reopened from its path.
 struct ImageData : public FileSection
 {
+	/// Read the section starting at the given offset, this spans until the end of the document.
+	void read(File& document, const FileHeader& header, const uint64_t offset);
+
+	/// Whether the section holds any composite data, this is false for sections that were not read from a document.
+	bool hasData() const noexcept { return m_Document != nullptr || m_Data != nullptr || !m_Path.empty(); }
+
+	/// The compression codec the composite is stored with on disk
+	Enum::Compression compression() const noexcept { return m_Compression; }
+
+	/// Decode the composite into its individual channels. These are stored in the order of the color mode
+	/// (e.g. R, G, B for RGB) followed by any alpha channels and each hold exactly width * height pixels.
+	/// Returns an empty vector if `hasData()` is false.
+	///
+	/// \throws std::runtime_error if the source document had to be reopened but was modified since it was read
+	template <typename T>
+	std::vector<std::vector<T>> decode() const
+	{
+		PSAPI_PROFILE_FUNCTION();
+		if (!this->hasData())
+		{
+			return {};
+		}
+
+		std::shared_ptr<File> document = m_Document;
+		if (!document && !m_Path.empty())
+		{
+			std::error_code ec;
+			const auto writeTime = std::filesystem::last_write_time(m_Path, ec);
+			if (ec || writeTime != m_WriteTime || std::filesystem::file_size(m_Path, ec) != m_FileSize)
+			{
+				PSAPI_LOG_ERROR("ImageData", "Unable to decode the merged image data as '%s' was modified or removed since it was read",
+					m_Path.string().c_str());
+			}
+			document = std::make_shared<File>(m_Path);
+		}
+		ByteStream stream = document ? ByteStream(*document, m_DataOffset, m_DataSize) : ByteStream(*m_Data);
+		const uint32_t width = m_Header.m_Width;
+		const uint32_t height = m_Header.m_Height;
+		const uint64_t channelSize = static_cast<uint64_t>(width) * height;
+
+		// The channels are stored back to back and for RLE all the scanline sizes are stored at the start of the section, 
+		// this means we can decode the whole section as one image of height * numChannels scanlines
+		std::vector<T> data(channelSize * m_Header.m_NumChannels);
+		DecompressData<T>(stream, std::span<T>(data), 0u, m_Compression, m_Header, width, height * m_Header.m_NumChannels, m_DataSize);
+
+		std::vector<std::vector<T>> channels(m_Header.m_NumChannels);
+		for (size_t i = 0; i < channels.size(); ++i)
+		{
+			channels[i] = std::vector<T>(data.begin() + i * channelSize, data.begin() + (i + 1) * channelSize);
+		}
+		return channels;
+	}
 
-	/// Write out an empty image data section from the number of channels. This section is unfortunately required
+	/// Write out the image data section, if the section was initialized with precompressed channels these are written,
+	/// otherwise we write an empty image data section from the number of channels. This section is unfortunately required
 	inline void write(File& document, const FileHeader& header)
 	{
 		// Compression marker, we default to RLE compression to reduce the size significantly. The way in which the scanlines are stored
 		// is slightly different though. All the channels store their scanline sizes at the start of the ImageData section rather than
 		// at the start of each channel
 		WriteBinaryData<uint16_t>(document, 1u);
+		if (!m_CompressedChannels.empty())
+		{
+			ImageDataImpl::writePrecompressedData(document, header, m_ScanlineSizes, m_CompressedChannels);
+			return;
+		}
 		// Write out empty data for all of the channels
 		if (header.m_Depth == Enum::BitDepth::BD_8)
 		{
@@ -102,8 +207,42 @@ struct ImageData : public FileSection
 	/// from the header as the header counts alpha channels while this does not!
 	ImageData(uint16_t numChannels) : m_NumChannels(numChannels) {};
 
+	/// Initialize the ImageData with a merged composite that was already RLE compressed, holding `numChannels` channels
+	/// with the scanline sizes and compressed scanlines of each channel. See `generate_imagedata()` for how this is 
+	/// generated from a LayeredFile.
+	ImageData(uint16_t numChannels, std::vector<std::vector<uint8_t>> compressedChannels, std::vector<std::vector<uint32_t>> scanlineSizes) :
+		m_NumChannels(numChannels), m_CompressedChannels(std::move(compressedChannels)), m_ScanlineSizes(std::move(scanlineSizes))
+	{
+		if (m_CompressedChannels.size() != numChannels || m_ScanlineSizes.size() != numChannels)
+		{
+			PSAPI_LOG_ERROR("ImageData", "Expected precompressed data for %u channels but got %zu channels with %zu scanline sizes",
+				numChannels, m_CompressedChannels.size(), m_ScanlineSizes.size());
+		}
+	};
+
 private:
 	uint16_t m_NumChannels = 0u;
+
+	/// RLE compressed scanlines of each channel to write, if empty we write an empty composite instead
+	std::vector<std::vector<uint8_t>> m_CompressedChannels;
+	/// The compressed size of each scanline per channel in m_CompressedChannels
+	std::vector<std::vector<uint32_t>> m_ScanlineSizes;
+
+	/// The header of the document the section was read from, required for decoding
+	FileHeader m_Header{};
+	Enum::Compression m_Compression = Enum::Compression::Raw;
+	/// The source document, only held if it was read with lazy channel data in which case we decode straight from it
+	std::shared_ptr<File> m_Document = nullptr;
+	/// The path of the source document to reopen on decode if it is not held. The write time and size are used to
+	/// detect whether it was modified in the meantime
+	std::filesystem::path m_Path{};
+	std::filesystem::file_time_type m_WriteTime{};
+	uint64_t m_FileSize = 0u;
+	/// A copy of the compressed payload for documents read from memory as these cannot be reopened
+	std::shared_ptr<const std::vector<uint8_t>> m_Data = nullptr;
+	/// Offset and size of the compressed payload in the source document, excluding the compression marker
+	uint64_t m_DataOffset = 0u;
+	uint64_t m_DataSize = 0u;
 };
 
 
@@ -12,12 +12,13 @@
 #include "FileUtil.h"
 #include "Profiling/Perf/Instrumentor.h"
 #include "Util/CoordinateUtil.h"
+#include "Util/ScratchArena.h"
+#include "Util/Parallel.h"
 
 #include "libdeflate.h"
 
 #include <variant>
 #include <algorithm>
-#include <execution>
 #include <limits>
 
 #define __STDC_FORMAT_MACROS 1
@@ -596,7 +597,7 @@ void LayerRecord::read(File& document, const FileHeader& header, ProgressCallbac
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
-void LayerRecord::write(File& document, const FileHeader& header, ProgressCallback& callback, std::vector<LayerRecords::ChannelInformation> channelInfos) const
+std::vector<uint64_t> LayerRecord::write(File& document, const FileHeader& header, ProgressCallback& callback, std::vector<LayerRecords::ChannelInformation> channelInfos) const
 {
 	WriteBinaryData<uint32_t>(document, m_Top);
 	WriteBinaryData<uint32_t>(document, m_Left);
@@ -610,9 +611,12 @@ void LayerRecord::write(File& document, const FileHeader& header, ProgressCallba
 	if (channelInfos.size() != m_ChannelCount)
 		PSAPI_LOG_ERROR("LayerRecord", "The provided channelInfo vec does not have the same amount of channels as m_ChanneCount, expected %i but got %i instead",
 			m_ChannelCount, channelInfos.size());
+	std::vector<uint64_t> sizeOffsets;
+	sizeOffsets.reserve(channelInfos.size());
 	for (const auto& info : channelInfos)
 	{
 		WriteBinaryData<int16_t>(document, info.m_ChannelID.index);
+		sizeOffsets.push_back(document.getOffset());
 		WriteBinaryDataVariadic<uint32_t, uint64_t>(document, info.m_Size, header.m_Version);
 	}
 
@@ -653,6 +657,7 @@ void LayerRecord::write(File& document, const FileHeader& header, ProgressCallba
 			m_AdditionalLayerInfo.value().write(document, header, callback);
 		}
 	}
+	return sizeOffsets;
 }
 
 
@@ -675,7 +680,7 @@ uint32_t LayerRecord::getHeight() const noexcept
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 template <typename T>
-std::vector<std::vector<uint8_t>> ChannelImageData::compressData(const FileHeader& header, std::vector<LayerRecords::ChannelInformation>& lrChannelInfo, std::vector<Enum::Compression>& lrCompression)
+std::vector<std::vector<uint8_t>> ChannelImageData::compressData(const FileHeader& header, const ProgressCallback& callback, std::vector<LayerRecords::ChannelInformation>& lrChannelInfo, std::vector<Enum::Compression>& lrCompression, const std::optional<int> zipLevel)
 {
 	PSAPI_PROFILE_FUNCTION();
 
@@ -687,46 +692,58 @@ std::vector<std::vector<uint8_t>> ChannelImageData::compressData(const FileHeade
 	std::vector<std::vector<uint8_t>> compressedData;
 	compressedData.reserve(m_ImageData.size());
 
+	// Channels which still hold the payload they were read with and whose compression didn't change are written
+	// as-is, so we only have to size our scratch buffers for the ones that actually get re-encoded
+	auto writeCompression = [](const channel_wrapper& channel)
+		{
+			// In 32-bit mode Photoshop insists on the data being prediction encoded even if the compression mode is set to zip
+			// to probably get better compression. We switch to ZipPrediction in that case
+			if constexpr (std::is_same_v<T, float32_t>)
+			{
+				if (channel.compression_codec() == Enum::Compression::Zip)
+				{
+					return Enum::Compression::ZipPrediction;
+				}
+			}
+			return channel.compression_codec();
+		};
+	// The channels' own zip level takes precedence over the one we write the file with
+	auto writeZipLevel = [&](const channel_wrapper& channel)
+		{
+			return channel.zip_level().value_or(zipLevel.value_or(ZIP_COMPRESSION_LVL));
+		};
+	auto needsEncoding = [&](const std::unique_ptr<channel_wrapper>& channel)
+		{
+			if (channel == nullptr)
+			{
+				return false;
+			}
+			const auto compression = writeCompression(*channel);
+			const bool isZip = compression == Enum::Compression::Zip || compression == Enum::Compression::ZipPrediction;
+			return !channel->is_passthrough(compression, header) || (isZip && zipLevel.has_value());
+		};
+	const bool hasEncodedChannels = std::any_of(m_ImageData.begin(), m_ImageData.end(), needsEncoding);
+
 	// We create a scratch buffer here which we use to store data for compression since we need a sufficiently large buffer to compress into but
 	// then at the end want to shrink to the desired size. So here we create one that can accomodate any level of compression and then finally copy
-	// the buffers out after decompression in order to not allocate the buffer at each step of the way
-	std::vector<uint8_t> buffer;
-	libdeflate_compressor* compressor = libdeflate_alloc_compressor(ZIP_COMPRESSION_LVL);
+	// the buffers out after decompression in order to not allocate the buffer at each step of the way. Both this and the
+	// channel buffer below come from the thread's scratch arena so they are reused across layers and files
+	Scratch::Buffer compressionScratch;
+	std::span<uint8_t> buffer;
+	if (hasEncodedChannels)
 	{
 		PSAPI_PROFILE_SCOPE("Allocate compression buffer");
-		size_t maxWidth = 0;
-		size_t maxHeight = 0;
+		size_t maxCompressedSize = 0;
 		for (const auto& channel : m_ImageData)
 		{
-			size_t width = channel->width();
-			size_t height = channel->height();
-			if (width > maxWidth)
-				maxWidth = width;
-			if (height > maxHeight)
-				maxHeight = height;
-		}
-
-		// We filter RLE early here if its not present since RLE at worst has a compression overhead of ~33% while ZIP has
-		// <1% so we dont want to spend time allocating a buffer we wont need
-		bool hasRLE = false;
-		for (const auto& channel : m_ImageData)
-		{
-			if (channel->compression_codec() == Enum::Compression::Rle)
-				hasRLE = true;
-		}
-		// Compute the maximum necessary size to fit all of our compression needs and fill the buffer with that information
-		if (hasRLE)
-		{
-			size_t maxRLESize = RLE_Impl::MaxCompressedSize<T>(header, maxHeight, maxWidth);
-			size_t maxZIPSize = libdeflate_zlib_compress_bound(compressor, static_cast<uint64_t>(maxWidth) * maxHeight * sizeof(T));
-			size_t maxCompressedSize = std::max(maxRLESize, maxZIPSize);
-			buffer = std::vector<uint8_t>(maxCompressedSize);
-		}
-		else
-		{
-			size_t maxZIPSize = libdeflate_zlib_compress_bound(compressor, static_cast<uint64_t>(maxWidth) * maxHeight * sizeof(T));
-			buffer = std::vector<uint8_t>(maxZIPSize);
+			// RLE sizes its scanlines up front and compresses them straight into the output so it needs no scratch buffer
+			if (!needsEncoding(channel) || channel->compression_codec() == Enum::Compression::Rle)
+				continue;
+			const size_t channelSize = static_cast<size_t>(channel->width()) * channel->height() * sizeof(T);
+			maxCompressedSize = std::max(maxCompressedSize, ZIP_Impl::CompressBound(channelSize, writeZipLevel(*channel)));
 		}
+		compressionScratch = Scratch::acquire<uint8_t>(maxCompressedSize);
+		buffer = compressionScratch.as<uint8_t>(maxCompressedSize);
 	}
 
 	// Allocate a buffer we can use as scratch for the channel extraction that way we dont have to regenerate a buffer for each iteration.
@@ -734,51 +751,63 @@ std::vector<std::vector<uint8_t>> ChannelImageData::compressData(const FileHeade
 	size_t maxSize = 0;
 	for (const auto& channel : m_ImageData)
 	{
+		if (!needsEncoding(channel))
+			continue;
 		size_t size = static_cast<size_t>(channel->width()) * channel->height();
 		if (maxSize < size)
 		{
 			maxSize = size;
 		}
 	}
-	std::vector<T> channelDataBuffer;
+	Scratch::Buffer channelScratch;
+	std::span<T> channelDataBuffer;
 	{
 		PSAPI_PROFILE_SCOPE("Allocate channel buffer");
-		channelDataBuffer = std::vector<T>(maxSize);
+		channelScratch = Scratch::acquire<T>(maxSize);
+		channelDataBuffer = channelScratch.as<T>(maxSize);
 	}
 
 	for (int i = 0; i < m_ImageData.size(); ++i)
 	{
-		// Take ownership of and invalidate the current channel index
-		std::unique_ptr<channel_wrapper> imageChannelPtr = std::move(m_ImageData[i]);
-		if (imageChannelPtr == nullptr) [[unlikely]]
+		callback.throwIfCancelled();
+		if (m_ImageData[i] == nullptr) [[unlikely]]
 		{
 			PSAPI_LOG_WARNING("ChannelImageData", "Channel %i no longer contains any data, was it extracted beforehand?", i);
 			return std::vector<std::vector<uint8_t>>();
 		}
+		const bool encode = needsEncoding(m_ImageData[i]);
+
+		// Take ownership of and invalidate the current channel index
+		std::unique_ptr<channel_wrapper> imageChannelPtr = std::move(m_ImageData[i]);
 		m_ImageData[i] = nullptr;
 
 		const auto& width = imageChannelPtr->width();
 		const auto& height = imageChannelPtr->height();
-		auto compressionMode = imageChannelPtr->compression_codec();
 		const auto& channelIdx = imageChannelPtr->channel_id_info();
-
-		// In 32-bit mode Photoshop insists on the data being prediction encoded even if the compression mode is set to zip
-		// to probably get better compression. We warn the user of this and switch to ZipPrediction
+		auto compressionMode = writeCompression(*imageChannelPtr);
 		if constexpr (std::is_same_v<T, float32_t>)
 		{
-			if (compressionMode == Enum::Compression::Zip)
+			if (compressionMode != imageChannelPtr->compression_codec())
 			{
 				PSAPI_LOG("ChannelImageData", "Photoshop insists on ZipPrediction encoded data rather than Zip for 32-bit, switching to ZipPrediction");
-				compressionMode = Enum::Compression::ZipPrediction;
 			}
 		}
 
-		// Construct a span from our buffer that is exactly sized to make the CompressData calls behave correctly. The wh
-		std::span<T> channelDataSpan = std::span<T>(channelDataBuffer.begin(), channelDataBuffer.begin() + static_cast<size_t>(width) * height);
+		if (!encode)
+		{
+			// The channel is unmodified, copy its original payload rather than decoding and re-encoding it
+			PSAPI_PROFILE_SCOPE("Passthrough channel");
+			compressedData.push_back(imageChannelPtr->read_compressed());
+		}
+		else
+		{
+			// Construct a span from our buffer that is exactly sized to make the CompressData calls behave correctly. The wh
+			std::span<T> channelDataSpan = channelDataBuffer.subspan(0, static_cast<size_t>(width) * height);
 
-		// Compress the image data into a binary array and store it in our compressedData vec
-		imageChannelPtr->get_data<T>(channelDataSpan);
-		compressedData.push_back(CompressData(channelDataSpan, buffer, compressor, compressionMode, header, width, height));
+			// Compress the image data into a binary array and store it in our compressedData vec
+			imageChannelPtr->get_data<T>(channelDataSpan);
+			compressedData.push_back(CompressData(channelDataSpan, buffer, compressionMode, header, width, height, writeZipLevel(*imageChannelPtr)));
+		}
 
 		// Store our additional data. The size of the channel must include the 2 bytes for the compression marker
 		LayerRecords::ChannelInformation channelInfo{.m_ChannelID = channelIdx, .m_Size = compressedData[i].size() + 2u };
@@ -787,15 +816,31 @@ std::vector<std::vector<uint8_t>> ChannelImageData::compressData(const FileHeade
 		imageChannelPtr->compression_codec(compressionMode);
 	}
 
-	libdeflate_free_compressor(compressor);
-
 	return compressedData;
 }
 
 
+// Generate the coordinates of a channel from the layer record extents. If the channel is a mask the extents
+// are instead stored in the layer mask data
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
-void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord)
+static ChannelCoordinates channelCoordinates(const LayerRecord& layerRecord, const LayerRecords::ChannelInformation& channel)
+{
+	if (channel.m_ChannelID.id == Enum::ChannelID::UserSuppliedLayerMask || channel.m_ChannelID.id == Enum::ChannelID::RealUserSuppliedLayerMask)
+	{
+		if (layerRecord.m_LayerMaskData.has_value() && layerRecord.m_LayerMaskData->m_LayerMask.has_value())
+		{
+			const LayerRecords::LayerMask& mask = layerRecord.m_LayerMaskData.value().m_LayerMask.value();
+			return generateChannelCoordinates(ChannelExtents(mask.m_Top, mask.m_Left, mask.m_Bottom, mask.m_Right));
+		}
+	}
+	return generateChannelCoordinates(ChannelExtents(layerRecord.m_Top, layerRecord.m_Left, layerRecord.m_Bottom, layerRecord.m_Right));
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const ProgressCallback& callback, const uint64_t offset, const LayerRecord& layerRecord)
 {
 	PSAPI_PROFILE_FUNCTION();
 
@@ -832,19 +877,20 @@ void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const
 			}
 		}
 	}
-	std::vector<uint8_t> buffer;
-	if (header.m_Depth == Enum::BitDepth::BD_8)
+	// The buffer comes from the thread's scratch arena such that it is shared with the other layers (and files) read on 
+	// this thread rather than being reallocated for each of them
+	size_t bytesPerPixel = sizeof(uint8_t);
+	if (header.m_Depth == Enum::BitDepth::BD_16)
 	{
-		buffer = std::vector<uint8_t>(maxWidth * maxHeight * sizeof(uint8_t));
-	}
-	else if (header.m_Depth == Enum::BitDepth::BD_16)
-	{
-		buffer = std::vector<uint8_t>(maxWidth * maxHeight * sizeof(uint16_t));
+		bytesPerPixel = sizeof(uint16_t);
 	}
 	else if (header.m_Depth == Enum::BitDepth::BD_32)
 	{
-		buffer = std::vector<uint8_t>(maxWidth * maxHeight * sizeof(float32_t));
+		bytesPerPixel = sizeof(float32_t);
 	}
+	const size_t bufferSize = static_cast<size_t>(maxWidth) * maxHeight * bytesPerPixel;
+	Scratch::Buffer scratch = Scratch::acquire<uint8_t>(bufferSize);
+	std::span<uint8_t> buffer = scratch.as<uint8_t>(bufferSize);
 
 
 	// Preallocate the ImageData vector as we need valid indices for the for each loop
@@ -855,22 +901,12 @@ void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const
 	// uses the 'buffer' as an intermediate memory area
 	for (const auto& channel : layerRecord.m_ChannelInformation)
 	{
+		callback.throwIfCancelled();
 		const size_t index = &channel - &layerRecord.m_ChannelInformation[0];
 		const uint64_t channelOffset = channelOffsets[index];
 
-		// Generate our coordinates from the layer extents
-		ChannelCoordinates coordinates = generateChannelCoordinates(ChannelExtents(layerRecord.m_Top, layerRecord.m_Left, layerRecord.m_Bottom, layerRecord.m_Right));
-
-		// If the channel is a mask the extents are actually stored in the layermaskdata
-		if (channel.m_ChannelID.id == Enum::ChannelID::UserSuppliedLayerMask || channel.m_ChannelID.id == Enum::ChannelID::RealUserSuppliedLayerMask)
-		{
-			if (layerRecord.m_LayerMaskData.has_value() && layerRecord.m_LayerMaskData->m_LayerMask.has_value())
-			{
-				const LayerRecords::LayerMask mask = layerRecord.m_LayerMaskData.value().m_LayerMask.value();
-				// Generate our coordinates from the mask extents instead
-				coordinates = generateChannelCoordinates(ChannelExtents(mask.m_Top, mask.m_Left, mask.m_Bottom, mask.m_Right));
-			}
-		}
+		// Generate our coordinates from the layer (or mask) extents
+		ChannelCoordinates coordinates = channelCoordinates(layerRecord, channel);
 		// Get the compression of the channel. We must read it this way as the offset has to be correct before parsing
 		Enum::Compression channelCompression = Enum::Compression::ZipPrediction;
 		{
@@ -931,20 +967,113 @@ void ChannelImageData::read(ByteStream& stream, const FileHeader& header, const
 
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
-void ChannelImageData::write(File& document, std::vector<std::vector<uint8_t>>& compressedChannelData, const std::vector<Enum::Compression>& channelCompression)
+void ChannelImageData::read_lazy(std::shared_ptr<File> document, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord)
+{
+	PSAPI_PROFILE_FUNCTION();
+
+	FileSection::initialize(offset, 0u);
+
+	m_ImageData.resize(layerRecord.m_ChannelInformation.size());
+	m_ChannelCompression.resize(layerRecord.m_ChannelInformation.size());
+
+	uint64_t channelOffset = offset;
+	for (size_t index = 0; index < layerRecord.m_ChannelInformation.size(); ++index)
+	{
+		const auto& channel = layerRecord.m_ChannelInformation[index];
+		// The channel is decoded long after we parsed it so we must make sure it actually lies within the document
+		if (channel.m_Size < 2u || channelOffset + channel.m_Size > document->getSize())
+		{
+			PSAPI_LOG_ERROR("ChannelImageData", "Channel %zu of size %" PRIu64 " at offset %" PRIu64 " does not fit into the document, the file is likely corrupted",
+				index, static_cast<uint64_t>(channel.m_Size), channelOffset);
+		}
+		m_ChannelOffsetsAndSizes.push_back(std::tuple<uint64_t, uint64_t>(channelOffset, channel.m_Size));
+		FileSection::size(FileSection::size() + channel.m_Size);
+
+		// The compression marker is the only part of the channel we read ahead of time
+		Enum::Compression channelCompression = Enum::Compression::ZipPrediction;
+		{
+			uint16_t compressionNum = 0;
+			auto compressionNumSpan = Util::toWritableBytes(compressionNum);
+			document->readFromOffset(compressionNumSpan, channelOffset);
+			compressionNum = endian_decode_be<uint16_t>(reinterpret_cast<std::byte*>(compressionNumSpan.data()));
+			channelCompression = Enum::compressionMap.at(compressionNum);
+		}
+		m_ChannelCompression[index] = channelCompression;
+
+		ChannelCoordinates coordinates = channelCoordinates(layerRecord, channel);
+
+		lazy_channel_source source{};
+		source.document = document;
+		source.offset = channelOffset + 2u;
+		source.size = channel.m_Size - 2u;
+		source.compression = channelCompression;
+		source.header = header;
+		source.width = static_cast<uint32_t>(coordinates.width);
+		source.height = static_cast<uint32_t>(coordinates.height);
+
+		m_ImageData[index] = std::make_unique<channel_wrapper>(
+			std::move(source),
+			channel.m_ChannelID,
+			coordinates.centerX,
+			coordinates.centerY);
+
+		channelOffset += channel.m_Size;
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+uint64_t ChannelImageData::uncompressedSize() const
+{
+	uint64_t size = 0u;
+	for (const auto& channel : m_ImageData)
+	{
+		if (channel)
+		{
+			size += channel->byte_size();
+		}
+	}
+	return size;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+uint64_t ChannelImageData::writtenSize(const std::vector<std::vector<uint8_t>>& compressedChannelData)
 {
+	uint64_t size = 0u;
+	for (const auto& channel : compressedChannelData)
+	{
+		// Each channel is prefixed by its 2 byte compression marker
+		size += channel.size() + 2u;
+	}
+	return size;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void ChannelImageData::write(File& document, const uint64_t offset, std::vector<std::vector<uint8_t>>& compressedChannelData, const std::vector<Enum::Compression>& channelCompression)
+{
+	PSAPI_PROFILE_FUNCTION();
 	m_ChannelOffsetsAndSizes = {};
+	uint64_t channelOffset = offset;
 	for (int i = 0; i < compressedChannelData.size(); ++i)
 	{
 		m_ChannelCompression.push_back(channelCompression[i]);
-		m_ChannelOffsetsAndSizes.push_back(std::tuple<uint64_t, uint64_t>(document.getOffset(), compressedChannelData[i].size() + 2u));
+		m_ChannelOffsetsAndSizes.push_back(std::tuple<uint64_t, uint64_t>(channelOffset, compressedChannelData[i].size() + 2u));
 
 		std::optional<uint16_t> compressionCode = Enum::getCompression<Enum::Compression, uint16_t>(channelCompression[i]);
-		if (compressionCode.has_value()) [[likely]]
-			WriteBinaryData<uint16_t>(document, compressionCode.value());
-		else
+		if (!compressionCode.has_value()) [[unlikely]]
+		{
 			PSAPI_LOG_ERROR("LayerInfo", "Could not find a match for the given compression codec");
-		WriteBinaryArray<uint8_t>(document, std::move(compressedChannelData[i]));
+		}
+		const uint16_t compressionMarker = endian_encode_be<uint16_t>(compressionCode.value());
+		document.writeToOffset(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(&compressionMarker), sizeof(uint16_t)), channelOffset);
+		document.writeToOffset(compressedChannelData[i], channelOffset + 2u);
+		channelOffset += compressedChannelData[i].size() + 2u;
+		compressedChannelData[i] = {};
 	}
 }
 
@@ -993,6 +1122,7 @@ void LayerInfo::read(File& document, const FileHeader& header, ProgressCallback&
 	// Extract layer records
 	for (int i = 0; i < layerCount; i++)
 	{
+		callback.throwIfCancelled();
 		LayerRecord layerRecord = {};
 		layerRecord.read(document, header, callback, document.getOffset());
 		m_LayerRecords.push_back(std::move(layerRecord));
@@ -1016,10 +1146,33 @@ void LayerInfo::read(File& document, const FileHeader& header, ProgressCallback&
 		channelImageDataSizes.push_back(imageDataSize);
 	}
 
+	// If requested, skip decoding the channels entirely and only record where their compressed data lives.
+	// This requires the document to be owned by a shared_ptr as the channels keep it alive until they are decoded
+	if (document.lazyChannelData())
+	{
+		if (auto sharedDocument = document.weak_from_this().lock())
+		{
+			for (size_t index = 0; index < m_LayerRecords.size(); ++index)
+			{
+				auto result = ChannelImageData();
+				result.read_lazy(sharedDocument, header, channelImageDataOffsets[index], m_LayerRecords[index]);
+				m_ChannelImageData.push_back(std::move(result));
+				callback.increment();
+			}
+			document.setOffset(imageDataOffset);
+			this->skipSectionPadding(document);
+			return;
+		}
+		PSAPI_LOG_WARNING("LayerInfo", "Lazy channel decoding was requested but the document is not owned by a shared_ptr, decoding all channels instead");
+	}
+
 	// Read the Channel Image Instances
 	std::vector<ChannelImageData> localResults(m_LayerRecords.size());
-	std::for_each(std::execution::par, m_LayerRecords.begin(), m_LayerRecords.end(), [&](const LayerRecord& layerRecord)
+	Parallel::forEach(m_LayerRecords.begin(), m_LayerRecords.end(), [&](const LayerRecord& layerRecord)
 	{
+		// Bail out before reading (and allocating for) the layer if we were cancelled, the layers we already read get 
+		// freed with localResults as the exception unwinds
+		callback.throwIfCancelled();
 		callback.setTask("Reading Layer: " + std::string(layerRecord.m_LayerName.getString()));
 		size_t index = &layerRecord - &m_LayerRecords[0];
 
@@ -1032,7 +1185,7 @@ void LayerInfo::read(File& document, const FileHeader& header, ProgressCallback&
 
 		// Create the ChannelImageData by parsing the given buffer
 		auto result = ChannelImageData();
-		result.read(stream, header, tmpOffset, layerRecord);
+		result.read(stream, header, callback, tmpOffset, layerRecord);
 
 		// As each index is unique we do not need to worry about locking here
 		localResults[index] = std::move(result);
@@ -1045,7 +1198,14 @@ void LayerInfo::read(File& document, const FileHeader& header, ProgressCallback&
 
 	// Set the offset to where it is supposed to be as we cannot guarantee the location of the marker after jumping back and forth in image sections
 	document.setOffset(imageDataOffset);
+	this->skipSectionPadding(document);
+}
+
 
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void LayerInfo::skipSectionPadding(File& document) const
+{
 	const uint64_t expectedOffset = FileSection::offset() + FileSection::size();
 	if (document.getOffset() != expectedOffset)
 	{
@@ -1082,9 +1242,10 @@ int LayerInfo::getLayerIndex(const std::string& layerName)
 void LayerInfo::write(File& document, const FileHeader& header, ProgressCallback& callback)
 {
 	PSAPI_PROFILE_FUNCTION();
-	// The writing of this section is a bit confusing as we must first compress all of our image data, then write the 
-	// section size and Layer Records with the size markers that we found. After this we finally write the compressed data to disk
-	// it is imperative that the layer order is consistent between the LayerRecords and the ChannelImageData as that is how photoshop
+	// The writing of this section is a bit confusing as the Layer Records hold the size of each of the compressed channels
+	// which we only know once the image data was compressed. We therefore first write the Layer Records with placeholder sizes,
+	// then compress and write the image data in bounded batches and finally go back to patch the sizes we found.
+	// It is imperative that the layer order is consistent between the LayerRecords and the ChannelImageData as that is how photoshop
 	// maps these two together
 
 	// If we are in 16- or 32-bit mode we just write an empty section marker and continue. We must additionally check
@@ -1108,11 +1269,6 @@ void LayerInfo::write(File& document, const FileHeader& header, ProgressCallback
 	// writing the data, the final step is added for the ImageData section
 	callback.setMax(m_LayerRecords.size() * 2 + 1);
 	
-	// The nesting here indicates Layers/Channels/ImgData. We reserve the top level as we access these members in parallel
-	std::vector<std::vector<std::vector<uint8_t>>> compressedData(m_ChannelImageData.size());
-	std::vector<std::vector<LayerRecords::ChannelInformation>> channelInfos(m_ChannelImageData.size());
-	std::vector<std::vector<Enum::Compression>> channelCompression(m_ChannelImageData.size());
-
 	// Write an empty section size, we come back later and fill this out once written
 	uint64_t sizeMarkerOffset = document.getOffset();
 	WriteBinaryDataVariadic<uint32_t, uint64_t>(document, 0u, header.m_Version);
@@ -1120,51 +1276,146 @@ void LayerInfo::write(File& document, const FileHeader& header, ProgressCallback
 	// but we do not bother with that at this point
 	WriteBinaryData(document, static_cast<int16_t>(m_LayerRecords.size()));
 
-	// Loop over the individual layers and compress them while also storing the channel information
-	std::for_each(std::execution::par, m_ChannelImageData.begin(), m_ChannelImageData.end(),
-		[&](ChannelImageData& channel)
+	// Write the layer records with placeholder channel sizes, these get patched once each layer was compressed and written.
+	// The channel order is identical between the records and the ChannelImageData so we can patch them by index
+	std::vector<std::vector<uint64_t>> channelSizeOffsets(m_LayerRecords.size());
+	for (int i = 0; i < m_LayerRecords.size(); ++i)
+	{
+		std::vector<LayerRecords::ChannelInformation> placeholderInfos = m_LayerRecords[i].m_ChannelInformation;
+		for (auto& info : placeholderInfos)
 		{
-			// Get a unique index for each of the layers to compress them in random order
-			const size_t index = &channel - &m_ChannelImageData[0];
-			callback.setTask("Compressing Layer: " + std::string(m_LayerRecords[index].m_LayerName.getString()));
-			std::vector<LayerRecords::ChannelInformation> lrChannelInfo;
-			std::vector<Enum::Compression> lrCompression;
+			info.m_Size = 0u;
+		}
+		channelSizeOffsets[i] = m_LayerRecords[i].write(document, header, callback, placeholderInfos);
+	}
+
+	// The nesting here indicates Layers/Channels/ImgData. We reserve the top level as we access these members in parallel
+	// but only ever populate the layers of the batches we are currently compressing and writing
+	std::vector<std::vector<std::vector<uint8_t>>> compressedData(m_ChannelImageData.size());
+	std::vector<std::vector<LayerRecords::ChannelInformation>> channelInfos(m_ChannelImageData.size());
+	std::vector<std::vector<Enum::Compression>> channelCompression(m_ChannelImageData.size());
 
-			if (header.m_Depth == Enum::BitDepth::BD_8)
+	uint64_t dataOffset = document.getOffset();
+
+	// Loop over the individual layers and compress them while also storing the channel information
+	auto compressBatch = [&](size_t batchStart, size_t batchEnd)
+		{
+			Parallel::forEach(m_ChannelImageData.begin() + batchStart, m_ChannelImageData.begin() + batchEnd,
+				[&](ChannelImageData& channel)
+				{
+					// Get a unique index for each of the layers to compress them in random order
+					const size_t index = &channel - &m_ChannelImageData[0];
+					callback.throwIfCancelled();
+					callback.setTask("Compressing Layer: " + std::string(m_LayerRecords[index].m_LayerName.getString()));
+					std::vector<LayerRecords::ChannelInformation> lrChannelInfo;
+					std::vector<Enum::Compression> lrCompression;
+
+					if (header.m_Depth == Enum::BitDepth::BD_8)
+					{
+						compressedData[index] = channel.compressData<uint8_t>(header, callback, lrChannelInfo, lrCompression, m_ZipLevel);
+					}
+					else if (header.m_Depth == Enum::BitDepth::BD_16)
+					{
+						compressedData[index] = channel.compressData<uint16_t>(header, callback, lrChannelInfo, lrCompression, m_ZipLevel);
+					}
+					else if (header.m_Depth == Enum::BitDepth::BD_32)
+					{
+						compressedData[index] = channel.compressData<float32_t>(header, callback, lrChannelInfo, lrCompression, m_ZipLevel);
+					}
+					else
+					{
+						PSAPI_LOG_ERROR("LayerInfo", "Unsupported BitDepth encountered, currently only 8-, 16- and 32-bit files are supported");
+					}
+					channelInfos[index] = lrChannelInfo;
+					channelCompression[index] = lrCompression;
+					callback.setTask("Compressed Layer: " + std::string(m_LayerRecords[index].m_LayerName.getString()));
+					callback.increment();
+				});
+		};
+
+	// Write the ChannelImageData of the batch at their offsets in parallel, freeing the compressed data right after
+	std::vector<uint64_t> layerOffsets;
+	auto writeBatch = [&](size_t batchStart, size_t batchEnd)
+		{
+			Parallel::forEach(m_ChannelImageData.begin() + batchStart, m_ChannelImageData.begin() + batchEnd,
+				[&](ChannelImageData& channel)
+				{
+					const size_t index = &channel - &m_ChannelImageData[0];
+					callback.throwIfCancelled();
+					callback.setTask("Writing Layer: " + std::string(m_LayerRecords[index].m_LayerName.getString()));
+					channel.write(document, layerOffsets[index - batchStart], compressedData[index], channelCompression[index]);
+					compressedData[index] = {};
+					callback.increment();
+				});
+		};
+
+	// The previous batch whose positional writes run while we compress the current one
+	size_t writeStart = 0;
+	size_t writeEnd = 0;
+
+	size_t batchStart = 0;
+	while (batchStart < m_ChannelImageData.size())
+	{
+		callback.throwIfCancelled();
+		// Gather as many layers as fit into our batch size, we always take at least one layer
+		size_t batchEnd = batchStart;
+		uint64_t batchSize = 0u;
+		while (batchEnd < m_ChannelImageData.size())
+		{
+			uint64_t layerSize = m_ChannelImageData[batchEnd].uncompressedSize();
+			if (batchEnd != batchStart && batchSize + layerSize > LAYER_WRITE_BATCH_SIZE)
 			{
-				compressedData[index] = channel.compressData<uint8_t>(header, lrChannelInfo, lrCompression);
+				break;
 			}
-			else if (header.m_Depth == Enum::BitDepth::BD_16)
+			batchSize += layerSize;
+			++batchEnd;
+		}
+
+		// Compress this batch and write the previous one as two tasks on the executor rather than on a thread of our
+		// own, both of them have finished once this returns such that we are free to touch the document again
+		Parallel::executor()->parallelFor(2, [&](size_t begin, size_t end)
 			{
-				compressedData[index] = channel.compressData<uint16_t>(header, lrChannelInfo, lrCompression);
-			}
-			else if (header.m_Depth == Enum::BitDepth::BD_32)
+				for (size_t task = begin; task < end; ++task)
+				{
+					if (task == 0)
+					{
+						compressBatch(batchStart, batchEnd);
+					}
+					else
+					{
+						writeBatch(writeStart, writeEnd);
+					}
+				}
+			});
+
+		// Now that the sizes are known we can compute where each of the layers ends up and patch the channel sizes in
+		// the layer records
+		layerOffsets.resize(batchEnd - batchStart);
+		for (size_t i = batchStart; i < batchEnd; ++i)
+		{
+			layerOffsets[i - batchStart] = dataOffset;
+			dataOffset += ChannelImageData::writtenSize(compressedData[i]);
+
+			if (channelInfos[i].size() != channelSizeOffsets[i].size()) [[unlikely]]
 			{
-				compressedData[index] = channel.compressData<float32_t>(header, lrChannelInfo, lrCompression);
+				PSAPI_LOG_ERROR("LayerInfo", "Layer '%s' wrote %zu channels but its layer record holds %zu channels",
+					m_LayerRecords[i].m_LayerName.getString().c_str(), channelInfos[i].size(), channelSizeOffsets[i].size());
 			}
-			else
+			for (size_t j = 0; j < channelInfos[i].size(); ++j)
 			{
-				PSAPI_LOG_ERROR("LayerInfo", "Unsupported BitDepth encountered, currently only 8-, 16- and 32-bit files are supported");
+				document.setOffset(channelSizeOffsets[i][j]);
+				WriteBinaryDataVariadic<uint32_t, uint64_t>(document, channelInfos[i][j].m_Size, header.m_Version);
 			}
-			channelInfos[index] = lrChannelInfo;
-			channelCompression[index] = lrCompression;
-			callback.setTask("Compressed Layer: " + std::string(m_LayerRecords[index].m_LayerName.getString()));
-			callback.increment();
-		});
-
-	// Write the layer records
-	for (int i = 0; i < m_LayerRecords.size(); ++i)
-	{
-		m_LayerRecords[i].write(document, header, callback, channelInfos[i]);
-	}
+			m_LayerRecords[i].m_ChannelInformation = channelInfos[i];
+		}
+		document.preallocate(dataOffset);
 
-	// Write the ChannelImageData to disk, 
-	for (int i = 0; i < compressedData.size(); ++i)
-	{
-		callback.setTask("Writing Layer: " + std::string(m_LayerRecords[i].m_LayerName.getString()));
-		m_ChannelImageData[i].write(document, compressedData[i], channelCompression[i]);
-		callback.increment();
+		writeStart = batchStart;
+		writeEnd = batchEnd;
+		batchStart = batchEnd;
 	}
+	writeBatch(writeStart, writeEnd);
+	document.setOffset(dataOffset);
 
 	// Count how many bytes we already wrote, go back to the size marker and write that information
 	uint64_t endOffset = document.getOffset();
@@ -21,6 +21,11 @@
 PSAPI_NAMESPACE_BEGIN
 
 
+/// The maximum amount of uncompressed layer data (in bytes) that is compressed and held in memory at once while writing
+/// the LayerInfo section. Layers larger than this are compressed and written on their own.
+constexpr uint64_t LAYER_WRITE_BATCH_SIZE = 1024ull * 1024ull * 1024ull;
+
+
 // Structs to hold the different types of data found in the layer records themselves
 namespace LayerRecords
 {
@@ -231,8 +236,9 @@ struct LayerRecord : public FileSection
 	/// Read and Initialize the struct from disk using the given offset
 	void read(File& document, const FileHeader& header, ProgressCallback& callback, const uint64_t offset);
 
-	/// Write the layer record to disk, requires the Image data to be compressed already and the size to be known
-	void write(File& document, const FileHeader& header, ProgressCallback& callback, const std::vector<LayerRecords::ChannelInformation> channelInfos) const;
+	/// Write the layer record to disk. The channel sizes may be placeholders in which case they have to be patched once
+	/// the image data was compressed, for this we return the offsets of each of the channels' size markers.
+	std::vector<uint64_t> write(File& document, const FileHeader& header, ProgressCallback& callback, const std::vector<LayerRecords::ChannelInformation> channelInfos) const;
 
 	/// Extract the absolute width of the layer
 	uint32_t getWidth() const noexcept;
@@ -268,14 +274,31 @@ struct ChannelImageData : public FileSection
 	/// Compress the data for the current layer and return the individual channels, invalidating the data as we go.
 	/// This function must be called before writing the data for the LayerRecord as it reveals the size of the data
 	/// required to write them. We fill out the lrChannelInfo and lrCompression vector as it goes.
+	/// Channels that were read lazily and weren't modified since are passed through with their original payload.
+	/// Zip compressed channels are written with their own zip level if set, otherwise with the given zipLevel. If 
+	/// neither is set we write with ZIP_COMPRESSION_LVL and pass through unmodified channels.
+	/// The callback is checked for cancellation before each of the channels is compressed.
 	template <typename T>
-	std::vector<std::vector<uint8_t>> compressData(const FileHeader& header, std::vector<LayerRecords::ChannelInformation>& lrChannelInfo, std::vector<Enum::Compression>& lrCompression);
+	std::vector<std::vector<uint8_t>> compressData(const FileHeader& header, const ProgressCallback& callback, std::vector<LayerRecords::ChannelInformation>& lrChannelInfo, std::vector<Enum::Compression>& lrCompression, const std::optional<int> zipLevel = std::nullopt);
+
+	/// Read a single layer instance from a pre-allocated bytestream, checking the callback for cancellation before 
+	/// each of the channels is decompressed
+	void read(ByteStream& stream, const FileHeader& header, const ProgressCallback& callback, const uint64_t offset, const LayerRecord& layerRecord);
+
+	/// Read a single layer instance without decoding any of its channels. Each channel instead holds a reference
+	/// to its compressed data in the document and gets decoded once it is first accessed.
+	void read_lazy(std::shared_ptr<File> document, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord);
+
+	/// The combined size of all the channels held by this layer once decompressed, in bytes
+	uint64_t uncompressedSize() const;
 
-	/// Read a single layer instance from a pre-allocated bytestream
-	void read(ByteStream& stream, const FileHeader& header, const uint64_t offset, const LayerRecord& layerRecord);
+	/// The number of bytes write() will take up in the document for the given compressed channels, including the 
+	/// compression markers.
+	static uint64_t writtenSize(const std::vector<std::vector<uint8_t>>& compressedChannelData);
 
-	/// Write a single layer to disk, there is no need to write to a preallocated buffer here as we compress ahead of time
-	void write(File& document, std::vector<std::vector<uint8_t>>& compressedChannelData, const std::vector<Enum::Compression>& channelCompression);
+	/// Write a single layer to the document at the given offset using positional writes. This does not move the 
+	/// document offset so multiple layers may be written in parallel once the document was preallocated to hold them.
+	void write(File& document, const uint64_t offset, std::vector<std::vector<uint8_t>>& compressedChannelData, const std::vector<Enum::Compression>& channelCompression);
 
 	/// Get an index to a specific channel based on the identifier
 	/// returns -1 if no matching channel is found
@@ -389,6 +412,10 @@ struct LayerInfo : public FileSection
 	std::vector<LayerRecord> m_LayerRecords;
 	std::vector<ChannelImageData> m_ChannelImageData;
 
+	/// The zip compression level channels without their own level are written with. If unset we write with 
+	/// ZIP_COMPRESSION_LVL and unmodified channels keep their original compressed data rather than being re-encoded.
+	std::optional<int> m_ZipLevel = std::nullopt;
+
 	LayerInfo() = default;
 	LayerInfo(std::vector<LayerRecord> layerRecords, std::vector<ChannelImageData> imageData) : m_LayerRecords(std::move(layerRecords)), m_ChannelImageData(std::move(imageData)) {};
 
@@ -401,7 +428,12 @@ struct LayerInfo : public FileSection
 	/// \param isFromAdditionalLayerInfo If true the section is parsed without a size marker as it is already stored on the tagged block
 	/// \param sectionSize This parameter must be present when isFromAdditionalLayerInfo = true
 	void read(File& document, const FileHeader& header, ProgressCallback& callback, const uint64_t offset, const bool isFromAdditionalLayerInfo = false, std::optional<uint64_t> sectionSize = std::nullopt);
-	/// Write the layer info section to file with the given padding
+	/// Write the layer info section to file with the given padding. 
+	/// 
+	/// The layer records are written first with placeholder channel sizes after which the layers are compressed in 
+	/// batches of at most LAYER_WRITE_BATCH_SIZE (uncompressed) bytes, patching the channel sizes as we go. Once a batch
+	/// is compressed the offset of each of its layers is known so they are written in parallel using positional writes
+	/// while the next batch is being compressed. This way we hold at most two batches of compressed data in memory.
 	void write(File& document, const FileHeader& header, ProgressCallback& callback);
 
 	/// Find the index to a layer based on a layer name that is given
@@ -410,6 +442,10 @@ struct LayerInfo : public FileSection
 	/// is returned (due to photoshop storing layers in reverse). 
 	/// This can also be used to get an index into the ChannelImageData vector as the indices are identical
 	int getLayerIndex(const std::string& layerName);
+
+private:
+	/// Skip the (up to 4 byte) padding at the end of the section after all the channel image data was read
+	void skipSectionPadding(File& document) const;
 };
 
 
@@ -6,6 +6,8 @@
 #include "LayerAndMaskInformation.h"
 #include "ImageData.h"
 
+#include "Core/FileIO/Read.h"
+#include "Core/FileIO/Util.h"
 
 #include "Profiling/Perf/Instrumentor.h"
 
@@ -26,6 +28,30 @@ void PhotoshopFile::read(File& document, ProgressCallback& callback)
 	m_ImageResources.read(document, m_ColorModeData.offset() + m_ColorModeData.size());
 
 	m_LayerMaskInfo.read(document, m_Header, callback, m_ImageResources.offset() + m_ImageResources.size());
+	callback.throwIfCancelled();
+	// The layer and mask information size does not include its length marker
+	m_ImageData.read(document, m_Header, m_LayerMaskInfo.offset() + SwapPsdPsb<uint32_t, uint64_t>(m_Header.m_Version) + m_LayerMaskInfo.size());
+}
+
+
+// Only the length markers of the sections preceding the image data are read, skipping e.g. all of the layer records
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void PhotoshopFile::readComposite(File& document)
+{
+	PSAPI_PROFILE_FUNCTION();
+	m_Header.read(document);
+	m_ColorModeData.read(document);
+
+	uint64_t offset = m_ColorModeData.offset() + m_ColorModeData.size();
+	document.setOffset(offset);
+	offset += RoundUpToMultiple<uint32_t>(ReadBinaryData<uint32_t>(document), 2u) + 4u;
+
+	document.setOffset(offset);
+	std::variant<uint32_t, uint64_t> layerMaskInfoSize = ReadBinaryDataVariadic<uint32_t, uint64_t>(document, m_Header.m_Version);
+	offset += ExtractWidestValue<uint32_t, uint64_t>(layerMaskInfoSize) + SwapPsdPsb<uint32_t, uint64_t>(m_Header.m_Version);
+
+	m_ImageData.read(document, m_Header, offset);
 }
 
 
@@ -43,6 +69,7 @@ void PhotoshopFile::write(File& document, ProgressCallback& callback)
 	m_ImageResources.write(document);
 
 	m_LayerMaskInfo.write(document, m_Header, callback);
+	callback.throwIfCancelled();
 	// This unfortunately appears to be required which inflates files by quite a bit
 	// but still significantly less than photoshop itself
 	callback.setTask("Writing ImageData section");
@@ -46,6 +46,15 @@ struct PhotoshopFile
 	/// \param callback a callback which will report back the current progress of the read operation
 	void read(File& document, ProgressCallback& callback);
 
+	/// \brief Read only the header and the merged ImageData section from a File
+	///
+	/// The sections in between are skipped using their length markers without being parsed which makes this
+	/// significantly cheaper than `read()` if only the composite is of interest. All but `m_Header`, `m_ColorModeData`
+	/// and `m_ImageData` are left default initialized.
+	///
+	/// \param document the file object to read the data from
+	void readComposite(File& document);
+
 	/// \brief Write the PhotoshopFile struct to disk with an explicit progress callback
 	///
 	/// \param document the file object to write the data to
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define PSAPI_X86 1
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#endif
+	#include <immintrin.h>
+#endif
+
+
+// The SIMD kernels are not compiled with a global -mavx2 (or /arch:AVX2) but instead carry a per-function target so a
+// single binary runs on any x86 machine. Functions marked with PSAPI_TARGET_AVX2 may only be called after checking
+// CPU::hasAVX2(). MSVC allows AVX2 intrinsics in any function so the macro expands to nothing there.
+//
+// Any code guarded by PSAPI_SIMD_AVX2 must dispatch at runtime rather than assuming the instructions to be present.
+#if defined(PSAPI_X86) && (defined(__GNUC__) || defined(__clang__))
+	#define PSAPI_TARGET_AVX2 __attribute__((target("avx2")))
+	#define PSAPI_SIMD_AVX2 1
+#elif defined(PSAPI_X86) && defined(_MSC_VER)
+	#define PSAPI_TARGET_AVX2
+	#define PSAPI_SIMD_AVX2 1
+#else
+	#define PSAPI_TARGET_AVX2
+#endif
+
+
+PSAPI_NAMESPACE_BEGIN
+
+namespace CPU
+{
+	namespace impl
+	{
+		// Query the CPU (and the OS for saving the ymm registers) for AVX2 support.
+		// ---------------------------------------------------------------------------------------------------------------------
+		// ---------------------------------------------------------------------------------------------------------------------
+		inline bool detectAVX2()
+		{
+#if defined(__AVX2__)
+			return true;
+#elif defined(PSAPI_X86) && defined(_MSC_VER) && !defined(__clang__)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+			{
+				return false;
+			}
+			__cpuid(info, 1);
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx)
+			{
+				return false;
+			}
+			// Check that the OS saves both the xmm and ymm state on context switches
+			if ((_xgetbv(0) & 0x6) != 0x6)
+			{
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#elif defined(PSAPI_X86)
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+#else
+			return false;
+#endif
+		}
+
+		// The detected feature is stored once on first use after which it may only be turned off (and on again) through
+		// setAVX2Enabled()
+		// ---------------------------------------------------------------------------------------------------------------------
+		// ---------------------------------------------------------------------------------------------------------------------
+		inline std::atomic<bool>& avx2Enabled()
+		{
+			static std::atomic<bool> enabled = detectAVX2();
+			return enabled;
+		}
+	}
+
+
+	/// Whether the AVX2 kernels may be used on the current machine. This is queried once through CPUID, so
+	/// calling this in a per-scanline loop is cheap.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline bool hasAVX2()
+	{
+		return impl::avx2Enabled().load(std::memory_order_relaxed);
+	}
+
+
+	/// Force the scalar fallbacks by disabling the AVX2 kernels, or re-enable them. Enabling has no effect if the CPU does
+	/// not support AVX2. This is mostly useful for testing the scalar fallbacks.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline void setAVX2Enabled(bool enabled)
+	{
+		impl::avx2Enabled().store(enabled && impl::detectAVX2(), std::memory_order_relaxed);
+	}
+}
+
+PSAPI_NAMESPACE_END
@@ -0,0 +1,370 @@
+#pragma once
+
+#include "Macros.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <execution>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+
+// All the parallel loops of the PhotoshopAPI go through the executor set here rather than through the standard parallel
+// algorithms directly. This allows for capping the number of threads used (setNumThreads()) or for handing the work to
+// an executor owned by the host application (setExecutor()) such as its own pool or a TBB arena.
+//
+// By default the loops are run through std::execution::par which, depending on the standard library, is backed by TBB.
+
+PSAPI_NAMESPACE_BEGIN
+
+namespace Parallel
+{
+	/// Interface for running the parallel loops of the PhotoshopAPI, implement this to plug in a custom executor.
+	class Executor
+	{
+	public:
+		virtual ~Executor() = default;
+
+		/// Invoke the body for disjoint subranges [begin, end) which together cover [0, count), returning once all of them
+		/// have finished. The body may be called from the calling thread and parallelFor() may be called recursively from
+		/// within the body. If the body throws, one of the exceptions must be rethrown on the calling thread.
+		virtual void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& body) = 0;
+
+		/// The number of threads the executor runs its work on
+		virtual size_t concurrency() const = 0;
+	};
+
+
+	/// Run all the loops on the calling thread
+	class SerialExecutor final : public Executor
+	{
+	public:
+		void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) override
+		{
+			if (count > 0)
+			{
+				body(0, count);
+			}
+		}
+
+		size_t concurrency() const override { return 1; }
+	};
+
+
+	/// Run the loops through std::execution::par, the threading is left up to the standard library
+	class StdExecutor final : public Executor
+	{
+	public:
+		void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) override
+		{
+			if (count == 0)
+			{
+				return;
+			}
+			// Split into several chunks per thread to let the backend balance uneven work
+			const size_t numChunks = std::min(count, concurrency() * 8);
+			const size_t chunkSize = (count + numChunks - 1) / numChunks;
+			std::vector<size_t> chunks((count + chunkSize - 1) / chunkSize);
+			std::iota(chunks.begin(), chunks.end(), size_t(0));
+			// An exception escaping the standard parallel algorithms terminates so we forward it ourselves
+			std::mutex exceptionMutex;
+			std::exception_ptr exception;
+			std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](size_t chunk)
+				{
+					try
+					{
+						body(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(exceptionMutex);
+						if (!exception)
+						{
+							exception = std::current_exception();
+						}
+					}
+				});
+			if (exception)
+			{
+				std::rethrow_exception(exception);
+			}
+		}
+
+		size_t concurrency() const override { return std::max(1u, std::thread::hardware_concurrency()); }
+	};
+
+
+	/// Executor running the loops on a fixed number of threads (including the calling thread). Every loop is split into
+	/// chunks which the caller and any idle worker claim until none are left. A thread waiting on its loop to finish keeps
+	/// claiming chunks of the most recently started loop, which are usually the ones nested inside its own, such that
+	/// nested loops never use more than the configured number of threads.
+	class ThreadPoolExecutor final : public Executor
+	{
+	public:
+		explicit ThreadPoolExecutor(size_t numThreads)
+			: m_NumThreads(std::max<size_t>(numThreads, 1u))
+		{
+			for (size_t i = 1; i < m_NumThreads; ++i)
+			{
+				m_Workers.emplace_back([this]() { workerLoop(); });
+			}
+		}
+
+		ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+		ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+		~ThreadPoolExecutor() override
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Stopped = true;
+			}
+			m_Condition.notify_all();
+			for (auto& worker : m_Workers)
+			{
+				worker.join();
+			}
+		}
+
+		void parallelFor(size_t count, const std::function<void(size_t, size_t)>& body) override
+		{
+			if (count == 0)
+			{
+				return;
+			}
+			const size_t numChunks = std::min(count, m_NumThreads * 4);
+			if (numChunks == 1)
+			{
+				body(0, count);
+				return;
+			}
+
+			auto job = std::make_shared<Job>(body, count, numChunks);
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Jobs.push_back(job);
+			}
+			m_Condition.notify_all();
+
+			runChunks(*job);
+			while (!job->finished())
+			{
+				// Help out with the other loops (most likely the ones nested in our chunks) while waiting for ours
+				if (auto other = takeJob())
+				{
+					runChunks(*other);
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(job->mutex);
+				job->condition.wait_for(lock, std::chrono::microseconds(100), [&]() { return job->finished(); });
+			}
+
+			if (job->exception)
+			{
+				std::rethrow_exception(job->exception);
+			}
+		}
+
+		size_t concurrency() const override { return m_NumThreads; }
+
+	private:
+		struct Job
+		{
+			Job(const std::function<void(size_t, size_t)>& body, size_t count, size_t numChunks)
+				: body(body), count(count), numChunks(numChunks), chunkSize((count + numChunks - 1) / numChunks)
+			{
+				// Rounding up the chunk size may leave us with fewer chunks than requested
+				this->numChunks = (count + chunkSize - 1) / chunkSize;
+			}
+
+			bool exhausted() const { return next.load(std::memory_order_relaxed) >= numChunks; }
+			bool finished() const { return done.load(std::memory_order_acquire) >= numChunks; }
+
+			const std::function<void(size_t, size_t)>& body;
+			size_t count;
+			size_t numChunks;
+			size_t chunkSize;
+			std::atomic<size_t> next = 0;
+			std::atomic<size_t> done = 0;
+
+			std::mutex mutex;
+			std::condition_variable condition;
+			std::exception_ptr exception;
+		};
+
+		// Claim and run chunks of the job until none are left
+		void runChunks(Job& job)
+		{
+			while (true)
+			{
+				const size_t chunk = job.next.fetch_add(1, std::memory_order_relaxed);
+				if (chunk >= job.numChunks)
+				{
+					return;
+				}
+				try
+				{
+					job.body(chunk * job.chunkSize, std::min(job.count, (chunk + 1) * job.chunkSize));
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(job.mutex);
+					if (!job.exception)
+					{
+						job.exception = std::current_exception();
+					}
+				}
+				if (job.done.fetch_add(1, std::memory_order_acq_rel) + 1 == job.numChunks)
+				{
+					std::lock_guard<std::mutex> lock(job.mutex);
+					job.condition.notify_all();
+				}
+			}
+		}
+
+		// Get the most recently started job which still has chunks left, dropping the exhausted ones
+		std::shared_ptr<Job> takeJob()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			std::erase_if(m_Jobs, [](const std::shared_ptr<Job>& job) { return job->exhausted(); });
+			return m_Jobs.empty() ? nullptr : m_Jobs.back();
+		}
+
+		void workerLoop()
+		{
+			while (true)
+			{
+				std::shared_ptr<Job> job = takeJob();
+				if (!job)
+				{
+					std::unique_lock<std::mutex> lock(m_Mutex);
+					m_Condition.wait(lock, [this]() { return m_Stopped || std::any_of(m_Jobs.begin(), m_Jobs.end(), [](const auto& job) { return !job->exhausted(); }); });
+					if (m_Stopped)
+					{
+						return;
+					}
+					continue;
+				}
+				runChunks(*job);
+			}
+		}
+
+		size_t m_NumThreads;
+		std::vector<std::thread> m_Workers;
+		std::deque<std::shared_ptr<Job>> m_Jobs;
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		bool m_Stopped = false;
+	};
+
+
+	namespace impl
+	{
+		inline std::mutex& executorMutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		inline std::shared_ptr<Executor>& currentExecutor()
+		{
+			static std::shared_ptr<Executor> executor = std::make_shared<StdExecutor>();
+			return executor;
+		}
+	}
+
+
+	/// Get the executor all the parallel loops are currently run on
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline std::shared_ptr<Executor> executor()
+	{
+		std::lock_guard<std::mutex> lock(impl::executorMutex());
+		return impl::currentExecutor();
+	}
+
+
+	/// Run all the parallel loops on the given executor, passing a nullptr restores the default StdExecutor. Loops which
+	/// are already running finish on the executor they were started on.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline void setExecutor(std::shared_ptr<Executor> executor)
+	{
+		if (!executor)
+		{
+			executor = std::make_shared<StdExecutor>();
+		}
+		std::lock_guard<std::mutex> lock(impl::executorMutex());
+		impl::currentExecutor() = std::move(executor);
+	}
+
+
+	/// Limit the PhotoshopAPI to the given number of threads. A value of 1 runs everything on the calling thread while 0
+	/// restores the default of leaving the threading up to the standard library.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline void setNumThreads(size_t numThreads)
+	{
+		if (numThreads == 0)
+		{
+			setExecutor(std::make_shared<StdExecutor>());
+		}
+		else if (numThreads == 1)
+		{
+			setExecutor(std::make_shared<SerialExecutor>());
+		}
+		else
+		{
+			setExecutor(std::make_shared<ThreadPoolExecutor>(numThreads));
+		}
+	}
+
+
+	/// Invoke func for every element in [first, last) in parallel on the current executor. This replaces
+	/// std::for_each(std::execution::par, ...) and may be nested.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename Iterator, typename Func>
+	void forEach(Iterator first, Iterator last, Func&& func)
+	{
+		if constexpr (std::random_access_iterator<Iterator>)
+		{
+			const size_t count = static_cast<size_t>(last - first);
+			executor()->parallelFor(count, [&](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; ++i)
+					{
+						func(first[i]);
+					}
+				});
+		}
+		else
+		{
+			// Gather the iterators up front such that we can index into them
+			std::vector<Iterator> iterators;
+			for (auto it = first; it != last; ++it)
+			{
+				iterators.push_back(it);
+			}
+			executor()->parallelFor(iterators.size(), [&](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; ++i)
+					{
+						func(*iterators[i]);
+					}
+				});
+		}
+	}
+}
+
+PSAPI_NAMESPACE_END
@@ -4,10 +4,22 @@
 
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
 
 PSAPI_NAMESPACE_BEGIN
 
 
+/// Thrown by a read/write operation once its ProgressCallback was cancelled or its deadline passed. By the time this
+/// reaches the caller all the work of the operation was stopped and its intermediate buffers were freed.
+struct OperationCancelled : public std::runtime_error
+{
+	using std::runtime_error::runtime_error;
+};
+
+
 /// A simple callback which can be attached to some of the most common read/write operations to query the status of the operation
 /// during execution especially when its a long running task. This querying should be done asynchronously by either launching the read/write 
 /// asynchronously or in a different thread. The default constructor is the one that the user should be using most of the time
@@ -15,6 +27,9 @@ PSAPI_NAMESPACE_BEGIN
 /// 
 /// See the "ProgressCallback" example in the PhotoshopExamples/ folder of the repository for more information on how this can be 
 /// achieved
+/// 
+/// The callback additionally acts as a cancellation token: calling cancel() from any thread (or exceeding the deadline set 
+/// via setDeadline()) stops the operation between layers and channels, which then throws an OperationCancelled exception.
 struct ProgressCallback
 {
 	/// Default ctor
@@ -26,7 +41,7 @@ struct ProgressCallback
 	/// On destruction check if m_Count was able to reach m_Max, otherwise raise a warning
 	~ProgressCallback()
 	{
-		if (m_Count < m_Max)
+		if (m_Count < m_Max && !isCancelled())
 		{
 			PSAPI_LOG_WARNING("Progress", "Counter was deleted before it was able to complete,"\
 				" only managed to reach %zu/%zu. Stopped on task: '%s'", m_Count, m_Max, m_CurrentTask.c_str());
@@ -79,7 +94,47 @@ struct ProgressCallback
 	// or if it needs to do this itself.
 	inline bool isInitialized() const noexcept { return m_IsInitialized; }
 
+	/// Request the operation the callback is attached to to stop as soon as possible. The operation then throws an
+	/// OperationCancelled exception. This function is thread-safe
+	inline void cancel() noexcept { m_Cancelled.store(true, std::memory_order_relaxed); }
+
+	/// Cancel the operation once the given point in time is reached. This function is thread-safe
+	inline void setDeadline(std::chrono::steady_clock::time_point deadline) noexcept 
+	{ 
+		m_Deadline.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+	}
+
+	/// Cancel the operation once the given duration has passed from now on. This function is thread-safe
+	inline void setDeadline(std::chrono::steady_clock::duration timeout) noexcept
+	{
+		setDeadline(std::chrono::steady_clock::now() + timeout);
+	}
+
+	/// Query whether the operation was cancelled, either explicitly or by exceeding the deadline
+	inline bool isCancelled() const noexcept
+	{
+		if (m_Cancelled.load(std::memory_order_relaxed))
+		{
+			return true;
+		}
+		const auto deadline = m_Deadline.load(std::memory_order_relaxed);
+		return deadline != s_NoDeadline && std::chrono::steady_clock::now().time_since_epoch().count() >= deadline;
+	}
+
+	// Throw an OperationCancelled exception if the operation was cancelled. This is called by the code executing the
+	// long operation between its units of work, not the user itself.
+	// This function is thread-safe
+	inline void throwIfCancelled() const
+	{
+		if (isCancelled()) [[unlikely]]
+		{
+			throw OperationCancelled("PhotoshopAPI operation was cancelled");
+		}
+	}
+
 private:
+	static constexpr std::chrono::steady_clock::rep s_NoDeadline = std::numeric_limits<std::chrono::steady_clock::rep>::max();
+
 	/// The current counter progressing towards m_Max
 	size_t m_Count = 0;
 
@@ -92,6 +147,11 @@ private:
 	std::string m_CurrentTask = "";
 
 	std::mutex m_Mutex;
+
+	std::atomic<bool> m_Cancelled = false;
+
+	/// The deadline as ticks of the steady_clock, s_NoDeadline if none was set
+	std::atomic<std::chrono::steady_clock::rep> m_Deadline = s_NoDeadline;
 };
 
 
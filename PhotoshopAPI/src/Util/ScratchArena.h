@@ -0,0 +1,199 @@
+#pragma once
+
+#include "Macros.h"
+#include "Util/Logger.h"
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <bit>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// If we compile with C++<20 we replace the stdlib implementation with the compatibility
+// library
+#if (__cplusplus < 202002L)
+#include "tcb_span.hpp"
+#else
+#include <span>
+#endif
+
+
+// Scratch memory for the intermediate buffers of reading and writing image data. Every layer and channel otherwise
+// allocates (and zero-initializes) its own temporary buffers which, when reading many small files, makes the allocator
+// the dominant cost. Each thread owns an arena which buckets the buffers into power-of-two size classes and holds on
+// to them once released so subsequent channels, layers and files can reuse them.
+
+PSAPI_NAMESPACE_BEGIN
+
+namespace Scratch
+{
+	// Requests are rounded up to at least 2^MIN_SIZE_CLASS bytes (4KiB)
+	constexpr size_t MIN_SIZE_CLASS = 12;
+	// Buffers larger than 2^MAX_SIZE_CLASS bytes (32MiB) are not kept around after being released
+	constexpr size_t MAX_SIZE_CLASS = 25;
+	// The maximum number of bytes a single thread keeps cached, released buffers exceeding this get freed instead. As
+	// every worker thread owns an arena this is kept fairly low
+	constexpr size_t MAX_CACHED_BYTES = size_t(1) << 26;
+
+	class Arena;
+
+
+	/// Uninitialized scratch memory acquired from an Arena which hands it back to the arena on destruction. As the arenas
+	/// are per-thread the buffer must be destroyed on the thread that acquired it.
+	class Buffer
+	{
+	public:
+		Buffer() = default;
+		Buffer(const Buffer&) = delete;
+		Buffer& operator=(const Buffer&) = delete;
+		Buffer(Buffer&& other) noexcept { *this = std::move(other); }
+		Buffer& operator=(Buffer&& other) noexcept;
+		~Buffer();
+
+		/// The number of bytes available which may be more than requested
+		size_t capacity() const noexcept { return m_Capacity; }
+
+		/// View the first count elements of the buffer as the given type
+		template <typename T>
+		std::span<T> as(const size_t count)
+		{
+			if (count * sizeof(T) > m_Capacity) [[unlikely]]
+			{
+				PSAPI_LOG_ERROR("Scratch", "Unable to view %zu elements of %zu bytes in a scratch buffer of %zu bytes", count, sizeof(T), m_Capacity);
+			}
+			return std::span<T>(reinterpret_cast<T*>(m_Data.get()), count);
+		}
+
+	private:
+		friend class Arena;
+		Buffer(Arena* arena, std::unique_ptr<uint8_t[]> data, size_t capacity) noexcept
+			: m_Arena(arena), m_Data(std::move(data)), m_Capacity(capacity) {}
+
+		Arena* m_Arena = nullptr;
+		std::unique_ptr<uint8_t[]> m_Data;
+		size_t m_Capacity = 0u;
+	};
+
+
+	/// Pool of scratch buffers bucketed by size class, this is not thread-safe and is meant to be used through
+	/// threadArena()
+	class Arena
+	{
+	public:
+		Arena() = default;
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		/// Acquire a buffer holding at least the given number of bytes, reusing a cached buffer of the same size class
+		/// if possible
+		Buffer acquire(const size_t bytes)
+		{
+			const size_t sizeClass = sizeClassOf(bytes);
+			if (sizeClass > MAX_SIZE_CLASS)
+			{
+				return Buffer(this, std::unique_ptr<uint8_t[]>(new uint8_t[bytes]), bytes);
+			}
+			const size_t capacity = size_t(1) << sizeClass;
+			auto& freeList = m_Free[sizeClass];
+			if (!freeList.empty())
+			{
+				std::unique_ptr<uint8_t[]> data = std::move(freeList.back());
+				freeList.pop_back();
+				m_CachedBytes -= capacity;
+				return Buffer(this, std::move(data), capacity);
+			}
+			return Buffer(this, std::unique_ptr<uint8_t[]>(new uint8_t[capacity]), capacity);
+		}
+
+		/// Hand a buffer back to the arena, this is called by the Buffer destructor
+		void release(std::unique_ptr<uint8_t[]> data, const size_t capacity)
+		{
+			if (!std::has_single_bit(capacity) || capacity > (size_t(1) << MAX_SIZE_CLASS) || m_CachedBytes + capacity > MAX_CACHED_BYTES)
+			{
+				return;
+			}
+			m_Free[std::bit_width(capacity) - 1].push_back(std::move(data));
+			m_CachedBytes += capacity;
+		}
+
+		/// Free all the cached buffers
+		void clear()
+		{
+			for (auto& freeList : m_Free)
+			{
+				freeList.clear();
+			}
+			m_CachedBytes = 0u;
+		}
+
+		/// The number of bytes currently held by the cached buffers
+		size_t cachedBytes() const noexcept { return m_CachedBytes; }
+
+	private:
+		static size_t sizeClassOf(const size_t bytes) noexcept
+		{
+			if (bytes <= (size_t(1) << MIN_SIZE_CLASS))
+			{
+				return MIN_SIZE_CLASS;
+			}
+			return std::bit_width(bytes - 1);
+		}
+
+		std::array<std::vector<std::unique_ptr<uint8_t[]>>, MAX_SIZE_CLASS + 1> m_Free;
+		size_t m_CachedBytes = 0u;
+	};
+
+
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline Buffer& Buffer::operator=(Buffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_Arena && m_Data)
+			{
+				m_Arena->release(std::move(m_Data), m_Capacity);
+			}
+			m_Arena = std::exchange(other.m_Arena, nullptr);
+			m_Data = std::move(other.m_Data);
+			m_Capacity = std::exchange(other.m_Capacity, 0u);
+		}
+		return *this;
+	}
+
+
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline Buffer::~Buffer()
+	{
+		if (m_Arena && m_Data)
+		{
+			m_Arena->release(std::move(m_Data), m_Capacity);
+		}
+	}
+
+
+	/// The arena owned by the calling thread. Its buffers live until the thread exits, long-running processes may call
+	/// clear() on it to give the memory back to the system.
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	inline Arena& threadArena()
+	{
+		thread_local Arena arena;
+		return arena;
+	}
+
+
+	/// Acquire uninitialized scratch memory for at least count elements of T from the calling thread's arena
+	// ---------------------------------------------------------------------------------------------------------------------
+	// ---------------------------------------------------------------------------------------------------------------------
+	template <typename T>
+	Buffer acquire(const size_t count)
+	{
+		return threadArena().acquire(count * sizeof(T));
+	}
+}
+
+PSAPI_NAMESPACE_END
@@ -0,0 +1,83 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
+#include "Util/ProgressCallback.h"
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("ProgressCallback cancellation and deadlines")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	SUBCASE("Explicit cancellation")
+	{
+		ProgressCallback callback{};
+		CHECK_FALSE(callback.isCancelled());
+		CHECK_NOTHROW(callback.throwIfCancelled());
+		callback.cancel();
+		CHECK(callback.isCancelled());
+		CHECK_THROWS_AS(callback.throwIfCancelled(), OperationCancelled);
+	}
+	SUBCASE("Deadlines")
+	{
+		ProgressCallback callback{};
+		callback.setDeadline(std::chrono::hours(1));
+		CHECK_FALSE(callback.isCancelled());
+		callback.setDeadline(std::chrono::steady_clock::now() - std::chrono::seconds(1));
+		CHECK(callback.isCancelled());
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Cancelled reads throw")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	{
+		ProgressCallback callback{};
+		callback.cancel();
+		CHECK_THROWS_AS(LayeredFile<bpp8_t>::read("documents/Compression/Compression_RLE_8bit.psb", callback), OperationCancelled);
+	}
+	{
+		ProgressCallback callback{};
+		callback.setDeadline(std::chrono::steady_clock::now());
+		CHECK_THROWS_AS(LayeredFile<bpp8_t>::read("documents/Compression/Compression_RLE_8bit.psd", callback), OperationCancelled);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Cancelled writes throw and do not leave a file behind")
+{
+	using namespace NAMESPACE_PSAPI;
+	constexpr int32_t width = 64;
+	constexpr int32_t height = 64;
+	const std::filesystem::path path = "CancelledWrite.psd";
+
+	LayeredFile<bpp8_t> file(Enum::ColorMode::RGB, width, height);
+	std::unordered_map<int, std::vector<bpp8_t>> data =
+	{
+		{0, std::vector<bpp8_t>(width * height, 255u)},
+		{1, std::vector<bpp8_t>(width * height, 128u)},
+		{2, std::vector<bpp8_t>(width * height, 0u)},
+	};
+	auto params = Layer<bpp8_t>::Params{ .name = "Layer", .width = width, .height = height };
+	file.add_layer(std::make_shared<ImageLayer<bpp8_t>>(std::move(data), params));
+
+	ProgressCallback callback{};
+	callback.cancel();
+	CHECK_THROWS_AS(LayeredFile<bpp8_t>::write(std::move(file), path, callback), OperationCancelled);
+	CHECK_FALSE(std::filesystem::exists(path));
+}
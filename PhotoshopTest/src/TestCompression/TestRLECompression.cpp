@@ -3,9 +3,11 @@
 #include "Utility.h"
 #include "Core/Compression/Compress_RLE.h"
 #include "Core/Compression/Decompress_RLE.h"
+#include "Util/CPUFeatures.h"
 
 #include <iostream>
 #include <vector>
+#include <random>
 
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -48,6 +50,41 @@ TEST_CASE("Test Wikipedia Example")
 }
 
 
+// Check that the vectorized and the scalar encoder produce identical output on a mix of long runs and literals,
+// covering runs and literals crossing the 128 byte limit as well as the vector width
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Test PackBits with and without AVX2")
+{
+	std::mt19937 rng(42);
+	std::vector<uint8_t> data;
+	while (data.size() < 20011)
+	{
+		const size_t length = std::uniform_int_distribution<size_t>(1, 300)(rng);
+		if (std::uniform_int_distribution<int>(0, 1)(rng))
+		{
+			data.insert(data.end(), length, static_cast<uint8_t>(rng()));
+		}
+		else
+		{
+			for (size_t i = 0; i < length; ++i)
+				data.push_back(static_cast<uint8_t>(rng() % 4));
+		}
+	}
+	data.resize(20011);
+
+	uint32_t scanlineSize = 0u;
+	const bool hasAVX2 = NAMESPACE_PSAPI::CPU::hasAVX2();
+	std::vector<uint8_t> compressed = NAMESPACE_PSAPI::RLE_Impl::CompressPackBits(data, scanlineSize);
+	NAMESPACE_PSAPI::CPU::setAVX2Enabled(false);
+	std::vector<uint8_t> compressedScalar = NAMESPACE_PSAPI::RLE_Impl::CompressPackBits(data, scanlineSize);
+	NAMESPACE_PSAPI::CPU::setAVX2Enabled(hasAVX2);
+
+	CHECK(compressed == compressedScalar);
+	CHECK(NAMESPACE_PSAPI::RLE_Impl::DecompressPackBits<uint8_t>(compressed, data.size(), 1u) == data);
+}
+
+
 // Test that we can read, decompress and then recompress image data and get the exact same result. These tests rely on the
 // TestDecompressionTests to pass successfully
 // ---------------------------------------------------------------------------------------------------------------------
@@ -133,10 +170,8 @@ TEST_CASE("Check RLE MaxCompressedSize")
 		header.m_Version = NAMESPACE_PSAPI::Enum::Version::Psd;
 		size_t expectedSize = NAMESPACE_PSAPI::RLE_Impl::MaxCompressedSize<uint8_t>(header, height, width);
 
-		// Explicitly make the buffer larger than uncompressed data could ever be
-		std::vector<uint8_t> buffer(data.size() * 2);
-		auto resized_buffer = NAMESPACE_PSAPI::CompressRLE(std::span<uint8_t>(data), buffer, header, width, height);
-		CHECK(expectedSize == resized_buffer.size());
+		auto compressed = NAMESPACE_PSAPI::CompressRLE(std::span<uint8_t>(data), header, width, height);
+		CHECK(expectedSize == compressed.size());
 	}
 	SUBCASE("PSB")
 	{
@@ -153,9 +188,7 @@ TEST_CASE("Check RLE MaxCompressedSize")
 		header.m_Version = NAMESPACE_PSAPI::Enum::Version::Psb;
 		size_t expectedSize = NAMESPACE_PSAPI::RLE_Impl::MaxCompressedSize<uint8_t>(header, height, width);
 
-		// Explicitly make the buffer larger than uncompressed data could ever be
-		std::vector<uint8_t> buffer(data.size() * 2);
-		auto resized_buffer = NAMESPACE_PSAPI::CompressRLE(std::span<uint8_t>(data), buffer, header, width, height);
-		CHECK(expectedSize == resized_buffer.size());
+		auto compressed = NAMESPACE_PSAPI::CompressRLE(std::span<uint8_t>(data), header, width, height);
+		CHECK(expectedSize == compressed.size());
 	}
 }
\ No newline at end of file
@@ -9,6 +9,8 @@ sure these two results match.
 #include "Core/Compression/Compress_ZIP.h"
 #include "Core/Compression/Decompress_ZIP.h"
 
+#include "libdeflate.h"
+
 #include <vector>
 #include <limits>
 
@@ -124,4 +126,91 @@ TEST_CASE("Compress Very Large Flat Channel 32-bit")
 	std::vector<float32_t> uncompressedData = NAMESPACE_PSAPI::DecompressZIP<float32_t>(compressedData, width, height);
 
 	CHECK(dataExpected == uncompressedData);
-}
\ No newline at end of file
+}
+
+
+// Check that every supported compression level roundtrips and that levels outside of the range are rejected
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Compress Channel at explicit compression levels")
+{
+	uint32_t width = 256;
+	uint32_t height = 256;
+
+	std::vector<uint16_t> dataExpected(width * height);
+	for (size_t i = 0; i < dataExpected.size(); ++i)
+	{
+		dataExpected[i] = static_cast<uint16_t>((i * 7u) % 1024u);
+	}
+
+	for (int level = NAMESPACE_PSAPI::ZIP_MIN_COMPRESSION_LVL; level <= NAMESPACE_PSAPI::ZIP_MAX_COMPRESSION_LVL; ++level)
+	{
+		std::vector<uint16_t> channel = dataExpected;
+		std::vector<uint8_t> compressedData = NAMESPACE_PSAPI::CompressZIP<uint16_t>(channel, level);
+		std::vector<uint16_t> uncompressedData = NAMESPACE_PSAPI::DecompressZIP<uint16_t>(compressedData, width, height);
+
+		CHECK(dataExpected == uncompressedData);
+	}
+
+	std::vector<uint16_t> channel = dataExpected;
+	CHECK_THROWS(NAMESPACE_PSAPI::CompressZIP<uint16_t>(channel, NAMESPACE_PSAPI::ZIP_MAX_COMPRESSION_LVL + 1));
+	CHECK_THROWS(NAMESPACE_PSAPI::CompressZIP<uint16_t>(channel, -1));
+}
+
+
+// Check that channels large enough to be compressed in parallel chunks produce a single valid zlib stream. The size is
+// deliberately not a multiple of the chunk size and the data is noisy enough to produce dynamic huffman blocks
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Compress Large Channel in parallel chunks")
+{
+	uint32_t width = 3001;
+	uint32_t height = 1001;
+
+	std::vector<uint16_t> dataExpected(static_cast<size_t>(width) * height);
+	uint32_t state = 12345u;
+	for (size_t i = 0; i < dataExpected.size(); ++i)
+	{
+		state = state * 1664525u + 1013904223u;
+		dataExpected[i] = static_cast<uint16_t>((i / 64) % 4096 + (state >> 28));
+	}
+	REQUIRE(dataExpected.size() * sizeof(uint16_t) >= NAMESPACE_PSAPI::ZIP_PARALLEL_MIN_SIZE);
+
+	for (int level : { 0, 1, 4, 9, 12 })
+	{
+		std::vector<uint16_t> channel = dataExpected;
+		std::vector<uint8_t> compressedData = NAMESPACE_PSAPI::CompressZIP<uint16_t>(channel, level);
+		std::vector<uint16_t> uncompressedData = NAMESPACE_PSAPI::DecompressZIP<uint16_t>(compressedData, width, height);
+
+		CHECK(dataExpected == uncompressedData);
+	}
+}
+
+
+// Check that the zlib header we write by hand matches the one libdeflate writes for the same compression level
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Zlib header matches libdeflate")
+{
+	std::vector<uint8_t> data(1024);
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<uint8_t>(i % 13);
+	}
+
+	for (int level = NAMESPACE_PSAPI::ZIP_MIN_COMPRESSION_LVL; level <= NAMESPACE_PSAPI::ZIP_MAX_COMPRESSION_LVL; ++level)
+	{
+		libdeflate_compressor* compressor = libdeflate_alloc_compressor(level);
+		REQUIRE(compressor != nullptr);
+		std::vector<uint8_t> compressed(libdeflate_zlib_compress_bound(compressor, data.size()));
+		const size_t size = libdeflate_zlib_compress(compressor, data.data(), data.size(), compressed.data(), compressed.size());
+		libdeflate_free_compressor(compressor);
+		REQUIRE(size > 2);
+
+		std::vector<uint8_t> channel = data;
+		std::vector<uint8_t> ours = NAMESPACE_PSAPI::CompressZIP<uint8_t>(channel, level);
+		CHECK(compressed[0] == ours[0]);
+		CHECK(compressed[1] == ours[1]);
+		CHECK(compressed[1] == NAMESPACE_PSAPI::ZIP_Impl::ZlibHeaderByte(level));
+	}
+}
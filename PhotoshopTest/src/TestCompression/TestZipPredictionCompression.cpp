@@ -88,4 +88,51 @@ TEST_CASE("Compress Large Flat Channel 32-bit")
 	std::vector<float32_t> uncompressedData = NAMESPACE_PSAPI::DecompressZIPPrediction<float32_t>(compressedData, width, height);
 
 	CHECK_VEC_VERBOSE(dataExpected, uncompressedData);
-}
\ No newline at end of file
+}
+
+// Check that non-flat data with a width that is not a multiple of the vector width roundtrips for all bit depths, this 
+// exercises both the vectorized body and the scalar tail of the prediction kernels
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Compress Gradient Channel with odd width")
+{
+	uint32_t width = 67;
+	uint32_t height = 13;
+
+	SUBCASE("8-bit")
+	{
+		std::vector<uint8_t> channel(width * height);
+		for (size_t i = 0; i < channel.size(); ++i)
+			channel[i] = static_cast<uint8_t>(i * 7 + i / width);
+		std::vector<uint8_t> dataExpected = channel;
+
+		std::vector<uint8_t> compressedData = NAMESPACE_PSAPI::CompressZIPPrediction<uint8_t>(channel, width, height);
+		std::vector<uint8_t> uncompressedData = NAMESPACE_PSAPI::DecompressZIPPrediction<uint8_t>(compressedData, width, height);
+
+		CHECK(dataExpected == uncompressedData);
+	}
+	SUBCASE("16-bit")
+	{
+		std::vector<uint16_t> channel(width * height);
+		for (size_t i = 0; i < channel.size(); ++i)
+			channel[i] = static_cast<uint16_t>(i * 1031 + i / width);
+		std::vector<uint16_t> dataExpected = channel;
+
+		std::vector<uint8_t> compressedData = NAMESPACE_PSAPI::CompressZIPPrediction<uint16_t>(channel, width, height);
+		std::vector<uint16_t> uncompressedData = NAMESPACE_PSAPI::DecompressZIPPrediction<uint16_t>(compressedData, width, height);
+
+		CHECK(dataExpected == uncompressedData);
+	}
+	SUBCASE("32-bit")
+	{
+		std::vector<float32_t> channel(width * height);
+		for (size_t i = 0; i < channel.size(); ++i)
+			channel[i] = static_cast<float32_t>(i) / 17.0f - 3.0f;
+		std::vector<float32_t> dataExpected = channel;
+
+		std::vector<uint8_t> compressedData = NAMESPACE_PSAPI::CompressZIPPrediction<float32_t>(channel, width, height);
+		std::vector<float32_t> uncompressedData = NAMESPACE_PSAPI::DecompressZIPPrediction<float32_t>(compressedData, width, height);
+
+		CHECK_VEC_VERBOSE(dataExpected, uncompressedData);
+	}
+}
@@ -2,6 +2,7 @@
 
 #include "../DetectArmMac.h"
 #include "Core/Endian/EndianByteSwapArr.h"
+#include "Util/CPUFeatures.h"
 
 #include <vector>
 
@@ -469,4 +470,28 @@ TEST_CASE("Endian Decode Binary 32-bit large uneven")
 
 	auto result = NAMESPACE_PSAPI::endianDecodeBEBinaryArray<NAMESPACE_PSAPI::bpp32_t>(binaryData);
 }
-#endif
\ No newline at end of file
+#endif
+
+
+// Test that the runtime dispatched SIMD path and the scalar fallback agree on data that spans multiple cache blocks 
+// with a remainder
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Endian decoding with and without AVX2")
+{
+	std::vector<uint32_t> data(3 * 16384 + 17);
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<uint32_t>(i * 2654435761u);
+	}
+	std::vector<uint32_t> dataSimd = data;
+	std::vector<uint32_t> dataScalar = data;
+
+	NAMESPACE_PSAPI::endianDecodeBEArray(std::span<uint32_t>(dataSimd));
+	NAMESPACE_PSAPI::CPU::setAVX2Enabled(false);
+	NAMESPACE_PSAPI::endianDecodeBEArray(std::span<uint32_t>(dataScalar));
+	NAMESPACE_PSAPI::CPU::setAVX2Enabled(true);
+
+	CHECK(dataSimd == dataScalar);
+	CHECK(dataScalar[1] == NAMESPACE_PSAPI::endian_decode_be<uint32_t>(reinterpret_cast<std::byte*>(&data[1])));
+}
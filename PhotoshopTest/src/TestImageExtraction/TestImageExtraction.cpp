@@ -9,6 +9,7 @@
 
 #include <string>
 #include <vector>
+#include <filesystem>
 
 
 
@@ -166,4 +167,271 @@ TEST_CASE("Double extract mask channel from group")
 	std::vector<bpp8_t> groupMaskChannel2 = groupLayerPtr->get_mask();
 
 	CHECK(groupMaskChannel == groupMaskChannel2);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Lazily read channels match eagerly read channels")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	for (const auto& path : { "documents/Compression/Compression_RLE_8bit.psb", "documents/Compression/Compression_RLE_8bit.psd" })
+	{
+		ProgressCallback callback{};
+		LayeredFile<bpp8_t> eagerFile = LayeredFile<bpp8_t>::read(path);
+		LayeredFile<bpp8_t> lazyFile = LayeredFile<bpp8_t>::read(path, callback, true);
+		auto eagerLayerPtr = find_layer_as<bpp8_t, ImageLayer>("Layer_R255_G128_B0", eagerFile);
+		auto lazyLayerPtr = find_layer_as<bpp8_t, ImageLayer>("Layer_R255_G128_B0", lazyFile);
+
+		for (const auto& [key, channel] : lazyLayerPtr->get_storage())
+		{
+			CHECK(channel->is_lazy());
+		}
+
+		CHECK(lazyLayerPtr->get_channel(Enum::ChannelID::Red) == eagerLayerPtr->get_channel(Enum::ChannelID::Red));
+		// Accessing the channel again must decode the same data
+		CHECK(lazyLayerPtr->get_channel(Enum::ChannelID::Red) == eagerLayerPtr->get_channel(Enum::ChannelID::Red));
+		CHECK(lazyLayerPtr->get_image_data() == eagerLayerPtr->get_image_data());
+	}
+}
+
+
+template <typename T>
+void checkChannelRegions(const std::filesystem::path& path, const std::string& layerName = "Layer_R255_G128_B0")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	for (bool lazy : { false, true })
+	{
+		ProgressCallback callback{};
+		LayeredFile<T> file = LayeredFile<T>::read(path, callback, lazy);
+		auto layerPtr = find_layer_as<T, ImageLayer>(layerName, file);
+		REQUIRE(layerPtr != nullptr);
+		const auto width = static_cast<int>(layerPtr->width());
+		const auto height = static_cast<int>(layerPtr->height());
+		const auto full = layerPtr->get_channel(Enum::ChannelID::Red);
+
+		for (const auto& roi : {
+			Geometry::BoundingBox<int>({ 0, 0 }, { width, height }),
+			Geometry::BoundingBox<int>({ 0, height / 3 }, { width, height / 3 + 1 }),
+			Geometry::BoundingBox<int>({ width / 4, height / 4 }, { width / 2, height / 2 }),
+			Geometry::BoundingBox<int>({ width - 1, height - 1 }, { width, height })
+			})
+		{
+			std::vector<T> expected;
+			for (int y = roi.minimum.y; y < roi.maximum.y; ++y)
+			{
+				auto row = full.begin() + static_cast<size_t>(y) * width;
+				expected.insert(expected.end(), row + roi.minimum.x, row + roi.maximum.x);
+			}
+			CHECK(layerPtr->get_channel(Enum::ChannelID::Red, roi) == expected);
+		}
+
+		CHECK_THROWS_AS(layerPtr->get_channel(Enum::ChannelID::Red, Geometry::BoundingBox<int>({ 0, 0 }, { width + 1, 1 })), std::invalid_argument);
+		CHECK_THROWS_AS(layerPtr->get_channel(Enum::ChannelID::Red, Geometry::BoundingBox<int>({ 1, 1 }, { 1, 2 })), std::invalid_argument);
+	}
+}
+
+
+TEST_CASE("Retrieve a region of a channel")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	checkChannelRegions<bpp8_t>("documents/Compression/Compression_RLE_8bit.psb");
+	checkChannelRegions<bpp8_t>("documents/Compression/Compression_RLE_8bit.psd");
+	checkChannelRegions<bpp8_t>("documents/Compression/Compression_RAW_8bit.psd", "Layer 1");
+	checkChannelRegions<bpp16_t>("documents/Compression/Compression_ZipPrediction_16bit.psb");
+	checkChannelRegions<bpp32_t>("documents/Compression/Compression_ZipPrediction_32bit.psd");
+}
+
+
+TEST_CASE("Lazily read file can overwrite its source")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	const std::filesystem::path path = "documents/Compression/lazy_overwrite.psb";
+	std::filesystem::copy_file("documents/Compression/Compression_RLE_8bit.psb", path, std::filesystem::copy_options::overwrite_existing);
+
+	ProgressCallback callback{};
+	LayeredFile<bpp8_t> layeredFile = LayeredFile<bpp8_t>::read(path, callback, true);
+	LayeredFile<bpp8_t>::write(std::move(layeredFile), path);
+
+	LayeredFile<bpp8_t> reread = LayeredFile<bpp8_t>::read(path);
+	auto imageLayerPtr = find_layer_as<bpp8_t, ImageLayer>("Layer_R255_G128_B0", reread);
+	std::vector<bpp8_t> expected_g(reread.width() * reread.height(), 128u);
+	CHECK(imageLayerPtr->get_channel(Enum::ChannelID::Green) == expected_g);
+}
+
+
+TEST_CASE("Read the merged composite")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	for (const auto& path : { "documents/Compression/Compression_RLE_8bit.psb", "documents/Compression/Compression_RLE_8bit.psd" })
+	{
+		auto composite = LayeredFile<bpp8_t>::read_composite(path);
+		LayeredFile<bpp8_t> eagerFile = LayeredFile<bpp8_t>::read(path);
+		ProgressCallback callback{};
+		LayeredFile<bpp8_t> lazyFile = LayeredFile<bpp8_t>::read(path, callback, true);
+
+		REQUIRE(composite.size() >= 3);
+		for (int index : { 0, 1, 2 })
+		{
+			REQUIRE(composite.contains(index));
+			CHECK(composite.at(index).size() == eagerFile.width() * eagerFile.height());
+		}
+		// The top layer covers the whole canvas
+		CHECK(composite.at(0) == std::vector<bpp8_t>(composite.at(0).size(), 255u));
+		CHECK(composite.at(1) == std::vector<bpp8_t>(composite.at(1).size(), 128u));
+		CHECK(composite.at(2) == std::vector<bpp8_t>(composite.at(2).size(), 0u));
+		CHECK(eagerFile.composite() == composite);
+		CHECK(lazyFile.composite() == composite);
+	}
+
+	// Files created in memory don't hold a composite
+	LayeredFile<bpp8_t> emptyFile(Enum::ColorMode::RGB, 32, 32);
+	CHECK(emptyFile.composite().empty());
+
+	// Eagerly read files reopen the document to decode the composite which must therefore not have changed
+	const std::filesystem::path path = "documents/Compression/composite_modified.psb";
+	std::filesystem::copy_file("documents/Compression/Compression_RLE_8bit.psb", path, std::filesystem::copy_options::overwrite_existing);
+	LayeredFile<bpp8_t> modifiedFile = LayeredFile<bpp8_t>::read(path);
+	std::filesystem::copy_file("documents/Compression/Compression_RAW_8bit.psb", path, std::filesystem::copy_options::overwrite_existing);
+	CHECK_THROWS(modifiedFile.composite());
+	std::filesystem::remove(path);
+}
+
+
+TEST_CASE("Write the merged composite")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	for (const auto& extension : { ".psb", ".psd" })
+	{
+		std::filesystem::path path = std::string("documents/Compression/Compression_RLE_8bit") + extension;
+		std::filesystem::path outPath = std::string("documents/Compression/Compression_RLE_8bit_Composite") + extension;
+		auto expected = LayeredFile<bpp8_t>::read_composite(path);
+
+		// By default we write an empty composite
+		{
+			LayeredFile<bpp8_t> file = LayeredFile<bpp8_t>::read(path);
+			LayeredFile<bpp8_t>::write(std::move(file), outPath);
+			auto composite = LayeredFile<bpp8_t>::read_composite(outPath);
+			REQUIRE(composite.contains(0));
+			CHECK(composite.at(0) == std::vector<bpp8_t>(composite.at(0).size(), 0u));
+		}
+		{
+			LayeredFile<bpp8_t> file = LayeredFile<bpp8_t>::read(path);
+			file.write_composite(true);
+			LayeredFile<bpp8_t>::write(std::move(file), outPath);
+			auto composite = LayeredFile<bpp8_t>::read_composite(outPath);
+			for (int index : { 0, 1, 2 })
+			{
+				REQUIRE(composite.contains(index));
+				CHECK(composite.at(index) == expected.at(index));
+			}
+			// The layers themselves are unaffected
+			LayeredFile<bpp8_t> reread = LayeredFile<bpp8_t>::read(outPath);
+			CHECK(reread.flat_layers().size() == 5);
+		}
+	}
+
+	// Masked layers and nested groups are flattened the same way Photoshop does
+	for (const auto& path : { "documents/Masks/Masks_8bit.psd", "documents/Groups/Groups_8bit.psd" })
+	{
+		auto expected = LayeredFile<bpp8_t>::read_composite(path);
+		LayeredFile<bpp8_t> file = LayeredFile<bpp8_t>::read(path);
+		file.write_composite(true);
+		LayeredFile<bpp8_t>::write(std::move(file), "documents/Composite_Out.psd");
+		auto composite = LayeredFile<bpp8_t>::read_composite("documents/Composite_Out.psd");
+		for (int index : { 0, 1, 2 })
+		{
+			CHECK(composite.at(index) == expected.at(index));
+		}
+	}
+}
+
+
+TEST_CASE("Flatten a layered file")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	FlattenOptions options{};
+	options.matte = 1.0f;
+
+	// Clipping masks, blend fill and groups should match the composite Photoshop stored
+	for (const auto& path : { "documents/ClippingMasks/clipping_masks.psd", "documents/BlendFill/blend_fill.psd", "documents/Groups/Groups_8bit.psd" })
+	{
+		auto expected = LayeredFile<bpp8_t>::read_composite(path);
+		LayeredFile<bpp8_t> file = LayeredFile<bpp8_t>::read(path);
+		auto flattened = file.flatten(std::nullopt, options);
+		for (int index : { 0, 1, 2 })
+		{
+			REQUIRE(flattened.contains(index));
+			CHECK(flattened.at(index) == expected.at(index));
+		}
+		CHECK(flattened.contains(-1));
+	}
+
+	// A region of interest is identical to the same region of the full flatten
+	{
+		LayeredFile<bpp8_t> file = LayeredFile<bpp8_t>::read("documents/Masks/Masks_8bit.psd");
+		auto full = file.flatten(std::nullopt, options);
+		auto region = file.flatten(Geometry::BoundingBox<int>({ 5, 7 }, { 40, 33 }), options);
+		for (int y = 7; y < 33; ++y)
+		{
+			for (int x = 5; x < 40; ++x)
+			{
+				CHECK(region.at(0)[(y - 7) * 35 + (x - 5)] == full.at(0)[y * file.width() + x]);
+			}
+		}
+		CHECK_THROWS(file.flatten(Geometry::BoundingBox<int>({ -20, -20 }, { -1, -1 })));
+	}
+}
+
+
+TEST_CASE("Flatten clipped layers onto a base without fill")
+{
+	using namespace NAMESPACE_PSAPI;
+	constexpr int32_t width = 8;
+	constexpr int32_t height = 8;
+
+	LayeredFile<bpp8_t> file(Enum::ColorMode::RGB, width, height);
+
+	// The clipped layer is fully opaque while the base only covers the left half of the canvas
+	auto clippedParams = Layer<bpp8_t>::Params{ .name = "Clipped", .center_x = width / 2, .center_y = height / 2, .width = width, .height = height, .clipping_mask = true };
+	std::unordered_map<Enum::ChannelID, std::vector<bpp8_t>> clippedData =
+	{
+		{ Enum::ChannelID::Red, std::vector<bpp8_t>(width * height, 0u) },
+		{ Enum::ChannelID::Green, std::vector<bpp8_t>(width * height, 255u) },
+		{ Enum::ChannelID::Blue, std::vector<bpp8_t>(width * height, 0u) },
+	};
+	file.add_layer(std::make_shared<ImageLayer<bpp8_t>>(std::move(clippedData), clippedParams));
+
+	std::vector<bpp8_t> baseAlpha(width * height, 0u);
+	for (size_t i = 0; i < baseAlpha.size(); ++i)
+	{
+		baseAlpha[i] = (i % width) < width / 2 ? 255u : 0u;
+	}
+	auto baseParams = Layer<bpp8_t>::Params{ .name = "Base", .center_x = width / 2, .center_y = height / 2, .width = width, .height = height };
+	std::unordered_map<Enum::ChannelID, std::vector<bpp8_t>> baseData =
+	{
+		{ Enum::ChannelID::Red, std::vector<bpp8_t>(width * height, 255u) },
+		{ Enum::ChannelID::Green, std::vector<bpp8_t>(width * height, 0u) },
+		{ Enum::ChannelID::Blue, std::vector<bpp8_t>(width * height, 0u) },
+		{ Enum::ChannelID::Alpha, baseAlpha },
+	};
+	auto base = std::make_shared<ImageLayer<bpp8_t>>(std::move(baseData), baseParams);
+	base->fill(0.0f);
+	file.add_layer(base);
+
+	// The base itself is hidden but still clips the layers above it
+	auto flattened = file.flatten();
+	CHECK(flattened.at(-1) == baseAlpha);
+	for (size_t i = 0; i < baseAlpha.size(); ++i)
+	{
+		if (baseAlpha[i] != 0u)
+		{
+			CHECK(flattened.at(0)[i] == 0u);
+			CHECK(flattened.at(1)[i] == 255u);
+		}
+	}
+}
@@ -0,0 +1,303 @@
+#include "doctest.h"
+
+#include "PhotoshopAPI.h"
+#include "Core/Render/Composite.h"
+
+#include <vector>
+#include <random>
+#include <cstdlib>
+
+using namespace NAMESPACE_PSAPI;
+
+
+namespace
+{
+	/// Generate a row of random premultiplied values and their alpha.
+	template <typename T>
+	void generate_premultiplied(std::vector<T>& values, std::vector<T>& alpha, std::mt19937& generator)
+	{
+		std::uniform_int_distribution<int> distribution(0, 255);
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			const float a = static_cast<float>(distribution(generator)) / 255.0f;
+			const float v = static_cast<float>(distribution(generator)) / 255.0f;
+			if constexpr (std::is_same_v<T, float32_t>)
+			{
+				alpha[i] = a;
+				values[i] = v * a;
+			}
+			else
+			{
+				const float max = static_cast<float>(std::numeric_limits<T>::max());
+				alpha[i] = static_cast<T>(std::round(a * max));
+				values[i] = static_cast<T>(std::round(v * a * max));
+			}
+		}
+	}
+
+	/// Check that the row based kernel matches the per-pixel kernel within a tolerance of 1 (or 1/255 for floats).
+	template <typename T, typename BlendOp>
+	void check_separable_row(size_t size)
+	{
+		std::mt19937 generator(42);
+		std::vector<T> canvas(size), canvas_alpha(size), layer(size), layer_alpha(size);
+		generate_premultiplied(canvas, canvas_alpha, generator);
+		generate_premultiplied(layer, layer_alpha, generator);
+
+		std::vector<T> expected(size);
+		for (size_t i = 0; i < size; ++i)
+		{
+			expected[i] = Composite::kernel::separable_blend<T, float, BlendOp>(canvas[i], canvas_alpha[i], layer[i], layer_alpha[i]);
+		}
+		Composite::kernel::separable_row<T, float, BlendOp>(canvas, canvas_alpha, layer, layer_alpha);
+
+		const double tolerance = std::is_same_v<T, float32_t> ? 1.0 / 255.0 : 1.0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			CHECK(std::abs(static_cast<double>(canvas[i]) - static_cast<double>(expected[i])) <= tolerance);
+		}
+	}
+
+	template <typename T, typename BlendOp>
+	void check_nonseparable_row(size_t size)
+	{
+		std::mt19937 generator(42);
+		std::vector<T> canvas_alpha(size), layer_alpha(size);
+		std::array<std::vector<T>, 3> canvas, layer;
+		for (size_t c = 0; c < 3; ++c)
+		{
+			canvas[c].resize(size);
+			layer[c].resize(size);
+		}
+		// Generate the alpha once and then the color values respecting that alpha
+		generate_premultiplied(canvas[0], canvas_alpha, generator);
+		generate_premultiplied(layer[0], layer_alpha, generator);
+		for (size_t c = 1; c < 3; ++c)
+		{
+			std::vector<T> _alpha(size);
+			generate_premultiplied(canvas[c], _alpha, generator);
+			generate_premultiplied(layer[c], _alpha, generator);
+			for (size_t i = 0; i < size; ++i)
+			{
+				canvas[c][i] = std::min(canvas[c][i], canvas_alpha[i]);
+				layer[c][i] = std::min(layer[c][i], layer_alpha[i]);
+			}
+		}
+
+		std::array<std::vector<T>, 3> expected = canvas;
+		for (size_t i = 0; i < size; ++i)
+		{
+			const auto result = Composite::kernel::nonseparable_blend<T, float, BlendOp>(
+				{ canvas[0][i], canvas[1][i], canvas[2][i] }, canvas_alpha[i], { layer[0][i], layer[1][i], layer[2][i] }, layer_alpha[i]);
+			for (size_t c = 0; c < 3; ++c)
+			{
+				expected[c][i] = result[c];
+			}
+		}
+		Composite::kernel::nonseparable_row<T, float, BlendOp>(
+			{ std::span<T>(canvas[0]), std::span<T>(canvas[1]), std::span<T>(canvas[2]) },
+			canvas_alpha,
+			{ std::span<const T>(layer[0]), std::span<const T>(layer[1]), std::span<const T>(layer[2]) },
+			layer_alpha
+		);
+
+		const double tolerance = std::is_same_v<T, float32_t> ? 1.0 / 255.0 : 1.0;
+		for (size_t c = 0; c < 3; ++c)
+		{
+			for (size_t i = 0; i < size; ++i)
+			{
+				CHECK(std::abs(static_cast<double>(canvas[c][i]) - static_cast<double>(expected[c][i])) <= tolerance);
+			}
+		}
+	}
+
+	template <typename T>
+	void check_all_row_kernels(size_t size)
+	{
+		namespace sep = Composite::kernel::separable;
+		namespace nonsep = Composite::kernel::nonseparable;
+
+		check_separable_row<T, sep::normal>(size);
+		check_separable_row<T, sep::multiply>(size);
+		check_separable_row<T, sep::screen>(size);
+		check_separable_row<T, sep::overlay>(size);
+		check_separable_row<T, sep::soft_light>(size);
+		check_separable_row<T, sep::hard_light>(size);
+		check_separable_row<T, sep::color_dodge>(size);
+		check_separable_row<T, sep::color_burn>(size);
+		check_separable_row<T, sep::linear_dodge>(size);
+		check_separable_row<T, sep::linear_burn>(size);
+		check_separable_row<T, sep::darken>(size);
+		check_separable_row<T, sep::lighten>(size);
+		check_separable_row<T, sep::difference>(size);
+		check_separable_row<T, sep::exclusion>(size);
+		check_separable_row<T, sep::subtract>(size);
+		check_separable_row<T, sep::divide>(size);
+		check_separable_row<T, sep::vivid_light>(size);
+		check_separable_row<T, sep::linear_light>(size);
+		check_separable_row<T, sep::pin_light>(size);
+		check_separable_row<T, sep::hard_mix>(size);
+
+		check_nonseparable_row<T, nonsep::hue>(size);
+		check_nonseparable_row<T, nonsep::saturation>(size);
+		check_nonseparable_row<T, nonsep::color>(size);
+		check_nonseparable_row<T, nonsep::luminosity>(size);
+		check_nonseparable_row<T, nonsep::darker_color>(size);
+		check_nonseparable_row<T, nonsep::lighter_color>(size);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Composite separable blend modes on opaque pixels")
+{
+	using type = uint8_t;
+	namespace sep = Composite::kernel::separable;
+
+	CHECK(Composite::kernel::separable_blend<type, float, sep::normal>(255, 255, 128, 255) == 128);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::multiply>(255, 255, 128, 255) == 128);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::multiply>(0, 255, 128, 255) == 0);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::screen>(0, 255, 128, 255) == 128);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::screen>(255, 255, 128, 255) == 255);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::difference>(200, 255, 50, 255) == 150);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::darken>(200, 255, 50, 255) == 50);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::lighten>(200, 255, 50, 255) == 200);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::linear_dodge>(200, 255, 100, 255) == 255);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::linear_burn>(200, 255, 100, 255) == 45);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Composite separable blend modes over a transparent canvas")
+{
+	using type = uint8_t;
+	namespace sep = Composite::kernel::separable;
+
+	// With a fully transparent canvas the blend mode has no effect and the layer is placed as-is.
+	CHECK(Composite::kernel::separable_blend<type, float, sep::multiply>(0, 0, 100, 200) == 100);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::color_burn>(0, 0, 100, 200) == 100);
+	CHECK(Composite::kernel::separable_blend<type, float, sep::difference>(0, 0, 100, 200) == 100);
+	// And with a fully transparent layer the canvas is left untouched
+	CHECK(Composite::kernel::separable_blend<type, float, sep::screen>(100, 200, 0, 0) == 100);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Composite non-separable blend modes on opaque pixels")
+{
+	using type = uint8_t;
+	namespace nonsep = Composite::kernel::nonseparable;
+
+	const std::array<type, 3> gray = { 128, 128, 128 };
+	const std::array<type, 3> red = { 255, 0, 0 };
+
+	// A gray canvas has no saturation so applying the hue of red onto it keeps it gray
+	CHECK(Composite::kernel::nonseparable_blend<type, float, nonsep::hue>(gray, 255, red, 255) == gray);
+	// Luminosity of a gray layer over a gray canvas is a no-op
+	CHECK(Composite::kernel::nonseparable_blend<type, float, nonsep::luminosity>(gray, 255, gray, 255) == gray);
+	CHECK(Composite::kernel::nonseparable_blend<type, float, nonsep::darker_color>(gray, 255, red, 255) == red);
+	CHECK(Composite::kernel::nonseparable_blend<type, float, nonsep::lighter_color>(gray, 255, red, 255) == gray);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Composite row kernels match per-pixel kernels")
+{
+	// Use sizes that are not a multiple of the SIMD width to also exercise the scalar remainder
+	for (size_t size : { 1, 7, 8, 29, 64, 131 })
+	{
+		check_all_row_kernels<bpp8_t>(size);
+		check_all_row_kernels<bpp16_t>(size);
+		check_all_row_kernels<bpp32_t>(size);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Composite layer spanning multiple tiles with mask and opacity")
+{
+	using type = uint8_t;
+	namespace sep = Composite::kernel::separable;
+
+	constexpr size_t canvas_width = Composite::s_tile_size * 2 + 50;
+	constexpr size_t canvas_height = Composite::s_tile_size + 20;
+
+	// Layer extending past the top left of the canvas with a mask covering only part of it
+	constexpr int layer_left = -30;
+	constexpr int layer_top = -10;
+	constexpr size_t layer_width = 400;
+	constexpr size_t layer_height = 200;
+	constexpr int mask_left = 100;
+	constexpr int mask_top = 50;
+	constexpr size_t mask_width = 300;
+	constexpr size_t mask_height = 100;
+	constexpr float opacity = 0.5f;
+
+	std::mt19937 generator(7);
+	std::vector<type> canvas_r(canvas_width * canvas_height), canvas_alpha(canvas_width * canvas_height);
+	std::vector<type> layer_r(layer_width * layer_height), layer_alpha(layer_width * layer_height);
+	std::vector<type> mask(mask_width * mask_height);
+	generate_premultiplied(canvas_r, canvas_alpha, generator);
+	generate_premultiplied(layer_r, layer_alpha, generator);
+	std::uniform_int_distribution<int> distribution(0, 255);
+	std::generate(mask.begin(), mask.end(), [&]() { return static_cast<type>(distribution(generator)); });
+
+	// Compute the expected result per-pixel
+	std::vector<type> expected_r = canvas_r;
+	std::vector<type> expected_alpha = canvas_alpha;
+	for (int y = 0; y < static_cast<int>(canvas_height); ++y)
+	{
+		for (int x = 0; x < static_cast<int>(canvas_width); ++x)
+		{
+			const int lx = x - layer_left;
+			const int ly = y - layer_top;
+			const int mx = x - mask_left;
+			const int my = y - mask_top;
+			if (lx < 0 || ly < 0 || lx >= static_cast<int>(layer_width) || ly >= static_cast<int>(layer_height))
+			{
+				continue;
+			}
+			if (mx < 0 || my < 0 || mx >= static_cast<int>(mask_width) || my >= static_cast<int>(mask_height))
+			{
+				continue;
+			}
+			const float coverage = opacity * mask[my * mask_width + mx] / 255.0f;
+			const auto color = static_cast<type>(std::round(layer_r[ly * layer_width + lx] * coverage));
+			const auto alpha = static_cast<type>(std::round(layer_alpha[ly * layer_width + lx] * coverage));
+			const size_t idx = y * canvas_width + x;
+			expected_r[idx] = Composite::kernel::separable_blend<type, float, sep::multiply>(expected_r[idx], expected_alpha[idx], color, alpha);
+			expected_alpha[idx] = Composite::kernel::alpha<type, float>(expected_alpha[idx], alpha);
+		}
+	}
+
+	std::unordered_map<int, Render::ChannelBuffer<type>> canvas_channels;
+	canvas_channels[0] = Render::ChannelBuffer<type>(canvas_r, canvas_width, canvas_height);
+	canvas_channels[-1] = Render::ChannelBuffer<type>(canvas_alpha, canvas_width, canvas_height);
+	auto canvas = Render::ImageBuffer<type>(canvas_channels, "canvas");
+
+	// Channels are positioned by their center
+	const Geometry::Point2D<int> layer_center(layer_left + static_cast<int>(layer_width / 2), layer_top + static_cast<int>(layer_height / 2));
+	const Geometry::Point2D<int> mask_center(mask_left + static_cast<int>(mask_width / 2), mask_top + static_cast<int>(mask_height / 2));
+	std::unordered_map<int, Render::ConstChannelBuffer<type>> layer_channels;
+	layer_channels[0] = Render::ConstChannelBuffer<type>(layer_r, layer_width, layer_height, layer_center.x, layer_center.y);
+	layer_channels[-1] = Render::ConstChannelBuffer<type>(layer_alpha, layer_width, layer_height, layer_center.x, layer_center.y);
+	layer_channels[-2] = Render::ConstChannelBuffer<type>(mask, mask_width, mask_height, mask_center.x, mask_center.y);
+	auto layer = Render::ConstImageBuffer<type>(layer_channels, "layer", 0, layer_center, opacity);
+
+	Composite::composite_rgb<type, float>(canvas, layer, Enum::BlendMode::Multiply);
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < canvas_r.size(); ++i)
+	{
+		if (std::abs(canvas_r[i] - expected_r[i]) > 1 || std::abs(canvas_alpha[i] - expected_alpha[i]) > 1)
+		{
+			++mismatches;
+		}
+	}
+	CHECK(mismatches == 0);
+}
@@ -0,0 +1,82 @@
+#include "doctest.h"
+
+#include "PhotoshopAPI.h"
+#include "Core/Render/MipPyramid.h"
+
+#include <vector>
+
+using namespace NAMESPACE_PSAPI;
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Mip pyramid levels halve down to a single pixel")
+{
+	constexpr size_t width = 37;
+	constexpr size_t height = 10;
+	std::vector<uint8_t> image(width * height);
+	for (size_t i = 0; i < image.size(); ++i)
+	{
+		image[i] = static_cast<uint8_t>((i % 2) * 200);
+	}
+	Render::MipPyramid<uint8_t> pyramid(Render::ConstChannelBuffer<uint8_t>(image, width, height));
+
+	// 37x10 -> 19x5 -> 10x3 -> 5x2 -> 3x1 -> 2x1 -> 1x1
+	REQUIRE(pyramid.num_levels() == 6);
+	CHECK(pyramid.level(1).width == 19);
+	CHECK(pyramid.level(1).height == 5);
+	CHECK(pyramid.level(6).width == 1);
+	CHECK(pyramid.level(6).height == 1);
+	CHECK_THROWS(pyramid.level(0));
+	CHECK_THROWS(pyramid.level(7));
+
+	// Alternating columns of 0 and 200 get averaged out by the first reduction
+	CHECK(pyramid.level(1).pixel(4, 2) == 100);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Trilinear sampling of a mip pyramid")
+{
+	constexpr size_t size = 64;
+	std::vector<float> image(size * size);
+	for (size_t y = 0; y < size; ++y)
+	{
+		for (size_t x = 0; x < size; ++x)
+		{
+			image[y * size + x] = static_cast<float>((x + y) % 2);
+		}
+	}
+	Render::ConstChannelBuffer<float> buffer(image, size, size);
+	Render::MipPyramid<float> pyramid(buffer);
+	const Geometry::Point2D<double> uv(0.3, 0.6);
+
+	// A level of detail of zero samples the image itself
+	CHECK(pyramid.sample_trilinear_uv<double>(buffer, uv, 0.0f) == buffer.sample_bilinear_uv<double>(uv));
+	// Any reduced level of a checkerboard is a flat grey, as is any level of detail in between
+	CHECK(pyramid.sample_trilinear_uv<double>(buffer, uv, 1.0f) == doctest::Approx(0.5f));
+	CHECK(pyramid.sample_trilinear_uv<double>(buffer, uv, 3.5f) == doctest::Approx(0.5f));
+	// Levels of detail past the last level clamp to it
+	CHECK(pyramid.sample_trilinear_uv<double>(buffer, uv, 100.0f) == doctest::Approx(0.5f));
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Trilinear sampling of an integral mip pyramid rounds")
+{
+	// A 4x4 image with a black top-left quadrant reduces to [0, 255; 255, 255] and then to 191
+	constexpr size_t size = 4;
+	std::vector<uint8_t> image(size * size, 255);
+	image[0] = image[1] = image[4] = image[5] = 0;
+	Render::ConstChannelBuffer<uint8_t> buffer(image, size, size);
+	Render::MipPyramid<uint8_t> pyramid(buffer);
+	REQUIRE(pyramid.num_levels() == 2);
+	CHECK(pyramid.level(2).pixel(0, 0) == 191);
+
+	// Halfway between 0 and 191 is 95.5 which must round up rather than being truncated
+	const Geometry::Point2D<double> uv(0.25, 0.25);
+	CHECK(pyramid.sample_trilinear_uv<double>(buffer, uv, 1.0f) == 0);
+	CHECK(pyramid.sample_trilinear_uv<double>(buffer, uv, 1.5f) == 96);
+}
@@ -2,6 +2,7 @@
 
 #include "PhotoshopFile/PhotoshopFile.h"
 #include "LayeredFile/LayeredFile.h"
+#include "LayeredFile/LayerTypes/ImageLayer.h"
 #include "Macros.h"
 
 #include <filesystem>
@@ -242,4 +243,67 @@ TEST_CASE("Check Roundtripping Grayscale")
 	{
 		checkFileRoundtripping(inDir, outDir, fileName);
 	}
-}
\ No newline at end of file
+}
+
+
+// Gather the size of all the channels in the file, if the channels were passed through on write these must be identical
+std::vector<std::vector<uint64_t>> getChannelSizes(const std::filesystem::path& path)
+{
+	using namespace NAMESPACE_PSAPI;
+
+	ProgressCallback callback;
+	auto inputFile = File(path);
+	auto psDocumentPtr = std::make_unique<PhotoshopFile>();
+	psDocumentPtr->read(inputFile, callback);
+
+	std::vector<std::vector<uint64_t>> sizes;
+	for (const auto& layerRecord : psDocumentPtr->m_LayerMaskInfo.m_LayerInfo.m_LayerRecords)
+	{
+		std::vector<uint64_t> layerSizes;
+		for (const auto& channelInfo : layerRecord.m_ChannelInformation)
+		{
+			layerSizes.push_back(channelInfo.m_Size);
+		}
+		sizes.push_back(layerSizes);
+	}
+	return sizes;
+}
+
+
+template <typename T>
+void checkPassthroughRoundtripping(const std::filesystem::path& inDir, const std::filesystem::path& outDir, const std::filesystem::path& psFile)
+{
+	using namespace NAMESPACE_PSAPI;
+
+	std::filesystem::path fullInPath = inDir / psFile;
+	std::filesystem::path fullOutPath = outDir / ("Passthrough_" + psFile.string());
+	ProgressCallback callback;
+
+	// Only modify metadata, this must not force the channels to be recompressed
+	auto layeredFile = LayeredFile<T>::read(fullInPath, callback, true);
+	for (auto& layer : layeredFile.flat_layers())
+	{
+		layer->name(layer->name() + "_renamed");
+	}
+	LayeredFile<T>::write(std::move(layeredFile), fullOutPath);
+
+	auto expected = LayeredFile<T>::read(fullInPath);
+	auto roundtripped = LayeredFile<T>::read(fullOutPath);
+	auto expectedLayerPtr = find_layer_as<T, ImageLayer>("Layer_R255_G128_B0", expected);
+	auto roundtrippedLayerPtr = find_layer_as<T, ImageLayer>("Layer_R255_G128_B0_renamed", roundtripped);
+	CHECK(expectedLayerPtr->get_image_data() == roundtrippedLayerPtr->get_image_data());
+
+	CHECK(getChannelSizes(fullInPath) == getChannelSizes(fullOutPath));
+}
+
+
+TEST_CASE("Check Roundtripping lazily read files passes through unmodified channels")
+{
+	const std::filesystem::path inDir = std::filesystem::current_path() / "documents/Compression";
+	const std::filesystem::path outDir = std::filesystem::current_path() / "documents/TestRoundtrippingOutput";
+
+	checkPassthroughRoundtripping<NAMESPACE_PSAPI::bpp8_t>(inDir, outDir, "Compression_RLE_8bit.psb");
+	checkPassthroughRoundtripping<NAMESPACE_PSAPI::bpp8_t>(inDir, outDir, "Compression_RLE_8bit.psd");
+	checkPassthroughRoundtripping<NAMESPACE_PSAPI::bpp16_t>(inDir, outDir, "Compression_ZipPrediction_16bit.psb");
+	checkPassthroughRoundtripping<NAMESPACE_PSAPI::bpp16_t>(inDir, outDir, "Compression_ZipPrediction_16bit.psd");
+}
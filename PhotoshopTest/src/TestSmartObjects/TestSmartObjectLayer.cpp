@@ -127,6 +127,46 @@ TEST_CASE("Replace image multiple times same result")
 }
 
 
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Identical smart objects share their warped channels")
+{
+	using namespace NAMESPACE_PSAPI;
+	using bpp_type = uint8_t;
+
+	auto file = LayeredFile<bpp_type>(Enum::ColorMode::RGB, 64, 64);
+	auto& warp_cache = file.linked_layers()->warp_cache();
+
+	Layer<bpp_type>::Params lr_params{};
+	lr_params.name = "SmartObject";
+	lr_params.width = 64;
+	lr_params.height = 32;
+
+	auto layer = std::make_shared<SmartObjectLayer<bpp_type>>(file, lr_params, "documents/image_data/ImageStackerImage.jpg");
+	auto ref = layer->get_image_data();
+	const auto cached_channels = warp_cache.size();
+	CHECK(cached_channels == ref.size());
+
+	// Instances which only differ in their position reuse the cached channels
+	auto instance = std::make_shared<SmartObjectLayer<bpp_type>>(file, lr_params, "documents/image_data/ImageStackerImage.jpg");
+	instance->move(Geometry::Point2D<double>(10.0, 5.0));
+	auto image_data = instance->get_image_data();
+	CHECK(warp_cache.size() == cached_channels);
+	for (const auto& [key, value] : ref)
+	{
+		CHECK_VEC_VERBOSE(value, image_data[key]);
+	}
+
+	// While any other transformation requires warping them again
+	instance->width(100);
+	instance->get_image_data();
+	CHECK(warp_cache.size() == 2 * cached_channels);
+
+	warp_cache.byte_budget(0);
+	CHECK(warp_cache.size() == 0);
+}
+
+
 // ---------------------------------------------------------------------------------------------------------------------
 // ---------------------------------------------------------------------------------------------------------------------
 TEST_CASE("Read all supported warps and write image files")
@@ -0,0 +1,257 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Core/Warp/SmartObjectWarp.h"
+#include "Core/Render/ImageBuffer.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+// Generate a warp of the given size whose interior handles were pushed around such that the mesh is non-affine
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+NAMESPACE_PSAPI::SmartObject::Warp generateBentWarp(size_t width, size_t height)
+{
+	using namespace NAMESPACE_PSAPI;
+
+	auto warp = SmartObject::Warp::generate_default(width, height);
+	auto points = warp.points();
+	points[1] = points[1] + Geometry::Point2D<double>(0.0, -static_cast<double>(height) / 4);
+	points[6] = points[6] + Geometry::Point2D<double>(static_cast<double>(width) / 5, static_cast<double>(height) / 6);
+	points[13] = points[13] + Geometry::Point2D<double>(-static_cast<double>(width) / 8, static_cast<double>(height) / 5);
+	warp.points(points);
+	return warp;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Warping multiple channels at once matches warping them individually")
+{
+	using namespace NAMESPACE_PSAPI;
+	constexpr size_t width = 96;
+	constexpr size_t height = 64;
+
+	auto warp = generateBentWarp(width, height);
+	auto mesh = warp.surface().mesh(width / 10, height / 10, true);
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<int> dist(0, 255);
+	std::vector<std::vector<uint8_t>> images(3, std::vector<uint8_t>(width * height));
+	for (auto& image : images)
+	{
+		for (auto& value : image)
+		{
+			value = static_cast<uint8_t>(dist(rng));
+		}
+	}
+
+	const size_t out_width = static_cast<size_t>(std::ceil(mesh.bbox().width()));
+	const size_t out_height = static_cast<size_t>(std::ceil(mesh.bbox().height()));
+
+	std::vector<std::vector<uint8_t>> individual(images.size(), std::vector<uint8_t>(out_width * out_height));
+	std::vector<std::vector<uint8_t>> combined(images.size(), std::vector<uint8_t>(out_width * out_height));
+	std::vector<Render::ConstChannelBuffer<uint8_t>> image_buffers;
+	std::vector<Render::ChannelBuffer<uint8_t>> combined_buffers;
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		image_buffers.emplace_back(images[i], width, height);
+		combined_buffers.emplace_back(combined[i], out_width, out_height);
+		warp.apply<uint8_t>(Render::ChannelBuffer<uint8_t>(individual[i], out_width, out_height), image_buffers.back(), mesh);
+	}
+	warp.apply<uint8_t>(
+		std::span<Render::ChannelBuffer<uint8_t>>(combined_buffers),
+		std::span<const Render::ConstChannelBuffer<uint8_t>>(image_buffers),
+		mesh);
+
+	for (size_t i = 0; i < images.size(); ++i)
+	{
+		CHECK(individual[i] == combined[i]);
+	}
+	// Make sure we actually rendered something
+	CHECK(std::any_of(combined[0].begin(), combined[0].end(), [](uint8_t value) { return value != 0; }));
+
+	// Mismatching buffer dimensions are rejected
+	std::vector<uint8_t> small(4);
+	combined_buffers.front() = Render::ChannelBuffer<uint8_t>(small, 2, 2);
+	CHECK_THROWS(warp.apply<uint8_t>(
+		std::span<Render::ChannelBuffer<uint8_t>>(combined_buffers),
+		std::span<const Render::ConstChannelBuffer<uint8_t>>(image_buffers),
+		mesh));
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Rasterized warps match the uv lookup")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	for (auto [width, height] : { std::pair<size_t, size_t>{ 96, 64 }, std::pair<size_t, size_t>{ 301, 157 } })
+	{
+		auto warp = generateBentWarp(width, height);
+		auto mesh = warp.surface().mesh(width / 10, height / 10, true);
+
+		std::vector<float> image(width * height);
+		for (size_t y = 0; y < height; ++y)
+		{
+			for (size_t x = 0; x < width; ++x)
+			{
+				image[y * width + x] = static_cast<float>((x / 8 + y / 8) % 2);
+			}
+		}
+
+		const size_t out_width = static_cast<size_t>(std::ceil(mesh.bbox().width()));
+		const size_t out_height = static_cast<size_t>(std::ceil(mesh.bbox().height()));
+		std::vector<float> lookup(out_width * out_height);
+		std::vector<float> rasterized(out_width * out_height);
+		Render::ConstChannelBuffer<float> image_buffer(image, width, height);
+		Render::ChannelBuffer<float> rasterized_buffer(rasterized, out_width, out_height);
+
+		warp.apply<float>(Render::ChannelBuffer<float>(lookup, out_width, out_height), image_buffer, mesh);
+		warp.apply_rasterized<float>(
+			std::span<Render::ChannelBuffer<float>>(&rasterized_buffer, 1),
+			std::span<const Render::ConstChannelBuffer<float>>(&image_buffer, 1),
+			mesh);
+
+		// The interpolated uv coordinates may differ in their last bits while samples lying exactly on an edge shared 
+		// by two faces may be attributed to either of them
+		double total_error = 0.0;
+		for (size_t i = 0; i < lookup.size(); ++i)
+		{
+			total_error += std::abs(lookup[i] - rasterized[i]);
+		}
+		CHECK(total_error / lookup.size() < 1e-4);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Adaptive supersampling matches the fixed supersampling")
+{
+	using namespace NAMESPACE_PSAPI;
+	constexpr size_t width = 301;
+	constexpr size_t height = 157;
+
+	auto warp = generateBentWarp(width, height);
+	auto mesh = warp.surface().mesh(width / 10, height / 10, true);
+	const size_t out_width = static_cast<size_t>(std::ceil(mesh.bbox().width()));
+	const size_t out_height = static_cast<size_t>(std::ceil(mesh.bbox().height()));
+
+	// As the uv coordinates are normalized, the size of the source image decides whether the warp scales it up or down
+	for (double scale : { 0.5, 2.0, 3.0 })
+	{
+		const size_t image_width = static_cast<size_t>(width / scale);
+		const size_t image_height = static_cast<size_t>(height / scale);
+		std::vector<float> image(image_width * image_height);
+		for (size_t y = 0; y < image_height; ++y)
+		{
+			for (size_t x = 0; x < image_width; ++x)
+			{
+				image[y * image_width + x] = 0.5f + 0.5f * static_cast<float>(std::sin(x * 0.2) * std::cos(y * 0.3));
+			}
+		}
+
+		std::vector<float> fixed(out_width * out_height);
+		std::vector<float> adaptive(out_width * out_height);
+		Render::ConstChannelBuffer<float> image_buffer(image, image_width, image_height);
+		Render::ChannelBuffer<float> fixed_buffer(fixed, out_width, out_height);
+		Render::ChannelBuffer<float> adaptive_buffer(adaptive, out_width, out_height);
+
+		warp.apply_rasterized<float>(
+			std::span<Render::ChannelBuffer<float>>(&fixed_buffer, 1),
+			std::span<const Render::ConstChannelBuffer<float>>(&image_buffer, 1),
+			mesh);
+		warp.apply_adaptive<float>(
+			std::span<Render::ChannelBuffer<float>>(&adaptive_buffer, 1),
+			std::span<const Render::ConstChannelBuffer<float>>(&image_buffer, 1),
+			mesh);
+
+		// Singly sampled pixels are not box filtered so we only expect them to be close, the edges of the mesh
+		// however must be anti-aliased identically
+		double total_error = 0.0;
+		double max_error = 0.0;
+		for (size_t i = 0; i < fixed.size(); ++i)
+		{
+			total_error += std::abs(fixed[i] - adaptive[i]);
+			max_error = std::max<double>(max_error, std::abs(fixed[i] - adaptive[i]));
+		}
+		CHECK(total_error / fixed.size() < 1e-3);
+		CHECK(max_error < 0.02);
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Warping with mip pyramids filters images that are scaled down")
+{
+	using namespace NAMESPACE_PSAPI;
+	constexpr size_t width = 200;
+	constexpr size_t height = 150;
+
+	auto warp = generateBentWarp(width, height);
+	auto mesh = warp.surface().mesh(width / 10, height / 10, true);
+	const size_t out_width = static_cast<size_t>(std::ceil(mesh.bbox().width()));
+	const size_t out_height = static_cast<size_t>(std::ceil(mesh.bbox().height()));
+
+	// A single pixel checkerboard scaled down by a factor of 16 which the 4x4 supersampling cannot resolve
+	constexpr size_t scale = 16;
+	const size_t image_width = width * scale;
+	const size_t image_height = height * scale;
+	std::vector<float> image(image_width * image_height);
+	for (size_t y = 0; y < image_height; ++y)
+	{
+		for (size_t x = 0; x < image_width; ++x)
+		{
+			image[y * image_width + x] = static_cast<float>((x + y) % 2);
+		}
+	}
+	Render::ConstChannelBuffer<float> image_buffer(image, image_width, image_height);
+	Render::MipPyramid<float> pyramid(image_buffer);
+	const Render::MipPyramid<float>* pyramid_ptr = &pyramid;
+
+	std::vector<float> fixed(out_width * out_height);
+	std::vector<float> filtered(out_width * out_height);
+	Render::ChannelBuffer<float> fixed_buffer(fixed, out_width, out_height);
+	Render::ChannelBuffer<float> filtered_buffer(filtered, out_width, out_height);
+	warp.apply_rasterized<float>(
+		std::span<Render::ChannelBuffer<float>>(&fixed_buffer, 1),
+		std::span<const Render::ConstChannelBuffer<float>>(&image_buffer, 1),
+		mesh);
+	warp.apply_adaptive<float>(
+		std::span<Render::ChannelBuffer<float>>(&filtered_buffer, 1),
+		std::span<const Render::ConstChannelBuffer<float>>(&image_buffer, 1),
+		std::span<const Render::MipPyramid<float>* const>(&pyramid_ptr, 1),
+		mesh);
+
+	// The interior of the warp should come out as a flat grey, measure how far off each method is
+	auto deviation = [&](const std::vector<float>& data)
+		{
+			double total = 0.0;
+			size_t count = 0;
+			for (size_t y = out_height / 3; y < 2 * out_height / 3; ++y)
+			{
+				for (size_t x = out_width / 3; x < 2 * out_width / 3; ++x)
+				{
+					total += std::abs(data[y * out_width + x] - 0.5);
+					++count;
+				}
+			}
+			return total / count;
+		};
+	CHECK(deviation(filtered) < 0.02);
+	CHECK(deviation(filtered) < deviation(fixed));
+
+	// Pyramids must match the images they are passed with
+	Render::MipPyramid<float> other(Render::ConstChannelBuffer<float>(std::span<const float>(image).subspan(0, 16), 4, 4));
+	const Render::MipPyramid<float>* other_ptr = &other;
+	CHECK_THROWS(warp.apply_adaptive<float>(
+		std::span<Render::ChannelBuffer<float>>(&filtered_buffer, 1),
+		std::span<const Render::ConstChannelBuffer<float>>(&image_buffer, 1),
+		std::span<const Render::MipPyramid<float>* const>(&other_ptr, 1),
+		mesh));
+}
@@ -0,0 +1,90 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "LayeredFile/LinkedData/WarpCache.h"
+#include "Util/Enum.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("WarpCache lookup and eviction")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	constexpr auto red = Enum::ChannelIDInfo{ Enum::ChannelID::Red, 0 };
+	constexpr auto green = Enum::ChannelIDInfo{ Enum::ChannelID::Green, 1 };
+	auto channel = [](size_t size, uint8_t value) { return std::make_shared<const std::vector<uint8_t>>(size, value); };
+
+	WarpCache<uint8_t> cache;
+	cache.byte_budget(300);
+
+	SUBCASE("Entries are keyed on hash, fingerprint and channel")
+	{
+		cache.insert({ "a", 1, red }, channel(100, 1));
+		cache.insert({ "a", 1, green }, channel(100, 2));
+		CHECK(cache.size() == 2);
+		CHECK(cache.byte_size() == 200);
+		CHECK(cache.get({ "a", 1, red })->front() == 1);
+		CHECK(cache.get({ "a", 1, green })->front() == 2);
+		CHECK(cache.get({ "a", 2, red }) == nullptr);
+		CHECK(cache.get({ "b", 1, red }) == nullptr);
+
+		// Inserting the same key again replaces the entry
+		cache.insert({ "a", 1, red }, channel(50, 3));
+		CHECK(cache.size() == 2);
+		CHECK(cache.byte_size() == 150);
+		CHECK(cache.get({ "a", 1, red })->front() == 3);
+	}
+	SUBCASE("The least recently used entries are evicted")
+	{
+		cache.insert({ "a", 1, red }, channel(100, 1));
+		cache.insert({ "b", 1, red }, channel(100, 2));
+		cache.insert({ "c", 1, red }, channel(100, 3));
+		// Touch "a" such that "b" is now the least recently used
+		CHECK(cache.get({ "a", 1, red }) != nullptr);
+		cache.insert({ "d", 1, red }, channel(100, 4));
+
+		CHECK(cache.size() == 3);
+		CHECK(cache.byte_size() == 300);
+		CHECK(cache.get({ "a", 1, red }) != nullptr);
+		CHECK(cache.get({ "b", 1, red }) == nullptr);
+
+		// Lowering the budget evicts right away
+		cache.byte_budget(100);
+		CHECK(cache.size() == 1);
+		CHECK(cache.get({ "a", 1, red }) != nullptr);
+	}
+	SUBCASE("Entries held elsewhere outlive their eviction")
+	{
+		cache.insert({ "a", 1, red }, channel(100, 1));
+		auto held = cache.get({ "a", 1, red });
+		cache.clear();
+		CHECK(cache.size() == 0);
+		CHECK(cache.byte_size() == 0);
+		CHECK(held->size() == 100);
+	}
+	SUBCASE("Erasing a linked layer removes all of its channels")
+	{
+		cache.insert({ "a", 1, red }, channel(10, 1));
+		cache.insert({ "a", 2, green }, channel(10, 1));
+		cache.insert({ "b", 1, red }, channel(10, 1));
+		cache.erase("a");
+		CHECK(cache.size() == 1);
+		CHECK(cache.byte_size() == 10);
+		CHECK(cache.get({ "b", 1, red }) != nullptr);
+	}
+	SUBCASE("Channels exceeding the budget are not cached")
+	{
+		cache.insert({ "a", 1, red }, channel(301, 1));
+		CHECK(cache.size() == 0);
+
+		cache.byte_budget(0);
+		cache.insert({ "a", 1, red }, channel(1, 1));
+		CHECK(cache.size() == 0);
+		CHECK(cache.get({ "a", 1, red }) == nullptr);
+	}
+}
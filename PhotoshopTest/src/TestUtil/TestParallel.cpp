@@ -0,0 +1,105 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Util/Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+// Run the same set of checks against the given executor
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+void checkExecutor(std::shared_ptr<NAMESPACE_PSAPI::Parallel::Executor> executor)
+{
+	using namespace NAMESPACE_PSAPI;
+	Parallel::setExecutor(executor);
+
+	// Every element is visited exactly once
+	std::vector<int> values(10007, 0);
+	Parallel::forEach(values.begin(), values.end(), [](int& value) { value += 1; });
+	CHECK(std::all_of(values.begin(), values.end(), [](int value) { return value == 1; }));
+
+	// Non random-access iterators work as well
+	std::list<int> list(513, 1);
+	std::atomic<int> listSum = 0;
+	Parallel::forEach(list.begin(), list.end(), [&](int value) { listSum += value; });
+	CHECK(listSum == 513);
+
+	// Nested loops run to completion
+	std::vector<int> outer(64);
+	std::iota(outer.begin(), outer.end(), 0);
+	std::atomic<size_t> nestedCount = 0;
+	Parallel::forEach(outer.begin(), outer.end(), [&](int)
+		{
+			std::vector<int> inner(100);
+			Parallel::forEach(inner.begin(), inner.end(), [&](int) { ++nestedCount; });
+		});
+	CHECK(nestedCount == 6400);
+
+	// Exceptions get propagated to the caller
+	CHECK_THROWS(Parallel::forEach(values.begin(), values.end(), [](int value)
+		{
+			if (value == 1)
+				throw std::runtime_error("error");
+		}));
+
+	Parallel::setExecutor(nullptr);
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("Parallel loops on the different executors")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	SUBCASE("Std")
+	{
+		checkExecutor(std::make_shared<Parallel::StdExecutor>());
+	}
+	SUBCASE("Serial")
+	{
+		checkExecutor(std::make_shared<Parallel::SerialExecutor>());
+	}
+	SUBCASE("ThreadPool")
+	{
+		checkExecutor(std::make_shared<Parallel::ThreadPoolExecutor>(4));
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
+TEST_CASE("ThreadPoolExecutor caps the number of threads")
+{
+	using namespace NAMESPACE_PSAPI;
+	Parallel::setNumThreads(3);
+	CHECK(Parallel::executor()->concurrency() == 3);
+
+	std::atomic<int> running = 0;
+	std::atomic<int> maxRunning = 0;
+	std::vector<int> outer(16);
+	Parallel::forEach(outer.begin(), outer.end(), [&](int)
+		{
+			std::vector<int> inner(16);
+			Parallel::forEach(inner.begin(), inner.end(), [&](int)
+				{
+					const int current = ++running;
+					int expected = maxRunning.load();
+					while (current > expected && !maxRunning.compare_exchange_weak(expected, current)) {}
+					std::this_thread::sleep_for(std::chrono::microseconds(50));
+					--running;
+				});
+		});
+	CHECK(maxRunning <= 3);
+
+	Parallel::setNumThreads(0);
+}
@@ -0,0 +1,61 @@
+#include "doctest.h"
+
+#include "Macros.h"
+#include "Util/ScratchArena.h"
+
+#include <cstdint>
+
+
+TEST_CASE("Scratch buffers are reused by size class")
+{
+	using namespace NAMESPACE_PSAPI;
+
+	Scratch::Arena arena;
+
+	SUBCASE("Released buffers are handed out again")
+	{
+		const uint8_t* data = nullptr;
+		{
+			Scratch::Buffer buffer = arena.acquire(5000);
+			CHECK(buffer.capacity() == 8192);
+			data = buffer.as<uint8_t>(5000).data();
+		}
+		CHECK(arena.cachedBytes() == 8192);
+
+		// A request of the same size class gets the same memory back while a different size class allocates
+		Scratch::Buffer same = arena.acquire(8000);
+		CHECK(same.as<uint8_t>(8000).data() == data);
+		CHECK(arena.cachedBytes() == 0);
+		Scratch::Buffer other = arena.acquire(100);
+		CHECK(other.capacity() == 4096);
+		CHECK(other.as<uint8_t>(100).data() != data);
+	}
+
+	SUBCASE("Large buffers are not cached")
+	{
+		const size_t size = (size_t(1) << Scratch::MAX_SIZE_CLASS) + 1;
+		{
+			Scratch::Buffer buffer = arena.acquire(size);
+			CHECK(buffer.capacity() == size);
+		}
+		CHECK(arena.cachedBytes() == 0);
+	}
+
+	SUBCASE("Viewing past the capacity throws")
+	{
+		Scratch::Buffer buffer = arena.acquire(4096);
+		CHECK(buffer.as<float>(1024).size() == 1024);
+		CHECK_THROWS(buffer.as<float>(1025));
+	}
+
+	SUBCASE("Clearing frees the cached buffers")
+	{
+		{
+			Scratch::Buffer a = arena.acquire(4096);
+			Scratch::Buffer b = arena.acquire(4096);
+		}
+		CHECK(arena.cachedBytes() == 8192);
+		arena.clear();
+		CHECK(arena.cachedBytes() == 0);
+	}
+}